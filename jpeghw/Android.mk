@@ -14,3 +14,148 @@ include $(CLEAR_VARS)
 LOCAL_PREBUILT_LIBS := librkswscale.so
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_MULTI_PREBUILT)
+
+# Helpers on top of the Hantro JPEG decoder and encoder, post-processing through libvpu_helper.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				hw_jpeg_util.c \
+				hw_jpeg_slice.c \
+				hw_jpeg_batch.c \
+				hw_jpeg_thumb.c \
+				hw_jpeg_source.c \
+				hw_jpeg_soft.c \
+				hw_jpeg_index.c \
+				hw_jpeg_tiles.c \
+				hw_jpeg_burst.c \
+				hw_jpeg_scale.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/release/decoder_release \
+				$(LOCAL_PATH)/release/encode_release \
+				$(LOCAL_PATH)/src_dec/common \
+				$(LOCAL_PATH)/src_dec/inc \
+				$(LOCAL_PATH)/../libon2 \
+				$(LOCAL_PATH)/../libgralloc_ump
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libvpu libjpeghwdec libjpeghwenc libUMP
+LOCAL_STATIC_LIBRARIES := libvpu_helper libgralloc_priv
+LOCAL_MODULE := libjpeghw_helper
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_STATIC_LIBRARY)
+
+# NV12 scaler speed across camera frame sizes, scalar against vector rows, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				hw_jpeg_scale.c \
+				hw_jpeg_scale_bench.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/release/decoder_release \
+				$(LOCAL_PATH)/src_dec/common \
+				$(LOCAL_PATH)/src_dec/inc \
+				$(LOCAL_PATH)/../libon2
+
+LOCAL_CFLAGS := -DHW_JPEG_SCALE_BENCH_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := hw_jpeg_scale_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Thumbnail grid throughput of hw_jpeg_batch against hw_jpeg_decode per picture, needs the decoder:
+# adb shell hw_jpeg_batch_bench <dir> [cell [passes]]
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := hw_jpeg_batch_bench.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/release/decoder_release \
+				$(LOCAL_PATH)/src_dec/common \
+				$(LOCAL_PATH)/src_dec/inc \
+				$(LOCAL_PATH)/../libon2 \
+				$(LOCAL_PATH)/../libgralloc_ump
+
+LOCAL_STATIC_LIBRARIES := libjpeghw_helper libvpu_helper libgralloc_priv
+LOCAL_SHARED_LIBRARIES := liblog libcutils libvpu libjpeghwdec libjpeghwenc libUMP
+LOCAL_MODULE := hw_jpeg_batch_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Thumbnail or scaled picture choice of hw_jpeg_pick, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				hw_jpeg_thumb.c \
+				hw_jpeg_thumb_test.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/release/decoder_release \
+				$(LOCAL_PATH)/src_dec/common \
+				$(LOCAL_PATH)/src_dec/inc \
+				$(LOCAL_PATH)/../libon2
+
+LOCAL_CFLAGS := -DHW_JPEG_THUMB_TEST_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_MODULE := hw_jpeg_thumb_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Software decoder output, crop, scaling, threads and restart errors on a generated stream, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				hw_jpeg_soft.c \
+				hw_jpeg_test_stream.c \
+				hw_jpeg_soft_test.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/release/decoder_release \
+				$(LOCAL_PATH)/src_dec/common \
+				$(LOCAL_PATH)/src_dec/inc \
+				$(LOCAL_PATH)/../libon2
+
+LOCAL_CFLAGS := -DHW_JPEG_SOFT_TEST_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := hw_jpeg_soft_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Restart marker index plans and cuts, decoded against the whole picture, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				hw_jpeg_index.c \
+				hw_jpeg_soft.c \
+				hw_jpeg_test_stream.c \
+				hw_jpeg_index_test.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/release/decoder_release \
+				$(LOCAL_PATH)/src_dec/common \
+				$(LOCAL_PATH)/src_dec/inc \
+				$(LOCAL_PATH)/../libon2
+
+LOCAL_CFLAGS := -DHW_JPEG_INDEX_TEST_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := hw_jpeg_index_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Index and tile caches: hits, evictions, budget and invalidation, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				hw_jpeg_tiles.c \
+				hw_jpeg_index.c \
+				hw_jpeg_test_stream.c \
+				hw_jpeg_tiles_test.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/release/decoder_release \
+				$(LOCAL_PATH)/src_dec/common \
+				$(LOCAL_PATH)/src_dec/inc \
+				$(LOCAL_PATH)/../libon2
+
+LOCAL_CFLAGS := -DHW_JPEG_TILES_TEST_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := hw_jpeg_tiles_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
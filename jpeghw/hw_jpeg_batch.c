@@ -0,0 +1,659 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_batch.c
+    Description:
+        Batch JPEG decode with a warm decoder instance and stream prefetch
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_batch"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_mem_range.h"
+#include "vpu_hw_caps.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_thumb.h"
+#include "hw_jpeg_soft.h"
+#include "hw_jpeg_batch.h"
+#include "ump/include/ump/ump_ref_drv.h"
+
+/* one stream on the hardware, one being loaded */
+#define BATCH_STREAMS               (2)
+#define BATCH_STREAM_DEF            (256 * 1024)
+/* the decoder reads a little past the end of the stream */
+#define BATCH_STREAM_PAD            (64)
+#define BATCH_ALIGN(x, a)           (((x) + (a) - 1) & ~((a) - 1))
+
+typedef struct BatchJob
+{
+    HwJpegBatchItem     item;
+    HwJpegBatchResult   result;
+    VPUMemLinear_t      *stream;        /* set by the loader */
+    int                 length;         /* of the stream handed to the decoder */
+    HwJpegCut           cut;            /* cut.bytes 0: the whole stream */
+    RK_S64              submitUs;
+} BatchJob;
+
+/*
+ * Jobs live in a ring of queueDepth entries and move through it by four
+ * running counters: submitted >= loaded >= decoded >= collected. Job k uses
+ * stream buffer k % BATCH_STREAMS, so the loader stays at most one picture
+ * ahead of the decoder.
+ */
+struct HwJpegBatch
+{
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    pthread_t           loader;
+    pthread_t           decoder;
+    int                 threads;
+    int                 softThreads;
+    int                 quit;
+    RK_U32              depth;
+    RK_U32              submitted;
+    RK_U32              loaded;
+    RK_U32              decoded;
+    RK_U32              collected;
+    BatchJob            *jobs;
+    VPUMemLinear_t      stream[BATCH_STREAMS];
+    HwJpegBatchStats    stats;
+
+    /* decoder thread only */
+    JpegDecInst         inst;
+    VPUMemLinear_t      yuv;
+    VPUMemLinear_t      out;
+    VPUSchedSession_t   *pp;
+    RK_U32              regs[VPU_REG_NUM_DEC_PP];
+};
+
+static struct timespec *batch_deadline(struct timespec *ts, int timeoutMs)
+{
+    if (timeoutMs < 0)
+        return NULL;
+
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += timeoutMs / 1000;
+    ts->tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static int batch_wait(HwJpegBatch *b, const struct timespec *deadline)
+{
+    if (deadline == NULL)
+        return pthread_cond_wait(&b->cond, &b->lock);
+    return pthread_cond_timedwait(&b->cond, &b->lock, deadline);
+}
+
+/*
+ * A stream in VPU memory is read in place when the decoder can read past
+ * its end. A buffer of unknown size may end right after the stream, so it
+ * is copied like a stream in plain memory.
+ */
+static int batch_in_place(const HwJpegBatchItem *it)
+{
+    return it->mem != NULL && it->mem->size &&
+           (RK_U32)it->length + BATCH_STREAM_PAD <= it->mem->size;
+}
+
+static void *batch_loader(void *arg)
+{
+    HwJpegBatch *b = (HwJpegBatch *)arg;
+
+    pthread_mutex_lock(&b->lock);
+    for (;;) {
+        BatchJob *job;
+        VPUMemLinear_t *m;
+        int grown, length;
+        RK_S64 t;
+
+        while (!b->quit && (b->loaded == b->submitted ||
+                            b->loaded - b->decoded >= BATCH_STREAMS))
+            pthread_cond_wait(&b->cond, &b->lock);
+        if (b->quit)
+            break;
+
+        job = &b->jobs[b->loaded % b->depth];
+        m = &b->stream[b->loaded % BATCH_STREAMS];
+        length = job->length;
+        if (job->result.status != JPEGDEC_OK || (batch_in_place(&job->item) && !job->cut.bytes)) {
+            /* refused at submission, or decoded in place */
+            job->stream = job->item.mem;
+            b->loaded++;
+            pthread_cond_broadcast(&b->cond);
+            continue;
+        }
+        pthread_mutex_unlock(&b->lock);
+
+        /* the copy overlaps the picture the decoder is working on */
+        t = hw_jpeg_now_us();
+        grown = hw_jpeg_reserve(m, length + BATCH_STREAM_PAD);
+        if (grown >= 0) {
+            const unsigned char *data = job->item.data;
+
+            if (data == NULL)
+                data = (const unsigned char *)job->item.mem->vir_addr;
+            if (job->cut.bytes)
+                hw_jpeg_index_cut(job->item.index, data, &job->cut, (unsigned char *)m->vir_addr);
+            else
+                memcpy(m->vir_addr, data, length);
+        }
+        if (grown >= 0) {
+            memset((RK_U8 *)m->vir_addr + length, 0, BATCH_STREAM_PAD);
+            VPUMemCleanRange(m, 0, length + BATCH_STREAM_PAD);
+        }
+        t = hw_jpeg_now_us() - t;
+
+        pthread_mutex_lock(&b->lock);
+        if (grown < 0)
+            job->result.status = JPEGDEC_MEMFAIL;
+        else if (grown)
+            b->stats.bufferGrows++;
+        job->stream = m;
+        b->stats.loadUs += t;
+        b->stats.streamBytes += length;
+        b->loaded++;
+        pthread_cond_broadcast(&b->cond);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    return NULL;
+}
+
+/* replace scale_denom, and the picture by its thumbnail, to just cover the requested size */
+static int batch_pick(const HwJpegBatchItem *it, JpegDecImageInfo *info, PostProcessInfo *ppInfo,
+                      JpegDecInput *in, HwJpegBatchResult *result)
+{
+    JpegDecImageInfo view = *info;
+    HwJpegPick pick;
+
+    /* a crop window is in picture pixels, it is the window that has to cover the request */
+    if (ppInfo->cropW > 0 && ppInfo->cropH > 0) {
+        view.displayWidth = MIN((RK_U32)ppInfo->cropW, info->displayWidth);
+        view.displayHeight = MIN((RK_U32)ppInfo->cropH, info->displayHeight);
+        view.thumbnailType = JPEGDEC_NO_THUMBNAIL;
+    }
+
+    if (hw_jpeg_pick(&view, it->reqWidth, it->reqHeight, &pick))
+        return JPEGDEC_UNSUPPORTED;
+
+    ppInfo->scale_denom = pick.scaleDenom;
+    result->scaleDenom = pick.scaleDenom;
+
+    if (pick.useThumb) {
+        in->decImageType = JPEGDEC_THUMBNAIL;
+        info->displayWidth = info->displayWidthThumb;
+        info->displayHeight = info->displayHeightThumb;
+        info->outputWidth = info->outputWidthThumb;
+        info->outputHeight = info->outputHeightThumb;
+        info->outputFormat = info->outputFormatThumb;
+        info->codingMode = info->codingModeThumb;
+        result->thumbnail = 1;
+    }
+
+    return JPEGDEC_OK;
+}
+
+/* output geometry of one item, the crop window widened to whole macroblocks */
+static int batch_plan(const JpegDecImageInfo *info, const PostProcessInfo *ppInfo,
+                      VPU_POSTPROCESSING *pp, RK_U32 *cropX, RK_U32 *cropY,
+                      RK_U32 *visW, RK_U32 *visH)
+{
+    RK_U32 denom = ppInfo->scale_denom > 0 ? ppInfo->scale_denom : 1;
+    RK_U32 x0 = 0, y0 = 0, x1 = info->displayWidth, y1 = info->displayHeight;
+    RK_U32 ppFlags = VPU_HW_PP_NONE;
+    int color = hw_jpeg_pp_color(ppInfo->outFomart);
+
+    if (color < 0 || (denom & (denom - 1)) || denom > 8)
+        return JPEGDEC_PARAM_ERROR;
+    if (hw_jpeg_layout(info->outputFormat) == NULL)
+        return JPEGDEC_UNSUPPORTED;
+
+    if (ppInfo->cropW > 0 && ppInfo->cropH > 0) {
+        x0 = MIN((RK_U32)MAX(ppInfo->cropX, 0), info->displayWidth);
+        y0 = MIN((RK_U32)MAX(ppInfo->cropY, 0), info->displayHeight);
+        x1 = MIN(x0 + ppInfo->cropW, info->displayWidth);
+        y1 = MIN(y0 + ppInfo->cropH, info->displayHeight);
+        if (x1 <= x0 || y1 <= y0)
+            return JPEGDEC_PARAM_ERROR;
+    }
+
+    *cropX = x0 & ~15;
+    *cropY = y0 & ~15;
+
+    memset(pp, 0, sizeof(*pp));
+    pp->InputWidth = MIN(BATCH_ALIGN(x1, 16), info->outputWidth) - *cropX;
+    pp->InputHeight = MIN(BATCH_ALIGN(y1, 16), info->outputHeight) - *cropY;
+    pp->OutputWidth = BATCH_ALIGN(MAX(pp->InputWidth / denom, 8), 8);
+    pp->OutputHeight = BATCH_ALIGN(MAX(pp->InputHeight / denom, 2), 2);
+    pp->ColorType = color;
+    pp->ScaleEn = (pp->OutputWidth != pp->InputWidth || pp->OutputHeight != pp->InputHeight);
+    pp->DitherEn = ppInfo->shouldDither ? 1 : 0;
+
+    *visW = MIN((x1 - *cropX + denom - 1) / denom, pp->OutputWidth);
+    *visH = MIN((y1 - *cropY + denom - 1) / denom, pp->OutputHeight);
+
+    if (pp->ScaleEn)
+        ppFlags |= VPU_HW_PP_SCALE;
+    if (pp->DitherEn)
+        ppFlags |= VPU_HW_PP_DITHER;
+
+    if (!VPUHwCapsCanDecodeJpeg(info->displayWidth, info->displayHeight,
+                                info->codingMode == JPEGDEC_PROGRESSIVE, ppFlags) ||
+        !VPUHwCapsCanPostProcess(pp->OutputWidth, ppFlags))
+        return JPEGDEC_UNSUPPORTED;
+
+    return JPEGDEC_OK;
+}
+
+/* dst is reachable by the post-processor and has room for its padded rows */
+static int batch_direct(const HwJpegBatchItem *it, const VPU_POSTPROCESSING *pp, int bpp)
+{
+    RK_U32 bytes = it->dstStride * pp->OutputHeight;
+
+    /* the rows to keep coherent have to lie in dstMem */
+    if (it->dstMem != NULL &&
+        ((RK_U8 *)it->dst < (RK_U8 *)it->dstMem->vir_addr ||
+         (RK_U8 *)it->dst + bytes > (RK_U8 *)it->dstMem->vir_addr + it->dstMem->size))
+        return 0;
+
+    return it->dstPhys && !(it->dstPhys & 7) && !(it->dstStride % bpp) &&
+           it->dstStride / bpp <= VPU_DEC_PP_MAX_DISPLAY_WIDTH &&
+           it->dstStride >= (int)pp->OutputWidth * bpp &&
+           it->dstSize >= (int)bytes;
+}
+
+/*
+ * Write back and discard the CPU's lines over the rows the post-processor
+ * writes in dst, so that neither a dirty line evicted later nor a stale one
+ * read later hides its output. Run before and after the job.
+ */
+static void batch_direct_sync(const HwJpegBatchItem *it, RK_U32 bytes)
+{
+    if (it->dstMem != NULL)
+        VPUMemFlushRange(it->dstMem, (RK_U8 *)it->dst - (RK_U8 *)it->dstMem->vir_addr, bytes);
+    else if (it->dstUmp != UMP_INVALID_MEMORY_HANDLE)
+        ump_cpu_msync_now(it->dstUmp, UMP_MSYNC_CLEAN_AND_INVALIDATE, it->dst, bytes);
+}
+
+static int batch_decode(HwJpegBatch *b, VPUMemLinear_t *stream, BatchJob *job)
+{
+    const HwJpegBatchItem *it = &job->item;
+    const HwJpegLayout *layout;
+    JpegDecImageInfo info;
+    JpegDecInput in;
+    JpegDecOutput out;
+    PostProcessInfo ppInfo = it->ppInfo;
+    VPU_POSTPROCESSING pp;
+    RK_U32 cropX, cropY, visW, visH, lumaBytes, y;
+    int ret, grows = 0, bpp, direct;
+    RK_S64 t;
+
+    memset(&in, 0, sizeof(in));
+    in.streamBuffer.pVirtualAddress = stream->vir_addr;
+    in.streamBuffer.busAddress = stream->phy_addr;
+    in.streamLength = job->length;
+    in.decImageType = JPEGDEC_IMAGE;
+
+    ret = JpegDecGetImageInfo(b->inst, &in, &info);
+    if (ret != JPEGDEC_OK)
+        return ret;
+
+    /* a cut is a picture of its own, starting at line cut.y of the original */
+    ppInfo.cropY -= job->cut.y;
+
+    job->result.scaleDenom = MAX(ppInfo.scale_denom, 1);
+    if (it->reqWidth > 0 || it->reqHeight > 0) {
+        ret = batch_pick(it, &info, &ppInfo, &in, &job->result);
+        if (ret != JPEGDEC_OK)
+            return ret;
+    }
+
+    ret = batch_plan(&info, &ppInfo, &pp, &cropX, &cropY, &visW, &visH);
+    if (ret != JPEGDEC_OK)
+        return ret;
+
+    bpp = hw_jpeg_pp_bpp(pp.ColorType);
+    if (it->dst == NULL || it->dstStride < (int)visW * bpp || it->dstSize < it->dstStride * (int)visH)
+        return JPEGDEC_PARAM_ERROR;
+    direct = batch_direct(it, &pp, bpp);
+
+    /* the buffers only ever grow, a grid of similar pictures allocates once */
+    layout = hw_jpeg_layout(info.outputFormat);
+    lumaBytes = info.outputWidth * info.outputHeight;
+    ret = hw_jpeg_reserve(&b->yuv, hw_jpeg_yuv_bytes(layout, info.outputWidth, info.outputHeight));
+    if (ret >= 0)
+        grows += ret;
+    if (ret >= 0 && !direct &&
+        (ret = hw_jpeg_reserve(&b->out, pp.OutputWidth * pp.OutputHeight * bpp)) >= 0)
+        grows += ret;
+    if (ret < 0)
+        return JPEGDEC_MEMFAIL;
+
+    in.pictureBufferY.pVirtualAddress = b->yuv.vir_addr;
+    in.pictureBufferY.busAddress = b->yuv.phy_addr;
+    in.pictureBufferCbCr.pVirtualAddress = b->yuv.vir_addr + lumaBytes / 4;
+    in.pictureBufferCbCr.busAddress = b->yuv.phy_addr + lumaBytes;
+
+    t = hw_jpeg_now_us();
+    do {
+        ret = JpegDecDecode(b->inst, &in, &out);
+    } while (ret == JPEGDEC_SCAN_PROCESSED);
+    t = hw_jpeg_now_us() - t;
+
+    pthread_mutex_lock(&b->lock);
+    b->stats.decodeUs += t;
+    b->stats.bufferGrows += grows;
+    pthread_mutex_unlock(&b->lock);
+
+    if (ret != JPEGDEC_FRAME_READY)
+        return ret < 0 ? ret : JPEGDEC_ERROR;
+
+    pp.InputAddr[0] = out.outputPictureY.busAddress;
+    pp.InputAddr[1] = out.outputPictureCbCr.busAddress;
+    pp.OutputAddr[0] = direct ? it->dstPhys : b->out.phy_addr;
+
+    t = hw_jpeg_now_us();
+    if (direct)
+        batch_direct_sync(it, it->dstStride * pp.OutputHeight);
+    ret = hw_jpeg_pp_run(b->pp, b->regs, &pp, layout, info.outputWidth, cropX, cropY,
+                         direct ? it->dstStride / bpp : 0);
+    if (direct)
+        batch_direct_sync(it, it->dstStride * pp.OutputHeight);
+    t = hw_jpeg_now_us() - t;
+    if (ret != JPEGDEC_OK)
+        return ret;
+
+    job->result.width = visW;
+    job->result.height = visH;
+    job->result.direct = direct;
+    job->result.roi = job->cut.bytes != 0;
+
+    pthread_mutex_lock(&b->lock);
+    b->stats.ppUs += t;
+    pthread_mutex_unlock(&b->lock);
+
+    if (direct)
+        return JPEGDEC_OK;
+
+    t = hw_jpeg_now_us();
+    VPUMemInvalidateRange(&b->out, 0, pp.OutputWidth * visH * bpp);
+    for (y = 0; y < visH; y++)
+        memcpy((RK_U8 *)it->dst + y * it->dstStride,
+               (RK_U8 *)b->out.vir_addr + y * pp.OutputWidth * bpp, visW * bpp);
+    t = hw_jpeg_now_us() - t;
+
+    pthread_mutex_lock(&b->lock);
+    b->stats.copyUs += t;
+    pthread_mutex_unlock(&b->lock);
+
+    return JPEGDEC_OK;
+}
+
+/* the hardware refused the picture; decode it in software, straight into dst */
+static int batch_soft(HwJpegBatch *b, BatchJob *job)
+{
+    const HwJpegBatchItem *it = &job->item;
+    const unsigned char *data = it->data;
+    PostProcessInfo ppInfo = it->ppInfo;
+    HwJpegSoftInfo info;
+    int ret, w, h;
+
+    if (data == NULL)
+        data = (const unsigned char *)it->mem->vir_addr;
+    memset(&info, 0, sizeof(info));
+
+    /* the same origin as the hardware path, the window widened to the macroblock grid */
+    if (ppInfo.cropW > 0 && ppInfo.cropH > 0) {
+        int x0 = MAX(ppInfo.cropX, 0), y0 = MAX(ppInfo.cropY, 0);
+
+        ppInfo.cropX = x0 & ~15;
+        ppInfo.cropY = y0 & ~15;
+        ppInfo.cropW += x0 - ppInfo.cropX;
+        ppInfo.cropH += y0 - ppInfo.cropY;
+    }
+
+    if (it->reqWidth > 0 || it->reqHeight > 0) {
+        ret = hw_jpeg_soft_probe(data, it->length, &w, &h);
+        if (ret != JPEGDEC_OK)
+            return ret;
+        if (ppInfo.cropW > 0 && ppInfo.cropH > 0) {
+            w = MIN(ppInfo.cropW, w);
+            h = MIN(ppInfo.cropH, h);
+        }
+        ppInfo.scale_denom = MAX(hw_jpeg_pick_denom(w, h, it->reqWidth, it->reqHeight), 1);
+    }
+
+    ret = hw_jpeg_soft_decode(data, it->length, &ppInfo, it->dst, it->dstStride, it->dstSize,
+                              b->softThreads, &info);
+
+    pthread_mutex_lock(&b->lock);
+    b->stats.softUs += info.decodeUs;
+    pthread_mutex_unlock(&b->lock);
+
+    if (ret != JPEGDEC_OK)
+        return ret;
+
+    job->result.width = info.width;
+    job->result.height = info.height;
+    job->result.thumbnail = 0;
+    job->result.software = 1;
+    job->result.roi = 0;
+    job->result.scaleDenom = MAX(ppInfo.scale_denom, 1);
+    return JPEGDEC_OK;
+}
+
+static void *batch_decoder(void *arg)
+{
+    HwJpegBatch *b = (HwJpegBatch *)arg;
+
+    pthread_mutex_lock(&b->lock);
+    for (;;) {
+        BatchJob *job;
+        RK_S64 t = 0;
+
+        if (!b->quit && b->decoded == b->loaded && b->decoded != b->submitted)
+            t = hw_jpeg_now_us();
+        while (!b->quit && b->decoded == b->loaded)
+            pthread_cond_wait(&b->cond, &b->lock);
+        if (b->quit)
+            break;
+        if (t)
+            b->stats.starvedUs += hw_jpeg_now_us() - t;
+
+        job = &b->jobs[b->decoded % b->depth];
+        pthread_mutex_unlock(&b->lock);
+
+        if (job->result.status == JPEGDEC_OK)
+            job->result.status = batch_decode(b, job->stream, job);
+        if ((job->result.status == JPEGDEC_UNSUPPORTED ||
+             job->result.status == JPEGDEC_FORMAT_NOT_SUPPORTED) && b->softThreads >= 0)
+            job->result.status = batch_soft(b, job);
+        job->result.latencyUs = hw_jpeg_now_us() - job->submitUs;
+
+        pthread_mutex_lock(&b->lock);
+        b->stats.pictures++;
+        if (job->result.status != JPEGDEC_OK)
+            b->stats.failed++;
+        else if (job->result.thumbnail)
+            b->stats.thumbnails++;
+        else if (job->result.software)
+            b->stats.software++;
+        if (job->result.status == JPEGDEC_OK && job->result.direct)
+            b->stats.direct++;
+        if (job->result.status == JPEGDEC_OK && job->result.roi) {
+            b->stats.roi++;
+            b->stats.roiSkippedBytes += job->item.length - job->length;
+        }
+        b->decoded++;
+        pthread_cond_broadcast(&b->cond);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    return NULL;
+}
+
+HwJpegBatch *hw_jpeg_batch_create(const HwJpegBatchCfg *cfg)
+{
+    HwJpegBatch *b;
+    RK_U32 depth = HW_JPEG_BATCH_DEPTH_DEF;
+    int i, streamBytes = BATCH_STREAM_DEF, softThreads = 0;
+
+    if (cfg != NULL) {
+        if (cfg->queueDepth > 0)
+            depth = MIN(cfg->queueDepth, HW_JPEG_BATCH_DEPTH_MAX);
+        if (cfg->streamBytes > 0)
+            streamBytes = cfg->streamBytes;
+        softThreads = cfg->softThreads;
+    }
+
+    b = (HwJpegBatch *)calloc(1, sizeof(*b));
+    if (b == NULL)
+        return NULL;
+
+    b->depth = depth;
+    b->softThreads = softThreads;
+    b->jobs = (BatchJob *)calloc(depth, sizeof(BatchJob));
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond, NULL);
+
+    if (b->jobs == NULL)
+        goto fail;
+
+    for (i = 0; i < BATCH_STREAMS; i++) {
+        if (hw_jpeg_reserve(&b->stream[i], streamBytes + BATCH_STREAM_PAD) < 0)
+            goto fail;
+    }
+
+    if (JpegDecInit(&b->inst) != JPEGDEC_OK) {
+        ALOGE("JpegDecInit failed");
+        b->inst = NULL;
+        goto fail;
+    }
+
+    b->pp = VPUSchedOpen(VPU_PP, VPU_SCHED_PRIO_BACKGROUND, VPU_SCHED_DEFAULT_WEIGHT);
+    if (b->pp == NULL)
+        goto fail;
+
+    if (pthread_create(&b->decoder, NULL, batch_decoder, b))
+        goto fail;
+    b->threads = 1;
+    if (pthread_create(&b->loader, NULL, batch_loader, b)) {
+        hw_jpeg_batch_destroy(b);
+        return NULL;
+    }
+    b->threads = 2;
+
+    return b;
+
+fail:
+    hw_jpeg_batch_destroy(b);
+    return NULL;
+}
+
+void hw_jpeg_batch_destroy(HwJpegBatch *b)
+{
+    int i;
+
+    if (b == NULL)
+        return;
+
+    pthread_mutex_lock(&b->lock);
+    b->quit = 1;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+
+    if (b->threads > 0)
+        pthread_join(b->decoder, NULL);
+    if (b->threads > 1)
+        pthread_join(b->loader, NULL);
+
+    if (b->pp != NULL)
+        VPUSchedClose(b->pp);
+    if (b->inst != NULL)
+        JpegDecRelease(b->inst);
+    for (i = 0; i < BATCH_STREAMS; i++)
+        hw_jpeg_unreserve(&b->stream[i]);
+    hw_jpeg_unreserve(&b->yuv);
+    hw_jpeg_unreserve(&b->out);
+
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->lock);
+    free(b->jobs);
+    free(b);
+}
+
+int hw_jpeg_batch_submit(HwJpegBatch *b, const HwJpegBatchItem *items, int n)
+{
+    int i;
+
+    if (b == NULL || items == NULL || n <= 0)
+        return 0;
+
+    pthread_mutex_lock(&b->lock);
+    for (i = 0; i < n && b->submitted - b->collected < b->depth; i++) {
+        BatchJob *job = &b->jobs[b->submitted % b->depth];
+
+        job->item = items[i];
+        memset(&job->result, 0, sizeof(job->result));
+        job->result.cookie = items[i].cookie;
+        if ((items[i].data == NULL && items[i].mem == NULL) || items[i].length <= 0 ||
+            (items[i].mem != NULL && items[i].mem->size &&
+             (RK_U32)items[i].length > items[i].mem->size))
+            job->result.status = JPEGDEC_INVALID_STREAM_LENGTH;
+        job->length = items[i].length;
+        memset(&job->cut, 0, sizeof(job->cut));
+        if (items[i].index != NULL && items[i].ppInfo.cropW > 0 && items[i].ppInfo.cropH > 0 &&
+            !hw_jpeg_index_plan(items[i].index, items[i].ppInfo.cropY,
+                                items[i].ppInfo.cropY + items[i].ppInfo.cropH, &job->cut))
+            job->length = job->cut.bytes;
+        job->submitUs = hw_jpeg_now_us();
+        b->submitted++;
+    }
+    if (i)
+        pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+
+    return i;
+}
+
+int hw_jpeg_batch_wait(HwJpegBatch *b, HwJpegBatchResult *result, int timeoutMs)
+{
+    struct timespec ts, *deadline = batch_deadline(&ts, timeoutMs);
+    int ret = -1;
+
+    if (b == NULL || result == NULL)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    while (b->collected != b->submitted && b->collected == b->decoded) {
+        if (batch_wait(b, deadline) == ETIMEDOUT)
+            break;
+    }
+    if (b->collected != b->decoded) {
+        *result = b->jobs[b->collected % b->depth].result;
+        b->collected++;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    return ret;
+}
+
+void hw_jpeg_batch_get_stats(HwJpegBatch *b, HwJpegBatchStats *stats)
+{
+    if (b == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&b->lock);
+    *stats = b->stats;
+    pthread_mutex_unlock(&b->lock);
+}
@@ -0,0 +1,153 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_batch.h
+    Description:
+        Batch JPEG decode for thumbnail grids and media scanning. Every
+        hw_jpeg_decode call goes through JpegDecInit, buffer allocation and
+        hw_jpeg_release, which for small pictures costs more than the
+        decode. A batch keeps one decoder instance, its VPU buffers and a
+        post-processor session for its whole life. Submitted pictures are
+        copied into VPU memory by a loader thread while the previous one is
+        on the hardware, and finished pictures come back through a
+        completion queue in submission order. Pictures the hardware
+        refuses are decoded by hw_jpeg_soft on the decoder thread instead
+        of failing.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_BATCH_H__
+#define __HW_JPEG_BATCH_H__
+
+#include "vpu_mem.h"
+#include "hw_jpegdecapi.h"
+#include "hw_jpeg_index.h"
+#include "ump/include/ump/ump.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HW_JPEG_BATCH_DEPTH_DEF         (32)
+#define HW_JPEG_BATCH_DEPTH_MAX         (256)
+
+typedef struct
+{
+  int queueDepth;       /* pictures submitted and not yet collected; 0: default */
+  int streamBytes;      /* initial stream buffer size, grown on demand; 0: default */
+  int softThreads;      /* threads of the software fallback; 0: one per core, < 0: no fallback */
+} HwJpegBatchCfg;
+
+typedef struct
+{
+  const unsigned char *data;    /* whole JFIF, must stay valid until its result is collected */
+  int length;
+  /*
+   * The same stream already in VPU memory, e.g. from hw_jpeg_source: it
+   * is decoded in place instead of being copied, data may be NULL, when
+   * mem->size leaves HW_JPEG_SOURCE_PAD bytes of slack after the stream;
+   * otherwise, mem->size 0 included, it is copied like data.
+   */
+  VPUMemLinear_t *mem;
+  /*
+   * outFomart, scale_denom and shouldDither as for hw_jpeg_decode. The
+   * crop window is in picture pixels, widened to the macroblock grid;
+   * cropW or cropH 0 means the whole picture.
+   */
+  PostProcessInfo ppInfo;
+  /*
+   * Non zero: decode whatever covers this size most cheaply, the EXIF
+   * thumbnail or the picture at the largest scale_denom (see
+   * hw_jpeg_pick); scale_denom is then ignored.
+   */
+  int reqWidth;
+  int reqHeight;
+  /*
+   * Restart index of the stream (hw_jpeg_index_build), kept by the caller
+   * for as long as the picture is on screen. With a crop window only the
+   * MCU rows from the restart interval at or above the window to its
+   * bottom go to the decoder, the rest of the stream is never read. NULL:
+   * the whole picture is decoded and cropped by the post-processor.
+   */
+  const HwJpegIndex *index;
+  void *dst;            /* caller memory, dstStride bytes per row */
+  int dstStride;
+  int dstSize;
+  /*
+   * Bus address of dst when the post-processor can reach it: VPU memory
+   * (phy_addr plus the offset of dst) or a contiguous UMP / gralloc
+   * buffer (gralloc_ump_phys_get). The picture is then written into dst
+   * by the post-processor itself instead of being staged and copied,
+   * provided dst is 8 byte aligned and has room for the post-processor's
+   * rows: the width rounded up to 8 pixels, and an even number of rows.
+   * Padding pixels right of and below the picture may be overwritten.
+   * 0: always copy.
+   *
+   * The CPU cache over dst is kept coherent through dstMem or dstUmp,
+   * whichever dst lies in: its rows are written back and discarded
+   * before the post-processor writes them and discarded again after.
+   * With neither, dst must be uncached memory such as the framebuffer.
+   */
+  RK_U32 dstPhys;
+  VPUMemLinear_t *dstMem;
+  ump_handle dstUmp;
+  void *cookie;
+} HwJpegBatchItem;
+
+typedef struct
+{
+  void *cookie;
+  int status;           /* JPEGDEC_OK or a JpegDecRet error */
+  int width;            /* pixels written per row */
+  int height;           /* rows written */
+  HW_BOOL thumbnail;    /* decoded from the embedded thumbnail */
+  HW_BOOL software;     /* refused by the hardware, decoded by hw_jpeg_soft */
+  HW_BOOL direct;       /* post-processed straight into dst, see dstPhys */
+  HW_BOOL roi;          /* only the rows of the crop window were decoded, see index */
+  int scaleDenom;
+  RK_S64 latencyUs;     /* submission to completion */
+} HwJpegBatchResult;
+
+typedef struct
+{
+  int pictures;
+  int failed;
+  int thumbnails;
+  int software;
+  int direct;
+  int roi;
+  int bufferGrows;      /* VPU buffers reallocated for a larger picture */
+  long long streamBytes;
+  long long roiSkippedBytes;    /* stream left out of region decodes */
+  RK_S64 loadUs;        /* stream copies, overlapped with decoding */
+  RK_S64 starvedUs;     /* decoder waiting for the loader */
+  RK_S64 decodeUs;
+  RK_S64 ppUs;
+  RK_S64 copyUs;        /* post-processor output to dst, when not direct */
+  RK_S64 softUs;        /* software fallback decodes */
+} HwJpegBatchStats;
+
+typedef struct HwJpegBatch HwJpegBatch;
+
+extern HwJpegBatch *hw_jpeg_batch_create(const HwJpegBatchCfg *cfg);
+/* pictures not collected yet are dropped */
+extern void hw_jpeg_batch_destroy(HwJpegBatch *b);
+
+/*
+ * Queue up to n pictures, never blocks. Returns how many were taken, fewer
+ * than n when the queue depth is reached; collect results and submit the
+ * rest.
+ */
+extern int hw_jpeg_batch_submit(HwJpegBatch *b, const HwJpegBatchItem *items, int n);
+
+/*
+ * Next result in submission order. timeoutMs < 0 waits forever. Returns 0,
+ * or -1 on timeout or when nothing is outstanding.
+ */
+extern int hw_jpeg_batch_wait(HwJpegBatch *b, HwJpegBatchResult *result, int timeoutMs);
+
+extern void hw_jpeg_batch_get_stats(HwJpegBatch *b, HwJpegBatchStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_BATCH_H__ */
@@ -0,0 +1,270 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_batch_bench.c
+    Description:
+        Thumbnail grid throughput of hw_jpeg_batch against one
+        hw_jpeg_decode call per picture. Needs the decoder, runs on the
+        device:
+
+            hw_jpeg_batch_bench <dir> [cell [passes]]
+
+        Every .jpg in dir is read into memory once, so neither path pays
+        for the file system. Both decode every picture to ARGB at the same
+        scale_denom, the largest that still covers a cell x cell square,
+        into the same caller buffer. The per picture path is what a gallery
+        did before: VPU memory for the stream, hw_jpeg_decode, a copy out
+        of the library's bitmap and hw_jpeg_release. The batch path submits
+        the corpus through one HwJpegBatch. The target is 3x.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_thumb.h"
+#include "hw_jpeg_soft.h"
+#include "hw_jpeg_source.h"
+#include "hw_jpeg_batch.h"
+
+#define BENCH_PICTURES_MAX          (1024)
+#define BENCH_CELL_DEF              (256)
+#define BENCH_PASSES_DEF            (3)
+#define BENCH_TARGET                (3.0)
+
+typedef struct
+{
+    unsigned char   *data;
+    int             length;
+    int             scaleDenom;
+} BenchPicture;
+
+typedef struct
+{
+    BenchPicture    pics[BENCH_PICTURES_MAX];
+    int             count;
+    long long       bytes;
+    unsigned char   *dst;
+    int             dstStride;
+    int             dstSize;
+} BenchCorpus;
+
+static int bench_is_jpeg(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+
+    return dot != NULL && (!strcasecmp(dot, ".jpg") || !strcasecmp(dot, ".jpeg"));
+}
+
+static int bench_load(BenchCorpus *c, const char *dir, int cell)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    int maxW = 0, maxH = 0;
+
+    if (d == NULL) {
+        fprintf(stderr, "can not open %s\n", dir);
+        return -1;
+    }
+
+    while ((e = readdir(d)) != NULL && c->count < BENCH_PICTURES_MAX) {
+        BenchPicture *p = &c->pics[c->count];
+        char path[512];
+        struct stat st;
+        int fd, w = 0, h = 0;
+
+        if (!bench_is_jpeg(e->d_name))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+            continue;
+        if (fstat(fd, &st) || st.st_size <= 0 ||
+            (p->data = (unsigned char *)malloc(st.st_size)) == NULL) {
+            close(fd);
+            continue;
+        }
+        if (read(fd, p->data, st.st_size) != st.st_size) {
+            close(fd);
+            free(p->data);
+            continue;
+        }
+        close(fd);
+
+        p->length = st.st_size;
+        hw_jpeg_soft_probe(p->data, p->length, &w, &h);
+        if (w <= 0 || h <= 0) {
+            free(p->data);
+            continue;
+        }
+        p->scaleDenom = MAX(hw_jpeg_pick_denom(w, h, cell, cell), 1);
+        maxW = MAX(maxW, (w + p->scaleDenom - 1) / p->scaleDenom);
+        maxH = MAX(maxH, (h + p->scaleDenom - 1) / p->scaleDenom);
+        c->bytes += p->length;
+        c->count++;
+    }
+    closedir(d);
+
+    /* room for the widest output, padded the way the post-processor writes it */
+    c->dstStride = ((maxW + 15) & ~15) * 4;
+    c->dstSize = c->dstStride * ((maxH + 15) & ~15);
+    c->dst = (unsigned char *)malloc(c->dstSize);
+
+    return c->count && c->dst != NULL ? 0 : -1;
+}
+
+static void bench_pp_info(PostProcessInfo *ppInfo, const BenchPicture *p)
+{
+    memset(ppInfo, 0, sizeof(*ppInfo));
+    ppInfo->outFomart = PP_OUT_FORMAT_ARGB;
+    ppInfo->scale_denom = p->scaleDenom;
+}
+
+/* one hw_jpeg_decode per picture, returns the pictures decoded */
+static int bench_single(BenchCorpus *c)
+{
+    int i, ok = 0;
+
+    for (i = 0; i < c->count; i++) {
+        const BenchPicture *p = &c->pics[i];
+        VPUMemLinear_t mem;
+        HwJpegSource src;
+        HwJpegInputInfo in;
+        HwJpegOutputInfo out;
+        int y, rows, rowBytes;
+
+        memset(&mem, 0, sizeof(mem));
+        memset(&in, 0, sizeof(in));
+        memset(&out, 0, sizeof(out));
+        bench_pp_info(&in.ppInfo, p);
+
+        if (hw_jpeg_reserve(&mem, p->length + HW_JPEG_SOURCE_PAD) < 0)
+            continue;
+        memcpy(mem.vir_addr, p->data, p->length);
+        memset((unsigned char *)mem.vir_addr + p->length, 0, HW_JPEG_SOURCE_PAD);
+
+        if (!hw_jpeg_source_open_vpumem(&src, &mem, p->length, &in)) {
+            if (hw_jpeg_decode(&in, &out, NULL, 0, 0) >= 0 && out.outAddr != NULL) {
+                rowBytes = MIN(out.outWidth * 4, c->dstStride);
+                rows = MIN(out.outHeight, c->dstSize / c->dstStride);
+                for (y = 0; y < rows; y++)
+                    memcpy(c->dst + y * c->dstStride, out.outAddr + y * out.outWidth * 4, rowBytes);
+                ok++;
+            }
+            if (out.decoderHandle != NULL)
+                hw_jpeg_release(out.decoderHandle);
+            hw_jpeg_source_close(&src);
+        }
+        hw_jpeg_unreserve(&mem);
+    }
+
+    return ok;
+}
+
+/* the corpus through one batch, returns the pictures decoded */
+static int bench_batch(BenchCorpus *c, HwJpegBatchStats *stats)
+{
+    HwJpegBatchCfg cfg;
+    HwJpegBatch *b;
+    HwJpegBatchResult r;
+    int next = 0, done = 0, ok = 0;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.softThreads = -1;
+    b = hw_jpeg_batch_create(&cfg);
+    if (b == NULL)
+        return 0;
+
+    while (done < c->count) {
+        while (next < c->count) {
+            HwJpegBatchItem it;
+
+            memset(&it, 0, sizeof(it));
+            it.data = c->pics[next].data;
+            it.length = c->pics[next].length;
+            bench_pp_info(&it.ppInfo, &c->pics[next]);
+            /* every picture into the same cell, as a grid redrawing one slot */
+            it.dst = c->dst;
+            it.dstStride = c->dstStride;
+            it.dstSize = c->dstSize;
+            if (hw_jpeg_batch_submit(b, &it, 1) != 1)
+                break;
+            next++;
+        }
+        if (hw_jpeg_batch_wait(b, &r, -1))
+            break;
+        if (r.status == JPEGDEC_OK)
+            ok++;
+        done++;
+    }
+
+    hw_jpeg_batch_get_stats(b, stats);
+    hw_jpeg_batch_destroy(b);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    static BenchCorpus c;
+    HwJpegBatchStats stats;
+    int cell = argc > 2 ? atoi(argv[2]) : BENCH_CELL_DEF;
+    int passes = argc > 3 ? atoi(argv[3]) : BENCH_PASSES_DEF;
+    RK_S64 tSingle = 0, tBatch = 0, t;
+    int i, okSingle = 0, okBatch = 0;
+    double speedup;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <dir> [cell [passes]]\n", argv[0]);
+        return 2;
+    }
+    if (cell <= 0)
+        cell = BENCH_CELL_DEF;
+    if (passes <= 0)
+        passes = BENCH_PASSES_DEF;
+    if (bench_load(&c, argv[1], cell)) {
+        fprintf(stderr, "no decodable .jpg in %s\n", argv[1]);
+        return 2;
+    }
+
+    printf("%d pictures, %lld KB, %dx%d cells, %d passes\n", c.count, c.bytes / 1024, cell, cell,
+           passes);
+
+    /* one untimed pass of each, so neither pays for the first allocations */
+    bench_single(&c);
+    bench_batch(&c, &stats);
+
+    for (i = 0; i < passes; i++) {
+        t = hw_jpeg_now_us();
+        okSingle = bench_single(&c);
+        tSingle += hw_jpeg_now_us() - t;
+
+        t = hw_jpeg_now_us();
+        okBatch = bench_batch(&c, &stats);
+        tBatch += hw_jpeg_now_us() - t;
+    }
+
+    printf("  path          decoded   pictures/s   ms/picture\n");
+    printf("  hw_jpeg_decode %6d %12.1f %12.2f\n", okSingle,
+           tSingle ? 1e6 * c.count * passes / tSingle : 0, tSingle / 1e3 / (c.count * passes));
+    printf("  batch          %6d %12.1f %12.2f\n", okBatch,
+           tBatch ? 1e6 * c.count * passes / tBatch : 0, tBatch / 1e3 / (c.count * passes));
+    printf("  last batch: load %lld us, starved %lld us, decode %lld us, pp %lld us, copy %lld us, "
+           "%d buffer grows\n", (long long)stats.loadUs, (long long)stats.starvedUs,
+           (long long)stats.decodeUs, (long long)stats.ppUs, (long long)stats.copyUs,
+           stats.bufferGrows);
+
+    speedup = tBatch ? (double)tSingle / tBatch : 0;
+    printf("  speedup %.2fx, target %.1fx: %s\n", speedup, BENCH_TARGET,
+           speedup >= BENCH_TARGET ? "met" : "NOT met");
+
+    for (i = 0; i < c.count; i++)
+        free(c.pics[i].data);
+    free(c.dst);
+
+    return okBatch == okSingle ? 0 : 1;
+}
@@ -0,0 +1,444 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_burst.c
+    Description:
+        Two stage burst JPEG encode: thumbnail, then headers and main picture
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_burst"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_mem_range.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_scale.h"
+#include "rk29-ipp.h"
+#include "hw_jpeg_burst.h"
+
+/* one thumbnail waiting for the encode stage, one being made */
+#define BURST_THUMBS                (2)
+/* the thumbnail and the EXIF fields share the 64 KB of APP1 */
+#define BURST_THUMB_MAX             (60 * 1024)
+#define BURST_IPP_DEV               "/dev/rk29-ipp"
+#define BURST_IPP_TIMEOUT_MS        (50)
+
+typedef struct BurstJob
+{
+    HwJpegBurstFrame    frame;
+    HwJpegBurstResult   result;
+    int                 thumbOffset;    /* in the thumbnail output of the job's slot */
+    RK_S64              submitUs;
+    RK_S64              thumbDoneUs;
+} BurstJob;
+
+/*
+ * Jobs live in a ring of queueDepth entries and move through it by four
+ * running counters: submitted >= thumbed >= encoded >= collected. Job k
+ * keeps its thumbnail in thumbOut[k % BURST_THUMBS] until it is encoded,
+ * so the thumbnail stage stays at most one frame ahead of the encoder.
+ */
+struct HwJpegBurst
+{
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    pthread_t           thumber;
+    pthread_t           encoder;
+    int                 threads;
+    int                 quit;
+    RK_U32              depth;
+    RK_U32              submitted;
+    RK_U32              thumbed;
+    RK_U32              encoded;
+    RK_U32              collected;
+    BurstJob            *jobs;
+    VPUMemLinear_t      thumbOut[BURST_THUMBS];
+    HwJpegBurstStats    stats;
+
+    /* thumbnail stage only */
+    int                 ipp;
+    VPUMemLinear_t      thumbYuv;
+};
+
+static struct timespec *burst_deadline(struct timespec *ts, int timeoutMs)
+{
+    if (timeoutMs < 0)
+        return NULL;
+
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += timeoutMs / 1000;
+    ts->tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+/*
+ * hw_jpeg_encode is not known to be reentrant, and its cacheflush callback
+ * carries no context: the output buffer of the thumbnail encode in
+ * progress is kept here, both under burstHwLock.
+ */
+static pthread_mutex_t burstHwLock = PTHREAD_MUTEX_INITIALIZER;
+static VPUMemLinear_t *burstFlushOut;
+
+/*
+ * Called around the hardware run for the range of the output the library
+ * wrote headers into or the encoder wrote. buf_type names the camera HAL's
+ * buffer; in the thumbnail stage the input was cleaned by burst_scale and
+ * only the output is written by the CPU, so every call syncs the output.
+ * Write back and discard covers both directions.
+ */
+static int burst_cacheflush(int buf_type, int offset, int len)
+{
+    (void)buf_type;
+
+    if (burstFlushOut == NULL || offset < 0 || len <= 0)
+        return -1;
+
+    return VPUMemFlushRange(burstFlushOut, offset, len);
+}
+
+static int burst_wants_thumb(const JpegEncInInfo *in)
+{
+    /* the encoder codes whole 16x8 blocks, other sizes are left to hw_jpeg_encode */
+    return in->doThumbNail && in->thumbData == NULL && in->frameHeader &&
+           in->exifInfo != NULL && in->type == JPEGENC_YUV420_SP &&
+           in->rotateDegree == DEGREE_0 && in->thumbW > 0 && in->thumbH > 0 &&
+           !(in->thumbW % 16) && !(in->thumbH % 8);
+}
+
+/* scale the frame to w x h NV12 in thumbYuv: IPP, then hw_jpeg_scale */
+static int burst_scale(HwJpegBurst *b, const JpegEncInInfo *in, int w, int h, int *soft)
+{
+    VPUMemLinear_t *m = &b->thumbYuv;
+
+    *soft = 0;
+    if (b->ipp >= 0) {
+        struct rk29_ipp_req req;
+
+        memset(&req, 0, sizeof(req));
+        req.src0.YrgbMst = in->y_rgb_addr;
+        req.src0.CbrMst = in->uv_addr;
+        req.src0.w = in->inputW;
+        req.src0.h = in->inputH;
+        req.src0.fmt = IPP_Y_CBCR_H2V2;
+        req.dst0.YrgbMst = m->phy_addr;
+        req.dst0.CbrMst = m->phy_addr + w * h;
+        req.dst0.w = w;
+        req.dst0.h = h;
+        req.dst0.fmt = IPP_Y_CBCR_H2V2;
+        req.src_vir_w = in->inputW;
+        req.dst_vir_w = w;
+        req.timeout = BURST_IPP_TIMEOUT_MS;
+        req.flag = IPP_ROT_0;
+        if (!ioctl(b->ipp, IPP_BLIT_SYNC, &req))
+            return 0;
+    }
+
+    if (in->y_vir_addr == NULL || in->uv_vir_addr == NULL)
+        return -1;
+    /* box, a thumbnail is a large reduction */
+    if (hw_jpeg_scale_nv12(in->y_vir_addr, in->uv_vir_addr, in->inputW, in->inputH, 0,
+                           (uint8_t *)m->vir_addr, (uint8_t *)m->vir_addr + w * h, w, h, 0,
+                           HW_JPEG_SCALE_BOX, 0, 0, NULL))
+        return -1;
+
+    VPUMemCleanRange(m, 0, w * h * 3 / 2);
+    *soft = 1;
+    return 0;
+}
+
+/* encode the thumbnail of job into out; returns its size, 0 to leave it to hw_jpeg_encode */
+static int burst_thumb(HwJpegBurst *b, BurstJob *job, VPUMemLinear_t *out, int *soft)
+{
+    const JpegEncInInfo *in = &job->frame.in;
+    JpegEncInInfo ti;
+    JpegEncOutInfo to;
+    int w = in->thumbW, h = in->thumbH, ret;
+
+    if (hw_jpeg_reserve(&b->thumbYuv, w * h * 3 / 2) < 0 ||
+        hw_jpeg_reserve(out, w * h * 3 / 2 + BURST_THUMB_MAX) < 0)
+        return 0;
+    if (burst_scale(b, in, w, h, soft))
+        return 0;
+
+    memset(&ti, 0, sizeof(ti));
+    ti.frameHeader = 1;
+    ti.rotateDegree = DEGREE_0;
+    ti.y_rgb_addr = b->thumbYuv.phy_addr;
+    ti.uv_addr = b->thumbYuv.phy_addr + w * h;
+    ti.inputW = w;
+    ti.inputH = h;
+    ti.type = JPEGENC_YUV420_SP;
+    ti.qLvl = in->thumbqLvl;
+    ti.y_vir_addr = (unsigned char *)b->thumbYuv.vir_addr;
+    ti.uv_vir_addr = (unsigned char *)b->thumbYuv.vir_addr + w * h;
+
+    memset(&to, 0, sizeof(to));
+    to.outBufPhyAddr = out->phy_addr;
+    to.outBufVirAddr = (unsigned char *)out->vir_addr;
+    to.outBuflen = out->size;
+    to.cacheflush = burst_cacheflush;
+
+    pthread_mutex_lock(&burstHwLock);
+    burstFlushOut = out;
+    ret = hw_jpeg_encode(&ti, &to);
+    burstFlushOut = NULL;
+    pthread_mutex_unlock(&burstHwLock);
+
+    if (ret || to.jpegFileLen <= 0 || to.jpegFileLen > BURST_THUMB_MAX) {
+        ALOGW("thumbnail %dx%d: encode returned %d, %d bytes", w, h, ret, to.jpegFileLen);
+        return 0;
+    }
+
+    /*
+     * hw_jpeg_encode copies the thumbnail into APP1 with the CPU. The
+     * headers in front of the entropy data were written by the CPU too, so
+     * the range is written back, not only discarded.
+     */
+    VPUMemFlushRange(out, to.finalOffset, to.jpegFileLen);
+    job->thumbOffset = to.finalOffset;
+    return to.jpegFileLen;
+}
+
+static void *burst_thumber(void *arg)
+{
+    HwJpegBurst *b = (HwJpegBurst *)arg;
+
+    pthread_mutex_lock(&b->lock);
+    for (;;) {
+        BurstJob *job;
+        VPUMemLinear_t *out;
+        int bytes = 0, soft = 0;
+        RK_S64 t;
+
+        while (!b->quit && (b->thumbed == b->submitted ||
+                            b->thumbed - b->encoded >= BURST_THUMBS))
+            pthread_cond_wait(&b->cond, &b->lock);
+        if (b->quit)
+            break;
+
+        job = &b->jobs[b->thumbed % b->depth];
+        out = &b->thumbOut[b->thumbed % BURST_THUMBS];
+        pthread_mutex_unlock(&b->lock);
+
+        /* runs while the previous frame is on the encoder */
+        t = hw_jpeg_now_us();
+        if (burst_wants_thumb(&job->frame.in))
+            bytes = burst_thumb(b, job, out, &soft);
+        job->thumbDoneUs = hw_jpeg_now_us();
+        t = job->thumbDoneUs - t;
+
+        pthread_mutex_lock(&b->lock);
+        job->result.thumbBytes = bytes;
+        job->result.thumbUs = t;
+        if (bytes) {
+            b->stats.thumbs++;
+            b->stats.softScales += soft;
+        } else if (burst_wants_thumb(&job->frame.in)) {
+            b->stats.thumbFallbacks++;
+        }
+        b->stats.thumbUs += t;
+        b->stats.thumbUsMax = MAX(b->stats.thumbUsMax, t);
+        b->thumbed++;
+        pthread_cond_broadcast(&b->cond);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    return NULL;
+}
+
+static void *burst_encoder(void *arg)
+{
+    HwJpegBurst *b = (HwJpegBurst *)arg;
+
+    pthread_mutex_lock(&b->lock);
+    for (;;) {
+        BurstJob *job;
+        JpegEncInInfo in;
+        VPUMemLinear_t *thumb;
+        RK_S64 start, t;
+
+        while (!b->quit && b->encoded == b->thumbed)
+            pthread_cond_wait(&b->cond, &b->lock);
+        if (b->quit)
+            break;
+
+        job = &b->jobs[b->encoded % b->depth];
+        thumb = &b->thumbOut[b->encoded % BURST_THUMBS];
+        pthread_mutex_unlock(&b->lock);
+
+        in = job->frame.in;
+        if (job->result.thumbBytes) {
+            in.thumbData = (RK_U8 *)thumb->vir_addr + job->thumbOffset;
+            in.thumbDataLen = job->result.thumbBytes;
+        }
+
+        start = hw_jpeg_now_us();
+        pthread_mutex_lock(&burstHwLock);
+        job->result.status = hw_jpeg_encode(&in, &job->frame.out);
+        pthread_mutex_unlock(&burstHwLock);
+        t = hw_jpeg_now_us();
+
+        job->result.finalOffset = job->frame.out.finalOffset;
+        job->result.jpegFileLen = job->frame.out.jpegFileLen;
+        job->result.queueUs = start - job->thumbDoneUs;
+        job->result.encodeUs = t - start;
+        job->result.latencyUs = t - job->submitUs;
+
+        pthread_mutex_lock(&b->lock);
+        b->stats.frames++;
+        if (job->result.status)
+            b->stats.failed++;
+        b->stats.queueUs += job->result.queueUs;
+        b->stats.queueUsMax = MAX(b->stats.queueUsMax, job->result.queueUs);
+        b->stats.encodeUs += job->result.encodeUs;
+        b->stats.encodeUsMax = MAX(b->stats.encodeUsMax, job->result.encodeUs);
+        b->stats.latencyUs += job->result.latencyUs;
+        b->stats.latencyUsMax = MAX(b->stats.latencyUsMax, job->result.latencyUs);
+        b->encoded++;
+        pthread_cond_broadcast(&b->cond);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    return NULL;
+}
+
+HwJpegBurst *hw_jpeg_burst_create(const HwJpegBurstCfg *cfg)
+{
+    HwJpegBurst *b;
+    RK_U32 depth = HW_JPEG_BURST_DEPTH_DEF;
+
+    if (cfg != NULL && cfg->queueDepth > 0)
+        depth = MIN(cfg->queueDepth, HW_JPEG_BURST_DEPTH_MAX);
+
+    b = (HwJpegBurst *)calloc(1, sizeof(*b));
+    if (b == NULL)
+        return NULL;
+
+    b->depth = depth;
+    b->jobs = (BurstJob *)calloc(depth, sizeof(BurstJob));
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond, NULL);
+
+    /* without the IPP thumbnails are scaled by hw_jpeg_scale */
+    b->ipp = open(BURST_IPP_DEV, O_RDWR);
+    if (b->ipp < 0)
+        ALOGW("open %s failed: %s", BURST_IPP_DEV, strerror(errno));
+
+    if (b->jobs == NULL)
+        goto fail;
+
+    if (pthread_create(&b->encoder, NULL, burst_encoder, b))
+        goto fail;
+    b->threads = 1;
+    if (pthread_create(&b->thumber, NULL, burst_thumber, b))
+        goto fail;
+    b->threads = 2;
+
+    return b;
+
+fail:
+    hw_jpeg_burst_destroy(b);
+    return NULL;
+}
+
+void hw_jpeg_burst_destroy(HwJpegBurst *b)
+{
+    int i;
+
+    if (b == NULL)
+        return;
+
+    pthread_mutex_lock(&b->lock);
+    b->quit = 1;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+
+    if (b->threads > 0)
+        pthread_join(b->encoder, NULL);
+    if (b->threads > 1)
+        pthread_join(b->thumber, NULL);
+
+    if (b->ipp >= 0)
+        close(b->ipp);
+    for (i = 0; i < BURST_THUMBS; i++)
+        hw_jpeg_unreserve(&b->thumbOut[i]);
+    hw_jpeg_unreserve(&b->thumbYuv);
+
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->lock);
+    free(b->jobs);
+    free(b);
+}
+
+int hw_jpeg_burst_submit(HwJpegBurst *b, const HwJpegBurstFrame *frame)
+{
+    BurstJob *job;
+
+    if (b == NULL || frame == NULL)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    if (b->submitted - b->collected >= b->depth) {
+        b->stats.refused++;
+        pthread_mutex_unlock(&b->lock);
+        return -1;
+    }
+
+    job = &b->jobs[b->submitted % b->depth];
+    memset(job, 0, sizeof(*job));
+    job->frame = *frame;
+    job->result.cookie = frame->cookie;
+    job->submitUs = hw_jpeg_now_us();
+    b->submitted++;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+
+    return 0;
+}
+
+int hw_jpeg_burst_wait(HwJpegBurst *b, HwJpegBurstResult *result, int timeoutMs)
+{
+    struct timespec ts, *deadline = burst_deadline(&ts, timeoutMs);
+    int ret = -1;
+
+    if (b == NULL || result == NULL)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    while (b->collected != b->submitted && b->collected == b->encoded) {
+        if (deadline == NULL)
+            pthread_cond_wait(&b->cond, &b->lock);
+        else if (pthread_cond_timedwait(&b->cond, &b->lock, deadline) == ETIMEDOUT)
+            break;
+    }
+    if (b->collected != b->encoded) {
+        *result = b->jobs[b->collected % b->depth].result;
+        b->collected++;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    return ret;
+}
+
+void hw_jpeg_burst_get_stats(HwJpegBurst *b, HwJpegBurstStats *stats)
+{
+    if (b == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&b->lock);
+    *stats = b->stats;
+    pthread_mutex_unlock(&b->lock);
+}
@@ -0,0 +1,104 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_burst.h
+    Description:
+        Pipelined JPEG encode for burst capture. hw_jpeg_encode scales and
+        encodes the thumbnail, writes the EXIF and GPS headers and encodes
+        the main picture in one synchronous call, so in burst mode the
+        sensor outpaces it. Here frames go through two stages on their own
+        threads: the thumbnail stage scales the frame on the IPP, or with
+        hw_jpeg_scale when the IPP refuses, and encodes the thumbnail; the
+        encode stage hands that thumbnail to hw_jpeg_encode, which only
+        builds APP1 around it and encodes the main picture. The thumbnail of the next frame is made while the
+        current one is on the encoder. Frames come back in submission
+        order with the time each stage took.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_BURST_H__
+#define __HW_JPEG_BURST_H__
+
+#include <stdint.h>
+
+#include "vpu_mem.h"
+#include "hw_jpegenc.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HW_JPEG_BURST_DEPTH_DEF         (4)
+#define HW_JPEG_BURST_DEPTH_MAX         (16)
+
+typedef struct
+{
+  int queueDepth;       /* frames submitted and not yet collected; 0: default */
+} HwJpegBurstCfg;
+
+typedef struct
+{
+  /*
+   * As for hw_jpeg_encode. The input and output buffers, exifInfo and
+   * gpsInfo must stay valid until the result is collected. A thumbnail
+   * is made in the thumbnail stage for a YUV420_SP frame without
+   * rotation that asks for one and has no thumbData, when thumbW is a
+   * multiple of 16 and thumbH of 8; anything else is passed to
+   * hw_jpeg_encode as it is.
+   */
+  JpegEncInInfo in;
+  JpegEncOutInfo out;
+  void *cookie;
+} HwJpegBurstFrame;
+
+typedef struct
+{
+  void *cookie;
+  int status;           /* hw_jpeg_encode result, 0 on success */
+  int finalOffset;      /* of the JPEG in the output buffer */
+  int jpegFileLen;
+  int thumbBytes;       /* thumbnail made by the thumbnail stage, 0 if none */
+  RK_S64 thumbUs;       /* scale and encode of the thumbnail */
+  RK_S64 queueUs;       /* thumbnail done to main encode start */
+  RK_S64 encodeUs;      /* hw_jpeg_encode of the main picture */
+  RK_S64 latencyUs;     /* submission to completion */
+} HwJpegBurstResult;
+
+typedef struct
+{
+  RK_U32 frames;
+  RK_U32 failed;
+  RK_U32 refused;       /* submissions turned down on a full queue */
+  RK_U32 thumbs;        /* thumbnails made by the thumbnail stage */
+  RK_U32 softScales;    /* of which scaled by hw_jpeg_scale, the IPP refused */
+  RK_U32 thumbFallbacks;/* left to hw_jpeg_encode */
+  RK_S64 thumbUs;
+  RK_S64 thumbUsMax;
+  RK_S64 queueUs;
+  RK_S64 queueUsMax;
+  RK_S64 encodeUs;
+  RK_S64 encodeUsMax;
+  RK_S64 latencyUs;
+  RK_S64 latencyUsMax;
+} HwJpegBurstStats;
+
+typedef struct HwJpegBurst HwJpegBurst;
+
+extern HwJpegBurst *hw_jpeg_burst_create(const HwJpegBurstCfg *cfg);
+/* frames not encoded yet are dropped */
+extern void hw_jpeg_burst_destroy(HwJpegBurst *b);
+
+/* queue a frame, never blocks. Returns 0, or -1 when the queue is full. */
+extern int hw_jpeg_burst_submit(HwJpegBurst *b, const HwJpegBurstFrame *frame);
+
+/*
+ * Next result in submission order. timeoutMs < 0 waits forever. Returns 0,
+ * or -1 on timeout or when nothing is outstanding.
+ */
+extern int hw_jpeg_burst_wait(HwJpegBurst *b, HwJpegBurstResult *result, int timeoutMs);
+
+extern void hw_jpeg_burst_get_stats(HwJpegBurst *b, HwJpegBurstStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_BURST_H__ */
@@ -0,0 +1,292 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_index.c
+    Description:
+        Restart marker index and MCU row cuts of baseline JPEG streams
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_index"
+
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_index.h"
+
+static int index_gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static int index_keep(HwJpegIndex *idx, long offset, long length)
+{
+    if (idx->segs == HW_JPEG_INDEX_SEGS_MAX)
+        return JPEGDEC_UNSUPPORTED;
+
+    idx->seg[idx->segs].offset = offset;
+    idx->seg[idx->segs].length = length;
+    idx->segs++;
+    idx->headerBytes += length;
+    return JPEGDEC_OK;
+}
+
+static int index_sof(HwJpegIndex *idx, const unsigned char *s, int len)
+{
+    int i, n, maxH = 1, maxV = 1;
+
+    if (len < 6)
+        return JPEGDEC_STRM_ERROR;
+
+    idx->height = s[1] << 8 | s[2];
+    idx->width = s[3] << 8 | s[4];
+    n = s[5];
+    if (s[0] != 8 || !idx->height || !idx->width || (n != 1 && n != 3))
+        return JPEGDEC_UNSUPPORTED;
+    if (len < 6 + 3 * n)
+        return JPEGDEC_STRM_ERROR;
+    idx->components = n;
+
+    /* a single component scan is not interleaved, its MCU is one block */
+    for (i = 0; n == 3 && i < n; i++) {
+        maxH = MAX(maxH, s[7 + 3 * i] >> 4);
+        maxV = MAX(maxV, s[7 + 3 * i] & 15);
+    }
+
+    idx->mcuWidth = maxH * 8;
+    idx->mcuHeight = maxV * 8;
+    idx->mcusX = (idx->width + idx->mcuWidth - 1) / idx->mcuWidth;
+    idx->mcuRows = (idx->height + idx->mcuHeight - 1) / idx->mcuHeight;
+    return JPEGDEC_OK;
+}
+
+/* headers up to the first scan, keeping only what the decoder needs */
+static int index_headers(HwJpegIndex *idx, const unsigned char *data, long length)
+{
+    const unsigned char *p = data + 2, *end = data + length;
+    int ret;
+
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return JPEGDEC_STRM_ERROR;
+    index_keep(idx, 0, 2);
+
+    for (;;) {
+        long start;
+        int m, len;
+
+        if (p >= end || *p != 0xFF)
+            return JPEGDEC_STRM_ERROR;
+        while (p < end && *p == 0xFF)
+            p++;
+        if (end - p < 3)
+            return JPEGDEC_STRM_ERROR;
+
+        start = p - 1 - data;
+        m = *p++;
+        if (m == 0xD8 || m == 0x01 || (m >= 0xD0 && m <= 0xD7))
+            continue;
+        if (m == 0xD9)
+            return JPEGDEC_STRM_ERROR;
+
+        len = p[0] << 8 | p[1];
+        if (len < 2 || len > end - p)
+            return JPEGDEC_STRM_ERROR;
+
+        switch (m) {
+        case 0xC0:
+        case 0xC1:
+            ret = index_sof(idx, p + 2, len - 2);
+            idx->sofHeight = p + 3 - data;
+            break;
+        case 0xDD:
+            if (len < 4)
+                return JPEGDEC_STRM_ERROR;
+            idx->interval = p[2] << 8 | p[3];
+            ret = JPEGDEC_OK;
+            break;
+        case 0xC4:
+        case 0xDB:
+            ret = JPEGDEC_OK;
+            break;
+        case 0xDA:
+            if (!idx->width || len < 3)
+                return JPEGDEC_STRM_ERROR;
+            /* a scan of fewer components means more scans follow, the MCU grid is not the SOF's */
+            if (p[2] != idx->components)
+                return JPEGDEC_UNSUPPORTED;
+            ret = JPEGDEC_OK;
+            break;
+        default:
+            /* progressive, lossless, hierarchical and arithmetic coding */
+            if (m >= 0xC2 && m <= 0xCF && m != 0xC8)
+                return JPEGDEC_UNSUPPORTED;
+            p += len;
+            continue;
+        }
+
+        if (ret == JPEGDEC_OK)
+            ret = index_keep(idx, start, p + len - data - start);
+        if (ret != JPEGDEC_OK)
+            return ret;
+
+        p += len;
+        if (m == 0xDA) {
+            idx->scanStart = p - data;
+            return JPEGDEC_OK;
+        }
+    }
+}
+
+/* every RSTn of the scan, and its end */
+static int index_restarts(HwJpegIndex *idx, const unsigned char *data, long length)
+{
+    const unsigned char *p = data + idx->scanStart, *end = data + length;
+    int n = 1;
+
+    idx->intervals = 1;
+    if (idx->interval) {
+        long mcus = (long)idx->mcusX * idx->mcuRows;
+        idx->intervals = (mcus + idx->interval - 1) / idx->interval;
+    }
+
+    idx->starts = (long *)malloc(idx->intervals * sizeof(*idx->starts));
+    if (idx->starts == NULL)
+        return JPEGDEC_MEMFAIL;
+    idx->starts[0] = idx->scanStart;
+    idx->scanEnd = length;
+
+    while ((p = (const unsigned char *)memchr(p, 0xFF, end - p)) != NULL && p + 1 < end) {
+        if (p[1] >= 0xD0 && p[1] <= 0xD7) {
+            if (n < idx->intervals)
+                idx->starts[n] = p + 2 - data;
+            n++;
+            p += 2;
+        } else if (p[1] == 0x00) {
+            p += 2;
+        } else if (p[1] == 0xFF) {
+            p++;
+        } else {
+            idx->scanEnd = p - data;
+            break;
+        }
+    }
+
+    if (n != idx->intervals) {
+        ALOGW("%d restart intervals, DRI says %d", n, idx->intervals);
+        return JPEGDEC_STRM_ERROR;
+    }
+    return JPEGDEC_OK;
+}
+
+int hw_jpeg_index_build(HwJpegIndex *idx, const unsigned char *data, long length)
+{
+    int ret;
+
+    if (idx == NULL)
+        return JPEGDEC_PARAM_ERROR;
+
+    memset(idx, 0, sizeof(*idx));
+    if (data == NULL)
+        return JPEGDEC_PARAM_ERROR;
+
+    ret = index_headers(idx, data, length);
+    if (ret == JPEGDEC_OK)
+        ret = index_restarts(idx, data, length);
+    if (ret != JPEGDEC_OK)
+        hw_jpeg_index_free(idx);
+
+    return ret;
+}
+
+void hw_jpeg_index_free(HwJpegIndex *idx)
+{
+    if (idx == NULL)
+        return;
+
+    free(idx->starts);
+    idx->starts = NULL;
+    idx->intervals = 0;
+}
+
+int hw_jpeg_index_plan(const HwJpegIndex *idx, int y0, int y1, HwJpegCut *cut)
+{
+    int row0, rowEnd;
+    long mcuEnd, end;
+
+    if (idx == NULL || idx->starts == NULL || cut == NULL)
+        return -1;
+
+    y0 = CLIP(y0, 0, idx->height - 1);
+    y1 = CLIP(y1, y0 + 1, idx->height);
+    row0 = y0 / idx->mcuHeight;
+    rowEnd = (y1 + idx->mcuHeight - 1) / idx->mcuHeight;
+
+    /*
+     * Rows starting a restart interval come every interval / gcd(interval,
+     * mcusX) rows. The post-processor crops on a 16 line grid; a cut on it
+     * gives the same output lines as cropping the whole picture.
+     */
+    if (idx->interval) {
+        int step = idx->interval / index_gcd(idx->interval, idx->mcusX);
+        if (idx->mcuHeight < 16 && (step & 1))
+            step *= 2;
+        row0 = row0 / step * step;
+    } else {
+        row0 = 0;
+    }
+
+    if (!row0 && rowEnd == idx->mcuRows)
+        return -1;
+
+    memset(cut, 0, sizeof(*cut));
+    cut->row0 = row0;
+    cut->rows = rowEnd - row0;
+    cut->y = row0 * idx->mcuHeight;
+    cut->height = MIN(cut->rows * idx->mcuHeight, idx->height - cut->y);
+
+    /* the decoder stops after cut->rows, the rest of the last interval is never read */
+    if (idx->interval) {
+        mcuEnd = (long)rowEnd * idx->mcusX;
+        cut->first = (long)row0 * idx->mcusX / idx->interval;
+        cut->last = (mcuEnd - 1) / idx->interval;
+    }
+    end = cut->last + 1 < idx->intervals ? idx->starts[cut->last + 1] - 2 : idx->scanEnd;
+
+    cut->bytes = idx->headerBytes + end - idx->starts[cut->first] + 2;
+    return 0;
+}
+
+long hw_jpeg_index_cut(const HwJpegIndex *idx, const unsigned char *data,
+                       const HwJpegCut *cut, unsigned char *out)
+{
+    unsigned char *o = out, *scan;
+    long from = idx->starts[cut->first];
+    int i;
+
+    for (i = 0; i < idx->segs; i++) {
+        const HwJpegIndexSeg *s = &idx->seg[i];
+
+        memcpy(o, data + s->offset, s->length);
+        if (idx->sofHeight >= s->offset && idx->sofHeight < s->offset + s->length) {
+            o[idx->sofHeight - s->offset] = cut->height >> 8;
+            o[idx->sofHeight - s->offset + 1] = cut->height & 0xff;
+        }
+        o += s->length;
+    }
+
+    scan = o;
+    memcpy(o, data + from, cut->bytes - idx->headerBytes - 2);
+    o += cut->bytes - idx->headerBytes - 2;
+
+    /* the decoder expects RST0 after the first interval it sees */
+    for (i = cut->first + 1; i <= cut->last; i++)
+        scan[idx->starts[i] - 1 - from] = 0xD0 + ((i - cut->first - 1) & 7);
+
+    *o++ = 0xFF;
+    *o++ = 0xD9;
+    return o - out;
+}
@@ -0,0 +1,93 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_index.h
+    Description:
+        Restart marker index of a baseline JPEG, for decoding a region of a
+        large picture. The post-processor crop only throws pixels away after
+        the decoder went through the whole picture; zooming into a 50 MP
+        photo wants a tile. The index records where the header segments and
+        every restart interval start, so that a stream holding only the MCU
+        rows of the tile can be cut out: the decoder headers with a reduced
+        height, the entropy data from the restart marker at or above the
+        tile to the end of its last row, and EOI. It is built once per
+        picture and used for every pan.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_INDEX_H__
+#define __HW_JPEG_INDEX_H__
+
+#include "vpu_mem.h"
+#include "hw_jpegdecapi.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* header segments kept in a cut: SOI, DQT, DHT, SOF, DRI and SOS; APPn and COM are dropped */
+#define HW_JPEG_INDEX_SEGS_MAX          (16)
+
+typedef struct
+{
+  long offset;
+  long length;
+} HwJpegIndexSeg;
+
+typedef struct
+{
+  int width;
+  int height;
+  int mcuWidth;         /* pixels */
+  int mcuHeight;
+  int mcusX;
+  int mcuRows;
+  int components;
+  int interval;         /* MCUs per restart interval, 0 without DRI */
+  int segs;
+  HwJpegIndexSeg seg[HW_JPEG_INDEX_SEGS_MAX];
+  long headerBytes;     /* sum of the kept segments */
+  long sofHeight;       /* offset of the SOF height field */
+  long scanStart;       /* first byte of entropy data */
+  long scanEnd;         /* EOI, or the end of the data */
+  int intervals;
+  long *starts;         /* entropy data offset of each restart interval */
+} HwJpegIndex;
+
+/* a stream of MCU rows [row0, row0 + rows) */
+typedef struct
+{
+  int row0;
+  int rows;
+  int y;                /* first picture line of the cut */
+  int height;           /* picture lines in the cut */
+  int first;            /* restart intervals [first, last] */
+  int last;
+  long bytes;           /* size of the cut stream */
+} HwJpegCut;
+
+/*
+ * Index data. Returns JPEGDEC_OK, JPEGDEC_UNSUPPORTED for anything but a
+ * single scan sequential picture, or JPEGDEC_STRM_ERROR / JPEGDEC_MEMFAIL.
+ */
+extern int hw_jpeg_index_build(HwJpegIndex *idx, const unsigned char *data, long length);
+extern void hw_jpeg_index_free(HwJpegIndex *idx);
+
+/*
+ * Plan a cut covering picture lines [y0, y1). It starts on the last MCU
+ * row at or above y0 that begins a restart interval and a 16 line
+ * macroblock row, which is row 0 for a picture without DRI. Returns 0, or
+ * -1 when the cut is the whole picture anyway.
+ */
+extern int hw_jpeg_index_plan(const HwJpegIndex *idx, int y0, int y1, HwJpegCut *cut);
+
+/*
+ * Write the cut stream of data, cut->bytes long, into out. The restart
+ * markers are renumbered from RST0 and the SOF height is that of the cut.
+ */
+extern long hw_jpeg_index_cut(const HwJpegIndex *idx, const unsigned char *data,
+                              const HwJpegCut *cut, unsigned char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_INDEX_H__ */
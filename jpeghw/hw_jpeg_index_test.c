@@ -0,0 +1,333 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_index_test.c
+    Description:
+        Test of the restart marker index. Builds for the host:
+
+            hw_jpeg_index_test
+
+        The streams come from hw_jpeg_test_stream and a cut is checked by
+        decoding it with hw_jpeg_soft against the rows of the whole
+        picture. Covers the index of a 4:2:0 and a greyscale stream, APPn
+        and COM segments dropped, planning on the rows that start both a
+        restart interval and a macroblock row, the last rows of the
+        picture, the whole picture refused, the cut size, SOF height and
+        renumbered restart markers, a stream without DRI cut from row 0,
+        and streams the index must refuse: more than one scan, progressive,
+        a restart marker missing and no SOI.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_soft.h"
+#include "hw_jpeg_index.h"
+#include "hw_jpeg_test_stream.h"
+
+#ifdef HW_JPEG_INDEX_TEST_HOST
+/* the rest of hw_jpeg_util needs the VPU, the decoder only takes these */
+RK_S64 hw_jpeg_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int hw_jpeg_pp_color(int outFomart)
+{
+    return outFomart == 0 ? VPU_PP_OUTPUT_FORMAT_RGB565 :
+           outFomart == 1 ? VPU_PP_OUTPUT_FORMAT_ARGB8888 : -1;
+}
+
+int hw_jpeg_pp_bpp(int colorType)
+{
+    return colorType == VPU_PP_OUTPUT_FORMAT_ARGB8888 ? 4 :
+           colorType == VPU_PP_OUTPUT_FORMAT_RGB565 ? 2 : 0;
+}
+#endif
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+/* offset of the first marker m, -1 when there is none */
+static long test_find(const unsigned char *data, long length, int m)
+{
+    long i;
+
+    for (i = 0; i + 1 < length; i++) {
+        if (data[i] == 0xFF && data[i + 1] == m)
+            return i;
+    }
+    return -1;
+}
+
+static RK_U32 *test_decode(const unsigned char *data, long length, int *w, int *h)
+{
+    PostProcessInfo pp;
+    RK_U32 *out;
+
+    memset(&pp, 0, sizeof(pp));
+    pp.outFomart = 1;
+    if (hw_jpeg_soft_output_size(data, length, &pp, w, h) != JPEGDEC_OK)
+        return NULL;
+
+    out = (RK_U32 *)calloc(*w * *h, 4);
+    if (hw_jpeg_soft_decode(data, length, &pp, out, *w * 4, *w * *h * 4, 1, NULL) != JPEGDEC_OK) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+/* cut lines [y0, y1) of s, expecting the planned cut want, and decode it against full */
+static void test_cut(const HwJpegTestStream *s, const HwJpegIndex *idx, const RK_U32 *full,
+                     int y0, int y1, const HwJpegCut *want, const char *what)
+{
+    HwJpegCut cut;
+    unsigned char *out;
+    RK_U32 *pixels;
+    long len, i;
+    int w, h, rst;
+    char msg[128];
+
+    snprintf(msg, sizeof(msg), "%s: plan", what);
+    check_eq(msg, hw_jpeg_index_plan(idx, y0, y1, &cut), 0);
+    snprintf(msg, sizeof(msg), "%s: row0", what);
+    check_eq(msg, cut.row0, want->row0);
+    snprintf(msg, sizeof(msg), "%s: rows", what);
+    check_eq(msg, cut.rows, want->rows);
+    snprintf(msg, sizeof(msg), "%s: y", what);
+    check_eq(msg, cut.y, want->y);
+    snprintf(msg, sizeof(msg), "%s: height", what);
+    check_eq(msg, cut.height, want->height);
+    snprintf(msg, sizeof(msg), "%s: intervals", what);
+    check(cut.first == want->first && cut.last == want->last, msg);
+
+    out = (unsigned char *)malloc(cut.bytes);
+    len = hw_jpeg_index_cut(idx, s->data, &cut, out);
+    snprintf(msg, sizeof(msg), "%s: length", what);
+    check_eq(msg, len, cut.bytes);
+
+    /* RST0, RST1, ... in order, one between each pair of intervals */
+    for (rst = 0, i = idx->headerBytes; i + 1 < len - 2; i++) {
+        if (out[i] == 0xFF && out[i + 1] >= 0xD0 && out[i + 1] <= 0xD7) {
+            if (out[i + 1] != 0xD0 + (rst & 7))
+                break;
+            rst++;
+        }
+    }
+    snprintf(msg, sizeof(msg), "%s: restart markers", what);
+    check_eq(msg, rst, cut.last - cut.first);
+
+    pixels = test_decode(out, len, &w, &h);
+    snprintf(msg, sizeof(msg), "%s: decode", what);
+    check(pixels != NULL, msg);
+    if (pixels != NULL) {
+        snprintf(msg, sizeof(msg), "%s: size", what);
+        check(w == s->width && h == cut.height, msg);
+        snprintf(msg, sizeof(msg), "%s: same rows", what);
+        check(!memcmp(pixels, full + cut.y * s->width, (long)w * h * 4), msg);
+        free(pixels);
+    }
+    free(out);
+}
+
+static void test_colour(void)
+{
+    HwJpegTestStreamCfg cfg = { 32, 16, 24, 0 };
+    HwJpegTestStream s;
+    HwJpegIndex idx;
+    HwJpegCut cut;
+    RK_U32 *full;
+    int w, h, i, same = 1;
+
+    if (hw_jpeg_test_stream_make(&cfg, &s))
+        return;
+
+    check_eq("colour: build", hw_jpeg_index_build(&idx, s.data, s.length), JPEGDEC_OK);
+    check(idx.width == 512 && idx.height == 256, "colour: size");
+    check(idx.mcuWidth == 16 && idx.mcuHeight == 16, "colour: MCU size");
+    check(idx.mcusX == 32 && idx.mcuRows == 16, "colour: MCU grid");
+    check_eq("colour: components", idx.components, 3);
+    check_eq("colour: interval", idx.interval, 24);
+    /* SOI, DQT, SOF, two DHT, DRI and SOS */
+    check_eq("colour: segments", idx.segs, 7);
+    check_eq("colour: intervals", idx.intervals, s.intervals);
+    for (i = 0; i < s.intervals && i < idx.intervals; i++)
+        same = same && idx.starts[i] == s.start[i];
+    check(same, "colour: interval starts");
+    check_eq("colour: scan end", idx.scanEnd, s.length - 2);
+
+    full = test_decode(s.data, s.length, &w, &h);
+    check(full != NULL, "colour: full decode");
+    if (full != NULL) {
+        /* 24 MCU intervals on 32 MCU rows start a row every 3 rows */
+        HwJpegCut mid = { 6, 3, 96, 48, 8, 11, 0 };
+        HwJpegCut top = { 0, 4, 0, 64, 0, 5, 0 };
+        HwJpegCut bottom = { 15, 1, 240, 16, 20, 21, 0 };
+
+        test_cut(&s, &idx, full, 100, 140, &mid, "colour: middle");
+        test_cut(&s, &idx, full, 40, 60, &top, "colour: top");
+        test_cut(&s, &idx, full, 250, 256, &bottom, "colour: bottom");
+        free(full);
+    }
+
+    check_eq("colour: whole picture", hw_jpeg_index_plan(&idx, 0, 256, &cut), -1);
+    check_eq("colour: past the bottom", hw_jpeg_index_plan(&idx, 0, 1000, &cut), -1);
+
+    hw_jpeg_index_free(&idx);
+    hw_jpeg_test_stream_free(&s);
+}
+
+/* an 8 line MCU: an odd row step is doubled to stay on the 16 line grid */
+static void test_gray(void)
+{
+    HwJpegTestStreamCfg cfg = { 32, 16, 24, 1 };
+    HwJpegTestStream s;
+    HwJpegIndex idx;
+    RK_U32 *full;
+    int w, h;
+
+    if (hw_jpeg_test_stream_make(&cfg, &s))
+        return;
+
+    check_eq("gray: build", hw_jpeg_index_build(&idx, s.data, s.length), JPEGDEC_OK);
+    check(idx.mcuWidth == 8 && idx.mcuHeight == 8, "gray: MCU size");
+    check(idx.mcusX == 64 && idx.mcuRows == 32, "gray: MCU grid");
+    check_eq("gray: components", idx.components, 1);
+    check_eq("gray: intervals", idx.intervals, s.intervals);
+
+    full = test_decode(s.data, s.length, &w, &h);
+    check(full != NULL, "gray: full decode");
+    if (full != NULL) {
+        HwJpegCut mid = { 12, 6, 96, 48, 32, 47, 0 };
+
+        test_cut(&s, &idx, full, 100, 140, &mid, "gray: middle");
+        free(full);
+    }
+
+    hw_jpeg_index_free(&idx);
+    hw_jpeg_test_stream_free(&s);
+}
+
+/* APPn and COM before the frame are not kept, the offsets still are the stream's */
+static void test_dropped(void)
+{
+    static const unsigned char com[] = { 0xFF, 0xFE, 0x00, 0x06, 't', 'e', 's', 't' };
+    HwJpegTestStreamCfg cfg = { 8, 4, 8, 0 };
+    HwJpegTestStream s;
+    HwJpegIndex idx, plain;
+    unsigned char *data;
+
+    if (hw_jpeg_test_stream_make(&cfg, &s))
+        return;
+
+    data = (unsigned char *)malloc(s.length + sizeof(com));
+    memcpy(data, s.data, 2);
+    memcpy(data + 2, com, sizeof(com));
+    memcpy(data + 2 + sizeof(com), s.data + 2, s.length - 2);
+
+    hw_jpeg_index_build(&plain, s.data, s.length);
+    check_eq("dropped: build", hw_jpeg_index_build(&idx, data, s.length + sizeof(com)), JPEGDEC_OK);
+    check_eq("dropped: segments", idx.segs, plain.segs);
+    check_eq("dropped: header bytes", idx.headerBytes, plain.headerBytes);
+    check_eq("dropped: scan start", idx.scanStart, s.start[0] + (long)sizeof(com));
+
+    hw_jpeg_index_free(&plain);
+    hw_jpeg_index_free(&idx);
+    free(data);
+    hw_jpeg_test_stream_free(&s);
+}
+
+/* without DRI the only place to start is the top */
+static void test_no_dri(void)
+{
+    HwJpegTestStreamCfg cfg = { 8, 4, 0, 1 };
+    HwJpegTestStream s;
+    HwJpegIndex idx;
+    HwJpegCut cut;
+
+    if (hw_jpeg_test_stream_make(&cfg, &s))
+        return;
+
+    check_eq("no DRI: build", hw_jpeg_index_build(&idx, s.data, s.length), JPEGDEC_OK);
+    check_eq("no DRI: interval", idx.interval, 0);
+    check_eq("no DRI: intervals", idx.intervals, 1);
+    check_eq("no DRI: plan", hw_jpeg_index_plan(&idx, 40, 50, &cut), 0);
+    check(cut.row0 == 0 && cut.y == 0, "no DRI: from the top");
+    check_eq("no DRI: height", cut.height, 56);
+    check_eq("no DRI: bytes", cut.bytes, s.length);
+
+    hw_jpeg_index_free(&idx);
+    hw_jpeg_test_stream_free(&s);
+}
+
+static void test_refused(void)
+{
+    HwJpegTestStreamCfg cfg = { 8, 4, 8, 0 };
+    HwJpegTestStream s;
+    HwJpegIndex idx;
+    unsigned char *data;
+    long at;
+
+    if (hw_jpeg_test_stream_make(&cfg, &s))
+        return;
+    data = (unsigned char *)malloc(s.length);
+
+    /* a first scan of only Y: the chroma comes in later scans */
+    memcpy(data, s.data, s.length);
+    at = test_find(data, s.length, 0xDA);
+    data[at + 4] = 1;
+    check_eq("refused: partial scan", hw_jpeg_index_build(&idx, data, s.length),
+             JPEGDEC_UNSUPPORTED);
+    check(idx.starts == NULL, "refused: nothing held");
+
+    memcpy(data, s.data, s.length);
+    data[test_find(data, s.length, 0xC0) + 1] = 0xC2;
+    check_eq("refused: progressive", hw_jpeg_index_build(&idx, data, s.length),
+             JPEGDEC_UNSUPPORTED);
+
+    /* the RST before interval 3 taken out */
+    at = s.start[3] - 2;
+    memcpy(data, s.data, at);
+    memcpy(data + at, s.data + at + 2, s.length - at - 2);
+    check_eq("refused: restart marker missing", hw_jpeg_index_build(&idx, data, s.length - 2),
+             JPEGDEC_STRM_ERROR);
+
+    check_eq("refused: no SOI", hw_jpeg_index_build(&idx, s.data + 2, s.length - 2),
+             JPEGDEC_STRM_ERROR);
+    check_eq("refused: no data", hw_jpeg_index_build(&idx, NULL, 0), JPEGDEC_PARAM_ERROR);
+
+    free(data);
+    hw_jpeg_test_stream_free(&s);
+}
+
+int main(void)
+{
+    test_colour();
+    test_gray();
+    test_dropped();
+    test_no_dri();
+    test_refused();
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,346 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_scale.c
+    Description:
+        Bilinear and box NV12 scaler, vector row passes over row bands
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_scale"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_scale.h"
+
+/*
+ * Each output row is made in two passes. The vertical pass runs along whole
+ * source rows, blending two of them or summing a box of them into 16 bit
+ * accumulators, and takes nearly all the time when shrinking; it works on
+ * sixteen lanes through the compiler's generic vectors. The horizontal pass
+ * reads the accumulators at the taps of each output pixel. Both paths do
+ * the same integer arithmetic. Define HW_JPEG_SCALE_NO_SIMD for the plain
+ * scalar code only.
+ */
+#if defined(__GNUC__) && !defined(HW_JPEG_SCALE_NO_SIMD)
+#define SCALE_SIMD                  1
+typedef RK_U16 ScaleVec __attribute__((vector_size(32)));
+#else
+#define SCALE_SIMD                  0
+#endif
+
+#define SCALE_LANES                 (16)
+/* 256 rows of 255 still fit a 16 bit sum; taller boxes are folded into 32 bits */
+#define SCALE_BOX_ROWS16            (256)
+/* fewer output rows per band are not worth a thread */
+#define SCALE_ROWS_PER_THREAD       (16)
+
+/* horizontal taps of one output pixel: bilinear x0, x1 and weight; box [x0, x1) */
+typedef struct
+{
+    int x0;
+    int x1;
+    int f;
+} ScaleTap;
+
+typedef struct
+{
+    const RK_U8 *src;
+    int srcW;           /* pixels of ch bytes */
+    int srcH;
+    int srcStride;
+    RK_U8 *dst;
+    int dstW;
+    int dstH;
+    int dstStride;
+    int ch;
+    ScaleTap *taps;
+} ScalePlane;
+
+typedef struct
+{
+    ScalePlane plane[2];    /* luma, interleaved chroma */
+    HW_JPEG_SCALE_MODE mode;
+    int simd;
+} ScaleJob;
+
+typedef struct
+{
+    const ScaleJob *job;
+    int y0;             /* output luma rows [y0, y1), even */
+    int y1;
+    RK_U16 *acc;
+    RK_U32 *wide;       /* boxes taller than SCALE_BOX_ROWS16 */
+    pthread_t thread;
+} ScaleWork;
+
+/* source line under output line i of n, 16.16, centres aligned */
+static RK_S64 scale_pos(int i, int n, int srcN)
+{
+    RK_S64 s = ((RK_S64)(2 * i + 1) * srcN - n) * 65536 / (2 * n);
+
+    return MAX(s, 0);
+}
+
+static void scale_bilinear_tap(int i, int n, int srcN, ScaleTap *t)
+{
+    RK_S64 s = scale_pos(i, n, srcN);
+
+    t->x0 = MIN((int)(s >> 16), srcN - 1);
+    t->x1 = MIN(t->x0 + 1, srcN - 1);
+    t->f = (s >> 8) & 0xff;
+}
+
+static void scale_box_tap(int i, int n, int srcN, ScaleTap *t)
+{
+    t->x0 = (RK_S64)i * srcN / n;
+    t->x1 = MAX((int)((RK_S64)(i + 1) * srcN / n), t->x0 + 1);
+    t->f = 0;
+}
+
+#if SCALE_SIMD
+#define SCALE_LOAD(p, i)            { (p)[(i) + 0], (p)[(i) + 1], (p)[(i) + 2], (p)[(i) + 3],       \
+                                      (p)[(i) + 4], (p)[(i) + 5], (p)[(i) + 6], (p)[(i) + 7],       \
+                                      (p)[(i) + 8], (p)[(i) + 9], (p)[(i) + 10], (p)[(i) + 11],     \
+                                      (p)[(i) + 12], (p)[(i) + 13], (p)[(i) + 14], (p)[(i) + 15] }
+#endif
+
+/* acc[i] = a[i] * (256 - f) + b[i] * f */
+static void scale_blend(RK_U16 *acc, const RK_U8 *a, const RK_U8 *b, int f, int n, int simd)
+{
+    int i = 0;
+
+#if SCALE_SIMD
+    if (simd) {
+        for (; i + SCALE_LANES <= n; i += SCALE_LANES) {
+            ScaleVec va = SCALE_LOAD(a, i);
+            ScaleVec vb = SCALE_LOAD(b, i);
+            ScaleVec v = va * (RK_U16)(256 - f) + vb * (RK_U16)f;
+
+            memcpy(acc + i, &v, sizeof(v));
+        }
+    }
+#endif
+    for (; i < n; i++)
+        acc[i] = a[i] * (256 - f) + b[i] * f;
+}
+
+/* acc[i] += a[i] */
+static void scale_sum(RK_U16 *acc, const RK_U8 *a, int n, int simd)
+{
+    int i = 0;
+
+#if SCALE_SIMD
+    if (simd) {
+        for (; i + SCALE_LANES <= n; i += SCALE_LANES) {
+            ScaleVec va = SCALE_LOAD(a, i);
+            ScaleVec v;
+
+            memcpy(&v, acc + i, sizeof(v));
+            v += va;
+            memcpy(acc + i, &v, sizeof(v));
+        }
+    }
+#endif
+    for (; i < n; i++)
+        acc[i] += a[i];
+}
+
+/* one output row of box sums in acc, of type RK_U16 or RK_U32, rows source rows tall */
+#define SCALE_BOX_ROW(p, acc, rows, out)                                        \
+    do {                                                                        \
+        int x_, c_, sx_;                                                        \
+        for (x_ = 0; x_ < (p)->dstW; x_++) {                                    \
+            const ScaleTap *t_ = &(p)->taps[x_];                                \
+            RK_U32 n_ = (t_->x1 - t_->x0) * (rows);                             \
+            for (c_ = 0; c_ < (p)->ch; c_++) {                                  \
+                RK_U32 sum_ = 0;                                                \
+                for (sx_ = t_->x0; sx_ < t_->x1; sx_++)                         \
+                    sum_ += (acc)[sx_ * (p)->ch + c_];                          \
+                *(out)++ = (sum_ + n_ / 2) / n_;                                \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+static void scale_rows(const ScalePlane *p, HW_JPEG_SCALE_MODE mode, int simd,
+                       int y0, int y1, RK_U16 *acc, RK_U32 *wide)
+{
+    int bytes = p->srcW * p->ch, x, y, c, i;
+
+    for (y = y0; y < y1; y++) {
+        RK_U8 *out = p->dst + y * p->dstStride;
+        ScaleTap ty;
+
+        if (mode == HW_JPEG_SCALE_BILINEAR) {
+            scale_bilinear_tap(y, p->dstH, p->srcH, &ty);
+            scale_blend(acc, p->src + ty.x0 * p->srcStride, p->src + ty.x1 * p->srcStride,
+                        ty.f, bytes, simd);
+
+            for (x = 0; x < p->dstW; x++) {
+                const ScaleTap *t = &p->taps[x];
+
+                for (c = 0; c < p->ch; c++) {
+                    RK_U32 a = acc[t->x0 * p->ch + c], b = acc[t->x1 * p->ch + c];
+                    *out++ = (a * (256 - t->f) + b * t->f + 32768) >> 16;
+                }
+            }
+        } else {
+            int r, rows;
+
+            scale_box_tap(y, p->dstH, p->srcH, &ty);
+            rows = ty.x1 - ty.x0;
+            if (rows <= SCALE_BOX_ROWS16) {
+                memset(acc, 0, bytes * sizeof(*acc));
+                for (r = ty.x0; r < ty.x1; r++)
+                    scale_sum(acc, p->src + r * p->srcStride, bytes, simd);
+                SCALE_BOX_ROW(p, acc, rows, out);
+                continue;
+            }
+
+            memset(wide, 0, bytes * sizeof(*wide));
+            for (r = ty.x0; r < ty.x1; r += SCALE_BOX_ROWS16) {
+                int k, end = MIN(r + SCALE_BOX_ROWS16, ty.x1);
+
+                memset(acc, 0, bytes * sizeof(*acc));
+                for (k = r; k < end; k++)
+                    scale_sum(acc, p->src + k * p->srcStride, bytes, simd);
+                for (i = 0; i < bytes; i++)
+                    wide[i] += acc[i];
+            }
+            SCALE_BOX_ROW(p, wide, rows, out);
+        }
+    }
+}
+
+static void *scale_worker(void *arg)
+{
+    ScaleWork *w = (ScaleWork *)arg;
+    const ScaleJob *job = w->job;
+
+    scale_rows(&job->plane[0], job->mode, job->simd, w->y0, w->y1, w->acc, w->wide);
+    scale_rows(&job->plane[1], job->mode, job->simd, w->y0 / 2, w->y1 / 2, w->acc, w->wide);
+    return NULL;
+}
+
+static int scale_taps(ScalePlane *p, HW_JPEG_SCALE_MODE mode)
+{
+    int x;
+
+    p->taps = (ScaleTap *)malloc(p->dstW * sizeof(*p->taps));
+    if (p->taps == NULL)
+        return -1;
+
+    for (x = 0; x < p->dstW; x++) {
+        if (mode == HW_JPEG_SCALE_BILINEAR)
+            scale_bilinear_tap(x, p->dstW, p->srcW, &p->taps[x]);
+        else
+            scale_box_tap(x, p->dstW, p->srcW, &p->taps[x]);
+    }
+    return 0;
+}
+
+static int scale_threads(int dsth, int threads)
+{
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    threads = MIN(threads, HW_JPEG_SCALE_THREADS_MAX);
+    threads = MIN(threads, dsth / SCALE_ROWS_PER_THREAD);
+    return MAX(threads, 1);
+}
+
+int hw_jpeg_scale_nv12(const uint8_t *srcy, const uint8_t *srcuv, int srcw, int srch, int srcStride,
+                       uint8_t *dsty, uint8_t *dstuv, int dstw, int dsth, int dstStride,
+                       HW_JPEG_SCALE_MODE mode, int flags, int threads, HwJpegScaleInfo *info)
+{
+    ScaleJob job;
+    ScaleWork work[HW_JPEG_SCALE_THREADS_MAX];
+    RK_S64 t0 = hw_jpeg_now_us();
+    int i, n, started = 0, ret = -1;
+
+    if (srcStride == 0)
+        srcStride = srcw;
+    if (dstStride == 0)
+        dstStride = dstw;
+    if (srcy == NULL || srcuv == NULL || dsty == NULL || dstuv == NULL ||
+        srcw < 2 || srch < 2 || dstw < 2 || dsth < 2 ||
+        ((srcw | srch | dstw | dsth) & 1) || srcStride < srcw || dstStride < dstw ||
+        (mode != HW_JPEG_SCALE_BILINEAR && mode != HW_JPEG_SCALE_BOX))
+        return -1;
+
+    memset(&job, 0, sizeof(job));
+    memset(work, 0, sizeof(work));
+    job.mode = mode;
+    job.simd = SCALE_SIMD && !(flags & HW_JPEG_SCALE_SCALAR);
+    for (i = 0; i < 2; i++) {
+        ScalePlane *p = &job.plane[i];
+
+        p->src = i ? srcuv : srcy;
+        p->srcW = i ? srcw / 2 : srcw;
+        p->srcH = i ? srch / 2 : srch;
+        p->srcStride = srcStride;
+        p->dst = i ? dstuv : dsty;
+        p->dstW = i ? dstw / 2 : dstw;
+        p->dstH = i ? dsth / 2 : dsth;
+        p->dstStride = dstStride;
+        p->ch = i ? 2 : 1;
+        if (scale_taps(p, mode))
+            goto done;
+    }
+
+    /* bands of even luma rows, so that each owns its chroma rows */
+    n = scale_threads(dsth, threads);
+    for (i = 0; i < n; i++) {
+        work[i].job = &job;
+        work[i].y0 = dsth / 2 * i / n * 2;
+        work[i].y1 = dsth / 2 * (i + 1) / n * 2;
+        work[i].acc = (RK_U16 *)malloc(srcw * sizeof(RK_U16));
+        if (work[i].acc == NULL)
+            goto done;
+        if (mode == HW_JPEG_SCALE_BOX && srch / dsth >= SCALE_BOX_ROWS16) {
+            work[i].wide = (RK_U32 *)malloc(srcw * sizeof(RK_U32));
+            if (work[i].wide == NULL)
+                goto done;
+        }
+    }
+
+    /* the calling thread takes the first band */
+    for (i = 1; i < n; i++) {
+        if (pthread_create(&work[i].thread, NULL, scale_worker, &work[i]))
+            break;
+        started++;
+    }
+    for (; i < n; i++)
+        scale_worker(&work[i]);
+    scale_worker(&work[0]);
+
+    for (i = 1; i <= started; i++)
+        pthread_join(work[i].thread, NULL);
+    ret = 0;
+
+    if (info != NULL) {
+        info->threads = n;
+        info->simd = job.simd;
+        info->scaleUs = hw_jpeg_now_us() - t0;
+    }
+
+done:
+    for (i = 0; i < HW_JPEG_SCALE_THREADS_MAX; i++) {
+        free(work[i].acc);
+        free(work[i].wide);
+    }
+    free(job.plane[0].taps);
+    free(job.plane[1].taps);
+
+    return ret;
+}
+
+int hw_jpeg_soft_scale(uint8_t *srcy, uint8_t *srcuv, int srcw, int srch,
+                       uint8_t *dsty, uint8_t *dstuv, int dstw, int dsth, int flag)
+{
+    return hw_jpeg_scale_nv12(srcy, srcuv, srcw, srch, 0, dsty, dstuv, dstw, dsth, 0,
+                              (HW_JPEG_SCALE_MODE)flag, 0, 0, NULL);
+}
@@ -0,0 +1,63 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_scale.h
+    Description:
+        NV12 scaler on the CPU, for thumbnails when the IPP is missing or
+        busy. The doSoftScale of the prebuilt encoder library does not
+        scale in this build, it returns -1. Bilinear suits mild ratios;
+        box averages every source pixel and does not alias when a 12 MP
+        frame becomes a 160x120 thumbnail. The row passes over the source
+        run on sixteen lanes through the compiler's generic vectors, and the
+        output rows are split in bands over several threads. The scalar
+        code is kept and gives bit identical output, for checking the
+        vector path.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_SCALE_H__
+#define __HW_JPEG_SCALE_H__
+
+#include <stdint.h>
+
+#include "vpu_mem.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HW_JPEG_SCALE_THREADS_MAX       (4)
+
+typedef enum
+{
+  HW_JPEG_SCALE_BILINEAR        = 0,
+  HW_JPEG_SCALE_BOX             = 1,
+} HW_JPEG_SCALE_MODE;
+
+/* flags */
+#define HW_JPEG_SCALE_SCALAR            (0x1)   /* plain C rows, the reference output */
+
+typedef struct
+{
+  int threads;          /* bands the picture was scaled in */
+  int simd;             /* row passes ran on vectors */
+  RK_S64 scaleUs;
+} HwJpegScaleInfo;
+
+/*
+ * Scale an NV12 picture, luma rows stride bytes apart and the interleaved
+ * chroma plane at srcuv with the same stride; a stride of 0 is the width.
+ * Sizes must be even. threads 0 uses one per online core. Returns 0, or
+ * -1 on bad arguments or out of memory.
+ */
+extern int hw_jpeg_scale_nv12(const uint8_t *srcy, const uint8_t *srcuv, int srcw, int srch, int srcStride,
+                              uint8_t *dsty, uint8_t *dstuv, int dstw, int dsth, int dstStride,
+                              HW_JPEG_SCALE_MODE mode, int flags, int threads, HwJpegScaleInfo *info);
+
+/* drop-in for doSoftScale: packed planes, flag is the HW_JPEG_SCALE_MODE */
+extern int hw_jpeg_soft_scale(uint8_t *srcy, uint8_t *srcuv, int srcw, int srch,
+                              uint8_t *dsty, uint8_t *dstuv, int dstw, int dsth, int flag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_SCALE_H__ */
@@ -0,0 +1,164 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_scale_bench.c
+    Description:
+        Speed of the NV12 scaler across camera frame sizes. Builds for the
+        host:
+
+            hw_jpeg_scale_bench [runs [threads]]
+
+        Every sensor size is scaled to a 160x120 thumbnail with the box
+        filter and to half size with bilinear, once on the scalar rows on
+        one thread, once on the vector rows on one thread and once on the
+        vector rows in bands. The vector output is compared byte for byte
+        with the scalar one.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_scale.h"
+
+#define BENCH_RUNS_DEF              (10)
+#define BENCH_THUMB_W               (160)
+#define BENCH_THUMB_H               (120)
+
+#ifdef HW_JPEG_SCALE_BENCH_HOST
+/* the rest of hw_jpeg_util needs the VPU, the scaler only takes the clock */
+RK_S64 hw_jpeg_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+typedef struct
+{
+    const char      *name;
+    int             w;
+    int             h;
+} BenchSize;
+
+typedef struct
+{
+    int             flags;
+    int             threads;
+    double          ms;
+    int             simd;
+    int             bands;
+} BenchRun;
+
+static double bench_scale(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh,
+                          HW_JPEG_SCALE_MODE mode, int runs, BenchRun *r)
+{
+    HwJpegScaleInfo info;
+    RK_S64 us = 0;
+    int i;
+
+    /* the first run warms the caches and is not counted */
+    for (i = 0; i <= runs; i++) {
+        memset(&info, 0, sizeof(info));
+        if (hw_jpeg_scale_nv12(src, src + sw * sh, sw, sh, 0, dst, dst + dw * dh, dw, dh, 0,
+                               mode, r->flags, r->threads, &info))
+            return -1;
+        if (i)
+            us += info.scaleUs;
+    }
+
+    r->ms = us / 1e3 / runs;
+    r->simd = info.simd;
+    r->bands = info.threads;
+    return r->ms;
+}
+
+static int bench_size(const BenchSize *s, HW_JPEG_SCALE_MODE mode, int dw, int dh, int runs,
+                      int threads)
+{
+    int srcBytes = s->w * s->h * 3 / 2, dstBytes = dw * dh * 3 / 2, i, same;
+    uint8_t *src = (uint8_t *)malloc(srcBytes);
+    uint8_t *ref = (uint8_t *)malloc(dstBytes);
+    uint8_t *dst = (uint8_t *)malloc(dstBytes);
+    BenchRun r[3] = {
+        { HW_JPEG_SCALE_SCALAR, 1,       0, 0, 0 },
+        { 0,                    1,       0, 0, 0 },
+        { 0,                    threads, 0, 0, 0 },
+    };
+
+    if (src == NULL || ref == NULL || dst == NULL) {
+        free(src);
+        free(ref);
+        free(dst);
+        return -1;
+    }
+
+    /* a gradient with some noise, so neither filter sees flat rows */
+    srand(s->w * s->h);
+    for (i = 0; i < srcBytes; i++)
+        src[i] = (uint8_t)((i % s->w) * 255 / s->w + (rand() & 15));
+
+    if (bench_scale(src, s->w, s->h, ref, dw, dh, mode, runs, &r[0]) < 0 ||
+        bench_scale(src, s->w, s->h, dst, dw, dh, mode, runs, &r[1]) < 0) {
+        free(src);
+        free(ref);
+        free(dst);
+        return -1;
+    }
+    same = !memcmp(ref, dst, dstBytes);
+    if (bench_scale(src, s->w, s->h, dst, dw, dh, mode, runs, &r[2]) < 0) {
+        free(src);
+        free(ref);
+        free(dst);
+        return -1;
+    }
+    same = same && !memcmp(ref, dst, dstBytes);
+
+    printf("  %-6s %4dx%-4d %-8s %4dx%-4d %9.2f %9.2f %9.2f %2d %7.2fx %7.2fx  %s\n",
+           s->name, s->w, s->h, mode == HW_JPEG_SCALE_BOX ? "box" : "bilinear", dw, dh,
+           r[0].ms, r[1].ms, r[2].ms, r[2].bands,
+           r[1].ms > 0 ? r[0].ms / r[1].ms : 0, r[2].ms > 0 ? r[0].ms / r[2].ms : 0,
+           same ? "same" : "DIFFERENT");
+
+    free(src);
+    free(ref);
+    free(dst);
+    return same ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    static const BenchSize sizes[] = {
+        { "VGA",    640,  480  },
+        { "720p",   1280, 720  },
+        { "1080p",  1920, 1080 },
+        { "3MP",    2048, 1536 },
+        { "5MP",    2592, 1944 },
+        { "8MP",    3264, 2448 },
+        { "13MP",   4160, 3120 },
+    };
+    int runs = argc > 1 ? atoi(argv[1]) : BENCH_RUNS_DEF;
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    int i, failed = 0;
+
+    if (runs <= 0)
+        runs = BENCH_RUNS_DEF;
+
+    printf("ms per frame over %d runs; scalar and vector on one thread, vector in bands\n", runs);
+    printf("  size   source    filter   output       scalar    vector     bands  n  vector   bands\n");
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        const BenchSize *s = &sizes[i];
+
+        if (bench_size(s, HW_JPEG_SCALE_BOX, BENCH_THUMB_W, BENCH_THUMB_H, runs, threads))
+            failed = 1;
+        /* half size, even as NV12 wants it */
+        if (bench_size(s, HW_JPEG_SCALE_BILINEAR, (s->w / 2) & ~1, (s->h / 2) & ~1, runs, threads))
+            failed = 1;
+    }
+
+    if (failed)
+        printf("FAILED: vector output differs from scalar, or a scale failed\n");
+    return failed;
+}
@@ -0,0 +1,251 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_slice.c
+    Description:
+        Slice mode JPEG decode with per slice post-processing
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_slice"
+
+#include <string.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_hw_caps.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_slice.h"
+
+#define SLICE_ALIGN(x, a)           (((x) + (a) - 1) & ~((a) - 1))
+
+typedef struct SliceCtx
+{
+    const HwJpegLayout  *fmt;
+    JpegDecImageInfo    info;
+    RK_U32              lines;          /* decoded lines per slice */
+    RK_U32              lumaBytes;      /* per slice */
+    RK_U32              yuvBytes;
+    RK_U32              outWidth;       /* post-processor output, multiple of 8 */
+    RK_U32              outRows;        /* per full slice */
+    RK_U32              visWidth;
+    RK_U32              visHeight;
+    RK_U32              bpp;
+    RK_U32              ring;
+    VPUMemLinear_t      yuv[HW_JPEG_SLICE_RING_MAX];
+    VPUMemLinear_t      rgb[HW_JPEG_SLICE_RING_MAX];
+    VPUSchedSession_t   *pp;
+    RK_U32              regs[VPU_REG_NUM_DEC_PP];
+} SliceCtx_t;
+
+static void slice_free(SliceCtx_t *c)
+{
+    RK_U32 i;
+
+    for (i = 0; i < c->ring; i++) {
+        hw_jpeg_unreserve(&c->yuv[i]);
+        hw_jpeg_unreserve(&c->rgb[i]);
+    }
+    if (c->pp != NULL)
+        VPUSchedClose(c->pp);
+}
+
+/* slice geometry from the image info; everything the rings need is fixed here */
+static int slice_plan(SliceCtx_t *c, const HwJpegSliceCfg *cfg)
+{
+    const JpegDecImageInfo *info = &c->info;
+    RK_U32 denom = cfg->scaleDenom > 0 ? cfg->scaleDenom : 1;
+    RK_U32 ppFlags = VPU_HW_PP_NONE;
+    RK_U32 lines;
+
+    if (info->codingMode != JPEGDEC_BASELINE)
+        return JPEGDEC_SLICE_MODE_UNSUPPORTED;
+
+    c->fmt = hw_jpeg_layout(info->outputFormat);
+    c->bpp = hw_jpeg_pp_bpp(cfg->outFormat);
+    if (c->fmt == NULL || !c->bpp || (denom & (denom - 1)) || denom > 8)
+        return JPEGDEC_PARAM_ERROR;
+
+    if (denom > 1)
+        ppFlags |= VPU_HW_PP_SCALE;
+    if (cfg->shouldDither)
+        ppFlags |= VPU_HW_PP_DITHER;
+
+    if (!VPUHwCapsCanDecodeJpeg(info->displayWidth, info->displayHeight, 0, ppFlags))
+        return JPEGDEC_SLICE_MODE_UNSUPPORTED;
+
+    /*
+     * Whole macroblock rows keep every slice an even number of output rows
+     * at 1/8 and let the post-processor take it as a picture of its own.
+     */
+    lines = cfg->sliceLines > 0 ? cfg->sliceLines : HW_JPEG_SLICE_LINES_DEF;
+    lines = SLICE_ALIGN(lines, 16);
+    c->lines = MIN(lines, SLICE_ALIGN(info->outputHeight, 16));
+
+    c->ring = cfg->ringSlots > 0 ? cfg->ringSlots : HW_JPEG_SLICE_RING_DEF;
+    c->ring = CLIP(c->ring, HW_JPEG_SLICE_RING_MIN, HW_JPEG_SLICE_RING_MAX);
+
+    c->lumaBytes = info->outputWidth * c->lines;
+    c->yuvBytes = hw_jpeg_yuv_bytes(c->fmt, info->outputWidth, c->lines);
+
+    c->outWidth = SLICE_ALIGN(MAX(info->outputWidth / denom, 8), 8);
+    c->outRows = c->lines / denom;
+    c->visWidth = MIN((info->displayWidth + denom - 1) / denom, c->outWidth);
+    c->visHeight = (info->displayHeight + denom - 1) / denom;
+
+    if (!VPUHwCapsCanPostProcess(c->outWidth, ppFlags))
+        return JPEGDEC_SLICE_MODE_UNSUPPORTED;
+
+    return JPEGDEC_OK;
+}
+
+static int slice_alloc(SliceCtx_t *c)
+{
+    RK_U32 i;
+
+    for (i = 0; i < c->ring; i++) {
+        if (hw_jpeg_reserve(&c->yuv[i], c->yuvBytes) < 0 ||
+            hw_jpeg_reserve(&c->rgb[i], c->outWidth * c->outRows * c->bpp) < 0) {
+            ALOGE("slice ring allocation failed, %d bytes per slice", c->yuvBytes);
+            return JPEGDEC_MEMFAIL;
+        }
+    }
+
+    c->pp = VPUSchedOpen(VPU_PP, VPU_SCHED_PRIO_BACKGROUND, VPU_SCHED_DEFAULT_WEIGHT);
+    if (c->pp == NULL)
+        return JPEGDEC_SYSTEM_ERROR;
+
+    return JPEGDEC_OK;
+}
+
+/* scale and convert the decoded lines of one slice into dst */
+static int slice_post_process(SliceCtx_t *c, const JpegDecOutput *out, RK_U32 lines,
+                              VPUMemLinear_t *dst, const HwJpegSliceCfg *cfg)
+{
+    VPU_POSTPROCESSING pp;
+    int ret;
+
+    memset(&pp, 0, sizeof(pp));
+    pp.InputAddr[0] = out->outputPictureY.busAddress;
+    pp.InputAddr[1] = out->outputPictureCbCr.busAddress;
+    pp.OutputAddr[0] = dst->phy_addr;
+    pp.InputWidth = c->info.outputWidth;
+    pp.InputHeight = lines;
+    pp.OutputWidth = c->outWidth;
+    pp.OutputHeight = lines * c->outRows / c->lines;
+    pp.ColorType = cfg->outFormat;
+    pp.ScaleEn = (pp.OutputWidth != pp.InputWidth || pp.OutputHeight != pp.InputHeight);
+    pp.DitherEn = cfg->shouldDither ? 1 : 0;
+
+    ret = hw_jpeg_pp_run(c->pp, c->regs, &pp, c->fmt, 0, 0, 0, 0);
+    if (ret != JPEGDEC_OK)
+        return ret;
+
+    VPUMemInvalidate(dst);
+    return JPEGDEC_OK;
+}
+
+int hw_jpeg_slice_decode(VPUMemLinear_t *stream, int streamLength,
+                         const HwJpegSliceCfg *cfg, hw_jpeg_slice_cb cb, void *opaque,
+                         HwJpegSliceStats *stats)
+{
+    SliceCtx_t ctx, *c = &ctx;
+    HwJpegSliceStats st;
+    JpegDecInst inst = NULL;
+    JpegDecInput in;
+    JpegDecOutput out;
+    JpegDecRet dret;
+    RK_U32 decY = 0, outY = 0, n = 0;
+    RK_S64 t0, t;
+    int ret;
+
+    if (stream == NULL || streamLength <= 0 || cfg == NULL || cb == NULL)
+        return JPEGDEC_PARAM_ERROR;
+
+    memset(c, 0, sizeof(*c));
+    memset(&st, 0, sizeof(st));
+    t0 = hw_jpeg_now_us();
+
+    if (JpegDecInit(&inst) != JPEGDEC_OK)
+        return JPEGDEC_INITFAIL;
+
+    memset(&in, 0, sizeof(in));
+    in.streamBuffer.pVirtualAddress = stream->vir_addr;
+    in.streamBuffer.busAddress = stream->phy_addr;
+    in.streamLength = streamLength;
+    in.decImageType = JPEGDEC_IMAGE;
+
+    ret = JpegDecGetImageInfo(inst, &in, &c->info);
+    if (ret == JPEGDEC_OK)
+        ret = slice_plan(c, cfg);
+    if (ret == JPEGDEC_OK)
+        ret = slice_alloc(c);
+    if (ret != JPEGDEC_OK)
+        goto done;
+
+    st.outWidth = c->visWidth;
+    st.outHeight = c->visHeight;
+    st.ringBytes = (long)c->ring * (c->yuvBytes + c->outWidth * c->outRows * c->bpp);
+    st.frameBytes = (long)c->yuvBytes / c->lines * SLICE_ALIGN(c->info.outputHeight, 16) +
+                    (long)c->outWidth * c->visHeight * c->bpp;
+
+    in.sliceMbSet = c->lines / c->fmt->mcuHeight;
+
+    do {
+        VPUMemLinear_t *yuv = &c->yuv[n % c->ring];
+        VPUMemLinear_t *rgb = &c->rgb[n % c->ring];
+        HwJpegSlice slice;
+        RK_U32 lines;
+
+        in.pictureBufferY.pVirtualAddress = yuv->vir_addr;
+        in.pictureBufferY.busAddress = yuv->phy_addr;
+        in.pictureBufferCbCr.pVirtualAddress = yuv->vir_addr + c->lumaBytes / 4;
+        in.pictureBufferCbCr.busAddress = yuv->phy_addr + c->lumaBytes;
+
+        t = hw_jpeg_now_us();
+        dret = JpegDecDecode(inst, &in, &out);
+        st.decodeUs += hw_jpeg_now_us() - t;
+        if (dret != JPEGDEC_SLICE_READY && dret != JPEGDEC_FRAME_READY) {
+            ALOGE("slice %d at line %d: decode error %d", n, decY, dret);
+            ret = dret;
+            break;
+        }
+
+        lines = MIN(c->lines, SLICE_ALIGN(c->info.outputHeight, 16) - decY);
+        t = hw_jpeg_now_us();
+        ret = slice_post_process(c, &out, lines, rgb, cfg);
+        st.ppUs += hw_jpeg_now_us() - t;
+        if (ret != JPEGDEC_OK)
+            break;
+
+        memset(&slice, 0, sizeof(slice));
+        slice.index = n;
+        slice.y = outY;
+        slice.rows = MIN(lines * c->outRows / c->lines, c->visHeight - MIN(outY, c->visHeight));
+        slice.width = c->visWidth;
+        slice.stride = c->outWidth * c->bpp;
+        slice.pixels = (const unsigned char *)rgb->vir_addr;
+        slice.mem = rgb;
+        slice.last = (dret == JPEGDEC_FRAME_READY);
+
+        if (!n)
+            st.firstSliceUs = hw_jpeg_now_us() - t0;
+        st.slices++;
+
+        if (slice.rows > 0 && cb(opaque, &slice)) {
+            ret = JPEGDEC_OK;
+            break;
+        }
+
+        decY += lines;
+        outY += lines * c->outRows / c->lines;
+        n++;
+    } while (dret != JPEGDEC_FRAME_READY);
+
+done:
+    slice_free(c);
+    JpegDecRelease(inst);
+
+    st.totalUs = hw_jpeg_now_us() - t0;
+    if (stats != NULL)
+        *stats = st;
+
+    return ret;
+}
@@ -0,0 +1,84 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_slice.h
+    Description:
+        Streaming JPEG decode in slice mode. hw_jpeg_decode decodes the whole
+        picture into one linear buffer before the post-processor runs, which
+        for a 20 MP photo is tens of megabytes and nothing to show until the
+        end. Here the decoder runs with JpegDecInput::sliceMbSet, each group
+        of MCU rows lands in a small ring of YCbCr slice buffers, is scaled
+        and colour converted by a standalone post-processor job into a ring
+        of output slices and handed to the caller as soon as it is ready.
+        Linear memory is a few slices regardless of the picture size.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_SLICE_H__
+#define __HW_JPEG_SLICE_H__
+
+#include "vpu_mem.h"
+#include "hw_jpegdecapi.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HW_JPEG_SLICE_LINES_DEF         (64)    /* decoded lines per slice */
+#define HW_JPEG_SLICE_RING_MIN          (2)
+#define HW_JPEG_SLICE_RING_DEF          (3)
+#define HW_JPEG_SLICE_RING_MAX          (8)
+
+typedef struct
+{
+  int outFormat;        /* VPU_PP_OUTPUT_FORMAT_RGB565 / ARGB8888 / ABGR8888 */
+  int scaleDenom;       /* 1, 2, 4 or 8, like PostProcessInfo::scale_denom */
+  HW_BOOL shouldDither;
+  int sliceLines;       /* decoded lines per slice, rounded up to 16; 0: default */
+  int ringSlots;        /* slices in flight; 0: default */
+} HwJpegSliceCfg;
+
+typedef struct
+{
+  int index;
+  int y;                /* first output row */
+  int rows;             /* visible rows, the picture is cropped to its display size */
+  int width;            /* visible pixels per row */
+  int stride;           /* bytes per row */
+  const unsigned char *pixels;
+  VPUMemLinear_t *mem;  /* ring slot holding the pixels */
+  HW_BOOL last;
+} HwJpegSlice;
+
+/* return 0 to go on, anything else stops the decode */
+typedef int (*hw_jpeg_slice_cb)(void *opaque, const HwJpegSlice *slice);
+
+typedef struct
+{
+  int slices;
+  int outWidth;         /* visible output size */
+  int outHeight;
+  long ringBytes;       /* linear memory of both slice rings */
+  long frameBytes;      /* what a whole picture decode plus post-process would take */
+  RK_S64 firstSliceUs;  /* call to the first slice handed out */
+  RK_S64 decodeUs;
+  RK_S64 ppUs;
+  RK_S64 totalUs;
+} HwJpegSliceStats;
+
+/*
+ * Decode the JFIF in stream (VPU memory, streamLength bytes) slice by
+ * slice. The pixels of a slice stay untouched until ringSlots - 1 more
+ * slices have been handed out, so the callback may pass them on to another
+ * thread. Returns JPEGDEC_OK, JPEGDEC_SLICE_MODE_UNSUPPORTED when the
+ * picture can not be streamed (progressive, non interleaved, or beyond the
+ * hardware; use hw_jpeg_decode), or another JpegDecRet error. stats may be
+ * NULL.
+ */
+extern int hw_jpeg_slice_decode(VPUMemLinear_t *stream, int streamLength,
+                                const HwJpegSliceCfg *cfg, hw_jpeg_slice_cb cb, void *opaque,
+                                HwJpegSliceStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_SLICE_H__ */
@@ -0,0 +1,1024 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_soft.c
+    Description:
+        Multithreaded software decode of baseline JPEG by restart interval
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_soft"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_soft.h"
+
+/*
+ * The IDCT and colour conversion work on eight lanes at a time through the
+ * compiler's generic vectors, which become NEON on ARM and SSE elsewhere.
+ * Define HW_JPEG_SOFT_NO_SIMD for the plain scalar code.
+ */
+#if defined(__GNUC__) && !defined(HW_JPEG_SOFT_NO_SIMD)
+#define SOFT_SIMD                   1
+typedef RK_S32 SoftVec __attribute__((vector_size(32)));
+#else
+#define SOFT_SIMD                   0
+#endif
+
+#define SOFT_COMP_MAX               (3)
+#define SOFT_MCU_MAX                (32)    /* 4:1:1 has four blocks across */
+#define SOFT_LUT_BITS               (9)
+/* fewer macroblocks than this per thread are not worth a thread */
+#define SOFT_MCUS_PER_THREAD        (64)
+
+/* islow IDCT constants, 13 bit fixed point */
+#define CONST_BITS                  (13)
+#define PASS1_BITS                  (2)
+#define FIX_0_298631336             (2446)
+#define FIX_0_390180644             (3196)
+#define FIX_0_541196100             (4433)
+#define FIX_0_765366865             (6270)
+#define FIX_0_899976223             (7373)
+#define FIX_1_175875602             (9633)
+#define FIX_1_501321110             (12299)
+#define FIX_1_847759065             (15137)
+#define FIX_1_961570560             (16069)
+#define FIX_2_053119869             (16819)
+#define FIX_2_562915447             (20995)
+#define FIX_3_072711026             (25172)
+#define PASS1_SHIFT                 (CONST_BITS - PASS1_BITS)
+#define PASS2_SHIFT                 (CONST_BITS + PASS1_BITS + 3)
+#define PASS1_ROUND                 (1 << (PASS1_SHIFT - 1))
+/* the +128 level shift rides on the rounding of the second pass */
+#define PASS2_ROUND                 ((1 << (PASS2_SHIFT - 1)) + (128 << PASS2_SHIFT))
+
+/* YCbCr to RGB, 16 bit fixed point */
+#define YCC_HALF                    (1 << 15)
+#define YCC_CR_R                    (91881)
+#define YCC_CB_G                    (-22554)
+#define YCC_CR_G                    (-46802)
+#define YCC_CB_B                    (116130)
+
+/* zigzag to natural order; a corrupt run past the end lands on the padding */
+static const RK_U8 soft_zigzag[64 + 16] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+    63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63,
+};
+
+/* ordered dither added before RGB565 truncation, like the post-processor's */
+static const RK_U8 soft_bayer[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+typedef struct SoftHuff
+{
+    RK_U16      lut[1 << SOFT_LUT_BITS];    /* (length << 8) | symbol, 0 for longer codes */
+    RK_S32      maxcode[17];                /* largest code of each length, -1 if none */
+    RK_S32      valoff[17];                 /* symbol index minus the first code of each length */
+    RK_U8       vals[256];
+    int         count;
+} SoftHuff;
+
+typedef struct SoftComp
+{
+    int         id;
+    int         h;                          /* blocks per MCU */
+    int         v;
+    int         hs;                         /* log2 of the upsampling to the MCU grid */
+    int         vs;
+    int         tq;
+    const SoftHuff *dc;
+    const SoftHuff *ac;
+} SoftComp;
+
+typedef struct SoftJpeg
+{
+    int         width;
+    int         height;
+    int         ncomp;
+    int         order[SOFT_COMP_MAX];       /* frame component of each scan component */
+    SoftComp    comp[SOFT_COMP_MAX];
+    int         mcuW;
+    int         mcuH;
+    int         mcusX;
+    int         mcus;
+    int         interval;                   /* MCUs per restart interval */
+    int         intervals;
+    RK_U16      qt[4][64];                  /* zigzag order */
+    int         qtDefined[4];
+    SoftHuff    dc[4];
+    SoftHuff    ac[4];
+    const RK_U8 *scan;                      /* entropy coded data */
+    const RK_U8 *end;
+    const RK_U8 **starts;                   /* first byte of each restart interval */
+
+    /* output, in output pixels of the scaled picture */
+    int         shift;                      /* log2 scale_denom */
+    int         color;
+    int         bpp;
+    int         dither;
+    int         outX;
+    int         outY;
+    int         outW;
+    int         outH;
+    RK_U8       *dst;
+    int         stride;
+} SoftJpeg;
+
+typedef struct SoftBits
+{
+    const RK_U8 *p;
+    const RK_U8 *end;
+    RK_U32      acc;                        /* next bits, MSB first */
+    int         n;
+    int         marker;                     /* hit a marker, the rest reads as zeros */
+} SoftBits;
+
+typedef struct SoftWork
+{
+    SoftJpeg    *j;
+    int         first;                      /* restart intervals [first, last) */
+    int         last;
+    int         ret;
+    pthread_t   thread;
+    RK_S32      pred[SOFT_COMP_MAX];
+    RK_S32      coef[64];
+    RK_U8       plane[SOFT_COMP_MAX][SOFT_MCU_MAX * SOFT_MCU_MAX];
+} SoftWork;
+
+static int soft_log2(int v)
+{
+    int s = 0;
+
+    while ((1 << s) < v)
+        s++;
+    return s;
+}
+
+static inline int soft_clamp(RK_S32 v)
+{
+    return (v & ~255) ? (~v >> 31) & 255 : v;
+}
+
+/*********************************** stream headers ***********************************/
+
+static int soft_huff_build(SoftHuff *h, const RK_U8 *counts, const RK_U8 *vals)
+{
+    int len, i, k = 0, code = 0;
+
+    memset(h->lut, 0, sizeof(h->lut));
+
+    for (len = 1; len <= 16; len++) {
+        h->valoff[len] = k - code;
+        for (i = 0; i < counts[len - 1]; i++, k++, code++) {
+            /* more codes than the length can hold */
+            if (code >= (1 << len))
+                return -1;
+            if (len <= SOFT_LUT_BITS) {
+                int shift = SOFT_LUT_BITS - len, f;
+                for (f = 0; f < (1 << shift); f++)
+                    h->lut[(code << shift) | f] = (len << 8) | vals[k];
+            }
+        }
+        h->maxcode[len] = counts[len - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+
+    memcpy(h->vals, vals, k);
+    h->count = k;
+    return 0;
+}
+
+static int soft_sof(SoftJpeg *j, const RK_U8 *s, int len)
+{
+    int i, maxH = 1, maxV = 1;
+
+    if (len < 6)
+        return JPEGDEC_STRM_ERROR;
+
+    j->height = s[1] << 8 | s[2];
+    j->width = s[3] << 8 | s[4];
+    j->ncomp = s[5];
+
+    /* 12 bit, height from a DNL marker, CMYK */
+    if (s[0] != 8 || !j->height || !j->width || (j->ncomp != 1 && j->ncomp != 3))
+        return JPEGDEC_UNSUPPORTED;
+    if (len < 6 + 3 * j->ncomp)
+        return JPEGDEC_STRM_ERROR;
+
+    for (i = 0; i < j->ncomp; i++) {
+        SoftComp *c = &j->comp[i];
+        c->id = s[6 + 3 * i];
+        c->h = s[7 + 3 * i] >> 4;
+        c->v = s[7 + 3 * i] & 15;
+        c->tq = s[8 + 3 * i];
+        if (c->tq > 3)
+            return JPEGDEC_STRM_ERROR;
+        if ((c->h != 1 && c->h != 2 && c->h != 4) || (c->v != 1 && c->v != 2 && c->v != 4))
+            return JPEGDEC_UNSUPPORTED;
+        maxH = MAX(maxH, c->h);
+        maxV = MAX(maxV, c->v);
+    }
+
+    /* a single component scan is not interleaved, its MCU is one block */
+    if (j->ncomp == 1)
+        j->comp[0].h = j->comp[0].v = maxH = maxV = 1;
+
+    for (i = 0; i < j->ncomp; i++) {
+        j->comp[i].hs = soft_log2(maxH / j->comp[i].h);
+        j->comp[i].vs = soft_log2(maxV / j->comp[i].v);
+    }
+
+    j->mcuW = maxH * 8;
+    j->mcuH = maxV * 8;
+    if (j->mcuW > SOFT_MCU_MAX || j->mcuH > SOFT_MCU_MAX)
+        return JPEGDEC_UNSUPPORTED;
+
+    j->mcusX = (j->width + j->mcuW - 1) / j->mcuW;
+    j->mcus = j->mcusX * ((j->height + j->mcuH - 1) / j->mcuH);
+    return JPEGDEC_OK;
+}
+
+static int soft_dht(SoftJpeg *j, const RK_U8 *s, int len)
+{
+    while (len > 0) {
+        int tc = s[0] >> 4, th = s[0] & 15, i, n = 0;
+
+        if (len < 17 || tc > 1 || th > 3)
+            return JPEGDEC_STRM_ERROR;
+        for (i = 1; i <= 16; i++)
+            n += s[i];
+        if (n > 256 || len < 17 + n)
+            return JPEGDEC_STRM_ERROR;
+        if (soft_huff_build(tc ? &j->ac[th] : &j->dc[th], s + 1, s + 17))
+            return JPEGDEC_STRM_ERROR;
+
+        s += 17 + n;
+        len -= 17 + n;
+    }
+    return JPEGDEC_OK;
+}
+
+static int soft_dqt(SoftJpeg *j, const RK_U8 *s, int len)
+{
+    while (len > 0) {
+        int pq = s[0] >> 4, tq = s[0] & 15, k;
+
+        if (pq > 1 || tq > 3 || len < 1 + 64 * (pq + 1))
+            return JPEGDEC_STRM_ERROR;
+        for (k = 0; k < 64; k++)
+            j->qt[tq][k] = pq ? s[1 + 2 * k] << 8 | s[2 + 2 * k] : s[1 + k];
+        j->qtDefined[tq] = 1;
+
+        s += 1 + 64 * (pq + 1);
+        len -= 1 + 64 * (pq + 1);
+    }
+    return JPEGDEC_OK;
+}
+
+static int soft_sos(SoftJpeg *j, const RK_U8 *s, int len)
+{
+    int i, k, ns;
+
+    if (!j->ncomp || len < 1)
+        return JPEGDEC_STRM_ERROR;
+
+    /* one scan per component is legal in baseline too, but nobody writes it */
+    ns = s[0];
+    if (ns != j->ncomp)
+        return JPEGDEC_UNSUPPORTED;
+    if (len < 4 + 2 * ns)
+        return JPEGDEC_STRM_ERROR;
+
+    for (i = 0; i < ns; i++) {
+        int td = s[2 + 2 * i] >> 4, ta = s[2 + 2 * i] & 15;
+
+        for (k = 0; k < j->ncomp && j->comp[k].id != s[1 + 2 * i]; k++)
+            ;
+        if (k == j->ncomp || td > 3 || ta > 3 || !j->dc[td].count || !j->ac[ta].count ||
+            !j->qtDefined[j->comp[k].tq])
+            return JPEGDEC_STRM_ERROR;
+
+        j->order[i] = k;
+        j->comp[k].dc = &j->dc[td];
+        j->comp[k].ac = &j->ac[ta];
+    }
+
+    if (s[1 + 2 * ns] != 0 || s[2 + 2 * ns] != 63 || s[3 + 2 * ns] != 0)
+        return JPEGDEC_UNSUPPORTED;
+
+    return JPEGDEC_OK;
+}
+
+/* headers up to the first scan */
+static int soft_parse(SoftJpeg *j, const RK_U8 *data, int length)
+{
+    const RK_U8 *p = data + 2, *end = data + length;
+    int ret;
+
+    if (data == NULL || length < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return JPEGDEC_STRM_ERROR;
+
+    for (;;) {
+        int m, len;
+
+        if (p >= end || *p != 0xFF)
+            return JPEGDEC_STRM_ERROR;
+        while (p < end && *p == 0xFF)
+            p++;
+        if (end - p < 3)
+            return JPEGDEC_STRM_ERROR;
+
+        m = *p++;
+        if (m == 0xD8 || m == 0x01 || (m >= 0xD0 && m <= 0xD7))
+            continue;
+        if (m == 0xD9)
+            return JPEGDEC_STRM_ERROR;
+
+        len = p[0] << 8 | p[1];
+        if (len < 2 || len > end - p)
+            return JPEGDEC_STRM_ERROR;
+
+        switch (m) {
+        case 0xC0:
+        case 0xC1:
+            ret = soft_sof(j, p + 2, len - 2);
+            break;
+        case 0xC4:
+            ret = soft_dht(j, p + 2, len - 2);
+            break;
+        case 0xDB:
+            ret = soft_dqt(j, p + 2, len - 2);
+            break;
+        case 0xDD:
+            ret = len < 4 ? JPEGDEC_STRM_ERROR : JPEGDEC_OK;
+            if (ret == JPEGDEC_OK)
+                j->interval = p[2] << 8 | p[3];
+            break;
+        case 0xDA:
+            ret = soft_sos(j, p + 2, len - 2);
+            if (ret == JPEGDEC_OK) {
+                j->scan = p + len;
+                j->end = end;
+                return JPEGDEC_OK;
+            }
+            break;
+        default:
+            /* progressive, lossless, hierarchical and arithmetic coding */
+            if (m >= 0xC2 && m <= 0xCF && m != 0xC4 && m != 0xC8)
+                return JPEGDEC_UNSUPPORTED;
+            ret = JPEGDEC_OK;
+            break;
+        }
+
+        if (ret != JPEGDEC_OK)
+            return ret;
+        p += len;
+    }
+}
+
+/* start of every restart interval, found by scanning for RSTn ahead of decoding */
+static int soft_restarts(SoftJpeg *j)
+{
+    const RK_U8 *p = j->scan;
+    int n = 1;
+
+    j->intervals = j->interval ? (j->mcus + j->interval - 1) / j->interval : 1;
+    if (!j->interval)
+        j->interval = j->mcus;
+
+    j->starts = (const RK_U8 **)malloc(j->intervals * sizeof(*j->starts));
+    if (j->starts == NULL)
+        return JPEGDEC_MEMFAIL;
+    j->starts[0] = p;
+
+    while (n < j->intervals) {
+        p = (const RK_U8 *)memchr(p, 0xFF, j->end - p);
+        if (p == NULL || p + 1 >= j->end)
+            break;
+        if (p[1] >= 0xD0 && p[1] <= 0xD7) {
+            j->starts[n++] = p + 2;
+            p += 2;
+        } else if (p[1] == 0x00) {
+            p += 2;
+        } else if (p[1] == 0xFF) {
+            p++;
+        } else {
+            break;
+        }
+    }
+
+    if (n < j->intervals) {
+        ALOGW("%d of %d restart intervals found", n, j->intervals);
+        j->intervals = n;
+        return JPEGDEC_STRM_ERROR;
+    }
+    return JPEGDEC_OK;
+}
+
+/* output window of ppInfo; crop in picture pixels, rounded out to whole output pixels */
+static int soft_geometry(SoftJpeg *j, const PostProcessInfo *ppInfo)
+{
+    int denom = ppInfo->scale_denom > 0 ? ppInfo->scale_denom : 1;
+    int x0 = 0, y0 = 0, x1 = j->width, y1 = j->height;
+
+    if ((denom & (denom - 1)) || denom > 8)
+        return JPEGDEC_PARAM_ERROR;
+
+    if (ppInfo->cropW > 0 && ppInfo->cropH > 0) {
+        x0 = MIN(MAX(ppInfo->cropX, 0), j->width);
+        y0 = MIN(MAX(ppInfo->cropY, 0), j->height);
+        x1 = MIN(x0 + ppInfo->cropW, j->width);
+        y1 = MIN(y0 + ppInfo->cropH, j->height);
+        if (x1 <= x0 || y1 <= y0)
+            return JPEGDEC_PARAM_ERROR;
+    }
+
+    j->shift = soft_log2(denom);
+    j->outX = x0 >> j->shift;
+    j->outY = y0 >> j->shift;
+    j->outW = ((x1 + denom - 1) >> j->shift) - j->outX;
+    j->outH = ((y1 + denom - 1) >> j->shift) - j->outY;
+    return JPEGDEC_OK;
+}
+
+/*********************************** entropy decoding ***********************************/
+
+static void soft_fill(SoftBits *b)
+{
+    while (b->n <= 24) {
+        RK_U32 c = 0;
+
+        if (!b->marker && b->p < b->end) {
+            c = *b->p++;
+            if (c == 0xFF) {
+                if (b->p < b->end && *b->p == 0x00) {
+                    b->p++;
+                } else {
+                    b->marker = 1;
+                    c = 0;
+                }
+            }
+        }
+        b->acc |= c << (24 - b->n);
+        b->n += 8;
+    }
+}
+
+static inline RK_S32 soft_bits(SoftBits *b, int s)
+{
+    RK_U32 v;
+
+    if (b->n < s)
+        soft_fill(b);
+    v = b->acc >> (32 - s);
+    b->acc <<= s;
+    b->n -= s;
+    return v;
+}
+
+static inline RK_S32 soft_extend(RK_S32 v, int s)
+{
+    return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+static inline int soft_huff(SoftBits *b, const SoftHuff *h)
+{
+    int e, len;
+
+    if (b->n < 16)
+        soft_fill(b);
+
+    e = h->lut[b->acc >> (32 - SOFT_LUT_BITS)];
+    if (e) {
+        b->acc <<= e >> 8;
+        b->n -= e >> 8;
+        return e & 255;
+    }
+
+    for (len = SOFT_LUT_BITS + 1; len <= 16; len++) {
+        RK_S32 code = b->acc >> (32 - len);
+        if (code <= h->maxcode[len]) {
+            b->acc <<= len;
+            b->n -= len;
+            code += h->valoff[len];
+            return code < h->count ? h->vals[code] : -1;
+        }
+    }
+    return -1;
+}
+
+/* one block, dequantised in natural order; returns the last coded zigzag index, -1 on error */
+static int soft_block(SoftBits *b, const SoftComp *c, const RK_U16 *q, RK_S32 *pred, RK_S32 *coef)
+{
+    int k, s, rs, last = 0;
+
+    s = soft_huff(b, c->dc);
+    if (s < 0 || s > 11)
+        return -1;
+    if (s)
+        *pred += soft_extend(soft_bits(b, s), s);
+
+    memset(coef, 0, 64 * sizeof(*coef));
+    coef[0] = *pred * q[0];
+
+    for (k = 1; k < 64; k++) {
+        rs = soft_huff(b, c->ac);
+        if (rs < 0)
+            return -1;
+        s = rs & 15;
+        if (s) {
+            k += rs >> 4;
+            if (k > 63)
+                return -1;
+            coef[soft_zigzag[k]] = soft_extend(soft_bits(b, s), s) * q[k];
+            last = k;
+        } else if (rs == 0xF0) {
+            k += 15;
+        } else {
+            break;
+        }
+    }
+    return last;
+}
+
+/*********************************** IDCT and colour ***********************************/
+
+/*
+ * One dimensional islow IDCT on eight inputs. T is RK_S32 for one column
+ * or SoftVec for eight at once; IN(k) and OUT(k, v) access the data.
+ */
+#define SOFT_IDCT_1D(T, IN, OUT, round, shift)                                  \
+do {                                                                            \
+    T z1, z2, z3, z4, z5, t0, t1, t2, t3, t10, t11, t12, t13;                   \
+                                                                                \
+    z2 = IN(2);                                                                 \
+    z3 = IN(6);                                                                 \
+    z1 = (z2 + z3) * FIX_0_541196100;                                           \
+    t2 = z1 + z3 * (-FIX_1_847759065);                                          \
+    t3 = z1 + z2 * FIX_0_765366865;                                             \
+    t0 = (IN(0) + IN(4)) * (1 << CONST_BITS) + (round);                         \
+    t1 = (IN(0) - IN(4)) * (1 << CONST_BITS) + (round);                         \
+    t10 = t0 + t3;                                                              \
+    t13 = t0 - t3;                                                              \
+    t11 = t1 + t2;                                                              \
+    t12 = t1 - t2;                                                              \
+                                                                                \
+    t0 = IN(7);                                                                 \
+    t1 = IN(5);                                                                 \
+    t2 = IN(3);                                                                 \
+    t3 = IN(1);                                                                 \
+    z1 = t0 + t3;                                                               \
+    z2 = t1 + t2;                                                               \
+    z3 = t0 + t2;                                                               \
+    z4 = t1 + t3;                                                               \
+    z5 = (z3 + z4) * FIX_1_175875602;                                           \
+    t0 = t0 * FIX_0_298631336;                                                  \
+    t1 = t1 * FIX_2_053119869;                                                  \
+    t2 = t2 * FIX_3_072711026;                                                  \
+    t3 = t3 * FIX_1_501321110;                                                  \
+    z1 = z1 * (-FIX_0_899976223);                                               \
+    z2 = z2 * (-FIX_2_562915447);                                               \
+    z3 = z3 * (-FIX_1_961570560) + z5;                                          \
+    z4 = z4 * (-FIX_0_390180644) + z5;                                          \
+    t0 += z1 + z3;                                                              \
+    t1 += z2 + z4;                                                              \
+    t2 += z2 + z3;                                                              \
+    t3 += z1 + z4;                                                              \
+                                                                                \
+    OUT(0, (t10 + t3) >> (shift));                                              \
+    OUT(7, (t10 - t3) >> (shift));                                              \
+    OUT(1, (t11 + t2) >> (shift));                                              \
+    OUT(6, (t11 - t2) >> (shift));                                              \
+    OUT(2, (t12 + t1) >> (shift));                                              \
+    OUT(5, (t12 - t1) >> (shift));                                              \
+    OUT(3, (t13 + t0) >> (shift));                                              \
+    OUT(4, (t13 - t0) >> (shift));                                              \
+} while (0)
+
+static void soft_idct(const RK_S32 *coef, RK_U8 *out, int stride)
+{
+    RK_S32 ws[64];
+    int r, k;
+
+#if SOFT_SIMD
+    SoftVec v[8], w[8];
+    RK_S32 tr[64];
+
+    /* rows of coefficients, so each lane runs one column */
+#define V_IN(k)         v[k]
+#define V_OUT(k, x)     w[k] = (x)
+    memcpy(v, coef, sizeof(v));
+    SOFT_IDCT_1D(SoftVec, V_IN, V_OUT, PASS1_ROUND, PASS1_SHIFT);
+
+    memcpy(ws, w, sizeof(w));
+    for (r = 0; r < 8; r++) {
+        for (k = 0; k < 8; k++)
+            tr[r * 8 + k] = ws[k * 8 + r];
+    }
+    memcpy(v, tr, sizeof(v));
+
+    /* and now each lane runs one row, w[k] holds column k */
+    SOFT_IDCT_1D(SoftVec, V_IN, V_OUT, PASS2_ROUND, PASS2_SHIFT);
+    memcpy(ws, w, sizeof(w));
+#undef V_IN
+#undef V_OUT
+#else
+    int i;
+
+#define C_IN(k)         coef[(k) * 8 + i]
+#define C_OUT(k, x)     ws[(k) * 8 + i] = (x)
+    for (i = 0; i < 8; i++)
+        SOFT_IDCT_1D(RK_S32, C_IN, C_OUT, PASS1_ROUND, PASS1_SHIFT);
+#undef C_IN
+#undef C_OUT
+
+    {
+        RK_S32 rows[64];
+
+#define R_IN(k)         ws[i * 8 + (k)]
+#define R_OUT(k, x)     rows[(k) * 8 + i] = (x)
+        for (i = 0; i < 8; i++)
+            SOFT_IDCT_1D(RK_S32, R_IN, R_OUT, PASS2_ROUND, PASS2_SHIFT);
+#undef R_IN
+#undef R_OUT
+        memcpy(ws, rows, sizeof(rows));
+    }
+#endif
+
+    /* ws[k * 8 + r] is row r, column k */
+    for (r = 0; r < 8; r++) {
+        for (k = 0; k < 8; k++)
+            out[r * stride + k] = soft_clamp(ws[k * 8 + r]);
+    }
+}
+
+static void soft_fill_block(RK_U8 *out, int stride, RK_S32 dc)
+{
+    int r, v = soft_clamp(((dc + 4) >> 3) + 128);
+
+    for (r = 0; r < 8; r++)
+        memset(out + r * stride, v, 8);
+}
+
+/* n pixels, n rounded up to 8 readable entries; cb NULL for grey */
+static void soft_ycc_rgb(const RK_U8 *y, const RK_U8 *cb, const RK_U8 *cr, int n,
+                         RK_S32 *r, RK_S32 *g, RK_S32 *b)
+{
+    int i;
+
+    if (cb == NULL) {
+        for (i = 0; i < n; i++)
+            r[i] = g[i] = b[i] = y[i];
+        return;
+    }
+
+#if SOFT_SIMD
+    for (i = 0; i < n; i += 8) {
+        SoftVec vy = { y[i], y[i + 1], y[i + 2], y[i + 3], y[i + 4], y[i + 5], y[i + 6], y[i + 7] };
+        SoftVec vb = { cb[i], cb[i + 1], cb[i + 2], cb[i + 3],
+                       cb[i + 4], cb[i + 5], cb[i + 6], cb[i + 7] };
+        SoftVec vr = { cr[i], cr[i + 1], cr[i + 2], cr[i + 3],
+                       cr[i + 4], cr[i + 5], cr[i + 6], cr[i + 7] };
+        SoftVec o;
+
+        vb -= 128;
+        vr -= 128;
+        o = vy + ((vr * YCC_CR_R + YCC_HALF) >> 16);
+        memcpy(r + i, &o, sizeof(o));
+        o = vy + ((vb * YCC_CB_G + vr * YCC_CR_G + YCC_HALF) >> 16);
+        memcpy(g + i, &o, sizeof(o));
+        o = vy + ((vb * YCC_CB_B + YCC_HALF) >> 16);
+        memcpy(b + i, &o, sizeof(o));
+    }
+#else
+    for (i = 0; i < n; i++) {
+        RK_S32 u = cb[i] - 128, v = cr[i] - 128;
+        r[i] = y[i] + ((v * YCC_CR_R + YCC_HALF) >> 16);
+        g[i] = y[i] + ((u * YCC_CB_G + v * YCC_CR_G + YCC_HALF) >> 16);
+        b[i] = y[i] + ((u * YCC_CB_B + YCC_HALF) >> 16);
+    }
+#endif
+}
+
+/* one output row segment starting at output column ox of output row oy */
+static void soft_emit(const SoftJpeg *j, const RK_U8 *y, const RK_U8 *cb, const RK_U8 *cr,
+                      int n, RK_U8 *dst, int ox, int oy)
+{
+    RK_S32 r[SOFT_MCU_MAX], g[SOFT_MCU_MAX], b[SOFT_MCU_MAX];
+    int i;
+
+    soft_ycc_rgb(y, cb, cr, (n + 7) & ~7, r, g, b);
+
+    switch (j->color) {
+    case VPU_PP_OUTPUT_FORMAT_RGB565: {
+        RK_U16 *o = (RK_U16 *)dst;
+        const RK_U8 *m = soft_bayer[oy & 3];
+
+        for (i = 0; i < n; i++) {
+            int d = j->dither ? m[(ox + i) & 3] : 0;
+            o[i] = (soft_clamp(r[i] + (d >> 1)) >> 3) << 11 |
+                   (soft_clamp(g[i] + (d >> 2)) >> 2) << 5 |
+                   (soft_clamp(b[i] + (d >> 1)) >> 3);
+        }
+        break;
+    }
+    case VPU_PP_OUTPUT_FORMAT_ABGR8888: {
+        RK_U32 *o = (RK_U32 *)dst;
+
+        for (i = 0; i < n; i++)
+            o[i] = 0xff000000 | soft_clamp(b[i]) << 16 | soft_clamp(g[i]) << 8 | soft_clamp(r[i]);
+        break;
+    }
+    default: {
+        RK_U32 *o = (RK_U32 *)dst;
+
+        for (i = 0; i < n; i++)
+            o[i] = 0xff000000 | soft_clamp(r[i]) << 16 | soft_clamp(g[i]) << 8 | soft_clamp(b[i]);
+        break;
+    }
+    }
+}
+
+/*
+ * n scaled samples of component c along MCU row fy from MCU column fx,
+ * each the average of its scale_denom square of the upsampled plane.
+ */
+static void soft_row(const SoftJpeg *j, const SoftWork *w, int c, int fy, int fx, int n, RK_U8 *out)
+{
+    const SoftComp *cp = &j->comp[c];
+    const RK_U8 *p = w->plane[c];
+    int stride = cp->h * 8, d = 1 << j->shift, i, x, y;
+    int bw = MAX(d >> cp->hs, 1), bh = MAX(d >> cp->vs, 1);
+    int shift = soft_log2(bw * bh);
+
+    /* at 1/8 a full resolution block is flat, one sample is its average */
+    if (j->shift == 3 && !cp->hs && !cp->vs)
+        bw = bh = 1;
+
+    p += (fy >> cp->vs) * stride;
+
+    if (bw == 1 && bh == 1) {
+        if (!cp->hs && d == 1) {
+            memcpy(out, p + fx, n);
+        } else {
+            for (i = 0; i < n; i++)
+                out[i] = p[(fx + i * d) >> cp->hs];
+        }
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        const RK_U8 *s = p + ((fx + i * d) >> cp->hs);
+        RK_U32 sum = 0;
+
+        for (y = 0; y < bh; y++, s += stride) {
+            for (x = 0; x < bw; x++)
+                sum += s[x];
+        }
+        out[i] = (sum + (1 << shift >> 1)) >> shift;
+    }
+}
+
+/* the part of an MCU inside the output window, in output pixels */
+static int soft_mcu_window(const SoftJpeg *j, int mx, int my, int *x0, int *x1, int *y0, int *y1)
+{
+    int ox = (mx * j->mcuW) >> j->shift, oy = (my * j->mcuH) >> j->shift;
+
+    *x0 = MAX(ox, j->outX);
+    *x1 = MIN(ox + (j->mcuW >> j->shift), j->outX + j->outW);
+    *y0 = MAX(oy, j->outY);
+    *y1 = MIN(oy + (j->mcuH >> j->shift), j->outY + j->outH);
+    return *x0 < *x1 && *y0 < *y1;
+}
+
+static void soft_mcu_out(const SoftJpeg *j, const SoftWork *w, int mx, int my,
+                         int x0, int x1, int y0, int y1)
+{
+    RK_U8 row[SOFT_COMP_MAX][SOFT_MCU_MAX];
+    int ox = (mx * j->mcuW) >> j->shift, oy = (my * j->mcuH) >> j->shift;
+    int c, y;
+
+    for (y = y0; y < y1; y++) {
+        for (c = 0; c < j->ncomp; c++)
+            soft_row(j, w, c, (y - oy) << j->shift, (x0 - ox) << j->shift, x1 - x0, row[c]);
+
+        soft_emit(j, row[0], j->ncomp == 3 ? row[1] : NULL, row[2], x1 - x0,
+                  j->dst + (y - j->outY) * j->stride + (x0 - j->outX) * j->bpp, x0, y);
+    }
+}
+
+/*********************************** threads ***********************************/
+
+static int soft_interval(SoftJpeg *j, SoftWork *w, int n)
+{
+    SoftBits bits;
+    int m = n * j->interval, mEnd = MIN(m + j->interval, j->mcus);
+
+    memset(&bits, 0, sizeof(bits));
+    bits.p = j->starts[n];
+    bits.end = j->end;
+    memset(w->pred, 0, sizeof(w->pred));
+
+    for (; m < mEnd; m++) {
+        int mx = m % j->mcusX, my = m / j->mcusX, x0, x1, y0, y1, i, bx, by;
+        /* blocks outside the crop window are entropy decoded and dropped */
+        int visible = soft_mcu_window(j, mx, my, &x0, &x1, &y0, &y1);
+
+        for (i = 0; i < j->ncomp; i++) {
+            int c = j->order[i];
+            const SoftComp *cp = &j->comp[c];
+            int stride = cp->h * 8;
+
+            for (by = 0; by < cp->v; by++) {
+                for (bx = 0; bx < cp->h; bx++) {
+                    RK_U8 *out = w->plane[c] + by * 8 * stride + bx * 8;
+                    int last = soft_block(&bits, cp, j->qt[cp->tq], &w->pred[c], w->coef);
+
+                    if (last < 0)
+                        return JPEGDEC_STRM_ERROR;
+                    if (!visible)
+                        continue;
+                    /* subsampled blocks span several output pixels even at 1/8 */
+                    if (!last || (j->shift == 3 && !cp->hs && !cp->vs))
+                        soft_fill_block(out, stride, w->coef[0]);
+                    else
+                        soft_idct(w->coef, out, stride);
+                }
+            }
+        }
+
+        if (visible)
+            soft_mcu_out(j, w, mx, my, x0, x1, y0, y1);
+    }
+
+    return JPEGDEC_OK;
+}
+
+static void *soft_worker(void *arg)
+{
+    SoftWork *w = (SoftWork *)arg;
+    int n;
+
+    for (n = w->first; n < w->last; n++) {
+        /* a broken interval loses its own macroblocks only */
+        if (soft_interval(w->j, w, n) != JPEGDEC_OK) {
+            ALOGW("restart interval %d is corrupt", n);
+            w->ret = JPEGDEC_STRM_ERROR;
+        }
+    }
+    return NULL;
+}
+
+static int soft_threads(const SoftJpeg *j, int threads)
+{
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    threads = MIN(threads, HW_JPEG_SOFT_THREADS_MAX);
+    threads = MIN(threads, j->intervals);
+    threads = MIN(threads, j->mcus / SOFT_MCUS_PER_THREAD);
+    return MAX(threads, 1);
+}
+
+/*********************************** API ***********************************/
+
+int hw_jpeg_soft_probe(const unsigned char *data, int length, int *width, int *height)
+{
+    SoftJpeg *j = (SoftJpeg *)calloc(1, sizeof(*j));
+    int ret;
+
+    if (j == NULL)
+        return JPEGDEC_MEMFAIL;
+
+    ret = soft_parse(j, data, length);
+    if (ret == JPEGDEC_OK) {
+        if (width != NULL)
+            *width = j->width;
+        if (height != NULL)
+            *height = j->height;
+    }
+
+    free(j);
+    return ret;
+}
+
+int hw_jpeg_soft_output_size(const unsigned char *data, int length,
+                             const PostProcessInfo *ppInfo, int *width, int *height)
+{
+    SoftJpeg *j;
+    int ret;
+
+    if (ppInfo == NULL)
+        return JPEGDEC_PARAM_ERROR;
+
+    j = (SoftJpeg *)calloc(1, sizeof(*j));
+    if (j == NULL)
+        return JPEGDEC_MEMFAIL;
+
+    ret = soft_parse(j, data, length);
+    if (ret == JPEGDEC_OK)
+        ret = soft_geometry(j, ppInfo);
+    if (ret == JPEGDEC_OK) {
+        *width = j->outW;
+        *height = j->outH;
+    }
+
+    free(j);
+    return ret;
+}
+
+int hw_jpeg_soft_decode(const unsigned char *data, int length, const PostProcessInfo *ppInfo,
+                        void *dst, int dstStride, int dstSize, int threads,
+                        HwJpegSoftInfo *info)
+{
+    SoftWork *work = NULL;
+    SoftJpeg *j;
+    RK_S64 t0 = hw_jpeg_now_us();
+    int ret, i, n = 0, started = 0;
+
+    if (ppInfo == NULL || dst == NULL)
+        return JPEGDEC_PARAM_ERROR;
+
+    j = (SoftJpeg *)calloc(1, sizeof(*j));
+    if (j == NULL)
+        return JPEGDEC_MEMFAIL;
+
+    ret = soft_parse(j, data, length);
+    if (ret == JPEGDEC_OK)
+        ret = soft_geometry(j, ppInfo);
+    if (ret != JPEGDEC_OK)
+        goto done;
+
+    j->color = hw_jpeg_pp_color(ppInfo->outFomart);
+    j->bpp = hw_jpeg_pp_bpp(j->color);
+    j->dither = ppInfo->shouldDither;
+    j->dst = (RK_U8 *)dst;
+    j->stride = dstStride;
+    if (!j->bpp || dstStride < j->outW * j->bpp || dstSize < dstStride * j->outH) {
+        ret = JPEGDEC_PARAM_ERROR;
+        goto done;
+    }
+
+    /* a missing restart marker is reported, the intervals before it still decode */
+    ret = soft_restarts(j);
+    if (ret == JPEGDEC_MEMFAIL)
+        goto done;
+
+    n = soft_threads(j, threads);
+    work = (SoftWork *)calloc(n, sizeof(*work));
+    if (work == NULL) {
+        ret = JPEGDEC_MEMFAIL;
+        goto done;
+    }
+
+    for (i = 0; i < n; i++) {
+        work[i].j = j;
+        work[i].first = j->intervals * i / n;
+        work[i].last = j->intervals * (i + 1) / n;
+    }
+
+    /* the calling thread takes the first share */
+    for (i = 1; i < n; i++) {
+        if (pthread_create(&work[i].thread, NULL, soft_worker, &work[i]))
+            break;
+        started++;
+    }
+    for (; i < n; i++)
+        soft_worker(&work[i]);
+    soft_worker(&work[0]);
+
+    for (i = 1; i <= started; i++)
+        pthread_join(work[i].thread, NULL);
+
+    for (i = 0; i < n; i++) {
+        if (work[i].ret != JPEGDEC_OK)
+            ret = work[i].ret;
+    }
+
+done:
+    if (info != NULL) {
+        memset(info, 0, sizeof(*info));
+        if (ret == JPEGDEC_OK || ret == JPEGDEC_STRM_ERROR) {
+            info->width = j->outW;
+            info->height = j->outH;
+        }
+        info->threads = n;
+        info->intervals = j->intervals;
+        info->decodeUs = hw_jpeg_now_us() - t0;
+    }
+
+    free(work);
+    free(j->starts);
+    free(j);
+    return ret;
+}
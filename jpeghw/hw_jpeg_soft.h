@@ -0,0 +1,67 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_soft.h
+    Description:
+        Software decode of the baseline JPEGs the hardware refuses, e.g.
+        pictures beyond the decoder limits or with a sampling the
+        post-processor can not read. Callers used to fall back to single
+        threaded libjpeg for those. Here the restart intervals of the
+        stream are entropy decoded on several cores at once, each thread
+        running the IDCT, upsampling and colour conversion of its own
+        macroblocks straight into the destination, and the PostProcessInfo
+        crop, scale and output format are honoured like on the hardware
+        path. Progressive, arithmetic coded, 12 bit and CMYK streams are
+        still refused with JPEGDEC_UNSUPPORTED.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_SOFT_H__
+#define __HW_JPEG_SOFT_H__
+
+#include "vpu_mem.h"
+#include "hw_jpegdecapi.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HW_JPEG_SOFT_THREADS_MAX        (8)
+
+typedef struct
+{
+  int width;            /* pixels written per row */
+  int height;           /* rows written */
+  int threads;          /* threads the picture was decoded on */
+  int intervals;        /* restart intervals, 1 for a stream without DRI */
+  RK_S64 decodeUs;
+} HwJpegSoftInfo;
+
+/*
+ * Picture size and whether the stream is something hw_jpeg_soft_decode
+ * takes: JPEGDEC_OK, JPEGDEC_UNSUPPORTED or JPEGDEC_STRM_ERROR.
+ */
+extern int hw_jpeg_soft_probe(const unsigned char *data, int length, int *width, int *height);
+
+/*
+ * Output size of a decode with ppInfo, so that dst can be sized first.
+ * The crop window is in picture pixels and is not widened to macroblocks;
+ * cropW or cropH 0 means the whole picture.
+ */
+extern int hw_jpeg_soft_output_size(const unsigned char *data, int length,
+                                    const PostProcessInfo *ppInfo, int *width, int *height);
+
+/*
+ * Decode the whole JFIF in data into dst, dstStride bytes per row, as
+ * RGB565 or ARGB8888 per ppInfo->outFomart. threads 0 uses one per
+ * online core. Returns JPEGDEC_OK or a JpegDecRet error; a corrupt
+ * restart interval leaves its macroblocks unwritten and returns
+ * JPEGDEC_STRM_ERROR once the rest is decoded.
+ */
+extern int hw_jpeg_soft_decode(const unsigned char *data, int length, const PostProcessInfo *ppInfo,
+                               void *dst, int dstStride, int dstSize, int threads,
+                               HwJpegSoftInfo *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_SOFT_H__ */
@@ -0,0 +1,301 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_soft_test.c
+    Description:
+        Test of the software JPEG decoder. Builds for the host:
+
+            hw_jpeg_soft_test
+
+        The stream comes from hw_jpeg_test_stream: a 4:2:0 baseline JPEG
+        whose macroblocks are flat colours, so every sample decodes exactly
+        and the expected RGB is known. Covers probe and output size,
+        ARGB8888 and RGB565 output, the same bytes on one thread and
+        several, crop windows at and off the macroblock grid against the
+        full picture, scale_denom, a corrupt restart interval losing only
+        its own macroblocks, and a progressive stream refused.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_soft.h"
+#include "hw_jpeg_test_stream.h"
+
+#define TEST_MB_W                   (32)
+#define TEST_MB_H                   (16)
+#define TEST_W                      (TEST_MB_W * 16)
+#define TEST_H                      (TEST_MB_H * 16)
+#define TEST_INTERVAL               (16)
+#define TEST_INTERVALS              (TEST_MB_W * TEST_MB_H / TEST_INTERVAL)
+#define TEST_CORRUPT                (5)
+
+#ifdef HW_JPEG_SOFT_TEST_HOST
+/* the rest of hw_jpeg_util needs the VPU, the decoder only takes these */
+RK_S64 hw_jpeg_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int hw_jpeg_pp_color(int outFomart)
+{
+    return outFomart == 0 ? VPU_PP_OUTPUT_FORMAT_RGB565 :
+           outFomart == 1 ? VPU_PP_OUTPUT_FORMAT_ARGB8888 : -1;
+}
+
+int hw_jpeg_pp_bpp(int colorType)
+{
+    return colorType == VPU_PP_OUTPUT_FORMAT_ARGB8888 ? 4 :
+           colorType == VPU_PP_OUTPUT_FORMAT_RGB565 ? 2 : 0;
+}
+#endif
+
+static int failures;
+static HwJpegTestStream test;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+static RK_U32 *test_decode(const RK_U8 *data, const PostProcessInfo *pp, int threads,
+                           int *w, int *h, HwJpegSoftInfo *info, int *ret)
+{
+    RK_U32 *out;
+
+    *ret = hw_jpeg_soft_output_size(data, test.length, pp, w, h);
+    if (*ret != JPEGDEC_OK)
+        return NULL;
+
+    out = (RK_U32 *)calloc(*w * *h, 4);
+    *ret = hw_jpeg_soft_decode(data, test.length, pp, out, *w * 4, *w * *h * 4, threads, info);
+    return out;
+}
+
+/* the centre pixel of every macroblock, denom output pixels per picture pixel */
+static int test_mb_colours(const RK_U32 *out, int stride, int denom, int first, int last)
+{
+    int m, bad = 0;
+
+    for (m = first; m < last; m++) {
+        int mx = m % TEST_MB_W, my = m / TEST_MB_W, r, g, b;
+        RK_U32 px = out[(my * 16 + 8) / denom * stride + (mx * 16 + 8) / denom];
+
+        hw_jpeg_test_mb_rgb(&test, mx, my, &r, &g, &b);
+        if ((px >> 24) != 0xFF || abs((int)((px >> 16) & 255) - r) > 1 ||
+            abs((int)((px >> 8) & 255) - g) > 1 || abs((int)(px & 255) - b) > 1)
+            bad++;
+    }
+    return bad;
+}
+
+static RK_U32 *test_full;
+
+static void test_probe(void)
+{
+    PostProcessInfo pp;
+    RK_U8 *prog;
+    int w = 0, h = 0, i;
+
+    check_eq("probe", hw_jpeg_soft_probe(test.data, test.length, &w, &h), JPEGDEC_OK);
+    check(w == TEST_W && h == TEST_H, "probe: size");
+
+    memset(&pp, 0, sizeof(pp));
+    pp.outFomart = 1;
+    pp.scale_denom = 4;
+    hw_jpeg_soft_output_size(test.data, test.length, &pp, &w, &h);
+    check(w == TEST_W / 4 && h == TEST_H / 4, "probe: quarter size");
+    pp.scale_denom = 3;
+    check_eq("probe: bad denom", hw_jpeg_soft_output_size(test.data, test.length, &pp, &w, &h),
+             JPEGDEC_PARAM_ERROR);
+
+    /* the same stream marked progressive */
+    prog = (RK_U8 *)malloc(test.length);
+    memcpy(prog, test.data, test.length);
+    for (i = 0; i + 1 < test.length; i++) {
+        if (prog[i] == 0xFF && prog[i + 1] == 0xC0) {
+            prog[i + 1] = 0xC2;
+            break;
+        }
+    }
+    check_eq("probe: progressive", hw_jpeg_soft_probe(prog, test.length, &w, &h),
+             JPEGDEC_UNSUPPORTED);
+    free(prog);
+}
+
+static void test_full_picture(void)
+{
+    PostProcessInfo pp;
+    HwJpegSoftInfo one, many;
+    RK_U32 *out;
+    int w, h, ret;
+
+    memset(&pp, 0, sizeof(pp));
+    pp.outFomart = 1;
+
+    test_full = test_decode(test.data, &pp, 1, &w, &h, &one, &ret);
+    check_eq("full: decode", ret, JPEGDEC_OK);
+    if (test_full == NULL)
+        return;
+    check(one.width == TEST_W && one.height == TEST_H, "full: size");
+    check_eq("full: one thread", one.threads, 1);
+    check_eq("full: intervals", one.intervals, TEST_INTERVALS);
+    check_eq("full: colours", test_mb_colours(test_full, TEST_W, 1, 0, TEST_MB_W * TEST_MB_H), 0);
+
+    out = test_decode(test.data, &pp, 4, &w, &h, &many, &ret);
+    check_eq("full: threaded decode", ret, JPEGDEC_OK);
+    check_eq("full: threads", many.threads, 4);
+    check(out != NULL && !memcmp(out, test_full, TEST_W * TEST_H * 4), "full: same on 4 threads");
+    free(out);
+}
+
+/* a crop window is honoured to the pixel, the same bytes as the full picture */
+static void test_crop(int x, int y, int cw, int ch, const char *what)
+{
+    PostProcessInfo pp;
+    HwJpegSoftInfo info;
+    RK_U32 *out;
+    int w, h, ret, row, same = 1;
+
+    if (test_full == NULL)
+        return;
+
+    memset(&pp, 0, sizeof(pp));
+    pp.outFomart = 1;
+    pp.cropX = x;
+    pp.cropY = y;
+    pp.cropW = cw;
+    pp.cropH = ch;
+
+    out = test_decode(test.data, &pp, 0, &w, &h, &info, &ret);
+    check_eq(what, ret, JPEGDEC_OK);
+    if (out == NULL)
+        return;
+    check(w == MIN(cw, TEST_W - x) && h == MIN(ch, TEST_H - y), what);
+    for (row = 0; row < h; row++)
+        same = same && !memcmp(out + row * w, test_full + (y + row) * TEST_W + x, w * 4);
+    check(same, what);
+    free(out);
+}
+
+static void test_scaled(void)
+{
+    PostProcessInfo pp;
+    HwJpegSoftInfo info;
+    RK_U32 *out;
+    int w, h, ret, d;
+
+    for (d = 2; d <= 8; d <<= 1) {
+        memset(&pp, 0, sizeof(pp));
+        pp.outFomart = 1;
+        pp.scale_denom = d;
+        out = test_decode(test.data, &pp, 0, &w, &h, &info, &ret);
+        check_eq("scaled: decode", ret, JPEGDEC_OK);
+        if (out == NULL)
+            continue;
+        check(w == TEST_W / d && h == TEST_H / d, "scaled: size");
+        check_eq("scaled: colours", test_mb_colours(out, w, d, 0, TEST_MB_W * TEST_MB_H), 0);
+        free(out);
+    }
+}
+
+static void test_rgb565(void)
+{
+    PostProcessInfo pp;
+    HwJpegSoftInfo info;
+    RK_U16 *out;
+    int m, r, g, b, bad = 0;
+
+    memset(&pp, 0, sizeof(pp));
+    pp.outFomart = 0;
+    out = (RK_U16 *)calloc(TEST_W * TEST_H, 2);
+    check_eq("565: decode", hw_jpeg_soft_decode(test.data, test.length, &pp, out, TEST_W * 2,
+             TEST_W * TEST_H * 2, 2, &info), JPEGDEC_OK);
+
+    for (m = 0; m < TEST_MB_W * TEST_MB_H; m++) {
+        int mx = m % TEST_MB_W, my = m / TEST_MB_W;
+        RK_U16 px = out[(my * 16 + 8) * TEST_W + mx * 16 + 8];
+
+        hw_jpeg_test_mb_rgb(&test, mx, my, &r, &g, &b);
+        if (abs((px >> 11) - (r >> 3)) > 1 || abs(((px >> 5) & 63) - (g >> 2)) > 1 ||
+            abs((px & 31) - (b >> 3)) > 1)
+            bad++;
+    }
+    check_eq("565: colours", bad, 0);
+    free(out);
+}
+
+/* garbage in one interval costs its macroblocks, the others still decode */
+static void test_corrupt(void)
+{
+    PostProcessInfo pp;
+    HwJpegSoftInfo info;
+    RK_U8 *bad;
+    RK_U32 *out;
+    int w, h, ret, i, lost = 0;
+
+    bad = (RK_U8 *)malloc(test.length);
+    memcpy(bad, test.data, test.length);
+    /* stuffed 0xFF bytes: all ones, no DC code of the table */
+    for (i = test.start[TEST_CORRUPT]; i + 1 < test.end[TEST_CORRUPT]; i += 2) {
+        bad[i] = 0xFF;
+        bad[i + 1] = 0x00;
+    }
+
+    memset(&pp, 0, sizeof(pp));
+    pp.outFomart = 1;
+    out = test_decode(bad, &pp, 4, &w, &h, &info, &ret);
+    check_eq("corrupt: reported", ret, JPEGDEC_STRM_ERROR);
+    if (out != NULL) {
+        check_eq("corrupt: before", test_mb_colours(out, TEST_W, 1, 0,
+                 TEST_CORRUPT * TEST_INTERVAL), 0);
+        check_eq("corrupt: after", test_mb_colours(out, TEST_W, 1, (TEST_CORRUPT + 1) * TEST_INTERVAL,
+                 TEST_MB_W * TEST_MB_H), 0);
+        for (i = TEST_CORRUPT * TEST_INTERVAL; i < (TEST_CORRUPT + 1) * TEST_INTERVAL; i++)
+            lost += !out[((i / TEST_MB_W) * 16 + 8) * TEST_W + (i % TEST_MB_W) * 16 + 8];
+        check(lost > 0, "corrupt: interval left unwritten");
+        free(out);
+    }
+    free(bad);
+}
+
+int main(void)
+{
+    HwJpegTestStreamCfg cfg = { TEST_MB_W, TEST_MB_H, TEST_INTERVAL, 0 };
+
+    if (hw_jpeg_test_stream_make(&cfg, &test)) {
+        printf("FAILED: no stream\n");
+        return 1;
+    }
+
+    test_probe();
+    test_full_picture();
+    test_crop(48, 32, 100, 70, "crop: on the macroblock grid");
+    test_crop(13, 9, 200, 101, "crop: off the grid");
+    test_crop(TEST_W - 20, TEST_H - 10, 64, 64, "crop: past the edge");
+    test_scaled();
+    test_rgb565();
+    test_corrupt();
+
+    free(test_full);
+
+    printf("%ld byte stream, %d restart intervals\n", test.length, test.intervals);
+    hw_jpeg_test_stream_free(&test);
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,315 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_source.c
+    Description:
+        Whole stream source manager over a file, VPU memory or UMP buffer
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_source"
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_mem_range.h"
+#include "gralloc_buffer_phys.h"
+#include "gralloc_ump_cache.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_source.h"
+
+static HwJpegSource *source_of(HwJpegInputInfo *hwInfo)
+{
+    return (HwJpegSource *)hwInfo->streamCtl.inStream;
+}
+
+static void source_at(HwJpegSource *src, long offset)
+{
+    offset = CLIP(offset, 0, src->length);
+    src->mgr.next_input_byte = src->base + offset;
+    src->mgr.bytes_in_buffer = src->length - offset;
+    src->mgr.cur_offset_instream = offset;
+}
+
+static long source_offset(HwJpegSource *src)
+{
+    return src->mgr.next_input_byte - src->base;
+}
+
+static void src_init_source(HwJpegInputInfo *hwInfo)
+{
+    source_at(source_of(hwInfo), 0);
+}
+
+/* everything is in memory already, the "buffer" is the rest of the stream */
+static HW_BOOL src_fill_input_buffer(HwJpegInputInfo *hwInfo)
+{
+    HwJpegSource *src = source_of(hwInfo);
+
+    source_at(src, source_offset(src));
+    return src->mgr.bytes_in_buffer > 0;
+}
+
+static HW_BOOL src_skip_input_data(HwJpegInputInfo *hwInfo, long num_bytes)
+{
+    HwJpegSource *src = source_of(hwInfo);
+    long offset = source_offset(src) + num_bytes;
+
+    source_at(src, offset);
+    return offset <= src->length;
+}
+
+static HW_BOOL src_resync_to_restart(HwJpegInputInfo *hwInfo)
+{
+    (void)hwInfo;
+    return 1;
+}
+
+static HW_BOOL src_seek_input_data(HwJpegInputInfo *hwInfo, long byte_offset)
+{
+    HwJpegSource *src = source_of(hwInfo);
+
+    if (byte_offset < 0 || byte_offset > src->length)
+        return 0;
+
+    source_at(src, byte_offset);
+    return 1;
+}
+
+/* only reached when the library wants its own copy despite isVpuMem */
+static int src_fill_buffer(HwJpegInputInfo *hwInfo, void *destination, VPUMemLinear_t *newmem,
+                           int w, int h)
+{
+    HwJpegSource *src = source_of(hwInfo);
+    long offset = hwInfo->streamCtl.useThumb ? hwInfo->streamCtl.thumbOffset : 0;
+    long length = hwInfo->streamCtl.useThumb ? hwInfo->streamCtl.thumbLength : src->length;
+
+    (void)w;
+    (void)h;
+
+    if (destination == NULL || offset < 0 || offset + length > src->length)
+        return 0;
+
+    memcpy(destination, src->base + offset, length);
+    if (newmem != NULL)
+        VPUMemCleanRange(newmem, 0, length);
+    src->copiedBytes += length;
+
+    return length;
+}
+
+static int src_fill_thumb(HwJpegInputInfo *hwInfo, void *thumbBuf)
+{
+    HwJpegSource *src = source_of(hwInfo);
+    long offset = hwInfo->streamCtl.thumbOffset;
+    long length = hwInfo->streamCtl.thumbLength;
+
+    if (thumbBuf == NULL || offset < 0 || length <= 0 || offset + length > src->length)
+        return 0;
+
+    memcpy(thumbBuf, src->base + offset, length);
+    return length;
+}
+
+static HW_BOOL src_read_1_byte(HwJpegInputInfo *hwInfo, unsigned char *ch)
+{
+    HwJpegSource *src = source_of(hwInfo);
+
+    if (src->mgr.bytes_in_buffer <= 0)
+        return 0;
+
+    *ch = *src->mgr.next_input_byte;
+    source_at(src, source_offset(src) + 1);
+    return 1;
+}
+
+static void src_get_vpumemInst(HwJpegInputInfo *hwInfo, VPUMemLinear_t *vpumem)
+{
+    *vpumem = source_of(hwInfo)->mem;
+}
+
+static void source_setup(HwJpegSource *src, HwJpegInputInfo *hwInfo)
+{
+    struct hw_jpeg_source_mgr *mgr = &src->mgr;
+
+    mgr->isVpuMem = 1;
+    mgr->info = hwInfo;
+    mgr->init_source = src_init_source;
+    mgr->fill_input_buffer = src_fill_input_buffer;
+    mgr->skip_input_data = src_skip_input_data;
+    mgr->resync_to_restart = src_resync_to_restart;
+    mgr->seek_input_data = src_seek_input_data;
+    mgr->fill_buffer = src_fill_buffer;
+    mgr->fill_thumb = src_fill_thumb;
+    mgr->read_1_byte = src_read_1_byte;
+    mgr->get_vpumemInst = src_get_vpumemInst;
+    source_at(src, 0);
+
+    if (hwInfo != NULL) {
+        hwInfo->streamCtl.inStream = mgr;
+        hwInfo->streamCtl.wholeStreamLength = src->length;
+    }
+}
+
+/* own VPU memory with the stream and the padding the decoder reads past its end */
+static int source_alloc(HwJpegSource *src, long length)
+{
+    if (hw_jpeg_reserve(&src->mem, length + HW_JPEG_SOURCE_PAD) < 0)
+        return -1;
+
+    src->ownsMem = 1;
+    src->base = (const unsigned char *)src->mem.vir_addr;
+    src->length = length;
+    memset((unsigned char *)src->mem.vir_addr + length, 0, HW_JPEG_SOURCE_PAD);
+    return 0;
+}
+
+int hw_jpeg_source_open_file(HwJpegSource *src, const char *path, HwJpegInputInfo *hwInfo)
+{
+    struct stat st;
+    long done = 0;
+    int fd;
+
+    if (src == NULL || path == NULL)
+        return -1;
+
+    memset(src, 0, sizeof(*src));
+    src->kind = HW_JPEG_SOURCE_FILE;
+    src->umpId = UMP_INVALID_SECURE_ID;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ALOGE("open %s failed, %s", path, strerror(errno));
+        return -1;
+    }
+
+    /*
+     * The decoder needs physically contiguous memory, which a page cache
+     * mapping is not, so the file is read once, straight into VPU memory.
+     */
+    if (fstat(fd, &st) || st.st_size <= 0 || source_alloc(src, st.st_size)) {
+        close(fd);
+        return -1;
+    }
+
+    while (done < src->length) {
+        ssize_t n = pread(fd, (unsigned char *)src->mem.vir_addr + done, src->length - done, done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            ALOGE("read %s failed at %ld of %ld", path, done, src->length);
+            close(fd);
+            hw_jpeg_source_close(src);
+            return -1;
+        }
+        done += n;
+    }
+    close(fd);
+
+    VPUMemCleanRange(&src->mem, 0, src->length + HW_JPEG_SOURCE_PAD);
+    src->copiedBytes = src->length;
+    source_setup(src, hwInfo);
+
+    return 0;
+}
+
+int hw_jpeg_source_open_vpumem(HwJpegSource *src, VPUMemLinear_t *mem, long length,
+                               HwJpegInputInfo *hwInfo)
+{
+    if (src == NULL || mem == NULL || mem->vir_addr == NULL || length <= 0)
+        return -1;
+
+    memset(src, 0, sizeof(*src));
+    src->kind = HW_JPEG_SOURCE_VPUMEM;
+    src->umpId = UMP_INVALID_SECURE_ID;
+
+    if (mem->size && (RK_U32)length + HW_JPEG_SOURCE_PAD > mem->size) {
+        /* no room for the padding, the decoder could read into a neighbour */
+        if (source_alloc(src, length))
+            return -1;
+        memcpy(src->mem.vir_addr, mem->vir_addr, length);
+        VPUMemCleanRange(&src->mem, 0, length + HW_JPEG_SOURCE_PAD);
+        src->copiedBytes = length;
+    } else {
+        src->mem = *mem;
+        src->base = (const unsigned char *)mem->vir_addr;
+        src->length = length;
+    }
+
+    source_setup(src, hwInfo);
+    return 0;
+}
+
+int hw_jpeg_source_open_ump(HwJpegSource *src, ump_secure_id id, long length,
+                            HwJpegInputInfo *hwInfo)
+{
+    unsigned int phys = 0;
+    unsigned long size;
+    void *base;
+
+    if (src == NULL || id == UMP_INVALID_SECURE_ID || length <= 0)
+        return -1;
+
+    memset(src, 0, sizeof(*src));
+    src->kind = HW_JPEG_SOURCE_UMP;
+    src->umpId = id;
+
+    base = gralloc_ump_cache_map(id, &src->ump);
+    if (base == NULL) {
+        ALOGE("UMP buffer 0x%x is not mappable", id);
+        return -1;
+    }
+
+    size = ump_size_get(src->ump);
+    if ((unsigned long)length > size) {
+        ALOGE("stream of %ld bytes in UMP buffer 0x%x of %lu", length, id, size);
+        hw_jpeg_source_close(src);
+        return -1;
+    }
+
+    if (gralloc_ump_phys_get(id, &phys) < 0 || !phys ||
+        (unsigned long)length + HW_JPEG_SOURCE_PAD > size) {
+        /* not contiguous or no room for the padding, the decoder gets a copy */
+        if (source_alloc(src, length)) {
+            hw_jpeg_source_close(src);
+            return -1;
+        }
+        memcpy(src->mem.vir_addr, base, length);
+        VPUMemCleanRange(&src->mem, 0, length + HW_JPEG_SOURCE_PAD);
+        src->copiedBytes = length;
+    } else {
+        /* read in place; a CPU producer must have cleaned its writes */
+        src->mem.phy_addr = phys;
+        src->mem.vir_addr = (RK_U32 *)base;
+        src->mem.size = size;
+        src->base = (const unsigned char *)base;
+        src->length = length;
+    }
+
+    source_setup(src, hwInfo);
+    return 0;
+}
+
+void hw_jpeg_source_close(HwJpegSource *src)
+{
+    if (src == NULL)
+        return;
+
+    if (src->ownsMem)
+        hw_jpeg_unreserve(&src->mem);
+    if (src->ump != UMP_INVALID_MEMORY_HANDLE)
+        gralloc_ump_cache_unmap(src->umpId, src->ump);
+
+    src->ownsMem = 0;
+    src->ump = UMP_INVALID_MEMORY_HANDLE;
+    src->base = NULL;
+    src->length = 0;
+}
+
+void hw_jpeg_source_stream(const HwJpegSource *src, JpegDecLinearMem *stream)
+{
+    stream->pVirtualAddress = src->mem.vir_addr;
+    stream->busAddress = src->mem.phy_addr;
+}
@@ -0,0 +1,70 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_source.h
+    Description:
+        hw_jpeg_source_mgr over a stream that is already whole in memory.
+        The usual source managers pull the file through fill_input_buffer
+        into a JPEG_INPUT_BUFFER staging area, and the stream is copied
+        once more into a VPU linear buffer for the decoder. A file here is
+        read once straight into VPU memory; a VPUMemLinear_t or a
+        contiguous UMP buffer is handed to the decoder as it is. The
+        callbacks serve the parser from the same memory, so no staging
+        copy is left at all.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_SOURCE_H__
+#define __HW_JPEG_SOURCE_H__
+
+#include "vpu_mem.h"
+#include "hw_jpegdecapi.h"
+#include "ump/include/ump/ump.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* the decoder reads a little past the end of the stream */
+#define HW_JPEG_SOURCE_PAD              (64)
+
+typedef enum
+{
+  HW_JPEG_SOURCE_FILE = 0,      /* read into VPU memory owned by the source */
+  HW_JPEG_SOURCE_VPUMEM,        /* caller's VPUMemLinear_t, zero copy */
+  HW_JPEG_SOURCE_UMP,           /* caller's UMP buffer, zero copy when contiguous */
+} HwJpegSourceKind;
+
+typedef struct
+{
+  struct hw_jpeg_source_mgr mgr;    /* what SourceStreamCtl::inStream points to */
+  HwJpegSourceKind kind;
+  VPUMemLinear_t mem;               /* the stream as the decoder reads it */
+  HW_BOOL ownsMem;
+  const unsigned char *base;        /* the stream as the parser reads it */
+  long length;
+  ump_secure_id umpId;
+  ump_handle ump;
+  long copiedBytes;                 /* bytes copied on the way in, 0 when zero copy */
+} HwJpegSource;
+
+/*
+ * Open a source and point hwInfo->streamCtl at it (hwInfo may be NULL when
+ * only hw_jpeg_source_stream is used). Return 0, or -1 on failure. The
+ * caller's buffer must stay valid until hw_jpeg_source_close and have
+ * HW_JPEG_SOURCE_PAD bytes of slack after the stream; a VPUMemLinear_t or
+ * UMP buffer without the slack is copied.
+ */
+extern int hw_jpeg_source_open_file(HwJpegSource *src, const char *path, HwJpegInputInfo *hwInfo);
+extern int hw_jpeg_source_open_vpumem(HwJpegSource *src, VPUMemLinear_t *mem, long length,
+                                      HwJpegInputInfo *hwInfo);
+extern int hw_jpeg_source_open_ump(HwJpegSource *src, ump_secure_id id, long length,
+                                   HwJpegInputInfo *hwInfo);
+extern void hw_jpeg_source_close(HwJpegSource *src);
+
+/* the stream for JpegDecInput::streamBuffer */
+extern void hw_jpeg_source_stream(const HwJpegSource *src, JpegDecLinearMem *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_SOURCE_H__ */
@@ -0,0 +1,246 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_test_stream.c
+    Description:
+        Flat colour baseline JPEG streams for the host tests
+ **************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "hw_jpeg_test_stream.h"
+
+typedef struct
+{
+    unsigned char   *p;
+    long            size;
+    unsigned int    acc;
+    int             n;
+} StreamWriter;
+
+/*
+ * The Annex K luminance DC table for every component, and an AC table
+ * holding only end of block: the blocks are flat.
+ */
+static const unsigned char streamDcBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+
+static void stream_mb_ycc(int mx, int my, int *y, int *cb, int *cr)
+{
+    *y = 16 + (mx * 7 + my * 13) % 200;
+    *cb = 128 + (mx % 4 - 2) * 20;
+    *cr = 128 + (my % 4 - 2) * 20;
+}
+
+static int stream_clamp(double v)
+{
+    int i = (int)(v + 0.5);
+
+    return i < 0 ? 0 : i > 255 ? 255 : i;
+}
+
+void hw_jpeg_test_mb_rgb(const HwJpegTestStream *s, int mx, int my, int *r, int *g, int *b)
+{
+    int y, cb, cr;
+
+    stream_mb_ycc(mx, my, &y, &cb, &cr);
+    if (s->gray) {
+        *r = *g = *b = y;
+        return;
+    }
+    *r = stream_clamp(y + 1.402 * (cr - 128));
+    *g = stream_clamp(y - 0.344136 * (cb - 128) - 0.714136 * (cr - 128));
+    *b = stream_clamp(y + 1.772 * (cb - 128));
+}
+
+static void put_byte(StreamWriter *w, int v)
+{
+    w->p[w->size++] = (unsigned char)v;
+}
+
+static void put_word(StreamWriter *w, int v)
+{
+    put_byte(w, v >> 8);
+    put_byte(w, v & 255);
+}
+
+static void put_segment(StreamWriter *w, int marker, const unsigned char *s, int len)
+{
+    put_word(w, marker);
+    put_word(w, 2 + len);
+    while (len--)
+        put_byte(w, *s++);
+}
+
+/* entropy coded bits, MSB first, with 0xFF stuffing */
+static void put_bits(StreamWriter *w, unsigned int code, int len)
+{
+    while (len--) {
+        w->acc = (w->acc << 1) | ((code >> len) & 1);
+        if (++w->n == 8) {
+            put_byte(w, w->acc);
+            if (w->acc == 0xFF)
+                put_byte(w, 0);
+            w->acc = 0;
+            w->n = 0;
+        }
+    }
+}
+
+/* pad the last byte with ones, as before a marker */
+static void put_align(StreamWriter *w)
+{
+    if (w->n)
+        put_bits(w, 0x7F, 8 - w->n);
+}
+
+/* a flat block at level v: DC only, 8 * (v - 128) with unit quantisation */
+static void put_block(StreamWriter *w, int v, int *pred)
+{
+    static unsigned short code[12];
+    static unsigned char len[12];
+    int dc = 8 * (v - 128), diff = dc - *pred, mag = diff < 0 ? -diff : diff, s = 0;
+
+    if (!len[0]) {
+        int l, i, sym = 0, c = 0;
+
+        for (l = 1; l <= 16; l++) {
+            for (i = 0; i < streamDcBits[l - 1]; i++) {
+                code[sym] = c++;
+                len[sym++] = l;
+            }
+            c <<= 1;
+        }
+    }
+
+    while (mag >> s)
+        s++;
+    put_bits(w, code[s], len[s]);
+    if (s)
+        put_bits(w, diff < 0 ? diff + (1 << s) - 1 : diff, s);
+    put_bits(w, 0, 1);      /* end of block */
+    *pred = dc;
+}
+
+static void put_headers(const HwJpegTestStreamCfg *cfg, StreamWriter *w, int ncomp)
+{
+    unsigned char seg[80];
+    int i, n;
+
+    put_word(w, 0xFFD8);
+
+    seg[0] = 0;
+    memset(seg + 1, 1, 64);
+    put_segment(w, 0xFFDB, seg, 65);
+
+    n = 0;
+    seg[n++] = 8;
+    seg[n++] = (cfg->mbH * 16) >> 8;
+    seg[n++] = (cfg->mbH * 16) & 255;
+    seg[n++] = (cfg->mbW * 16) >> 8;
+    seg[n++] = (cfg->mbW * 16) & 255;
+    seg[n++] = ncomp;
+    for (i = 0; i < ncomp; i++) {
+        seg[n++] = i + 1;
+        seg[n++] = (ncomp == 3 && !i) ? 0x22 : 0x11;
+        seg[n++] = 0;
+    }
+    put_segment(w, 0xFFC0, seg, n);
+
+    seg[0] = 0x00;
+    memcpy(seg + 1, streamDcBits, 16);
+    for (i = 0; i < 12; i++)
+        seg[17 + i] = i;
+    put_segment(w, 0xFFC4, seg, 29);
+
+    memset(seg, 0, 18);
+    seg[0] = 0x10;
+    seg[1] = 1;
+    put_segment(w, 0xFFC4, seg, 18);
+
+    if (cfg->interval) {
+        seg[0] = cfg->interval >> 8;
+        seg[1] = cfg->interval & 255;
+        put_segment(w, 0xFFDD, seg, 2);
+    }
+
+    n = 0;
+    seg[n++] = ncomp;
+    for (i = 0; i < ncomp; i++) {
+        seg[n++] = i + 1;
+        seg[n++] = 0x00;
+    }
+    seg[n++] = 0;
+    seg[n++] = 63;
+    seg[n++] = 0;
+    put_segment(w, 0xFFDA, seg, n);
+}
+
+int hw_jpeg_test_stream_make(const HwJpegTestStreamCfg *cfg, HwJpegTestStream *s)
+{
+    /* a 4:2:0 MCU is a macroblock, a greyscale one an 8x8 block */
+    int mcusX = cfg->gray ? cfg->mbW * 2 : cfg->mbW;
+    int mcus = mcusX * (cfg->gray ? cfg->mbH * 2 : cfg->mbH);
+    int blocks = cfg->gray ? 1 : 6;
+    StreamWriter w;
+    int m, n, pred[3];
+
+    memset(s, 0, sizeof(*s));
+    s->width = cfg->mbW * 16;
+    s->height = cfg->mbH * 16;
+    s->gray = cfg->gray;
+    s->intervals = cfg->interval ? (mcus + cfg->interval - 1) / cfg->interval : 1;
+    s->start = (long *)calloc(s->intervals, sizeof(long));
+    s->end = (long *)calloc(s->intervals, sizeof(long));
+    /* at most three bytes a block, stuffing included */
+    s->data = (unsigned char *)malloc(1024 + (long)mcus * blocks * 3 + s->intervals * 2);
+    if (s->start == NULL || s->end == NULL || s->data == NULL) {
+        hw_jpeg_test_stream_free(s);
+        return -1;
+    }
+
+    memset(&w, 0, sizeof(w));
+    w.p = s->data;
+    put_headers(cfg, &w, cfg->gray ? 1 : 3);
+
+    for (m = 0; m < mcus; m++) {
+        int y, cb, cr, i;
+
+        if (!cfg->interval || !(m % cfg->interval)) {
+            n = cfg->interval ? m / cfg->interval : 0;
+            if (n) {
+                put_align(&w);
+                s->end[n - 1] = w.size;
+                put_word(&w, 0xFFD0 + (n - 1) % 8);
+            }
+            if (!m || cfg->interval) {
+                s->start[n] = w.size;
+                memset(pred, 0, sizeof(pred));
+            }
+        }
+
+        if (cfg->gray) {
+            stream_mb_ycc(m % mcusX / 2, m / mcusX / 2, &y, &cb, &cr);
+            put_block(&w, y, &pred[0]);
+            continue;
+        }
+
+        stream_mb_ycc(m % mcusX, m / mcusX, &y, &cb, &cr);
+        for (i = 0; i < 4; i++)
+            put_block(&w, y, &pred[0]);
+        put_block(&w, cb, &pred[1]);
+        put_block(&w, cr, &pred[2]);
+    }
+    put_align(&w);
+    s->end[s->intervals - 1] = w.size;
+    put_word(&w, 0xFFD9);
+
+    s->length = w.size;
+    return 0;
+}
+
+void hw_jpeg_test_stream_free(HwJpegTestStream *s)
+{
+    free(s->data);
+    free(s->start);
+    free(s->end);
+    memset(s, 0, sizeof(*s));
+}
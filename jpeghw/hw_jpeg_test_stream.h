@@ -0,0 +1,52 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_test_stream.h
+    Description:
+        Baseline JPEG streams made up for the host tests. Every 16x16
+        macroblock is one flat colour and the quantisation is unity, so
+        each sample decodes exactly and a test knows the RGB of every
+        macroblock without a reference decoder. The streams are 4:2:0 or
+        greyscale, with or without restart intervals, and the entropy data
+        offsets of every interval are reported so that a test can damage
+        one.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_TEST_STREAM_H__
+#define __HW_JPEG_TEST_STREAM_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct
+{
+  int mbW;              /* picture size in 16x16 macroblocks */
+  int mbH;
+  int interval;         /* MCUs per restart interval, 0: no DRI */
+  int gray;             /* one component, its MCU is an 8x8 block */
+} HwJpegTestStreamCfg;
+
+typedef struct
+{
+  unsigned char *data;
+  long length;
+  int width;
+  int height;
+  int gray;
+  int intervals;
+  long *start;          /* entropy data of each restart interval */
+  long *end;            /* its end, the RSTn or EOI that follows */
+} HwJpegTestStream;
+
+/* 0, or -1 when out of memory */
+extern int hw_jpeg_test_stream_make(const HwJpegTestStreamCfg *cfg, HwJpegTestStream *s);
+extern void hw_jpeg_test_stream_free(HwJpegTestStream *s);
+
+/* colour of macroblock (mx, my), as the decoder converts it */
+extern void hw_jpeg_test_mb_rgb(const HwJpegTestStream *s, int mx, int my, int *r, int *g, int *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_TEST_STREAM_H__ */
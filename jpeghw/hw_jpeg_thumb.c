@@ -0,0 +1,134 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_thumb.c
+    Description:
+        Thumbnail or scaled main picture, whichever covers the request cheaper
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_thumb"
+
+#include <string.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_hw_caps.h"
+#include "hw_jpeg_thumb.h"
+
+typedef struct PickSource
+{
+    int     thumb;
+    RK_U32  displayWidth;
+    RK_U32  displayHeight;
+    RK_U32  outputWidth;
+    RK_U32  outputHeight;
+    RK_U32  progressive;
+} PickSource;
+
+static int pick_covers(RK_U32 w, RK_U32 h, int d, int reqWidth, int reqHeight)
+{
+    return (reqWidth <= 0 || (int)((w + d - 1) / d) >= reqWidth) &&
+           (reqHeight <= 0 || (int)((h + d - 1) / d) >= reqHeight);
+}
+
+int hw_jpeg_pick_denom(int width, int height, int reqWidth, int reqHeight)
+{
+    int d;
+
+    if (reqWidth <= 0 && reqHeight <= 0)
+        return 1;
+
+    for (d = HW_JPEG_SCALE_DENOM_MAX; d >= 1; d >>= 1) {
+        if (pick_covers(width, height, d, reqWidth, reqHeight))
+            return d;
+    }
+
+    return 0;
+}
+
+static int pick_denom(const PickSource *src, int reqWidth, int reqHeight)
+{
+    return hw_jpeg_pick_denom(src->displayWidth, src->displayHeight, reqWidth, reqHeight);
+}
+
+static int pick_supported(const PickSource *src, int denom)
+{
+    return VPUHwCapsCanDecodeJpeg(src->displayWidth, src->displayHeight, src->progressive,
+                                  denom > 1 ? VPU_HW_PP_SCALE : VPU_HW_PP_NONE);
+}
+
+/* a letterboxed thumbnail would show bars once scaled to the picture's shape */
+static int pick_same_shape(const JpegDecImageInfo *info)
+{
+    long long a = (long long)info->displayWidthThumb * info->displayHeight;
+    long long b = (long long)info->displayWidth * info->displayHeightThumb;
+    long long diff = a > b ? a - b : b - a;
+
+    return diff * 100 <= b * HW_JPEG_THUMB_ASPECT_TOL;
+}
+
+static void pick_fill(HwJpegPick *pick, const PickSource *src, int denom)
+{
+    pick->useThumb = src->thumb;
+    pick->scaleDenom = denom;
+    pick->srcWidth = src->displayWidth;
+    pick->srcHeight = src->displayHeight;
+    pick->outWidth = (src->displayWidth + denom - 1) / denom;
+    pick->outHeight = (src->displayHeight + denom - 1) / denom;
+    pick->decodedPixels = (long)src->outputWidth * src->outputHeight;
+}
+
+int hw_jpeg_pick(const JpegDecImageInfo *info, int reqWidth, int reqHeight, HwJpegPick *pick)
+{
+    PickSource main, thumb;
+    int mainDenom, thumbDenom;
+
+    if (info == NULL || pick == NULL)
+        return -1;
+
+    memset(pick, 0, sizeof(*pick));
+
+    memset(&main, 0, sizeof(main));
+    main.displayWidth = info->displayWidth;
+    main.displayHeight = info->displayHeight;
+    main.outputWidth = info->outputWidth;
+    main.outputHeight = info->outputHeight;
+    main.progressive = (info->codingMode == JPEGDEC_PROGRESSIVE);
+
+    /* a full size request never takes the thumbnail */
+    if ((reqWidth > 0 || reqHeight > 0) &&
+        (info->thumbnailType == JPEGDEC_THUMBNAIL_JPEG ||
+         info->thumbnailType == JPEGDEC_THUMBNAIL_EXIF) &&
+        info->displayWidthThumb && info->displayHeightThumb && pick_same_shape(info)) {
+        memset(&thumb, 0, sizeof(thumb));
+        thumb.thumb = 1;
+        thumb.displayWidth = info->displayWidthThumb;
+        thumb.displayHeight = info->displayHeightThumb;
+        thumb.outputWidth = info->outputWidthThumb;
+        thumb.outputHeight = info->outputHeightThumb;
+        thumb.progressive = (info->codingModeThumb == JPEGDEC_PROGRESSIVE);
+
+        thumbDenom = pick_denom(&thumb, reqWidth, reqHeight);
+        if (thumbDenom && pick_supported(&thumb, thumbDenom)) {
+            pick_fill(pick, &thumb, thumbDenom);
+            return 0;
+        }
+    }
+
+    /* the request may be bigger than the picture, then it is decoded unscaled */
+    mainDenom = pick_denom(&main, reqWidth, reqHeight);
+    if (!mainDenom)
+        mainDenom = 1;
+    if (!pick_supported(&main, mainDenom))
+        return -1;
+
+    pick_fill(pick, &main, mainDenom);
+    return 0;
+}
+
+void hw_jpeg_pick_apply(const HwJpegPick *pick, HwJpegInputInfo *hwInfo)
+{
+    if (pick == NULL || hwInfo == NULL)
+        return;
+
+    hwInfo->streamCtl.useThumb = pick->useThumb;
+    hwInfo->ppInfo.scale_denom = pick->scaleDenom;
+}
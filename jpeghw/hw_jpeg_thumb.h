@@ -0,0 +1,58 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_thumb.h
+    Description:
+        Source and scale policy for decoding to a requested size. Camera
+        JPEGs usually carry an EXIF thumbnail that is already big enough
+        for a grid cell, and otherwise the post-processor only has to
+        produce a fraction of the picture. hw_jpeg_pick looks at the image
+        information once and returns the cheapest decode that still covers
+        the request: the thumbnail when it is large enough and has the
+        picture's shape, and the largest scale_denom that keeps the output
+        at least the requested size.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_THUMB_H__
+#define __HW_JPEG_THUMB_H__
+
+#include "vpu_mem.h"
+#include "hw_jpegdecapi.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* thumbnails whose aspect ratio differs more than this (percent) are letterboxed, skip them */
+#define HW_JPEG_THUMB_ASPECT_TOL        (3)
+#define HW_JPEG_SCALE_DENOM_MAX         (8)
+
+typedef struct
+{
+  HW_BOOL useThumb;
+  int scaleDenom;
+  int srcWidth;         /* display size of the picture decoded */
+  int srcHeight;
+  int outWidth;         /* after scaling */
+  int outHeight;
+  long decodedPixels;   /* samples the decoder produces, what the choice is judged by */
+} HwJpegPick;
+
+/*
+ * The decode of info covering reqWidth x reqHeight. A request of 0 x 0 is
+ * the full picture; one of 0 follows the aspect ratio. Returns 0, or -1
+ * when neither the picture nor its thumbnail can be decoded in hardware.
+ */
+extern int hw_jpeg_pick(const JpegDecImageInfo *info, int reqWidth, int reqHeight,
+                        HwJpegPick *pick);
+
+/* largest scale_denom still covering the request, 0 when even 1 does not */
+extern int hw_jpeg_pick_denom(int width, int height, int reqWidth, int reqHeight);
+
+/* carry a pick over to a hw_jpeg_decode call */
+extern void hw_jpeg_pick_apply(const HwJpegPick *pick, HwJpegInputInfo *hwInfo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_THUMB_H__ */
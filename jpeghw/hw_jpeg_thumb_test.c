@@ -0,0 +1,175 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_thumb_test.c
+    Description:
+        Test of the decode size picker. Builds for the host:
+
+            hw_jpeg_thumb_test
+
+        The hardware capability check is replaced by a stand-in that
+        refuses progressive streams and records the post-processor
+        functions asked for. Covers the scale_denom search and its
+        rounding, a thumbnail that is large enough against one that is too
+        small, letterboxed and progressive thumbnails falling back to the
+        main picture, full size and oversized requests, a picture the
+        hardware cannot decode, and carrying a pick over to the decoder
+        input.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vpu_macro.h"
+#include "vpu_hw_caps.h"
+#include "hw_jpeg_thumb.h"
+
+static int failures;
+static RK_U32 capsLastPpFlags;
+
+#ifdef HW_JPEG_THUMB_TEST_HOST
+/* baseline only, like the DWL configuration of the shipped decoder */
+RK_S32 VPUHwCapsCanDecodeJpeg(RK_U32 width, RK_U32 height, RK_S32 progressive, RK_U32 ppFlags)
+{
+    capsLastPpFlags = ppFlags;
+    return !progressive && width <= 8176 && height <= 8176;
+}
+#endif
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+/* a 4000x3000 camera picture, with an EXIF thumbnail of thumbW x thumbH when not 0 */
+static void test_info(JpegDecImageInfo *info, RK_U32 thumbW, RK_U32 thumbH)
+{
+    memset(info, 0, sizeof(*info));
+    info->displayWidth = 4000;
+    info->displayHeight = 3000;
+    info->outputWidth = 4000;
+    info->outputHeight = 3008;
+    info->codingMode = JPEGDEC_BASELINE;
+    if (thumbW && thumbH) {
+        info->thumbnailType = JPEGDEC_THUMBNAIL_EXIF;
+        info->displayWidthThumb = thumbW;
+        info->displayHeightThumb = thumbH;
+        info->outputWidthThumb = (thumbW + 15) & ~15;
+        info->outputHeightThumb = (thumbH + 15) & ~15;
+        info->codingModeThumb = JPEGDEC_BASELINE;
+    }
+}
+
+static void test_denom(void)
+{
+    check_eq("denom: eighth covers", hw_jpeg_pick_denom(4000, 3000, 500, 375), 8);
+    check_eq("denom: one pixel more", hw_jpeg_pick_denom(4000, 3000, 501, 375), 4);
+    check_eq("denom: full size", hw_jpeg_pick_denom(4000, 3000, 0, 0), 1);
+    check_eq("denom: height only", hw_jpeg_pick_denom(4000, 3000, 0, 750), 4);
+    check_eq("denom: bigger than the picture", hw_jpeg_pick_denom(4000, 3000, 4001, 3000), 0);
+    /* the scaled size rounds up, 1001 / 8 gives 126 pixels */
+    check_eq("denom: rounded up", hw_jpeg_pick_denom(1001, 1001, 126, 126), 8);
+    check_eq("denom: rounded up, one more", hw_jpeg_pick_denom(1001, 1001, 127, 127), 4);
+}
+
+static void test_thumb(void)
+{
+    JpegDecImageInfo info;
+    HwJpegPick pick;
+
+    test_info(&info, 160, 120);
+
+    check_eq("thumb: pick", hw_jpeg_pick(&info, 160, 120, &pick), 0);
+    check(pick.useThumb, "thumb: thumbnail big enough");
+    check_eq("thumb: unscaled", pick.scaleDenom, 1);
+    check_eq("thumb: decoded pixels", pick.decodedPixels, 160 * 128);
+    check_eq("thumb: no pp", capsLastPpFlags, VPU_HW_PP_NONE);
+
+    hw_jpeg_pick(&info, 80, 60, &pick);
+    check(pick.useThumb && pick.scaleDenom == 2, "thumb: halved thumbnail");
+    check_eq("thumb: scaling asked", capsLastPpFlags, VPU_HW_PP_SCALE);
+    check(pick.outWidth == 80 && pick.outHeight == 60, "thumb: halved size");
+
+    /* too small for the request: an eighth of the picture is cheaper than the full one */
+    hw_jpeg_pick(&info, 320, 240, &pick);
+    check(!pick.useThumb, "thumb: too small");
+    check_eq("thumb: main at an eighth", pick.scaleDenom, 8);
+    check(pick.outWidth == 500 && pick.outHeight == 375, "thumb: main eighth size");
+    check_eq("thumb: main decoded pixels", pick.decodedPixels, 4000 * 3008);
+
+    /* a full size request never takes the thumbnail */
+    hw_jpeg_pick(&info, 0, 0, &pick);
+    check(!pick.useThumb && pick.scaleDenom == 1, "thumb: full size");
+}
+
+static void test_fallback(void)
+{
+    JpegDecImageInfo info;
+    HwJpegPick pick;
+
+    /* 16:9 on a 4:3 picture would show bars */
+    test_info(&info, 160, 90);
+    hw_jpeg_pick(&info, 160, 90, &pick);
+    check(!pick.useThumb, "fallback: letterboxed thumbnail");
+
+    /* within the aspect tolerance still counts as the same shape */
+    test_info(&info, 160, 121);
+    hw_jpeg_pick(&info, 160, 120, &pick);
+    check(pick.useThumb, "fallback: shape within tolerance");
+
+    test_info(&info, 160, 120);
+    info.thumbnailType = JPEGDEC_THUMBNAIL_NOT_SUPPORTED_FORMAT;
+    hw_jpeg_pick(&info, 160, 120, &pick);
+    check(!pick.useThumb, "fallback: unsupported thumbnail format");
+
+    test_info(&info, 160, 120);
+    info.codingModeThumb = JPEGDEC_PROGRESSIVE;
+    check_eq("fallback: progressive thumbnail", hw_jpeg_pick(&info, 160, 120, &pick), 0);
+    check(!pick.useThumb && pick.scaleDenom == 8, "fallback: main instead");
+
+    /* bigger than the picture is decoded unscaled */
+    test_info(&info, 0, 0);
+    hw_jpeg_pick(&info, 8000, 6000, &pick);
+    check(!pick.useThumb && pick.scaleDenom == 1, "fallback: oversized request");
+
+    info.codingMode = JPEGDEC_PROGRESSIVE;
+    check_eq("fallback: nothing in hardware", hw_jpeg_pick(&info, 160, 120, &pick), -1);
+    check_eq("fallback: no info", hw_jpeg_pick(NULL, 160, 120, &pick), -1);
+}
+
+static void test_apply(void)
+{
+    JpegDecImageInfo info;
+    HwJpegInputInfo hwInfo;
+    HwJpegPick pick;
+
+    test_info(&info, 160, 120);
+    hw_jpeg_pick(&info, 80, 60, &pick);
+
+    memset(&hwInfo, 0, sizeof(hwInfo));
+    hwInfo.ppInfo.scale_denom = 1;
+    hw_jpeg_pick_apply(&pick, &hwInfo);
+    check(hwInfo.streamCtl.useThumb, "apply: thumbnail");
+    check_eq("apply: scale_denom", hwInfo.ppInfo.scale_denom, 2);
+}
+
+int main(void)
+{
+    test_denom();
+    test_thumb();
+    test_fallback();
+    test_apply();
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,443 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_tiles.c
+    Description:
+        Picture index cache and LRU cache of decoded tiles
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_tiles"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_tiles.h"
+
+#define TILES_BUCKETS               (256)
+
+typedef struct TilesIndex
+{
+    HwJpegFileKey       key;
+    int                 refs;
+    int                 cached;         /* 0: dropped, freed by the last put */
+    RK_U32              lru;
+    HwJpegIndex         index;
+} TilesIndex;
+
+typedef struct TilesTile
+{
+    HwJpegTileKey       key;
+    int                 width;
+    int                 height;
+    int                 bpp;
+    size_t              bytes;
+    struct TilesTile    *hashNext;
+    struct TilesTile    *lruPrev;
+    struct TilesTile    *lruNext;
+} TilesTile;
+
+struct HwJpegTiles
+{
+    pthread_mutex_t     lock;
+    int                 indexes;
+    int                 refs;           /* indexes handed out and not put back */
+    int                 closed;         /* destroyed, freed by the last put */
+    RK_U32              tick;
+    TilesIndex          *index[HW_JPEG_TILES_INDEXES_MAX];
+    TilesTile           *buckets[TILES_BUCKETS];
+    TilesTile           *lruHead;       /* most recently used */
+    TilesTile           *lruTail;
+    HwJpegTilesStats    stats;
+};
+
+static int tiles_same_file(const HwJpegFileKey *a, const HwJpegFileKey *b)
+{
+    return a->dev == b->dev && a->ino == b->ino;
+}
+
+static int tiles_same_version(const HwJpegFileKey *a, const HwJpegFileKey *b)
+{
+    return tiles_same_file(a, b) && a->mtimeNs == b->mtimeNs && a->size == b->size;
+}
+
+static int tiles_same_tile(const HwJpegTileKey *a, const HwJpegTileKey *b)
+{
+    return tiles_same_version(&a->file, &b->file) && a->scaleDenom == b->scaleDenom &&
+           a->outFomart == b->outFomart && a->x == b->x && a->y == b->y &&
+           a->w == b->w && a->h == b->h;
+}
+
+static RK_U32 tiles_hash(const HwJpegTileKey *k)
+{
+    RK_U32 h = (RK_U32)k->file.ino * 2654435761U;
+
+    h ^= (RK_U32)k->file.mtimeNs;
+    h = h * 31 + k->scaleDenom;
+    h = h * 31 + k->x;
+    h = h * 31 + k->y;
+    h = h * 31 + k->w;
+    h = h * 31 + k->h;
+    return (h ^ (h >> 16)) % TILES_BUCKETS;
+}
+
+static unsigned char *tiles_pixels(TilesTile *tile)
+{
+    return (unsigned char *)(tile + 1);
+}
+
+/* caller holds the lock */
+static void tiles_drop_index(HwJpegTiles *t, int slot)
+{
+    TilesIndex *e = t->index[slot];
+
+    t->index[slot] = NULL;
+    t->stats.indexEntries--;
+    e->cached = 0;
+    if (!e->refs) {
+        hw_jpeg_index_free(&e->index);
+        free(e);
+    }
+}
+
+static void tiles_lru_remove(HwJpegTiles *t, TilesTile *tile)
+{
+    if (tile->lruPrev)
+        tile->lruPrev->lruNext = tile->lruNext;
+    else
+        t->lruHead = tile->lruNext;
+
+    if (tile->lruNext)
+        tile->lruNext->lruPrev = tile->lruPrev;
+    else
+        t->lruTail = tile->lruPrev;
+
+    tile->lruPrev = tile->lruNext = NULL;
+}
+
+static void tiles_lru_push(HwJpegTiles *t, TilesTile *tile)
+{
+    tile->lruPrev = NULL;
+    tile->lruNext = t->lruHead;
+    if (t->lruHead)
+        t->lruHead->lruPrev = tile;
+    else
+        t->lruTail = tile;
+    t->lruHead = tile;
+}
+
+static void tiles_remove(HwJpegTiles *t, TilesTile *tile)
+{
+    TilesTile **pp = &t->buckets[tiles_hash(&tile->key)];
+
+    while (*pp != tile)
+        pp = &(*pp)->hashNext;
+    *pp = tile->hashNext;
+
+    tiles_lru_remove(t, tile);
+    t->stats.tiles--;
+    t->stats.tileBytes -= tile->bytes;
+    free(tile);
+}
+
+static TilesTile *tiles_find(HwJpegTiles *t, const HwJpegTileKey *key)
+{
+    TilesTile *tile = t->buckets[tiles_hash(key)];
+
+    while (tile != NULL && !tiles_same_tile(&tile->key, key))
+        tile = tile->hashNext;
+    return tile;
+}
+
+static void tiles_fit(HwJpegTiles *t)
+{
+    while (t->stats.tileBytes > t->stats.budget && t->lruTail != NULL) {
+        tiles_remove(t, t->lruTail);
+        t->stats.tileEvictions++;
+    }
+}
+
+HwJpegTiles *hw_jpeg_tiles_create(const HwJpegTilesCfg *cfg)
+{
+    HwJpegTiles *t = (HwJpegTiles *)calloc(1, sizeof(*t));
+
+    if (t == NULL)
+        return NULL;
+
+    t->indexes = HW_JPEG_TILES_INDEXES_DEF;
+    t->stats.budget = HW_JPEG_TILES_BUDGET_DEF;
+    if (cfg != NULL) {
+        if (cfg->indexes > 0)
+            t->indexes = MIN(cfg->indexes, HW_JPEG_TILES_INDEXES_MAX);
+        if (cfg->budget > 0)
+            t->stats.budget = cfg->budget;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+
+    return t;
+}
+
+static void tiles_free(HwJpegTiles *t)
+{
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+}
+
+void hw_jpeg_tiles_destroy(HwJpegTiles *t)
+{
+    int i, last;
+
+    if (t == NULL)
+        return;
+
+    /* indexes still held are freed, with the cache, by their last put */
+    pthread_mutex_lock(&t->lock);
+    for (i = 0; i < t->indexes; i++) {
+        if (t->index[i] != NULL)
+            tiles_drop_index(t, i);
+    }
+    while (t->lruHead != NULL)
+        tiles_remove(t, t->lruHead);
+    t->closed = 1;
+    last = !t->refs;
+    pthread_mutex_unlock(&t->lock);
+
+    if (last)
+        tiles_free(t);
+}
+
+int hw_jpeg_file_key(int fd, HwJpegFileKey *key)
+{
+    struct stat st;
+
+    if (key == NULL || fstat(fd, &st))
+        return -1;
+
+    memset(key, 0, sizeof(*key));
+    key->dev = st.st_dev;
+    key->ino = st.st_ino;
+#ifdef __BIONIC__
+    key->mtimeNs = (RK_S64)st.st_mtime * 1000000000LL + st.st_mtime_nsec;
+#else
+    key->mtimeNs = (RK_S64)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    key->size = st.st_size;
+    return 0;
+}
+
+int hw_jpeg_tiles_get_index(HwJpegTiles *t, const HwJpegFileKey *key,
+                            const unsigned char *data, long length,
+                            const HwJpegIndex **index)
+{
+    TilesIndex *e = NULL;
+    int i, slot, ret;
+    RK_S64 us;
+
+    if (t == NULL || key == NULL || index == NULL)
+        return JPEGDEC_PARAM_ERROR;
+
+    pthread_mutex_lock(&t->lock);
+    for (i = 0; i < t->indexes; i++) {
+        if (t->index[i] != NULL && tiles_same_version(&t->index[i]->key, key)) {
+            e = t->index[i];
+            break;
+        }
+    }
+    if (e != NULL) {
+        e->refs++;
+        t->refs++;
+        e->lru = ++t->tick;
+        t->stats.indexHits++;
+        pthread_mutex_unlock(&t->lock);
+        *index = &e->index;
+        return JPEGDEC_OK;
+    }
+    t->stats.indexMisses++;
+    pthread_mutex_unlock(&t->lock);
+
+    /* parse outside the lock, a large picture takes a while */
+    e = (TilesIndex *)calloc(1, sizeof(*e));
+    if (e == NULL)
+        return JPEGDEC_MEMFAIL;
+
+    us = hw_jpeg_now_us();
+    ret = hw_jpeg_index_build(&e->index, data, length);
+    us = hw_jpeg_now_us() - us;
+    if (ret != JPEGDEC_OK) {
+        free(e);
+        return ret;
+    }
+    e->key = *key;
+    e->refs = 1;
+    e->cached = 1;
+
+    pthread_mutex_lock(&t->lock);
+    t->stats.indexBuildUs += us;
+
+    /* an older version of the file, an empty slot, or the least recently used */
+    slot = -1;
+    for (i = 0; i < t->indexes; i++) {
+        if (t->index[i] != NULL && tiles_same_file(&t->index[i]->key, key)) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 || (t->index[slot] != NULL &&
+                         (t->index[i] == NULL || t->index[i]->lru < t->index[slot]->lru)))
+            slot = i;
+    }
+    if (t->index[slot] != NULL) {
+        if (!tiles_same_file(&t->index[slot]->key, key))
+            t->stats.indexEvictions++;
+        tiles_drop_index(t, slot);
+    }
+    e->lru = ++t->tick;
+    t->index[slot] = e;
+    t->stats.indexEntries++;
+    t->refs++;
+    pthread_mutex_unlock(&t->lock);
+
+    *index = &e->index;
+    return JPEGDEC_OK;
+}
+
+void hw_jpeg_tiles_put_index(HwJpegTiles *t, const HwJpegIndex *index)
+{
+    TilesIndex *e;
+    int last;
+
+    if (t == NULL || index == NULL)
+        return;
+
+    e = (TilesIndex *)((char *)index - offsetof(TilesIndex, index));
+
+    pthread_mutex_lock(&t->lock);
+    if (!--e->refs && !e->cached) {
+        hw_jpeg_index_free(&e->index);
+        free(e);
+    }
+    last = !--t->refs && t->closed;
+    pthread_mutex_unlock(&t->lock);
+
+    if (last)
+        tiles_free(t);
+}
+
+void hw_jpeg_tiles_invalidate(HwJpegTiles *t, const HwJpegFileKey *file)
+{
+    TilesTile *tile, *next;
+    int i;
+
+    if (t == NULL || file == NULL)
+        return;
+
+    pthread_mutex_lock(&t->lock);
+    for (i = 0; i < t->indexes; i++) {
+        if (t->index[i] != NULL && tiles_same_file(&t->index[i]->key, file))
+            tiles_drop_index(t, i);
+    }
+    for (tile = t->lruHead; tile != NULL; tile = next) {
+        next = tile->lruNext;
+        if (tiles_same_file(&tile->key.file, file))
+            tiles_remove(t, tile);
+    }
+    pthread_mutex_unlock(&t->lock);
+}
+
+int hw_jpeg_tiles_lookup(HwJpegTiles *t, const HwJpegTileKey *key,
+                         void *dst, int dstStride, int dstSize, int *width, int *height)
+{
+    TilesTile *tile;
+    int y, ret = -1;
+
+    if (t == NULL || key == NULL || dst == NULL)
+        return -1;
+
+    pthread_mutex_lock(&t->lock);
+    tile = tiles_find(t, key);
+    if (tile == NULL) {
+        t->stats.tileMisses++;
+    } else if (dstStride >= tile->width * tile->bpp && dstSize >= dstStride * tile->height) {
+        tiles_lru_remove(t, tile);
+        tiles_lru_push(t, tile);
+        for (y = 0; y < tile->height; y++)
+            memcpy((RK_U8 *)dst + y * dstStride, tiles_pixels(tile) + y * tile->width * tile->bpp,
+                   tile->width * tile->bpp);
+        if (width != NULL)
+            *width = tile->width;
+        if (height != NULL)
+            *height = tile->height;
+        t->stats.tileHits++;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    return ret;
+}
+
+int hw_jpeg_tiles_store(HwJpegTiles *t, const HwJpegTileKey *key, const void *src,
+                        int srcStride, int width, int height, int bpp)
+{
+    TilesTile *tile, *old;
+    size_t bytes;
+    int y;
+
+    if (t == NULL || key == NULL || src == NULL || width <= 0 || height <= 0 || bpp <= 0 ||
+        srcStride < width * bpp)
+        return -1;
+
+    bytes = (size_t)width * height * bpp;
+    if (bytes > t->stats.budget)
+        return -1;
+
+    tile = (TilesTile *)malloc(sizeof(*tile) + bytes);
+    if (tile == NULL)
+        return -1;
+
+    memset(tile, 0, sizeof(*tile));
+    tile->key = *key;
+    tile->width = width;
+    tile->height = height;
+    tile->bpp = bpp;
+    tile->bytes = bytes;
+    for (y = 0; y < height; y++)
+        memcpy(tiles_pixels(tile) + y * width * bpp, (const RK_U8 *)src + y * srcStride, width * bpp);
+
+    pthread_mutex_lock(&t->lock);
+    old = tiles_find(t, key);
+    if (old != NULL)
+        tiles_remove(t, old);
+
+    tile->hashNext = t->buckets[tiles_hash(key)];
+    t->buckets[tiles_hash(key)] = tile;
+    tiles_lru_push(t, tile);
+    t->stats.tiles++;
+    t->stats.tileBytes += bytes;
+    tiles_fit(t);
+    pthread_mutex_unlock(&t->lock);
+
+    return 0;
+}
+
+void hw_jpeg_tiles_set_budget(HwJpegTiles *t, size_t budget)
+{
+    if (t == NULL)
+        return;
+
+    pthread_mutex_lock(&t->lock);
+    t->stats.budget = budget > 0 ? budget : HW_JPEG_TILES_BUDGET_DEF;
+    tiles_fit(t);
+    pthread_mutex_unlock(&t->lock);
+}
+
+void hw_jpeg_tiles_get_stats(HwJpegTiles *t, HwJpegTilesStats *stats)
+{
+    if (t == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&t->lock);
+    *stats = t->stats;
+    pthread_mutex_unlock(&t->lock);
+}
@@ -0,0 +1,127 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_tiles.h
+    Description:
+        Caches for panning around large pictures in a viewer. Every pan
+        used to decode again from the file: JpegDecGetImageInfo parsing
+        the headers and the decoder walking the entropy data of the whole
+        picture. The index cache keeps the hw_jpeg_index of the last few
+        pictures, headers, tables and restart offsets, keyed by file
+        identity and modification time so that a rewritten file is parsed
+        again. The tile cache keeps decoded regions per scale denominator
+        under a byte budget, least recently used first out, so that
+        panning back, or showing a coarser level while the finer one is
+        decoding, costs a copy.
+
+        A viewer looks a tile up, and on a miss submits it to a
+        hw_jpeg_batch with the cached index and the tile as crop window,
+        then stores the result.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_TILES_H__
+#define __HW_JPEG_TILES_H__
+
+#include <stddef.h>
+
+#include "vpu_mem.h"
+#include "hw_jpeg_index.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HW_JPEG_TILES_INDEXES_DEF       (8)
+#define HW_JPEG_TILES_INDEXES_MAX       (64)
+#define HW_JPEG_TILES_BUDGET_DEF        (32 * 1024 * 1024)
+
+typedef struct
+{
+  RK_U64 dev;
+  RK_U64 ino;
+  RK_S64 mtimeNs;
+  RK_S64 size;
+} HwJpegFileKey;
+
+typedef struct
+{
+  HwJpegFileKey file;
+  int scaleDenom;
+  int outFomart;        /* as in PostProcessInfo */
+  int x;                /* picture pixels */
+  int y;
+  int w;
+  int h;
+} HwJpegTileKey;
+
+typedef struct
+{
+  int indexes;          /* pictures indexed at once; 0: default */
+  size_t budget;        /* bytes of decoded tiles; 0: default */
+} HwJpegTilesCfg;
+
+typedef struct
+{
+  RK_U32 indexHits;
+  RK_U32 indexMisses;
+  RK_U32 indexEvictions;
+  RK_U32 indexEntries;
+  RK_S64 indexBuildUs;
+  RK_U32 tileHits;
+  RK_U32 tileMisses;
+  RK_U32 tileEvictions;
+  RK_U32 tiles;
+  size_t tileBytes;
+  size_t budget;
+} HwJpegTilesStats;
+
+typedef struct HwJpegTiles HwJpegTiles;
+
+extern HwJpegTiles *hw_jpeg_tiles_create(const HwJpegTilesCfg *cfg);
+/*
+ * Indexes not put back yet stay valid; they are freed, and the cache with
+ * them, by their last hw_jpeg_tiles_put_index. No other call is allowed
+ * after destroy.
+ */
+extern void hw_jpeg_tiles_destroy(HwJpegTiles *t);
+
+/* identity of an open file, from fstat. Returns 0 or -1. */
+extern int hw_jpeg_file_key(int fd, HwJpegFileKey *key);
+
+/*
+ * Index of the picture in data, built on a miss. The index stays valid
+ * until hw_jpeg_tiles_put_index, also when the cache drops it meanwhile.
+ * Returns JPEGDEC_OK or the hw_jpeg_index_build error.
+ */
+extern int hw_jpeg_tiles_get_index(HwJpegTiles *t, const HwJpegFileKey *key,
+                                   const unsigned char *data, long length,
+                                   const HwJpegIndex **index);
+extern void hw_jpeg_tiles_put_index(HwJpegTiles *t, const HwJpegIndex *index);
+
+/* forget the indexes and tiles of a file, e.g. once it is edited */
+extern void hw_jpeg_tiles_invalidate(HwJpegTiles *t, const HwJpegFileKey *file);
+
+/*
+ * Copy a cached tile into dst, dstStride bytes per row, no more than
+ * dstSize bytes. Returns 0 and its size, or -1 on a miss.
+ */
+extern int hw_jpeg_tiles_lookup(HwJpegTiles *t, const HwJpegTileKey *key,
+                                void *dst, int dstStride, int dstSize, int *width, int *height);
+
+/*
+ * Keep a copy of a decoded tile, width x height pixels of bpp bytes.
+ * Evicts least recently used tiles to stay in budget; a tile larger than
+ * the budget is not kept. Returns 0 or -1.
+ */
+extern int hw_jpeg_tiles_store(HwJpegTiles *t, const HwJpegTileKey *key, const void *src,
+                               int srcStride, int width, int height, int bpp);
+
+/* change the budget, evicting tiles to fit */
+extern void hw_jpeg_tiles_set_budget(HwJpegTiles *t, size_t budget);
+
+extern void hw_jpeg_tiles_get_stats(HwJpegTiles *t, HwJpegTilesStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_TILES_H__ */
@@ -0,0 +1,277 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_tiles_test.c
+    Description:
+        Test of the index and tile caches. Builds for the host:
+
+            hw_jpeg_tiles_test
+
+        The indexes are built from hw_jpeg_test_stream streams and the
+        tiles are made up pixels. Covers file keys from fstat, index hits
+        and misses, a rewritten file parsed again, the least recently used
+        index evicted while the ones handed out stay valid, a bad stream,
+        tiles stored and copied back, least recently used tiles evicted
+        under the budget, a tile larger than the budget refused, tiles of
+        another scale denominator or output format kept apart, invalidating
+        a file, a smaller budget, and destroy with an index still held.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+#include "hw_jpeg_tiles.h"
+#include "hw_jpeg_test_stream.h"
+
+#define TEST_TILE                   (64)
+#define TEST_TILE_BYTES             (TEST_TILE * TEST_TILE * 4)
+
+#ifdef HW_JPEG_TILES_TEST_HOST
+/* the rest of hw_jpeg_util needs the VPU, the caches only take this */
+RK_S64 hw_jpeg_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+static int failures;
+static HwJpegTestStream test;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+static void test_key(HwJpegFileKey *key, RK_U64 ino, RK_S64 mtimeNs)
+{
+    memset(key, 0, sizeof(*key));
+    key->dev = 1;
+    key->ino = ino;
+    key->mtimeNs = mtimeNs;
+    key->size = test.length;
+}
+
+static void test_file_key(void)
+{
+    char path[] = "/tmp/hw_jpeg_tiles_testXXXXXX";
+    HwJpegFileKey a, b;
+    int fd;
+
+    fd = mkstemp(path);
+    check(fd >= 0, "file key: temp file");
+    if (fd < 0)
+        return;
+    unlink(path);
+
+    check(write(fd, test.data, test.length) == test.length, "file key: write");
+    check_eq("file key", hw_jpeg_file_key(fd, &a), 0);
+    check_eq("file key: size", a.size, test.length);
+    check(a.mtimeNs > 0, "file key: mtime");
+
+    check(write(fd, test.data, 16) == 16, "file key: append");
+    hw_jpeg_file_key(fd, &b);
+    check(a.dev == b.dev && a.ino == b.ino, "file key: same file");
+    check_eq("file key: new size", b.size, test.length + 16);
+
+    close(fd);
+    check_eq("file key: closed", hw_jpeg_file_key(fd, &a), -1);
+}
+
+static void test_indexes(void)
+{
+    HwJpegTilesCfg cfg = { 2, 0 };
+    HwJpegTiles *t = hw_jpeg_tiles_create(&cfg);
+    HwJpegTilesStats st;
+    HwJpegFileKey k1, k1new, k2, k3;
+    const HwJpegIndex *a, *b, *c, *d, *e;
+
+    test_key(&k1, 1, 1000);
+    test_key(&k1new, 1, 2000);
+    test_key(&k2, 2, 1000);
+    test_key(&k3, 3, 1000);
+
+    check_eq("index: miss", hw_jpeg_tiles_get_index(t, &k1, test.data, test.length, &a), JPEGDEC_OK);
+    check_eq("index: hit", hw_jpeg_tiles_get_index(t, &k1, test.data, test.length, &b), JPEGDEC_OK);
+    check(a == b, "index: same index");
+    check(a->width == test.width && a->intervals == test.intervals, "index: built");
+
+    /* rewritten: parsed again, in the slot of the old version */
+    check_eq("index: new version", hw_jpeg_tiles_get_index(t, &k1new, test.data, test.length, &c),
+             JPEGDEC_OK);
+    check(c != a, "index: new version parsed");
+    hw_jpeg_tiles_get_stats(t, &st);
+    check_eq("index: one entry a file", st.indexEntries, 1);
+    check_eq("index: new version no eviction", st.indexEvictions, 0);
+
+    /* dropped from the cache, still held */
+    check(a->starts != NULL && a->starts[1] == test.start[1], "index: old version held");
+    hw_jpeg_tiles_put_index(t, a);
+    hw_jpeg_tiles_put_index(t, b);
+
+    /* two slots: k3 evicts k1new, used before k2 */
+    hw_jpeg_tiles_get_index(t, &k2, test.data, test.length, &d);
+    hw_jpeg_tiles_get_index(t, &k3, test.data, test.length, &e);
+    hw_jpeg_tiles_get_stats(t, &st);
+    check_eq("index: hits", st.indexHits, 1);
+    check_eq("index: misses", st.indexMisses, 4);
+    check_eq("index: evictions", st.indexEvictions, 1);
+    check_eq("index: entries", st.indexEntries, 2);
+    check(c->starts != NULL && c->height == test.height, "index: evicted one held");
+    hw_jpeg_tiles_put_index(t, c);
+
+    check_eq("index: evicted one parsed again",
+             hw_jpeg_tiles_get_index(t, &k1new, test.data, test.length, &c), JPEGDEC_OK);
+    hw_jpeg_tiles_put_index(t, c);
+
+    check_eq("index: bad stream", hw_jpeg_tiles_get_index(t, &k1, test.data + 2, test.length - 2, &a),
+             JPEGDEC_STRM_ERROR);
+    hw_jpeg_tiles_get_stats(t, &st);
+    check_eq("index: bad stream not kept", st.indexEntries, 2);
+
+    /* destroyed with e held: e stays valid, the last put frees the cache */
+    hw_jpeg_tiles_put_index(t, d);
+    hw_jpeg_tiles_destroy(t);
+    check(e->starts != NULL && e->intervals == test.intervals, "index: held over destroy");
+    hw_jpeg_tiles_put_index(t, e);
+}
+
+/* a tile whose pixels say which one it is */
+static void test_fill(RK_U32 *px, int id)
+{
+    int i;
+
+    for (i = 0; i < TEST_TILE * TEST_TILE; i++)
+        px[i] = id << 16 | i;
+}
+
+static int test_lookup(HwJpegTiles *t, const HwJpegTileKey *key, int id)
+{
+    static RK_U32 out[TEST_TILE * TEST_TILE];
+    int w = 0, h = 0;
+
+    memset(out, 0, sizeof(out));
+    if (hw_jpeg_tiles_lookup(t, key, out, TEST_TILE * 4, sizeof(out), &w, &h))
+        return -1;
+    return w == TEST_TILE && h == TEST_TILE && out[0] == (RK_U32)(id << 16) &&
+           out[TEST_TILE * TEST_TILE - 1] == (RK_U32)(id << 16 | (TEST_TILE * TEST_TILE - 1));
+}
+
+static void test_tiles(void)
+{
+    static RK_U32 px[TEST_TILE * TEST_TILE];
+    HwJpegTilesCfg cfg = { 0, 3 * TEST_TILE_BYTES };
+    HwJpegTiles *t = hw_jpeg_tiles_create(&cfg);
+    HwJpegTilesStats st;
+    HwJpegTileKey key, other;
+    int i;
+
+    memset(&key, 0, sizeof(key));
+    test_key(&key.file, 1, 1000);
+    key.scaleDenom = 1;
+    key.outFomart = 1;
+    key.w = key.h = 256;
+
+    check_eq("tiles: miss", test_lookup(t, &key, 0), -1);
+
+    /* four tiles in a budget of three; tile 0 used after tile 1 stored */
+    for (i = 0; i < 4; i++) {
+        key.x = i * 256;
+        test_fill(px, i);
+        check_eq("tiles: store", hw_jpeg_tiles_store(t, &key, px, TEST_TILE * 4, TEST_TILE,
+                 TEST_TILE, 4), 0);
+        if (i == 1) {
+            key.x = 0;
+            check_eq("tiles: hit", test_lookup(t, &key, 0), 1);
+        }
+    }
+    key.x = 256;
+    check_eq("tiles: least recently used evicted", test_lookup(t, &key, 1), -1);
+    key.x = 0;
+    check_eq("tiles: used one kept", test_lookup(t, &key, 0), 1);
+    key.x = 768;
+    check_eq("tiles: last one kept", test_lookup(t, &key, 3), 1);
+
+    hw_jpeg_tiles_get_stats(t, &st);
+    check_eq("tiles: count", st.tiles, 3);
+    check_eq("tiles: bytes", st.tileBytes, 3 * TEST_TILE_BYTES);
+    check_eq("tiles: evictions", st.tileEvictions, 1);
+    check_eq("tiles: hits", st.tileHits, 3);
+    check_eq("tiles: misses", st.tileMisses, 2);
+
+    /* the same place at another scale, in another format or of another version */
+    other = key;
+    other.scaleDenom = 2;
+    check_eq("tiles: other denom", test_lookup(t, &other, 3), -1);
+    other = key;
+    other.outFomart = 0;
+    check_eq("tiles: other format", test_lookup(t, &other, 3), -1);
+    other = key;
+    other.file.mtimeNs++;
+    check_eq("tiles: other version", test_lookup(t, &other, 3), -1);
+
+    /* storing again replaces */
+    test_fill(px, 9);
+    hw_jpeg_tiles_store(t, &key, px, TEST_TILE * 4, TEST_TILE, TEST_TILE, 4);
+    check_eq("tiles: replaced", test_lookup(t, &key, 9), 1);
+    hw_jpeg_tiles_get_stats(t, &st);
+    check_eq("tiles: replaced in place", st.tiles, 3);
+
+    check_eq("tiles: larger than the budget", hw_jpeg_tiles_store(t, &key, px, TEST_TILE * 4,
+             TEST_TILE, TEST_TILE * 4, 4), -1);
+    check_eq("tiles: short stride", hw_jpeg_tiles_store(t, &key, px, TEST_TILE, TEST_TILE,
+             TEST_TILE, 4), -1);
+
+    hw_jpeg_tiles_set_budget(t, TEST_TILE_BYTES);
+    hw_jpeg_tiles_get_stats(t, &st);
+    check(st.tiles == 1 && st.tileBytes == TEST_TILE_BYTES, "tiles: smaller budget");
+    check_eq("tiles: most recent kept", test_lookup(t, &key, 9), 1);
+
+    /* another file's tile goes on invalidate, for any version */
+    hw_jpeg_tiles_set_budget(t, 2 * TEST_TILE_BYTES);
+    other = key;
+    other.file.ino = 2;
+    hw_jpeg_tiles_store(t, &other, px, TEST_TILE * 4, TEST_TILE, TEST_TILE, 4);
+    other = key;
+    other.file.mtimeNs++;
+    hw_jpeg_tiles_invalidate(t, &other.file);
+    hw_jpeg_tiles_get_stats(t, &st);
+    check_eq("tiles: invalidated", st.tiles, 1);
+    check_eq("tiles: invalidated file gone", test_lookup(t, &key, 9), -1);
+
+    hw_jpeg_tiles_destroy(t);
+}
+
+int main(void)
+{
+    HwJpegTestStreamCfg cfg = { 8, 4, 4, 0 };
+
+    if (hw_jpeg_test_stream_make(&cfg, &test)) {
+        printf("FAILED: no stream\n");
+        return 1;
+    }
+
+    test_file_key();
+    test_indexes();
+    test_tiles();
+
+    hw_jpeg_test_stream_free(&test);
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
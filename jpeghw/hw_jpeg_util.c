@@ -0,0 +1,126 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_util.c
+    Description:
+        Shared helpers of the JPEG decode paths
+ **************************************************************************************************/
+#define LOG_TAG "hw_jpeg_util"
+
+#include <string.h>
+#include <time.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "hw_jpeg_util.h"
+
+#define UTIL_ALLOC_ALIGN            (4096)
+
+static const HwJpegLayout jpegLayouts[] = {
+    { JPEGDEC_YCbCr420_SEMIPLANAR, VPU_DEC_PP_IN_YUV420_SEMI, 16, 1, 2 },
+    { JPEGDEC_YCbCr422_SEMIPLANAR, VPU_DEC_PP_IN_YUV422_SEMI,  8, 1, 1 },
+    { JPEGDEC_YCbCr440,            VPU_DEC_PP_IN_YUV440_SEMI, 16, 1, 1 },
+    { JPEGDEC_YCbCr444_SEMIPLANAR, VPU_DEC_PP_IN_YUV444_SEMI,  8, 2, 1 },
+    { JPEGDEC_YCbCr411_SEMIPLANAR, VPU_DEC_PP_IN_YUV411_SEMI,  8, 1, 2 },
+    { JPEGDEC_YCbCr400,            VPU_DEC_PP_IN_YUV400,       8, 0, 1 },
+};
+
+const HwJpegLayout *hw_jpeg_layout(RK_U32 jpegFormat)
+{
+    RK_U32 i;
+
+    for (i = 0; i < sizeof(jpegLayouts) / sizeof(jpegLayouts[0]); i++) {
+        if (jpegLayouts[i].jpegFormat == jpegFormat)
+            return &jpegLayouts[i];
+    }
+
+    return NULL;
+}
+
+RK_U32 hw_jpeg_yuv_bytes(const HwJpegLayout *layout, RK_U32 width, RK_U32 lines)
+{
+    RK_U32 luma = width * lines;
+
+    return luma + luma * layout->chromaNum / layout->chromaDen;
+}
+
+int hw_jpeg_pp_color(int outFomart)
+{
+    switch (outFomart) {
+    case 0:
+        return VPU_PP_OUTPUT_FORMAT_RGB565;
+    case 1:
+        return VPU_PP_OUTPUT_FORMAT_ARGB8888;
+    default:
+        return -1;
+    }
+}
+
+int hw_jpeg_pp_bpp(int colorType)
+{
+    switch (colorType) {
+    case VPU_PP_OUTPUT_FORMAT_ARGB8888:
+    case VPU_PP_OUTPUT_FORMAT_ABGR8888:
+        return 4;
+    case VPU_PP_OUTPUT_FORMAT_RGB565:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+RK_S64 hw_jpeg_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int hw_jpeg_reserve(VPUMemLinear_t *m, RK_U32 size)
+{
+    if (m->phy_addr && m->size >= size)
+        return 0;
+
+    hw_jpeg_unreserve(m);
+    if (VPUMallocLinear(m, (size + UTIL_ALLOC_ALIGN - 1) & ~(UTIL_ALLOC_ALIGN - 1))) {
+        ALOGE("VPUMallocLinear of %d bytes failed", size);
+        memset(m, 0, sizeof(*m));
+        return -1;
+    }
+
+    return 1;
+}
+
+void hw_jpeg_unreserve(VPUMemLinear_t *m)
+{
+    if (m->phy_addr)
+        VPUFreeLinear(m);
+    memset(m, 0, sizeof(*m));
+}
+
+int hw_jpeg_pp_run(VPUSchedSession_t *s, RK_U32 *regs, const VPU_POSTPROCESSING *pp,
+                   const HwJpegLayout *layout, RK_U32 origWidth, RK_U32 cropX, RK_U32 cropY,
+                   RK_U32 outStride)
+{
+    VPU_CMD_TYPE cmd;
+    RK_S32 len;
+
+    memset(regs, 0, VPU_REG_NUM_DEC_PP * sizeof(RK_U32));
+    if (VPUDecPPSetup(regs, pp, VPU_DEC_PP_STANDALONE, 0) != VPU_OK ||
+        VPUDecPPSetInputFormat(regs, layout->ppFormat) != VPU_OK)
+        return JPEGDEC_PARAM_ERROR;
+
+    if (origWidth && VPUDecPPSetCrop(regs, origWidth, cropX, cropY) != VPU_OK)
+        return JPEGDEC_PARAM_ERROR;
+
+    if (outStride && VPUDecPPSetOutputStride(regs, outStride) != VPU_OK)
+        return JPEGDEC_PARAM_ERROR;
+
+    if (VPUSchedSendReg(s, VPU_DEC_PP_REGS(regs), VPU_REG_NUM_PP) != VPU_OK ||
+        VPUSchedWaitResult(s, VPU_DEC_PP_REGS(regs), VPU_REG_NUM_PP, &cmd, &len) != VPU_OK ||
+        cmd != VPU_SEND_CONFIG_ACK_OK) {
+        ALOGE("post-processor job failed");
+        return JPEGDEC_HW_BUS_ERROR;
+    }
+
+    return JPEGDEC_OK;
+}
@@ -0,0 +1,63 @@
+/***************************************************************************************************
+    File:
+        hw_jpeg_util.h
+    Description:
+        Pieces shared by the JPEG helpers: decoder output layouts, VPU buffer
+        reuse and standalone post-processor jobs on decoder output.
+ **************************************************************************************************/
+#ifndef __HW_JPEG_UTIL_H__
+#define __HW_JPEG_UTIL_H__
+
+#include "vpu_mem.h"
+#include "vpu_dec_pp.h"
+#include "vpu_sched.h"
+#include "hw_jpegdecapi.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* decoder output of one JPEG sampling */
+typedef struct
+{
+  RK_U32 jpegFormat;
+  VPU_DEC_PP_IN_FORMAT ppFormat;
+  RK_U32 mcuHeight;
+  RK_U32 chromaNum;     /* chroma bytes = luma bytes * num / den */
+  RK_U32 chromaDen;
+} HwJpegLayout;
+
+/* NULL for formats the post-processor can not read */
+extern const HwJpegLayout *hw_jpeg_layout(RK_U32 jpegFormat);
+extern RK_U32 hw_jpeg_yuv_bytes(const HwJpegLayout *layout, RK_U32 width, RK_U32 lines);
+
+/* PostProcessInfo::outFomart to VPU_PP_OUTPUT_FORMAT_*, -1 if unknown */
+extern int hw_jpeg_pp_color(int outFomart);
+/* bytes per pixel of a VPU_PP_OUTPUT_FORMAT_* RGB format, 0 otherwise */
+extern int hw_jpeg_pp_bpp(int colorType);
+
+extern RK_S64 hw_jpeg_now_us(void);
+
+/*
+ * Make m hold at least size bytes, keeping the buffer when it is big
+ * enough. Returns 0 when kept, 1 when (re)allocated, -1 on failure.
+ */
+extern int hw_jpeg_reserve(VPUMemLinear_t *m, RK_U32 size);
+extern void hw_jpeg_unreserve(VPUMemLinear_t *m);
+
+/*
+ * Run pp as a standalone job on decoder output of the given layout and
+ * wait for it. With origWidth non zero the input is a window at cropX,
+ * cropY of a picture that wide. With outStride non zero the output rows
+ * are that many pixels apart. regs holds VPU_REG_NUM_DEC_PP words.
+ */
+extern int hw_jpeg_pp_run(VPUSchedSession_t *s, RK_U32 *regs, const VPU_POSTPROCESSING *pp,
+                          const HwJpegLayout *layout, RK_U32 origWidth, RK_U32 cropX, RK_U32 cropY,
+                          RK_U32 outStride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HW_JPEG_UTIL_H__ */
@@ -0,0 +1,56 @@
+# Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+LOCAL_PATH := $(call my-dir)
+
+# Helpers shared by the gralloc module and its clients (hwcomposer,
+# mediaserver) that operate on private_handle_t.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				gralloc_lock_state.cpp \
+				gralloc_ump_cache.cpp \
+				gralloc_buffer_phys.cpp
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libUMP
+LOCAL_MODULE := libgralloc_priv
+LOCAL_CFLAGS := -DLOG_TAG=\"gralloc\"
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_STATIC_LIBRARY)
+
+# Stress test and lock/unlock benchmark of the lockState transitions:
+# adb shell gralloc_lock_state_test [seconds]
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := gralloc_lock_state_test.cpp
+
+LOCAL_STATIC_LIBRARIES := libgralloc_priv
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libUMP
+LOCAL_MODULE := gralloc_lock_state_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Mapping cache test on a fake UMP layer: hits, LRU eviction under the
+# byte budget and invalidation on reference release.
+# adb shell gralloc_ump_cache_test
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := gralloc_ump_cache_test.cpp
+
+LOCAL_STATIC_LIBRARIES := libgralloc_priv
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libUMP
+LOCAL_MODULE := gralloc_ump_cache_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include <utils/Log.h>
+
+#include "gralloc_priv.h"
+#include "gralloc_buffer_phys.h"
+#include "ump/include/ump/ump_ref_drv.h"
+
+int gralloc_buffer_describe(buffer_handle_t handle, struct gralloc_buffer_desc *desc)
+{
+	const private_handle_t *hnd = private_handle_t::dynamicCast(handle);
+
+	if (hnd == NULL || desc == NULL)
+	{
+		return -EINVAL;
+	}
+
+	desc->framebuffer = (hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER) ? 1 : 0;
+#if GRALLOC_ARM_UMP_MODULE
+	desc->secure_id = desc->framebuffer ? (int)UMP_INVALID_SECURE_ID : hnd->ump_id;
+#else
+	desc->secure_id = (int)UMP_INVALID_SECURE_ID;
+#endif
+	desc->format = hnd->format;
+	desc->width = hnd->width;
+	desc->height = hnd->height;
+	desc->stride = hnd->stride;
+	desc->size = hnd->size;
+	desc->offset = hnd->offset;
+	desc->base = (void *)hnd->base;
+
+	return 0;
+}
+
+int gralloc_ump_phys_get(ump_secure_id secure_id, unsigned int *phys)
+{
+	ump_handle h;
+	int address;
+
+	if (phys == NULL || secure_id == UMP_INVALID_SECURE_ID)
+	{
+		return -EINVAL;
+	}
+
+	h = ump_handle_create_from_secure_id(secure_id);
+
+	if (h == UMP_INVALID_MEMORY_HANDLE)
+	{
+		AWAR("Invalid UMP id %d", secure_id);
+		return -EINVAL;
+	}
+
+	/* zero or negative unless the allocation is dedicated, physically contiguous memory */
+	address = ump_phy_addr_get(h);
+	ump_reference_release(h);
+
+	if (address <= 0)
+	{
+		AWAR("No physical address for UMP id %d", secure_id);
+		return -ENOSYS;
+	}
+
+	*phys = (unsigned int)address;
+	return 0;
+}
+
+int gralloc_buffer_phys_get(buffer_handle_t handle, unsigned int *phys)
+{
+	const private_handle_t *hnd = private_handle_t::dynamicCast(handle);
+
+	if (hnd == NULL || phys == NULL)
+	{
+		return -EINVAL;
+	}
+
+	if (hnd->phy_addr)
+	{
+		*phys = (unsigned int)hnd->phy_addr;
+		return 0;
+	}
+
+	if (hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER)
+	{
+		struct fb_fix_screeninfo finfo;
+
+		if (ioctl(hnd->fd, FBIOGET_FSCREENINFO, &finfo) < 0)
+		{
+			AERR("FBIOGET_FSCREENINFO failed: %s", strerror(errno));
+			return -errno;
+		}
+
+		*phys = (unsigned int)finfo.smem_start + hnd->offset;
+		return 0;
+	}
+
+#if GRALLOC_ARM_UMP_MODULE
+	if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP)
+	{
+		return gralloc_ump_phys_get((ump_secure_id)hnd->ump_id, phys);
+	}
+#endif
+
+	return -ENOSYS;
+}
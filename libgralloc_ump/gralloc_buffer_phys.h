@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRALLOC_BUFFER_PHYS_H_
+#define GRALLOC_BUFFER_PHYS_H_
+
+#include <cutils/native_handle.h>
+
+#include "ump/include/ump/ump.h"
+
+/*
+ * Physical addresses of gralloc buffers for hardware blocks that do not go
+ * through UMP themselves (VPU, IPP). Usable from C, so libon2 can feed
+ * buffers to the encoder without including gralloc_priv.h.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gralloc_buffer_desc
+{
+	int secure_id;          /* UMP_INVALID_SECURE_ID for framebuffer handles */
+	int framebuffer;
+	int format;             /* HAL_PIXEL_FORMAT_* */
+	int width;
+	int height;
+	int stride;             /* in pixels */
+	int size;
+	int offset;             /* framebuffer offset */
+	void *base;             /* CPU address, NULL if not mapped in this process */
+};
+
+// Fill desc from the handle without any system call.
+// Returns 0, or -EINVAL if handle is not a gralloc buffer.
+int gralloc_buffer_describe(buffer_handle_t handle, struct gralloc_buffer_desc *desc);
+
+// Physical address of the start of the buffer. Uses the address recorded in
+// the handle at allocation, the framebuffer base, or asks UMP, in that order.
+// Returns 0, or -ENOSYS when the buffer is not physically contiguous or the
+// address cannot be found. May do ioctls, so callers should cache the result.
+int gralloc_buffer_phys_get(buffer_handle_t handle, unsigned int *phys);
+
+// Physical address of a dedicated (contiguous) UMP allocation.
+int gralloc_ump_phys_get(ump_secure_id secure_id, unsigned int *phys);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GRALLOC_BUFFER_PHYS_H_ */
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
+#include <utils/Timers.h>
+
+#include "gralloc_lock_state.h"
+#include "alloc_device.h"
+
+/* spins before a waiting writer starts yielding the CPU */
+#define LOCK_STATE_SPIN_COUNT       100
+/* a writer waiting this long for readers is most likely facing a leaked lock */
+#define LOCK_STATE_WARN_NS          ms2ns(500)
+
+static inline volatile int32_t *lock_word(private_handle_t *hnd)
+{
+	return (volatile int32_t *)&hnd->lockState;
+}
+
+/*
+ * Read locks held by the calling thread, one entry per lock. The reader
+ * count in lockState has no owners, and a thread asking to write a buffer
+ * it still reads would otherwise wait for itself forever.
+ */
+struct lock_state_reads
+{
+	private_handle_t **hnds;
+	int count;
+	int size;
+};
+
+static pthread_key_t reads_key;
+static pthread_once_t reads_once = PTHREAD_ONCE_INIT;
+
+static void reads_free(void *arg)
+{
+	lock_state_reads *reads = (lock_state_reads *)arg;
+
+	free(reads->hnds);
+	free(reads);
+}
+
+static void reads_init(void)
+{
+	pthread_key_create(&reads_key, reads_free);
+}
+
+static lock_state_reads *reads_get(bool create)
+{
+	lock_state_reads *reads;
+
+	pthread_once(&reads_once, reads_init);
+	reads = (lock_state_reads *)pthread_getspecific(reads_key);
+
+	if (reads == NULL && create)
+	{
+		reads = (lock_state_reads *)calloc(1, sizeof(*reads));
+
+		if (reads != NULL && pthread_setspecific(reads_key, reads))
+		{
+			free(reads);
+			reads = NULL;
+		}
+	}
+
+	return reads;
+}
+
+/* a thread over its table is not tracked, and can still deadlock itself */
+static void reads_add(private_handle_t *hnd)
+{
+	lock_state_reads *reads = reads_get(true);
+
+	if (reads == NULL)
+	{
+		return;
+	}
+
+	if (reads->count == reads->size)
+	{
+		int size = reads->size ? reads->size * 2 : 8;
+		private_handle_t **hnds = (private_handle_t **)realloc(reads->hnds, size * sizeof(*hnds));
+
+		if (hnds == NULL)
+		{
+			return;
+		}
+
+		reads->hnds = hnds;
+		reads->size = size;
+	}
+
+	reads->hnds[reads->count++] = hnd;
+}
+
+/* returns false when this thread has no read lock on hnd */
+static bool reads_remove(private_handle_t *hnd)
+{
+	lock_state_reads *reads = reads_get(false);
+
+	if (reads == NULL)
+	{
+		return false;
+	}
+
+	for (int i = reads->count - 1; i >= 0; i--)
+	{
+		if (reads->hnds[i] == hnd)
+		{
+			reads->hnds[i] = reads->hnds[--reads->count];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int gralloc_lock_state_read_acquire(private_handle_t *hnd)
+{
+	volatile int32_t *word = lock_word(hnd);
+	int32_t current;
+
+	do
+	{
+		current = *word;
+
+		if (current & private_handle_t::LOCK_STATE_WRITE)
+		{
+			return -EBUSY;
+		}
+
+		if ((current & private_handle_t::LOCK_STATE_READ_MASK) == private_handle_t::LOCK_STATE_READ_MASK)
+		{
+			AERR("Reader count overflow on handle %p", hnd);
+			return -EBUSY;
+		}
+	}
+	while (android_atomic_acquire_cas(current, current + 1, word));
+
+	reads_add(hnd);
+	return 0;
+}
+
+int gralloc_lock_state_read_release(private_handle_t *hnd)
+{
+	volatile int32_t *word = lock_word(hnd);
+	int32_t current;
+
+	do
+	{
+		current = *word;
+
+		if ((current & private_handle_t::LOCK_STATE_READ_MASK) == 0)
+		{
+			AERR("Unlocking handle %p which has no readers (state 0x%x)", hnd, current);
+			return -EINVAL;
+		}
+	}
+	while (android_atomic_release_cas(current, current - 1, word));
+
+	/* not found when another thread took the lock, which gralloc allows */
+	reads_remove(hnd);
+	return 0;
+}
+
+int gralloc_lock_state_write_acquire(private_handle_t *hnd)
+{
+	volatile int32_t *word = lock_word(hnd);
+	int32_t current;
+
+	/*
+	 * Waiting on our own read lock would never end. An entry left by a read
+	 * lock that another thread released is stale once no reader is left.
+	 */
+	while (reads_remove(hnd))
+	{
+		if (android_atomic_acquire_load(word) & private_handle_t::LOCK_STATE_READ_MASK)
+		{
+			reads_add(hnd);
+			AERR("Thread %d asks to write handle %p it holds for read", gettid(), hnd);
+			return -EBUSY;
+		}
+	}
+
+	/* publish the write intent first so no new reader can get in */
+	do
+	{
+		current = *word;
+
+		if (current & private_handle_t::LOCK_STATE_WRITE)
+		{
+			return -EBUSY;
+		}
+	}
+	while (android_atomic_acquire_cas(current, current | private_handle_t::LOCK_STATE_WRITE, word));
+
+	/* then wait for the readers that were already inside */
+	int spins = 0;
+	bool warned = false;
+	nsecs_t start = 0;
+
+	while (android_atomic_acquire_load(word) & private_handle_t::LOCK_STATE_READ_MASK)
+	{
+		if (spins < LOCK_STATE_SPIN_COUNT)
+		{
+			spins++;
+			continue;
+		}
+
+		if (start == 0)
+		{
+			start = systemTime();
+		}
+		else if (!warned && systemTime() - start > LOCK_STATE_WARN_NS)
+		{
+			AWAR("Writer on handle %p still waiting for %d readers", hnd,
+			     android_atomic_acquire_load(word) & private_handle_t::LOCK_STATE_READ_MASK);
+			warned = true;
+		}
+
+		sched_yield();
+	}
+
+	hnd->writeOwner = gettid();
+	return 0;
+}
+
+int gralloc_lock_state_write_release(private_handle_t *hnd)
+{
+	volatile int32_t *word = lock_word(hnd);
+	int32_t current;
+
+	hnd->writeOwner = 0;
+
+	do
+	{
+		current = *word;
+
+		if (!(current & private_handle_t::LOCK_STATE_WRITE))
+		{
+			AERR("Unlocking handle %p which is not write locked (state 0x%x)", hnd, current);
+			return -EINVAL;
+		}
+	}
+	while (android_atomic_release_cas(current, current & ~private_handle_t::LOCK_STATE_WRITE, word));
+
+	return 0;
+}
+
+int gralloc_lock_state_acquire(private_handle_t *hnd, int usage)
+{
+	if (usage & GRALLOC_USAGE_SW_WRITE_MASK)
+	{
+		return gralloc_lock_state_write_acquire(hnd);
+	}
+
+	return gralloc_lock_state_read_acquire(hnd);
+}
+
+int gralloc_lock_state_release(private_handle_t *hnd)
+{
+	int32_t current = android_atomic_acquire_load(lock_word(hnd));
+
+	/*
+	 * While a writer is draining readers both WRITE and a non-zero count are
+	 * set, and the caller can only be one of those readers. Once the count is
+	 * zero the write bit belongs to the caller.
+	 */
+	if ((current & private_handle_t::LOCK_STATE_WRITE) &&
+	    (current & private_handle_t::LOCK_STATE_READ_MASK) == 0)
+	{
+		return gralloc_lock_state_write_release(hnd);
+	}
+
+	return gralloc_lock_state_read_release(hnd);
+}
+
+bool gralloc_lock_state_mark_mapped(private_handle_t *hnd)
+{
+	int32_t prev = android_atomic_or(private_handle_t::LOCK_STATE_MAPPED, lock_word(hnd));
+
+	return (prev & private_handle_t::LOCK_STATE_MAPPED) ? false : true;
+}
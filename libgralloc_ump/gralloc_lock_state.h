@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRALLOC_LOCK_STATE_H_
+#define GRALLOC_LOCK_STATE_H_
+
+#include "gralloc_priv.h"
+
+/*
+ * Lock-free transitions of private_handle_t::lockState.
+ *
+ * lockState packs LOCK_STATE_WRITE, LOCK_STATE_MAPPED and a 30 bit reader
+ * count, so every lock()/unlock() of a non-framebuffer buffer can be done
+ * with a compare-and-swap on that word instead of taking
+ * private_module_t::lock. Readers never block: they either bump the count or
+ * get -EBUSY while a writer owns the buffer. A writer first publishes
+ * LOCK_STATE_WRITE, which stops new readers, and then waits for the readers
+ * already inside to drain.
+ *
+ * Framebuffer handles still go through the module lock, since posting
+ * touches private_module_t state as well.
+ */
+
+/* true when lock()/unlock() of this handle must hold private_module_t::lock */
+inline bool gralloc_lock_state_needs_module_lock(const private_handle_t *hnd)
+{
+	return (hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER) ? true : false;
+}
+
+// Add a reader. Returns 0, or -EBUSY if a writer holds the buffer.
+int gralloc_lock_state_read_acquire(private_handle_t *hnd);
+
+// Drop a reader taken with gralloc_lock_state_read_acquire().
+int gralloc_lock_state_read_release(private_handle_t *hnd);
+
+// Take the write lock, waiting for current readers to leave.
+// Returns 0, or -EBUSY if another writer already holds the buffer or the
+// calling thread holds it for read.
+int gralloc_lock_state_write_acquire(private_handle_t *hnd);
+
+// Release the write lock taken with gralloc_lock_state_write_acquire().
+int gralloc_lock_state_write_release(private_handle_t *hnd);
+
+// Pick the read or write path from gralloc usage bits, as lock() does.
+int gralloc_lock_state_acquire(private_handle_t *hnd, int usage);
+
+// Undo gralloc_lock_state_acquire(), as unlock() does.
+int gralloc_lock_state_release(private_handle_t *hnd);
+
+// Set LOCK_STATE_MAPPED; returns true if this call made the transition.
+bool gralloc_lock_state_mark_mapped(private_handle_t *hnd);
+
+#endif /* GRALLOC_LOCK_STATE_H_ */
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stress test and benchmark of the lockState transitions.
+ *
+ *   gralloc_lock_state_test [seconds]
+ *
+ * The stress part runs readers and writers on a few handles. A writer
+ * fills a buffer with one value while it holds the write lock, and a
+ * reader checks it never sees two values at once. The benchmark counts
+ * read lock/unlock pairs per second on one shared handle, against the
+ * module mutex the lock() path used to take.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gralloc_lock_state.h"
+
+#define TEST_HANDLES        4
+#define TEST_READERS        6
+#define TEST_WRITERS        2
+#define TEST_WORDS          64
+#define BENCH_THREADS_MAX   8
+
+struct test_buffer
+{
+	private_handle_t *hnd;
+	volatile int words[TEST_WORDS];
+};
+
+static test_buffer buffers[TEST_HANDLES];
+static volatile int stop;
+static volatile int failures;
+static pthread_mutex_t module_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fail(const char *what, int hnd, int value)
+{
+	__sync_fetch_and_add(&failures, 1);
+	fprintf(stderr, "FAIL: %s on handle %d (%d)\n", what, hnd, value);
+}
+
+static void *reader(void *arg)
+{
+	unsigned seed = (unsigned)(long)arg;
+	long locked = 0, busy = 0;
+
+	while (!stop)
+	{
+		int i = rand_r(&seed) % TEST_HANDLES;
+		test_buffer *b = &buffers[i];
+		int ret = gralloc_lock_state_acquire(b->hnd, GRALLOC_USAGE_SW_READ_OFTEN);
+
+		if (ret == -EBUSY)
+		{
+			busy++;
+			continue;
+		}
+		else if (ret)
+		{
+			fail("read acquire", i, ret);
+			continue;
+		}
+
+		int first = b->words[0];
+
+		for (int w = 1; w < TEST_WORDS; w++)
+		{
+			if (b->words[w] != first)
+			{
+				fail("torn read", i, b->words[w] - first);
+				break;
+			}
+		}
+
+		if (gralloc_lock_state_release(b->hnd))
+		{
+			fail("read release", i, 0);
+		}
+
+		locked++;
+	}
+
+	printf("  reader: %ld locks, %ld refused\n", locked, busy);
+	return NULL;
+}
+
+static void *writer(void *arg)
+{
+	unsigned seed = (unsigned)(long)arg;
+	long locked = 0, busy = 0;
+
+	while (!stop)
+	{
+		int i = rand_r(&seed) % TEST_HANDLES;
+		test_buffer *b = &buffers[i];
+		int ret = gralloc_lock_state_acquire(b->hnd, GRALLOC_USAGE_SW_WRITE_OFTEN);
+
+		if (ret == -EBUSY)
+		{
+			busy++;
+			continue;
+		}
+		else if (ret)
+		{
+			fail("write acquire", i, ret);
+			continue;
+		}
+
+		int state = b->hnd->lockState;
+
+		if (state & private_handle_t::LOCK_STATE_READ_MASK)
+		{
+			fail("readers inside a write lock", i, state & private_handle_t::LOCK_STATE_READ_MASK);
+		}
+
+		int value = rand_r(&seed);
+
+		for (int w = 0; w < TEST_WORDS; w++)
+		{
+			b->words[w] = value;
+		}
+
+		if (gralloc_lock_state_release(b->hnd))
+		{
+			fail("write release", i, 0);
+		}
+
+		locked++;
+	}
+
+	printf("  writer: %ld locks, %ld refused\n", locked, busy);
+	return NULL;
+}
+
+/* a thread reading a buffer must not be able to wait for itself as a writer */
+static void test_self_upgrade(private_handle_t *hnd)
+{
+	int ret;
+
+	if (gralloc_lock_state_read_acquire(hnd))
+	{
+		fail("self upgrade: read acquire", 0, 0);
+		return;
+	}
+
+	ret = gralloc_lock_state_write_acquire(hnd);
+
+	if (ret != -EBUSY)
+	{
+		fail("self upgrade: write acquire under own read lock", 0, ret);
+	}
+
+	gralloc_lock_state_read_release(hnd);
+
+	ret = gralloc_lock_state_write_acquire(hnd);
+
+	if (ret)
+	{
+		fail("self upgrade: write acquire after read release", 0, ret);
+	}
+	else
+	{
+		gralloc_lock_state_write_release(hnd);
+	}
+
+	if (hnd->lockState)
+	{
+		fail("self upgrade: state left", 0, hnd->lockState);
+	}
+}
+
+static void stress(double seconds)
+{
+	pthread_t threads[TEST_READERS + TEST_WRITERS];
+	int n = 0;
+
+	printf("stress: %d readers, %d writers, %d handles, %.1f s\n",
+	       TEST_READERS, TEST_WRITERS, TEST_HANDLES, seconds);
+
+	stop = 0;
+
+	for (int i = 0; i < TEST_READERS; i++)
+	{
+		pthread_create(&threads[n++], NULL, reader, (void *)(long)(i + 1));
+	}
+
+	for (int i = 0; i < TEST_WRITERS; i++)
+	{
+		pthread_create(&threads[n++], NULL, writer, (void *)(long)(i + 100));
+	}
+
+	usleep((useconds_t)(seconds * 1e6));
+	stop = 1;
+
+	for (int i = 0; i < n; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	for (int i = 0; i < TEST_HANDLES; i++)
+	{
+		if (buffers[i].hnd->lockState)
+		{
+			fail("state left after stress", i, buffers[i].hnd->lockState);
+		}
+	}
+}
+
+struct bench_arg
+{
+	private_handle_t *hnd;
+	int mutex;
+	double seconds;
+	long pairs;
+};
+
+static void *bench_thread(void *arg)
+{
+	bench_arg *a = (bench_arg *)arg;
+	double end = now_s() + a->seconds;
+	long pairs = 0;
+
+	while (now_s() < end)
+	{
+		for (int i = 0; i < 1000; i++)
+		{
+			if (a->mutex)
+			{
+				pthread_mutex_lock(&module_lock);
+				a->hnd->lockState++;
+				pthread_mutex_unlock(&module_lock);
+				pthread_mutex_lock(&module_lock);
+				a->hnd->lockState--;
+				pthread_mutex_unlock(&module_lock);
+			}
+			else
+			{
+				gralloc_lock_state_acquire(a->hnd, GRALLOC_USAGE_SW_READ_OFTEN);
+				gralloc_lock_state_release(a->hnd);
+			}
+		}
+
+		pairs += 1000;
+	}
+
+	a->pairs = pairs;
+	return NULL;
+}
+
+static double bench(private_handle_t *hnd, int threads, int mutex, double seconds)
+{
+	pthread_t tid[BENCH_THREADS_MAX];
+	bench_arg args[BENCH_THREADS_MAX];
+	long pairs = 0;
+
+	for (int i = 0; i < threads; i++)
+	{
+		args[i].hnd = hnd;
+		args[i].mutex = mutex;
+		args[i].seconds = seconds;
+		args[i].pairs = 0;
+		pthread_create(&tid[i], NULL, bench_thread, &args[i]);
+	}
+
+	for (int i = 0; i < threads; i++)
+	{
+		pthread_join(tid[i], NULL);
+		pairs += args[i].pairs;
+	}
+
+	return pairs / seconds;
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+	private_handle_t bench_hnd(0, GRALLOC_USAGE_SW_READ_OFTEN, 4096, 0, 0, 0, 0);
+
+	if (seconds <= 0)
+	{
+		seconds = 2.0;
+	}
+
+	for (int i = 0; i < TEST_HANDLES; i++)
+	{
+		buffers[i].hnd = new private_handle_t(0, GRALLOC_USAGE_SW_READ_OFTEN, 4096, 0, 0, 0, 0);
+	}
+
+	test_self_upgrade(buffers[0].hnd);
+	stress(seconds);
+
+	printf("bench: read lock/unlock pairs per second\n");
+	printf("  threads       lockState    module mutex\n");
+
+	for (int threads = 1; threads <= BENCH_THREADS_MAX; threads *= 2)
+	{
+		double cas = bench(&bench_hnd, threads, 0, seconds / 4);
+		double mutex = bench(&bench_hnd, threads, 1, seconds / 4);
+
+		printf("  %7d %15.0f %15.0f\n", threads, cas, mutex);
+	}
+
+	for (int i = 0; i < TEST_HANDLES; i++)
+	{
+		delete buffers[i].hnd;
+	}
+
+	printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+	return failures ? 1 : 0;
+}
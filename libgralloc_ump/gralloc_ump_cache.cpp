@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/Log.h>
+
+#include "gralloc_ump_cache.h"
+#include "alloc_device.h"
+
+/* must be a power of two */
+#define UMP_CACHE_BUCKETS   64
+
+struct ump_cache_entry
+{
+	ump_secure_id id;
+	ump_handle handle;
+	void *vaddr;
+	unsigned long size;
+	int refs;
+
+	ump_cache_entry *hash_next;
+	/* idle (refs == 0) entries only, most recently used at the head */
+	ump_cache_entry *lru_prev;
+	ump_cache_entry *lru_next;
+};
+
+static void ump_cache_default_reference_release(ump_handle mem)
+{
+	ump_reference_release(mem);
+}
+
+static const gralloc_ump_ops ump_default_ops =
+{
+	ump_handle_create_from_secure_id,
+	ump_size_get,
+	ump_mapped_pointer_get,
+	ump_mapped_pointer_release,
+	ump_cache_default_reference_release,
+	ump_secure_id_get,
+};
+
+static pthread_mutex_t ump_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static const gralloc_ump_ops *ump_ops = &ump_default_ops;
+static ump_cache_entry *ump_cache_buckets[UMP_CACHE_BUCKETS];
+static ump_cache_entry *ump_cache_lru_head;
+static ump_cache_entry *ump_cache_lru_tail;
+
+/*
+ * Stale entries are out of the hash table, so a later map() of the same id
+ * creates a fresh mapping. They are kept on a side list until the users that
+ * still hold them are done.
+ */
+static ump_cache_entry *ump_cache_stale_list;
+static gralloc_ump_cache_stats ump_cache_stats = { 0, 0, 0, 0, 0, 0, 0, GRALLOC_UMP_CACHE_DEFAULT_BUDGET };
+
+static inline unsigned int ump_cache_bucket(ump_secure_id id)
+{
+	/* secure ids are small sequential integers, spread them a little */
+	return ((id * 2654435761u) >> 26) & (UMP_CACHE_BUCKETS - 1);
+}
+
+static ump_cache_entry *ump_cache_find_locked(ump_secure_id id)
+{
+	ump_cache_entry *e = ump_cache_buckets[ump_cache_bucket(id)];
+
+	while (e && e->id != id)
+	{
+		e = e->hash_next;
+	}
+
+	return e;
+}
+
+static void ump_cache_hash_remove_locked(ump_cache_entry *e)
+{
+	ump_cache_entry **pp = &ump_cache_buckets[ump_cache_bucket(e->id)];
+
+	while (*pp && *pp != e)
+	{
+		pp = &(*pp)->hash_next;
+	}
+
+	if (*pp)
+	{
+		*pp = e->hash_next;
+	}
+
+	e->hash_next = NULL;
+}
+
+static void ump_cache_lru_remove_locked(ump_cache_entry *e)
+{
+	if (e->lru_prev)
+	{
+		e->lru_prev->lru_next = e->lru_next;
+	}
+	else
+	{
+		ump_cache_lru_head = e->lru_next;
+	}
+
+	if (e->lru_next)
+	{
+		e->lru_next->lru_prev = e->lru_prev;
+	}
+	else
+	{
+		ump_cache_lru_tail = e->lru_prev;
+	}
+
+	e->lru_prev = e->lru_next = NULL;
+	ump_cache_stats.idle_entries--;
+}
+
+static void ump_cache_lru_push_locked(ump_cache_entry *e)
+{
+	e->lru_prev = NULL;
+	e->lru_next = ump_cache_lru_head;
+
+	if (ump_cache_lru_head)
+	{
+		ump_cache_lru_head->lru_prev = e;
+	}
+	else
+	{
+		ump_cache_lru_tail = e;
+	}
+
+	ump_cache_lru_head = e;
+	ump_cache_stats.idle_entries++;
+}
+
+/* e must already be out of the hash table and the LRU list */
+static void ump_cache_destroy_locked(ump_cache_entry *e)
+{
+	ump_ops->mapped_pointer_release(e->handle);
+	ump_ops->reference_release(e->handle);
+
+	ump_cache_stats.unmaps++;
+	ump_cache_stats.entries--;
+	ump_cache_stats.mapped_bytes -= e->size;
+	free(e);
+}
+
+static void ump_cache_evict_locked(size_t budget)
+{
+	while (ump_cache_stats.mapped_bytes > budget && ump_cache_lru_tail)
+	{
+		ump_cache_entry *e = ump_cache_lru_tail;
+
+		ump_cache_lru_remove_locked(e);
+		ump_cache_hash_remove_locked(e);
+		ump_cache_destroy_locked(e);
+	}
+}
+
+void *gralloc_ump_cache_map(ump_secure_id secure_id, ump_handle *handle)
+{
+	ump_cache_entry *e;
+	void *vaddr = NULL;
+
+	if (secure_id == UMP_INVALID_SECURE_ID)
+	{
+		return NULL;
+	}
+
+	pthread_mutex_lock(&ump_cache_lock);
+
+	e = ump_cache_find_locked(secure_id);
+
+	if (e)
+	{
+		if (e->refs++ == 0)
+		{
+			ump_cache_lru_remove_locked(e);
+		}
+
+		ump_cache_stats.hits++;
+		vaddr = e->vaddr;
+
+		if (handle)
+		{
+			*handle = e->handle;
+		}
+
+		pthread_mutex_unlock(&ump_cache_lock);
+		return vaddr;
+	}
+
+	ump_cache_stats.misses++;
+
+	ump_handle h = ump_ops->handle_create_from_secure_id(secure_id);
+
+	if (h == UMP_INVALID_MEMORY_HANDLE)
+	{
+		AERR("Failed to import UMP secure id %u", secure_id);
+		pthread_mutex_unlock(&ump_cache_lock);
+		return NULL;
+	}
+
+	vaddr = ump_ops->mapped_pointer_get(h);
+
+	if (vaddr == NULL)
+	{
+		AERR("Failed to map UMP secure id %u", secure_id);
+		ump_ops->reference_release(h);
+		pthread_mutex_unlock(&ump_cache_lock);
+		return NULL;
+	}
+
+	e = (ump_cache_entry *)calloc(1, sizeof(*e));
+
+	if (e == NULL)
+	{
+		ump_ops->mapped_pointer_release(h);
+		ump_ops->reference_release(h);
+		pthread_mutex_unlock(&ump_cache_lock);
+		return NULL;
+	}
+
+	e->id = secure_id;
+	e->handle = h;
+	e->vaddr = vaddr;
+	e->size = ump_ops->size_get(h);
+	e->refs = 1;
+
+	unsigned int bucket = ump_cache_bucket(secure_id);
+	e->hash_next = ump_cache_buckets[bucket];
+	ump_cache_buckets[bucket] = e;
+
+	ump_cache_stats.maps++;
+	ump_cache_stats.entries++;
+	ump_cache_stats.mapped_bytes += e->size;
+
+	/* make room for the new mapping from the idle entries */
+	ump_cache_evict_locked(ump_cache_stats.budget);
+
+	if (handle)
+	{
+		*handle = h;
+	}
+
+	pthread_mutex_unlock(&ump_cache_lock);
+	return vaddr;
+}
+
+int gralloc_ump_cache_unmap(ump_secure_id secure_id, ump_handle handle)
+{
+	pthread_mutex_lock(&ump_cache_lock);
+
+	ump_cache_entry *e = ump_cache_find_locked(secure_id);
+
+	if (e && e->handle == handle && e->refs > 0)
+	{
+		if (--e->refs == 0)
+		{
+			ump_cache_lru_push_locked(e);
+			ump_cache_evict_locked(ump_cache_stats.budget);
+		}
+
+		pthread_mutex_unlock(&ump_cache_lock);
+		return 0;
+	}
+
+	/* the mapping may have been invalidated while it was in use */
+	ump_cache_entry **link = &ump_cache_stale_list;
+
+	while (*link && (*link)->handle != handle)
+	{
+		link = &(*link)->hash_next;
+	}
+
+	e = *link;
+
+	if (e == NULL)
+	{
+		pthread_mutex_unlock(&ump_cache_lock);
+		AERR("Unmapping UMP secure id %u which is not mapped", secure_id);
+		return -EINVAL;
+	}
+
+	if (--e->refs == 0)
+	{
+		*link = e->hash_next;
+		e->hash_next = NULL;
+		ump_cache_destroy_locked(e);
+	}
+
+	pthread_mutex_unlock(&ump_cache_lock);
+	return 0;
+}
+
+static void ump_cache_invalidate_locked(ump_cache_entry *e)
+{
+	ump_cache_hash_remove_locked(e);
+
+	if (e->refs == 0)
+	{
+		ump_cache_lru_remove_locked(e);
+		ump_cache_destroy_locked(e);
+		return;
+	}
+
+	e->hash_next = ump_cache_stale_list;
+	ump_cache_stale_list = e;
+}
+
+void gralloc_ump_cache_invalidate(ump_secure_id secure_id)
+{
+	pthread_mutex_lock(&ump_cache_lock);
+
+	ump_cache_entry *e = ump_cache_find_locked(secure_id);
+
+	if (e)
+	{
+		ump_cache_invalidate_locked(e);
+	}
+
+	pthread_mutex_unlock(&ump_cache_lock);
+}
+
+void gralloc_ump_cache_reference_release(ump_handle handle)
+{
+	ump_secure_id id = ump_ops->secure_id_get(handle);
+	bool owned = false;
+
+	pthread_mutex_lock(&ump_cache_lock);
+
+	ump_cache_entry *e = ump_cache_find_locked(id);
+
+	if (e)
+	{
+		/* the cache owns the reference on its own handle */
+		owned = (e->handle == handle);
+		ump_cache_invalidate_locked(e);
+	}
+
+	pthread_mutex_unlock(&ump_cache_lock);
+
+	if (!owned)
+	{
+		ump_ops->reference_release(handle);
+	}
+}
+
+void gralloc_ump_cache_set_budget(size_t bytes)
+{
+	pthread_mutex_lock(&ump_cache_lock);
+	ump_cache_stats.budget = bytes;
+	ump_cache_evict_locked(bytes);
+	pthread_mutex_unlock(&ump_cache_lock);
+}
+
+void gralloc_ump_cache_trim(void)
+{
+	pthread_mutex_lock(&ump_cache_lock);
+	ump_cache_evict_locked(0);
+	pthread_mutex_unlock(&ump_cache_lock);
+}
+
+void gralloc_ump_cache_get_stats(gralloc_ump_cache_stats *stats)
+{
+	pthread_mutex_lock(&ump_cache_lock);
+	*stats = ump_cache_stats;
+	pthread_mutex_unlock(&ump_cache_lock);
+}
+
+void gralloc_ump_cache_set_ops(const gralloc_ump_ops *ops)
+{
+	pthread_mutex_lock(&ump_cache_lock);
+
+	if (ump_cache_stats.entries)
+	{
+		AWAR("Replacing UMP ops with %u live mappings", ump_cache_stats.entries);
+	}
+
+	ump_ops = ops ? ops : &ump_default_ops;
+	pthread_mutex_unlock(&ump_cache_lock);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRALLOC_UMP_CACHE_H_
+#define GRALLOC_UMP_CACHE_H_
+
+#include <stddef.h>
+
+#include "ump/include/ump/ump.h"
+
+/*
+ * Process-wide cache of UMP mappings keyed by ump_secure_id.
+ *
+ * registerBuffer()/lock() used to do ump_handle_create_from_secure_id() +
+ * ump_mapped_pointer_get() for every import, so hwcomposer and mediaserver
+ * remapped the same video buffers each frame. Entries are reference counted;
+ * once the last user drops a mapping it is parked on an LRU list and only
+ * unmapped when the total mapped size goes over the address-space budget,
+ * or when the buffer is invalidated because its UMP reference was released.
+ */
+
+#define GRALLOC_UMP_CACHE_DEFAULT_BUDGET    (128 * 1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* UMP entry points used by the cache, replaceable to count map/unmap calls */
+struct gralloc_ump_ops
+{
+	ump_handle (*handle_create_from_secure_id)(ump_secure_id secure_id);
+	unsigned long (*size_get)(ump_handle mem);
+	void *(*mapped_pointer_get)(ump_handle mem);
+	void (*mapped_pointer_release)(ump_handle mem);
+	void (*reference_release)(ump_handle mem);
+	ump_secure_id (*secure_id_get)(ump_handle mem);
+};
+
+struct gralloc_ump_cache_stats
+{
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int maps;
+	unsigned int unmaps;
+	unsigned int entries;
+	unsigned int idle_entries;
+	size_t mapped_bytes;
+	size_t budget;
+};
+
+// Map secure_id, reusing a cached mapping when there is one.
+// Returns the CPU address and the UMP handle, or NULL on failure.
+void *gralloc_ump_cache_map(ump_secure_id secure_id, ump_handle *handle);
+
+// Drop one reference taken with gralloc_ump_cache_map(); handle is the one
+// map() returned, which tells a live mapping from an invalidated one.
+int gralloc_ump_cache_unmap(ump_secure_id secure_id, ump_handle handle);
+
+// Forget secure_id: unmap now if idle, otherwise after its last unmap.
+void gralloc_ump_cache_invalidate(ump_secure_id secure_id);
+
+// ump_reference_release() for a handle that may be cached.
+void gralloc_ump_cache_reference_release(ump_handle handle);
+
+// Change the address-space budget, evicting idle mappings to fit.
+void gralloc_ump_cache_set_budget(size_t bytes);
+
+// Unmap every idle entry.
+void gralloc_ump_cache_trim(void);
+
+void gralloc_ump_cache_get_stats(struct gralloc_ump_cache_stats *stats);
+
+// Install UMP entry points; NULL restores the real library. Only call
+// while the cache is empty.
+void gralloc_ump_cache_set_ops(const struct gralloc_ump_ops *ops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GRALLOC_UMP_CACHE_H_ */
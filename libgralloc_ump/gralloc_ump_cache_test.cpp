@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test of the UMP mapping cache on a fake UMP layer.
+ *
+ *   gralloc_ump_cache_test
+ *
+ * The fake gralloc_ump_ops hand out a handle per import and count imports,
+ * maps, unmaps and reference releases, so the test can tell a cache hit
+ * from a remap, see which buffer LRU eviction picked, and check that every
+ * handle is released in the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gralloc_ump_cache.h"
+
+#define FAKE_BUFFER_SIZE    (1024 * 1024)
+#define FAKE_HANDLES_MAX    64
+
+struct fake_handle
+{
+	ump_secure_id id;
+	int mapped;
+	int released;
+	char mem[16];
+};
+
+static fake_handle fake_handles[FAKE_HANDLES_MAX];
+static int fake_created;
+static int fake_maps;
+static int fake_unmaps;
+static int fake_releases;
+static ump_secure_id fake_last_unmapped;
+static int failures;
+
+static ump_handle fake_create(ump_secure_id id)
+{
+	if (fake_created == FAKE_HANDLES_MAX)
+	{
+		return UMP_INVALID_MEMORY_HANDLE;
+	}
+
+	fake_handle *h = &fake_handles[fake_created++];
+
+	h->id = id;
+	return (ump_handle)h;
+}
+
+static unsigned long fake_size_get(ump_handle mem)
+{
+	(void)mem;
+	return FAKE_BUFFER_SIZE;
+}
+
+static void *fake_mapped_pointer_get(ump_handle mem)
+{
+	fake_handle *h = (fake_handle *)mem;
+
+	h->mapped++;
+	fake_maps++;
+	return h->mem;
+}
+
+static void fake_mapped_pointer_release(ump_handle mem)
+{
+	fake_handle *h = (fake_handle *)mem;
+
+	h->mapped--;
+	fake_unmaps++;
+	fake_last_unmapped = h->id;
+}
+
+static void fake_reference_release(ump_handle mem)
+{
+	fake_handle *h = (fake_handle *)mem;
+
+	h->released++;
+	fake_releases++;
+}
+
+static ump_secure_id fake_secure_id_get(ump_handle mem)
+{
+	return ((fake_handle *)mem)->id;
+}
+
+static const gralloc_ump_ops fake_ops =
+{
+	fake_create,
+	fake_size_get,
+	fake_mapped_pointer_get,
+	fake_mapped_pointer_release,
+	fake_reference_release,
+	fake_secure_id_get,
+};
+
+static void expect(int ok, const char *what)
+{
+	if (!ok)
+	{
+		failures++;
+		fprintf(stderr, "FAIL: %s\n", what);
+	}
+}
+
+static void expect_eq(const char *what, long got, long want)
+{
+	if (got != want)
+	{
+		failures++;
+		fprintf(stderr, "FAIL: %s: %ld, expected %ld\n", what, got, want);
+	}
+}
+
+/* a second map of a live or idle buffer reuses the mapping */
+static void test_hit(void)
+{
+	ump_handle h1, h2, h3;
+	void *p1 = gralloc_ump_cache_map(1, &h1);
+	void *p2 = gralloc_ump_cache_map(1, &h2);
+
+	expect_eq("hit: maps", fake_maps, 1);
+	expect(p1 != NULL && p1 == p2 && h1 == h2, "hit: same mapping");
+
+	gralloc_ump_cache_unmap(1, h1);
+	gralloc_ump_cache_unmap(1, h2);
+	expect_eq("hit: idle entry stays mapped", fake_unmaps, 0);
+
+	gralloc_ump_cache_map(1, &h3);
+	expect_eq("hit: idle entry reused", fake_maps, 1);
+	gralloc_ump_cache_unmap(1, h3);
+
+	gralloc_ump_cache_stats stats;
+
+	gralloc_ump_cache_get_stats(&stats);
+	expect_eq("hit: hits", stats.hits, 2);
+	expect_eq("hit: misses", stats.misses, 1);
+	expect_eq("hit: idle entries", stats.idle_entries, 1);
+}
+
+/* over the budget the least recently used idle buffer is unmapped */
+static void test_lru(void)
+{
+	ump_handle h;
+
+	gralloc_ump_cache_trim();
+	gralloc_ump_cache_set_budget(3 * FAKE_BUFFER_SIZE);
+
+	for (ump_secure_id id = 10; id < 13; id++)
+	{
+		gralloc_ump_cache_map(id, &h);
+		gralloc_ump_cache_unmap(id, h);
+	}
+
+	/* 10 becomes the most recently used, 11 the oldest */
+	gralloc_ump_cache_map(10, &h);
+	gralloc_ump_cache_unmap(10, h);
+
+	int unmaps = fake_unmaps;
+
+	gralloc_ump_cache_map(13, &h);
+	expect_eq("lru: one eviction", fake_unmaps - unmaps, 1);
+	expect_eq("lru: oldest evicted", fake_last_unmapped, 11);
+
+	/* a buffer in use is never evicted, even over the budget */
+	gralloc_ump_cache_set_budget(0);
+	expect_eq("lru: busy entry kept", fake_handles[fake_created - 1].mapped, 1);
+	gralloc_ump_cache_unmap(13, h);
+	expect_eq("lru: evicted once idle", fake_handles[fake_created - 1].mapped, 0);
+
+	gralloc_ump_cache_stats stats;
+
+	gralloc_ump_cache_get_stats(&stats);
+	expect_eq("lru: nothing left mapped", stats.mapped_bytes, 0);
+	gralloc_ump_cache_set_budget(GRALLOC_UMP_CACHE_DEFAULT_BUDGET);
+}
+
+/* releasing the UMP reference drops the cached mapping */
+static void test_reference_release(void)
+{
+	ump_handle h, h2;
+
+	/* released while mapped: unmapped by the last unmap, not before */
+	gralloc_ump_cache_map(20, &h);
+	int unmaps = fake_unmaps;
+
+	gralloc_ump_cache_reference_release(h);
+	expect_eq("release: busy mapping kept", fake_unmaps - unmaps, 0);
+	expect_eq("release: unmap of the stale mapping", gralloc_ump_cache_unmap(20, h), 0);
+	expect_eq("release: stale mapping unmapped", fake_unmaps - unmaps, 1);
+
+	/* the next map of the id is a fresh import */
+	int maps = fake_maps;
+
+	gralloc_ump_cache_map(20, &h2);
+	expect_eq("release: remapped", fake_maps - maps, 1);
+	expect(h2 != h, "release: new handle");
+	gralloc_ump_cache_unmap(20, h2);
+
+	/* a handle the cache does not own is released, and the idle entry goes */
+	fake_handle *other = (fake_handle *)fake_create(20);
+
+	unmaps = fake_unmaps;
+	gralloc_ump_cache_reference_release((ump_handle)other);
+	expect_eq("release: foreign handle released", other->released, 1);
+	expect_eq("release: idle mapping dropped", fake_unmaps - unmaps, 1);
+}
+
+int main(void)
+{
+	gralloc_ump_cache_set_ops(&fake_ops);
+
+	test_hit();
+	test_lru();
+	test_reference_release();
+
+	gralloc_ump_cache_trim();
+
+	for (int i = 0; i < fake_created; i++)
+	{
+		expect_eq("every handle unmapped", fake_handles[i].mapped, 0);
+		expect_eq("every handle released once", fake_handles[i].released, 1);
+	}
+
+	gralloc_ump_cache_set_ops(NULL);
+
+	printf("%d imports, %d maps, %d unmaps, %d releases\n",
+	       fake_created, fake_maps, fake_unmaps, fake_releases);
+	printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+# Copyright (C) 2014 Rockchip Electronics Co., Ltd.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+LOCAL_PATH := $(call my-dir)
+
+# User space helpers layered on top of libvpu / libon2.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_mem_pool.c \
+				vpu_mem_range.c \
+				vpu_api_pipeline.c \
+				vpu_sched.c \
+				vpu_dec_pp.c \
+				vpu_enc_input.c \
+				vpu_enc_ring.c \
+				vpu_enc_rc.c \
+				vpu_frame_pool.c \
+				vpu_dec_seek.c \
+				vpu_ctx_pool.c \
+				vpu_hw_caps.c \
+				vpu_reg_batch.c
+
+# SetDecRegister, the register field names and the DWL configuration come with the Hantro decoder in jpeghw
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../jpeghw/src_dec/common \
+				$(LOCAL_PATH)/../jpeghw/src_dec/inc \
+				$(LOCAL_PATH)/../libgralloc_ump
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libvpu libjpeghwdec libUMP
+LOCAL_STATIC_LIBRARIES := libgralloc_priv
+LOCAL_MODULE := libvpu_helper
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_STATIC_LIBRARY)
+
+# Scheduler fairness and tail latency on the simulated service, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_sched.c \
+				vpu_sched_bench.c
+
+LOCAL_CFLAGS := -DVPU_SCHED_BENCH_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := vpu_sched_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Encoder output ring throughput with the stand-in encoder, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_enc_ring.c \
+				vpu_enc_ring_bench.c
+
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := vpu_enc_ring_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Slab pool test on the malloc stand-in, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_mem_pool.c \
+				vpu_mem_pool_test.c
+
+LOCAL_CFLAGS := -DVPU_MEM_POOL_TEST_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := vpu_mem_pool_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Pipelined decode front end on a fake codec context, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_api_pipeline.c \
+				vpu_api_pipeline_test.c
+
+LOCAL_CFLAGS := -DVPU_API_PIPELINE_TEST_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := vpu_api_pipeline_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Frame pool refcounting, exhaustion and threads on the malloc stand-in, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_mem_pool.c \
+				vpu_frame_pool.c \
+				vpu_frame_pool_test.c
+
+LOCAL_CFLAGS := -DVPU_FRAME_POOL_TEST_HOST
+LOCAL_STATIC_LIBRARIES := libcutils
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := vpu_frame_pool_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Seek and trick play filter on a fake decoder, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_dec_seek.c \
+				vpu_dec_seek_test.c
+
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := vpu_dec_seek_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Warm context pool reuse and eviction on a fake context backend, runs on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+				vpu_ctx_pool.c \
+				vpu_ctx_pool_test.c
+
+LOCAL_CFLAGS := -DVPU_CTX_POOL_TEST_HOST
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := vpu_ctx_pool_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,638 @@
+/***************************************************************************************************
+    File:
+        vpu_api_pipeline.c
+    Description:
+        Pipelined decode front end for VpuCodecContext
+ **************************************************************************************************/
+#define LOG_TAG "vpu_api_pipeline"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <cutils/log.h>
+
+#include "vpu_mem.h"
+#include "vpu_api_pipeline.h"
+
+#define PIPE_DEFAULT_IN_DEPTH       4
+#define PIPE_DEFAULT_OUT_DEPTH      4
+/* split interface: times a packet the codec did not take is offered again */
+#define PIPE_SEND_RETRY             100
+#define PIPE_SEND_RETRY_US          1000
+/* frames asked for at end of stream, more than any DPB holds */
+#define PIPE_DRAIN_MAX              32
+/* OMX_BUFFERFLAG_EOS, how the OMX component marks the last packet */
+#define PIPE_PKT_FLAG_EOS           0x1
+
+typedef struct {
+    VideoPacket_t   pkt;
+    RK_U8           *buf;
+    RK_U32          cap;
+    RK_U32          eos;
+} PipePacket_t;
+
+typedef struct {
+    DecoderOut_t    out;
+    RK_U8           *buf;
+} PipeFrame_t;
+
+struct VpuDecPipeline {
+    VpuCodecContext_t       *ctx;
+    VpuDecPipelineCfg_t     cfg;
+
+    pthread_t               thread;
+    pthread_mutex_t         lock;
+    pthread_cond_t          inNotEmpty;
+    pthread_cond_t          inNotFull;
+    pthread_cond_t          outNotEmpty;
+    pthread_cond_t          outNotFull;
+    pthread_cond_t          idle;
+    RK_U32                  running;
+    RK_U32                  busy;           /* feeder is inside the codec */
+    RK_U32                  gen;            /* bumped by flush, stale frames are dropped */
+    RK_U32                  eosReached;
+
+    PipePacket_t            *in;
+    RK_U32                  inHead;
+    RK_U32                  inCount;
+    PipePacket_t            work;           /* packet the feeder is decoding */
+
+    PipeFrame_t             *reorder;       /* sorted by timeUs */
+    RK_U32                  reorderCount;
+    PipeFrame_t             *out;
+    RK_U32                  outHead;
+    RK_U32                  outCount;
+    RK_U8                   *scratch;       /* decode_getframe target */
+
+    VpuDecPipelineStats_t   stats;
+};
+
+static RK_S64 pipe_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* wait on cond, returns ETIMEDOUT once the deadline has passed */
+static int pipe_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline)
+{
+    if (deadline == NULL)
+        return pthread_cond_wait(cond, lock);
+    return pthread_cond_timedwait(cond, lock, deadline);
+}
+
+static struct timespec *pipe_deadline(struct timespec *ts, RK_S32 timeoutMs)
+{
+    if (timeoutMs < 0)
+        return NULL;
+
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += timeoutMs / 1000;
+    ts->tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static RK_S32 pipe_packet_store(PipePacket_t *slot, const VideoPacket_t *pkt)
+{
+    if (pkt->size > 0 && (RK_U32)pkt->size > slot->cap) {
+        RK_U8 *buf = (RK_U8 *)realloc(slot->buf, pkt->size);
+        if (buf == NULL)
+            return VPU_DEC_PIPE_ERROR;
+        slot->buf = buf;
+        slot->cap = pkt->size;
+    }
+
+    slot->pkt = *pkt;
+    slot->pkt.data = slot->buf;
+    if (pkt->size > 0)
+        memcpy(slot->buf, pkt->data, pkt->size);
+    slot->eos = 0;
+    return VPU_DEC_PIPE_OK;
+}
+
+static void pipe_frame_copy(VpuDecPipeline_t *pipe, PipeFrame_t *dst, const DecoderOut_t *src,
+                            const RK_U8 *data)
+{
+    dst->out = *src;
+    dst->out.data = dst->buf;
+    memcpy(dst->buf, data, pipe->cfg.frameDataSize);
+}
+
+/*
+ * A decoded frame that will not reach the caller gives its VPU buffer back.
+ * Only VPU_FRAME data carries one.
+ */
+static void pipe_frame_release(VpuDecPipeline_t *pipe, RK_U8 *data)
+{
+    VPU_FRAME *frame = (VPU_FRAME *)data;
+
+    if (pipe->cfg.frameDataSize == sizeof(VPU_FRAME) && frame->vpumem.phy_addr) {
+        VPUFreeLinear(&frame->vpumem);
+        memset(&frame->vpumem, 0, sizeof(frame->vpumem));
+    }
+    pipe->stats.framesDropped++;
+}
+
+/* drop the frames waiting for reorder or for the caller, lock held */
+static void pipe_drop_queued_locked(VpuDecPipeline_t *pipe)
+{
+    RK_U32 i;
+
+    for (i = 0; i < pipe->reorderCount; i++)
+        pipe_frame_release(pipe, pipe->reorder[i].buf);
+    for (i = 0; i < pipe->outCount; i++)
+        pipe_frame_release(pipe, pipe->out[(pipe->outHead + i) % pipe->cfg.outQueueDepth].buf);
+
+    pipe->reorderCount = 0;
+    pipe->outHead = 0;
+    pipe->outCount = 0;
+}
+
+/* move the earliest reordered frame to the output queue, lock held */
+static RK_S32 pipe_emit_locked(VpuDecPipeline_t *pipe, RK_U32 gen)
+{
+    PipeFrame_t *slot;
+    PipeFrame_t tmp;
+    RK_S64 t0 = 0;
+
+    while (pipe->running && pipe->gen == gen && pipe->outCount == pipe->cfg.outQueueDepth) {
+        if (!t0) {
+            pipe->stats.feederBlocked++;
+            t0 = pipe_now_us();
+        }
+        pthread_cond_wait(&pipe->outNotFull, &pipe->lock);
+    }
+    if (t0)
+        pipe->stats.feederWaitUs += pipe_now_us() - t0;
+
+    if (!pipe->running || pipe->gen != gen)
+        return VPU_DEC_PIPE_ERROR;
+
+    slot = &pipe->out[(pipe->outHead + pipe->outCount) % pipe->cfg.outQueueDepth];
+
+    /* swap buffers instead of copying the frame data */
+    tmp = *slot;
+    *slot = pipe->reorder[0];
+    memmove(&pipe->reorder[0], &pipe->reorder[1], (pipe->reorderCount - 1) * sizeof(PipeFrame_t));
+    pipe->reorder[pipe->reorderCount - 1] = tmp;
+    pipe->reorderCount--;
+
+    pipe->outCount++;
+    if (pipe->outCount > pipe->stats.outQueuePeak)
+        pipe->stats.outQueuePeak = pipe->outCount;
+    pthread_cond_signal(&pipe->outNotEmpty);
+    return VPU_DEC_PIPE_OK;
+}
+
+static void pipe_push_frame_locked(VpuDecPipeline_t *pipe, const DecoderOut_t *frame, RK_U32 gen)
+{
+    RK_U32 pos;
+    PipeFrame_t tmp;
+
+    if (pipe->gen != gen) {
+        pipe_frame_release(pipe, frame->data);
+        return;
+    }
+
+    /* insertion sort on timeUs, frames without pts keep decode order */
+    pos = pipe->reorderCount;
+    if (frame->timeUs != (RK_S64)VPU_API_NOPTS_VALUE) {
+        while (pos > 0 && pipe->reorder[pos - 1].out.timeUs != (RK_S64)VPU_API_NOPTS_VALUE &&
+               pipe->reorder[pos - 1].out.timeUs > frame->timeUs)
+            pos--;
+    }
+
+    tmp = pipe->reorder[pipe->reorderCount];
+    memmove(&pipe->reorder[pos + 1], &pipe->reorder[pos],
+            (pipe->reorderCount - pos) * sizeof(PipeFrame_t));
+    pipe->reorder[pos] = tmp;
+    pipe_frame_copy(pipe, &pipe->reorder[pos], frame, frame->data);
+    pipe->reorderCount++;
+
+    while (pipe->reorderCount > pipe->cfg.reorderDepth) {
+        if (pipe_emit_locked(pipe, gen) != VPU_DEC_PIPE_OK) {
+            RK_U32 i;
+
+            for (i = 0; i < pipe->reorderCount; i++)
+                pipe_frame_release(pipe, pipe->reorder[i].buf);
+            pipe->reorderCount = 0;
+            break;
+        }
+    }
+}
+
+static void pipe_decode(VpuDecPipeline_t *pipe, VideoPacket_t *pkt, RK_U32 gen)
+{
+    VpuCodecContext_t *ctx = pipe->ctx;
+    DecoderOut_t frame;
+    RK_S32 retry = 0;
+    RK_S32 ret;
+
+    if (ctx->decode_sendstream == NULL || ctx->decode_getframe == NULL) {
+        do {
+            memset(&frame, 0, sizeof(frame));
+            frame.data = pipe->scratch;
+            ret = ctx->decode(ctx, pkt, &frame);
+            if (ret) {
+                pthread_mutex_lock(&pipe->lock);
+                pipe->stats.decodeErrors++;
+                pthread_mutex_unlock(&pipe->lock);
+                return;
+            }
+            if (frame.size) {
+                pthread_mutex_lock(&pipe->lock);
+                pipe_push_frame_locked(pipe, &frame, gen);
+                pthread_mutex_unlock(&pipe->lock);
+            }
+        } while (pkt->size > 0 && frame.size && ++retry < PIPE_SEND_RETRY);
+        return;
+    }
+
+    /*
+     * decode_sendstream clears pkt->size once it has taken the packet; a
+     * packet it could not queue yet is offered again after draining frames.
+     */
+    for (;;) {
+        ret = ctx->decode_sendstream(ctx, pkt);
+        if (ret) {
+            pthread_mutex_lock(&pipe->lock);
+            pipe->stats.decodeErrors++;
+            pthread_mutex_unlock(&pipe->lock);
+            break;
+        }
+
+        for (;;) {
+            memset(&frame, 0, sizeof(frame));
+            frame.data = pipe->scratch;
+            if (ctx->decode_getframe(ctx, &frame) || !frame.size)
+                break;
+            pthread_mutex_lock(&pipe->lock);
+            pipe_push_frame_locked(pipe, &frame, gen);
+            pthread_mutex_unlock(&pipe->lock);
+        }
+
+        if (pkt->size <= 0)
+            break;
+
+        if (++retry >= PIPE_SEND_RETRY) {
+            ALOGE("codec did not take a %d byte packet, dropped", pkt->size);
+            pthread_mutex_lock(&pipe->lock);
+            pipe->stats.decodeErrors++;
+            pthread_mutex_unlock(&pipe->lock);
+            break;
+        }
+        usleep(PIPE_SEND_RETRY_US);
+    }
+}
+
+/* take the frames still in the decoder's DPB with an empty end of stream packet */
+static void pipe_drain(VpuDecPipeline_t *pipe, RK_U32 gen)
+{
+    VpuCodecContext_t *ctx = pipe->ctx;
+    RK_U32 split = ctx->decode_sendstream != NULL && ctx->decode_getframe != NULL;
+    VideoPacket_t pkt;
+    DecoderOut_t frame;
+    RK_S32 i;
+
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.pts = VPU_API_NOPTS_VALUE;
+    pkt.dts = VPU_API_NOPTS_VALUE;
+    pkt.nFlags = PIPE_PKT_FLAG_EOS;
+
+    if (split && ctx->decode_sendstream(ctx, &pkt)) {
+        pthread_mutex_lock(&pipe->lock);
+        pipe->stats.decodeErrors++;
+        pthread_mutex_unlock(&pipe->lock);
+        return;
+    }
+
+    for (i = 0; i < PIPE_DRAIN_MAX; i++) {
+        memset(&frame, 0, sizeof(frame));
+        frame.data = pipe->scratch;
+        if (split ? ctx->decode_getframe(ctx, &frame) : ctx->decode(ctx, &pkt, &frame))
+            break;
+        if (!frame.size)
+            break;
+        pthread_mutex_lock(&pipe->lock);
+        pipe_push_frame_locked(pipe, &frame, gen);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+}
+
+static void *pipe_feeder(void *arg)
+{
+    VpuDecPipeline_t *pipe = (VpuDecPipeline_t *)arg;
+    PipePacket_t tmp;
+    RK_U32 gen;
+
+    prctl(PR_SET_NAME, (unsigned long)"vpu_dec_feeder", 0, 0, 0);
+
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->running) {
+        if (!pipe->inCount) {
+            pipe->stats.feederStarved++;
+            while (pipe->running && !pipe->inCount)
+                pthread_cond_wait(&pipe->inNotEmpty, &pipe->lock);
+            continue;
+        }
+
+        /* take ownership of the head slot by swapping it with the work packet */
+        tmp = pipe->in[pipe->inHead];
+        pipe->in[pipe->inHead] = pipe->work;
+        pipe->work = tmp;
+        pipe->inHead = (pipe->inHead + 1) % pipe->cfg.inQueueDepth;
+        pipe->inCount--;
+        pthread_cond_signal(&pipe->inNotFull);
+
+        gen = pipe->gen;
+
+        if (pipe->work.eos) {
+            pipe->busy = 1;
+            pthread_mutex_unlock(&pipe->lock);
+            pipe_drain(pipe, gen);
+            pthread_mutex_lock(&pipe->lock);
+            pipe->busy = 0;
+            pthread_cond_broadcast(&pipe->idle);
+
+            while (pipe->reorderCount && pipe_emit_locked(pipe, gen) == VPU_DEC_PIPE_OK)
+                ;
+            if (pipe->gen == gen)
+                pipe->eosReached = 1;
+            pthread_cond_broadcast(&pipe->outNotEmpty);
+            continue;
+        }
+
+        pipe->busy = 1;
+        pthread_mutex_unlock(&pipe->lock);
+
+        RK_S64 t0 = pipe_now_us();
+        pipe_decode(pipe, &pipe->work.pkt, gen);
+        RK_S64 t1 = pipe_now_us();
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->stats.decodeUs += t1 - t0;
+        pipe->stats.packetsDecoded++;
+        pipe->busy = 0;
+        pthread_cond_broadcast(&pipe->idle);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+
+    return NULL;
+}
+
+static void pipe_free(VpuDecPipeline_t *pipe)
+{
+    RK_U32 i;
+
+    if (pipe->in) {
+        for (i = 0; i < pipe->cfg.inQueueDepth; i++)
+            free(pipe->in[i].buf);
+        free(pipe->in);
+    }
+    free(pipe->work.buf);
+
+    if (pipe->reorder) {
+        for (i = 0; i < pipe->cfg.reorderDepth + 1; i++)
+            free(pipe->reorder[i].buf);
+        free(pipe->reorder);
+    }
+    if (pipe->out) {
+        for (i = 0; i < pipe->cfg.outQueueDepth; i++)
+            free(pipe->out[i].buf);
+        free(pipe->out);
+    }
+    free(pipe->scratch);
+
+    pthread_cond_destroy(&pipe->inNotEmpty);
+    pthread_cond_destroy(&pipe->inNotFull);
+    pthread_cond_destroy(&pipe->outNotEmpty);
+    pthread_cond_destroy(&pipe->outNotFull);
+    pthread_cond_destroy(&pipe->idle);
+    pthread_mutex_destroy(&pipe->lock);
+    free(pipe);
+}
+
+VpuDecPipeline_t *VpuDecPipelineCreate(VpuCodecContext_t *ctx, const VpuDecPipelineCfg_t *cfg)
+{
+    VpuDecPipeline_t *pipe;
+    RK_U32 i;
+
+    if (ctx == NULL || (ctx->decode == NULL && ctx->decode_sendstream == NULL))
+        return NULL;
+
+    pipe = (VpuDecPipeline_t *)calloc(1, sizeof(VpuDecPipeline_t));
+    if (pipe == NULL)
+        return NULL;
+
+    pipe->ctx = ctx;
+    if (cfg)
+        pipe->cfg = *cfg;
+    if (!pipe->cfg.inQueueDepth)
+        pipe->cfg.inQueueDepth = PIPE_DEFAULT_IN_DEPTH;
+    if (!pipe->cfg.outQueueDepth)
+        pipe->cfg.outQueueDepth = PIPE_DEFAULT_OUT_DEPTH;
+    if (!pipe->cfg.frameDataSize)
+        pipe->cfg.frameDataSize = sizeof(VPU_FRAME);
+
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->inNotEmpty, NULL);
+    pthread_cond_init(&pipe->inNotFull, NULL);
+    pthread_cond_init(&pipe->outNotEmpty, NULL);
+    pthread_cond_init(&pipe->outNotFull, NULL);
+    pthread_cond_init(&pipe->idle, NULL);
+
+    pipe->in = (PipePacket_t *)calloc(pipe->cfg.inQueueDepth, sizeof(PipePacket_t));
+    pipe->reorder = (PipeFrame_t *)calloc(pipe->cfg.reorderDepth + 1, sizeof(PipeFrame_t));
+    pipe->out = (PipeFrame_t *)calloc(pipe->cfg.outQueueDepth, sizeof(PipeFrame_t));
+    pipe->scratch = (RK_U8 *)calloc(1, pipe->cfg.frameDataSize);
+    if (!pipe->in || !pipe->reorder || !pipe->out || !pipe->scratch)
+        goto fail;
+
+    for (i = 0; i < pipe->cfg.reorderDepth + 1; i++) {
+        pipe->reorder[i].buf = (RK_U8 *)calloc(1, pipe->cfg.frameDataSize);
+        if (pipe->reorder[i].buf == NULL)
+            goto fail;
+    }
+    for (i = 0; i < pipe->cfg.outQueueDepth; i++) {
+        pipe->out[i].buf = (RK_U8 *)calloc(1, pipe->cfg.frameDataSize);
+        if (pipe->out[i].buf == NULL)
+            goto fail;
+    }
+
+    pipe->running = 1;
+    if (pthread_create(&pipe->thread, NULL, pipe_feeder, pipe)) {
+        ALOGE("failed to create feeder thread");
+        goto fail;
+    }
+
+    return pipe;
+
+fail:
+    pipe_free(pipe);
+    return NULL;
+}
+
+void VpuDecPipelineDestroy(VpuDecPipeline_t *pipe)
+{
+    if (pipe == NULL)
+        return;
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->running = 0;
+    pthread_cond_broadcast(&pipe->inNotEmpty);
+    pthread_cond_broadcast(&pipe->outNotFull);
+    pthread_mutex_unlock(&pipe->lock);
+
+    pthread_join(pipe->thread, NULL);
+    pipe_drop_queued_locked(pipe);
+    pipe_free(pipe);
+}
+
+static RK_S32 pipe_enqueue(VpuDecPipeline_t *pipe, VideoPacket_t *pkt, RK_S32 timeoutMs)
+{
+    struct timespec ts;
+    struct timespec *deadline = pipe_deadline(&ts, timeoutMs);
+    PipePacket_t *slot;
+    RK_S64 t0 = 0;
+    RK_S32 ret = VPU_DEC_PIPE_OK;
+
+    pthread_mutex_lock(&pipe->lock);
+
+    while (pipe->inCount == pipe->cfg.inQueueDepth) {
+        if (!t0) {
+            pipe->stats.producerBlocked++;
+            t0 = pipe_now_us();
+        }
+        if (timeoutMs == 0 || pipe_wait(&pipe->inNotFull, &pipe->lock, deadline) == ETIMEDOUT) {
+            ret = VPU_DEC_PIPE_TIMEOUT;
+            break;
+        }
+    }
+    if (t0)
+        pipe->stats.producerWaitUs += pipe_now_us() - t0;
+
+    if (ret == VPU_DEC_PIPE_OK) {
+        slot = &pipe->in[(pipe->inHead + pipe->inCount) % pipe->cfg.inQueueDepth];
+        if (pkt) {
+            ret = pipe_packet_store(slot, pkt);
+            pipe->eosReached = 0;
+            pipe->stats.packetsIn++;
+        } else {
+            slot->pkt.size = 0;
+            slot->eos = 1;
+        }
+    }
+
+    if (ret == VPU_DEC_PIPE_OK) {
+        pipe->inCount++;
+        if (pipe->inCount > pipe->stats.inQueuePeak)
+            pipe->stats.inQueuePeak = pipe->inCount;
+        pthread_cond_signal(&pipe->inNotEmpty);
+    }
+
+    pthread_mutex_unlock(&pipe->lock);
+    return ret;
+}
+
+RK_S32 VpuDecPipelineSendPacket(VpuDecPipeline_t *pipe, VideoPacket_t *pkt, RK_S32 timeoutMs)
+{
+    if (pipe == NULL || pkt == NULL || (pkt->size > 0 && pkt->data == NULL))
+        return VPU_DEC_PIPE_ERROR;
+
+    return pipe_enqueue(pipe, pkt, timeoutMs);
+}
+
+RK_S32 VpuDecPipelineSendEos(VpuDecPipeline_t *pipe)
+{
+    if (pipe == NULL)
+        return VPU_DEC_PIPE_ERROR;
+
+    return pipe_enqueue(pipe, NULL, VPU_DEC_PIPE_WAIT_FOREVER);
+}
+
+RK_S32 VpuDecPipelineGetFrame(VpuDecPipeline_t *pipe, DecoderOut_t *out, RK_S32 timeoutMs)
+{
+    struct timespec ts;
+    struct timespec *deadline = pipe_deadline(&ts, timeoutMs);
+    PipeFrame_t *slot;
+
+    if (pipe == NULL || out == NULL || out->data == NULL)
+        return VPU_DEC_PIPE_ERROR;
+
+    pthread_mutex_lock(&pipe->lock);
+
+    while (!pipe->outCount) {
+        if (pipe->eosReached) {
+            pthread_mutex_unlock(&pipe->lock);
+            out->size = 0;
+            return VPU_DEC_PIPE_EOS;
+        }
+        if (timeoutMs == 0 || pipe_wait(&pipe->outNotEmpty, &pipe->lock, deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&pipe->lock);
+            out->size = 0;
+            return VPU_DEC_PIPE_TIMEOUT;
+        }
+    }
+
+    slot = &pipe->out[pipe->outHead];
+    memcpy(out->data, slot->buf, pipe->cfg.frameDataSize);
+    out->size   = slot->out.size;
+    out->timeUs = slot->out.timeUs;
+    out->nFlags = slot->out.nFlags;
+
+    pipe->outHead = (pipe->outHead + 1) % pipe->cfg.outQueueDepth;
+    pipe->outCount--;
+    pipe->stats.framesOut++;
+    pthread_cond_signal(&pipe->outNotFull);
+
+    pthread_mutex_unlock(&pipe->lock);
+    return VPU_DEC_PIPE_OK;
+}
+
+RK_S32 VpuDecPipelineFlush(VpuDecPipeline_t *pipe)
+{
+    RK_S32 ret = 0;
+
+    if (pipe == NULL)
+        return VPU_DEC_PIPE_ERROR;
+
+    pthread_mutex_lock(&pipe->lock);
+
+    pipe->inHead = 0;
+    pipe->inCount = 0;
+    pipe->gen++;
+    pthread_cond_broadcast(&pipe->inNotFull);
+    pthread_cond_broadcast(&pipe->outNotFull);
+
+    /* let a packet already inside the codec finish; its frames are dropped by gen */
+    while (pipe->busy)
+        pthread_cond_wait(&pipe->idle, &pipe->lock);
+
+    if (pipe->ctx->flush)
+        ret = pipe->ctx->flush(pipe->ctx);
+
+    pipe_drop_queued_locked(pipe);
+    pipe->eosReached = 0;
+
+    pthread_mutex_unlock(&pipe->lock);
+    return ret ? VPU_DEC_PIPE_ERROR : VPU_DEC_PIPE_OK;
+}
+
+void VpuDecPipelineGetStats(VpuDecPipeline_t *pipe, VpuDecPipelineStats_t *stats)
+{
+    if (pipe == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&pipe->lock);
+    *stats = pipe->stats;
+    pthread_mutex_unlock(&pipe->lock);
+}
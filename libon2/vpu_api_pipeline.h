@@ -0,0 +1,75 @@
+/***************************************************************************************************
+    File:
+        vpu_api_pipeline.h
+    Description:
+        Pipelined decode front end for VpuCodecContext. Packets go into a
+        bounded input queue, a feeder thread drives decode_sendstream /
+        decode_getframe (or decode when the codec has no split interface) and
+        decoded frames come out of a pts ordered output queue, so the hardware
+        keeps working while the caller renders the previous frame.
+ **************************************************************************************************/
+#ifndef _VPU_API_PIPELINE_H_
+#define _VPU_API_PIPELINE_H_
+
+#include "vpu_api.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VPU_DEC_PIPE_OK                 (0)
+#define VPU_DEC_PIPE_TIMEOUT            (1)     /* queue full / empty within the timeout */
+#define VPU_DEC_PIPE_EOS                (2)     /* all frames before the end of stream were returned */
+#define VPU_DEC_PIPE_ERROR              (-1)
+
+#define VPU_DEC_PIPE_WAIT_FOREVER       (-1)
+
+typedef struct VpuDecPipelineCfg {
+    RK_U32 inQueueDepth;        /* packets buffered ahead of the decoder */
+    RK_U32 outQueueDepth;       /* frames buffered for the caller */
+    RK_U32 reorderDepth;        /* frames held back to sort by pts, 0 keeps decode order */
+    RK_U32 frameDataSize;       /* DecoderOut_t::data size, sizeof(VPU_FRAME) if 0 */
+} VpuDecPipelineCfg_t;
+
+typedef struct VpuDecPipelineStats {
+    RK_U32 packetsIn;
+    RK_U32 packetsDecoded;
+    RK_U32 framesOut;
+    RK_U32 framesDropped;       /* discarded by flush or destroy, VPU_FRAME buffers freed */
+    RK_U32 decodeErrors;
+    RK_U32 inQueuePeak;
+    RK_U32 outQueuePeak;
+    RK_U32 producerBlocked;     /* SendPacket found the input queue full */
+    RK_U32 feederBlocked;       /* the feeder found the output queue full */
+    RK_U32 feederStarved;       /* the feeder found the input queue empty */
+    RK_S64 producerWaitUs;
+    RK_S64 feederWaitUs;        /* time the decoder sat idle on a full output queue */
+    RK_S64 decodeUs;            /* time spent inside the codec */
+} VpuDecPipelineStats_t;
+
+typedef struct VpuDecPipeline VpuDecPipeline_t;
+
+/* ctx must already be initialised; it stays owned by the caller */
+VpuDecPipeline_t *VpuDecPipelineCreate(VpuCodecContext_t *ctx, const VpuDecPipelineCfg_t *cfg);
+void VpuDecPipelineDestroy(VpuDecPipeline_t *pipe);
+
+/* the packet data is copied, so the caller may reuse pkt right away */
+RK_S32 VpuDecPipelineSendPacket(VpuDecPipeline_t *pipe, VideoPacket_t *pkt, RK_S32 timeoutMs);
+/*
+ * no more packets; the codec is drained with an empty packet flagged end of
+ * stream and GetFrame returns VPU_DEC_PIPE_EOS once everything is out
+ */
+RK_S32 VpuDecPipelineSendEos(VpuDecPipeline_t *pipe);
+/* same contract as decode(): out->data points to frameDataSize bytes owned by the caller */
+RK_S32 VpuDecPipelineGetFrame(VpuDecPipeline_t *pipe, DecoderOut_t *out, RK_S32 timeoutMs);
+/* drop queued packets and frames and flush the codec, e.g. on seek */
+RK_S32 VpuDecPipelineFlush(VpuDecPipeline_t *pipe);
+
+void VpuDecPipelineGetStats(VpuDecPipeline_t *pipe, VpuDecPipelineStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VPU_API_PIPELINE_H_ */
@@ -0,0 +1,317 @@
+/***************************************************************************************************
+    File:
+        vpu_api_pipeline_test.c
+    Description:
+        Test of the pipelined decode front end on a fake codec context.
+        Builds for the host:
+
+            vpu_api_pipeline_test
+
+        The fake codec has the split decode_sendstream / decode_getframe
+        interface, holds two frames in a DPB the way an H.264 decoder does
+        with B frames, and refuses every fifth packet once so the feeder has
+        to offer it again. The test checks that frames come out sorted by
+        pts, that end of stream drains the DPB, that a flush drops queued
+        frames and frees their VPU buffers, and the same again through the
+        single decode() call.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vpu_mem.h"
+#include "vpu_api_pipeline.h"
+
+#define FAKE_DPB_DEPTH              (2)
+#define FAKE_DPB_MAX                (16)
+#define FAKE_REFUSE_EVERY           (5)
+#define FAKE_PKT_FLAG_EOS           (0x1)
+#define TEST_PHY_BASE               (0x1000)
+#define TEST_TIMEOUT_MS             (1000)
+
+typedef struct
+{
+    RK_S64          dpb[FAKE_DPB_MAX];
+    RK_U32          dpbCount;
+    RK_U32          draining;
+    RK_U32          packets;
+    RK_U32          refused;
+    RK_U32          frames;
+    RK_U32          flushes;
+    RK_U32          refusePending;
+} FakeCodec_t;
+
+static int failures;
+static RK_U32 vpuFrees;
+
+#ifdef VPU_API_PIPELINE_TEST_HOST
+/* frames of the fake codec carry a made up bus address, count the frees */
+RK_S32 VPUFreeLinear(VPUMemLinear_t *p)
+{
+    (void)p;
+    vpuFrees++;
+    return VPU_OK;
+}
+#endif
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+/* one frame per packet, held in the DPB until FAKE_DPB_DEPTH newer ones came in */
+static RK_S32 fake_take(FakeCodec_t *c, VideoPacket_t *pkt)
+{
+    if (pkt->nFlags & FAKE_PKT_FLAG_EOS) {
+        c->draining = 1;
+        return 0;
+    }
+    if (pkt->size <= 0)
+        return 0;
+
+    if (c->dpbCount == FAKE_DPB_MAX)
+        return -1;
+
+    c->dpb[c->dpbCount++] = pkt->pts;
+    c->packets++;
+    pkt->size = 0;
+    return 0;
+}
+
+static RK_U32 fake_give(FakeCodec_t *c, DecoderOut_t *out)
+{
+    VPU_FRAME *frame = (VPU_FRAME *)out->data;
+
+    out->size = 0;
+    if (!c->dpbCount || (!c->draining && c->dpbCount <= FAKE_DPB_DEPTH))
+        return 0;
+
+    memset(frame, 0, sizeof(VPU_FRAME));
+    frame->FrameWidth = 320;
+    frame->FrameHeight = 240;
+    frame->vpumem.phy_addr = TEST_PHY_BASE + c->frames;
+    frame->vpumem.offset = c->frames;
+    c->frames++;
+
+    out->timeUs = c->dpb[0];
+    out->size = sizeof(VPU_FRAME);
+    memmove(&c->dpb[0], &c->dpb[1], (c->dpbCount - 1) * sizeof(RK_S64));
+    c->dpbCount--;
+    return 1;
+}
+
+static RK_S32 fake_sendstream(VpuCodecContext_t *ctx, VideoPacket_t *pkt)
+{
+    FakeCodec_t *c = (FakeCodec_t *)ctx->private_data;
+
+    /* the decoder is busy now and then, the packet stays with the caller */
+    if (pkt->size > 0 && !c->refusePending && !((c->packets + 1) % FAKE_REFUSE_EVERY)) {
+        c->refusePending = 1;
+        c->refused++;
+        return 0;
+    }
+    c->refusePending = 0;
+    return fake_take(c, pkt);
+}
+
+static RK_S32 fake_getframe(VpuCodecContext_t *ctx, DecoderOut_t *out)
+{
+    fake_give((FakeCodec_t *)ctx->private_data, out);
+    return 0;
+}
+
+static RK_S32 fake_decode(VpuCodecContext_t *ctx, VideoPacket_t *pkt, DecoderOut_t *out)
+{
+    FakeCodec_t *c = (FakeCodec_t *)ctx->private_data;
+
+    if (fake_take(c, pkt))
+        return -1;
+    fake_give(c, out);
+    return 0;
+}
+
+static RK_S32 fake_flush(VpuCodecContext_t *ctx)
+{
+    FakeCodec_t *c = (FakeCodec_t *)ctx->private_data;
+
+    c->dpbCount = 0;
+    c->draining = 0;
+    c->flushes++;
+    return 0;
+}
+
+static void fake_init(VpuCodecContext_t *ctx, FakeCodec_t *c, int split)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    memset(c, 0, sizeof(*c));
+    ctx->private_data = c;
+    ctx->flush = fake_flush;
+    if (split) {
+        ctx->decode_sendstream = fake_sendstream;
+        ctx->decode_getframe = fake_getframe;
+    } else {
+        ctx->decode = fake_decode;
+    }
+}
+
+/* IBBP with the B frames after their P in decode order */
+static RK_S64 test_pts(RK_U32 n)
+{
+    static const RK_S32 gop[] = { 0, 3, 1, 2 };
+
+    return (RK_S64)((n / 4) * 4 + (n ? gop[n % 4] : 0)) * 33333;
+}
+
+static RK_S32 test_send(VpuDecPipeline_t *pipe, RK_U32 n)
+{
+    RK_U8 data[64];
+    VideoPacket_t pkt;
+
+    memset(&pkt, 0, sizeof(pkt));
+    memset(data, n, sizeof(data));
+    pkt.data = data;
+    pkt.size = sizeof(data);
+    pkt.pts = test_pts(n);
+    pkt.dts = VPU_API_NOPTS_VALUE;
+    return VpuDecPipelineSendPacket(pipe, &pkt, TEST_TIMEOUT_MS);
+}
+
+/* packets in, frames out in pts order, end of stream drains the DPB */
+static void test_decode_order(int split)
+{
+    const char *name = split ? "split" : "decode";
+    const RK_U32 packets = 40;
+    VpuDecPipelineCfg_t cfg;
+    VpuDecPipelineStats_t stats;
+    VpuCodecContext_t ctx;
+    FakeCodec_t codec;
+    VpuDecPipeline_t *pipe;
+    VPU_FRAME frame;
+    DecoderOut_t out;
+    RK_S64 last = -1;
+    RK_U32 n, got = 0, sorted = 1;
+    RK_S32 ret;
+
+    fake_init(&ctx, &codec, split);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.reorderDepth = 3;
+    pipe = VpuDecPipelineCreate(&ctx, &cfg);
+    if (pipe == NULL) {
+        check(0, name);
+        return;
+    }
+
+    for (n = 0; n < packets; n++) {
+        check_eq("order: send", test_send(pipe, n), VPU_DEC_PIPE_OK);
+
+        /* keep the output queue moving like a renderer would */
+        out.data = (RK_U8 *)&frame;
+        while (VpuDecPipelineGetFrame(pipe, &out, 0) == VPU_DEC_PIPE_OK) {
+            sorted = sorted && out.timeUs > last;
+            last = out.timeUs;
+            got++;
+        }
+    }
+    check_eq("order: eos", VpuDecPipelineSendEos(pipe), VPU_DEC_PIPE_OK);
+
+    for (;;) {
+        out.data = (RK_U8 *)&frame;
+        ret = VpuDecPipelineGetFrame(pipe, &out, TEST_TIMEOUT_MS);
+        if (ret != VPU_DEC_PIPE_OK)
+            break;
+        sorted = sorted && out.timeUs > last;
+        last = out.timeUs;
+        got++;
+    }
+
+    check_eq("order: ends with eos", ret, VPU_DEC_PIPE_EOS);
+    check_eq("order: every frame out", got, packets);
+    check(sorted, "order: frames sorted by pts");
+    check(!split || codec.refused > 0, "order: refused packets offered again");
+
+    VpuDecPipelineGetStats(pipe, &stats);
+    check_eq("order: packets in", stats.packetsIn, packets);
+    check_eq("order: frames out", stats.framesOut, packets);
+    check_eq("order: no errors", stats.decodeErrors, 0);
+    check_eq("order: nothing dropped", stats.framesDropped, 0);
+    check_eq("order: codec packets", codec.packets, packets);
+
+    VpuDecPipelineDestroy(pipe);
+}
+
+/* a flush drops what is queued and frees the VPU buffers of dropped frames */
+static void test_flush(void)
+{
+    VpuDecPipelineCfg_t cfg;
+    VpuDecPipelineStats_t stats;
+    VpuCodecContext_t ctx;
+    FakeCodec_t codec;
+    VpuDecPipeline_t *pipe;
+    VPU_FRAME frame;
+    DecoderOut_t out;
+    RK_U32 n, frees;
+
+    fake_init(&ctx, &codec, 1);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.outQueueDepth = 8;
+    pipe = VpuDecPipelineCreate(&ctx, &cfg);
+    if (pipe == NULL) {
+        check(0, "flush: create");
+        return;
+    }
+
+    for (n = 0; n < 8; n++)
+        test_send(pipe, n);
+    check_eq("flush: eos", VpuDecPipelineSendEos(pipe), VPU_DEC_PIPE_OK);
+
+    /* nothing is read, so after the drain all eight frames sit in the output queue */
+    for (n = 0; n < TEST_TIMEOUT_MS; n++) {
+        VpuDecPipelineGetStats(pipe, &stats);
+        if (stats.outQueuePeak == 8)
+            break;
+        usleep(1000);
+    }
+    check_eq("flush: output queue full", stats.outQueuePeak, 8);
+    frees = vpuFrees;
+
+    check_eq("flush", VpuDecPipelineFlush(pipe), VPU_DEC_PIPE_OK);
+    check_eq("flush: codec flushed", codec.flushes, 1);
+    VpuDecPipelineGetStats(pipe, &stats);
+    check_eq("flush: frames dropped", stats.framesDropped, 8);
+    check_eq("flush: dropped frames freed", vpuFrees - frees, 8);
+
+    out.data = (RK_U8 *)&frame;
+    check_eq("flush: nothing left", VpuDecPipelineGetFrame(pipe, &out, 0), VPU_DEC_PIPE_TIMEOUT);
+
+    /* decoding goes on after the flush */
+    for (n = 0; n < 4; n++)
+        test_send(pipe, n);
+    VpuDecPipelineSendEos(pipe);
+    for (n = 0; VpuDecPipelineGetFrame(pipe, &out, TEST_TIMEOUT_MS) == VPU_DEC_PIPE_OK; n++)
+        ;
+    check_eq("flush: frames after the flush", n, 4);
+
+    VpuDecPipelineDestroy(pipe);
+}
+
+int main(void)
+{
+    test_decode_order(1);
+    test_decode_order(0);
+    test_flush();
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
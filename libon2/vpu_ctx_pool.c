@@ -0,0 +1,641 @@
+/***************************************************************************************************
+    File:
+        vpu_ctx_pool.c
+    Description:
+        Warm decoder context pool over vpu_open_context / vpu_close_context
+ **************************************************************************************************/
+#define LOG_TAG "vpu_ctx_pool"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_ctx_pool.h"
+#include "vpu_hw_caps.h"
+
+#define CTX_POOL_IDLE_DEF       (2)
+
+typedef struct CtxEntry {
+    VpuCodecContext_t           *ctx;
+    OMX_ON2_VIDEO_CODINGTYPE    coding;
+    VPU_CTX_CLASS               cls;
+    RK_U32                      width;          /* size the decoder was initialised for */
+    RK_U32                      height;
+    RK_U8                       *extradata;     /* headers the decoder runs with */
+    RK_U32                      extraSize;
+    RK_U32                      nalLengthSize;  /* H.264 packet format fixed at init, 0: Annex B */
+    RK_S32                      used;           /* slot holds a context */
+    RK_S32                      busy;
+    RK_U32                      lru;
+    RK_S32                      warm;
+    RK_S32                      zapPending;
+    RK_S64                      acquireUs;
+} CtxEntry_t;
+
+struct VpuCtxPool {
+    pthread_mutex_t         lock;
+    VpuCtxPoolBackend_t     backend;
+    RK_U32                  maxIdle;
+    RK_U32                  tick;
+    CtxEntry_t              entry[VPU_CTX_POOL_MAX];
+    VpuCtxPoolStats_t       stats;
+};
+
+static RK_S64 ctx_pool_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+VPU_CTX_CLASS VpuCtxPoolClass(RK_U32 width, RK_U32 height)
+{
+    RK_U32 area = width * height;
+
+    if (area <= 720 * 576)
+        return VPU_CTX_CLASS_SD;
+    if (area <= 1280 * 720)
+        return VPU_CTX_CLASS_HD;
+    if (area <= 1920 * 1088)
+        return VPU_CTX_CLASS_FHD;
+    return VPU_CTX_CLASS_UHD;
+}
+
+/* NAL length size of avcC extradata, 0 for Annex B or none */
+static RK_U32 ctx_pool_nal_length(OMX_ON2_VIDEO_CODINGTYPE coding, const RK_U8 *extradata,
+                                  RK_U32 extraSize)
+{
+    if (coding != OMX_ON2_VIDEO_CodingAVC || extradata == NULL || extraSize < 7 ||
+        extradata[0] != 1)
+        return 0;
+    return (extradata[4] & 3) + 1;
+}
+
+static RK_S32 ctx_pool_same_extra(const CtxEntry_t *e, const RK_U8 *extradata, RK_U32 extraSize)
+{
+    if (e->extraSize != extraSize)
+        return 0;
+    return !extraSize || !memcmp(e->extradata, extradata, extraSize);
+}
+
+/* can the parked context take this stream by feeding its headers in band */
+static RK_S32 ctx_pool_compatible(const CtxEntry_t *e, OMX_ON2_VIDEO_CODINGTYPE coding,
+                                  RK_U32 width, RK_U32 height, const RK_U8 *extradata,
+                                  RK_U32 extraSize)
+{
+    switch (coding) {
+    case OMX_ON2_VIDEO_CodingAVC:
+    case OMX_ON2_VIDEO_CodingMPEG2:
+    case OMX_ON2_VIDEO_CodingMPEG4:
+    case OMX_ON2_VIDEO_CodingH263:
+    case OMX_ON2_VIDEO_CodingVP8:
+    case OMX_ON2_VIDEO_CodingMJPEG:
+        /* sequence headers in the stream resize these within the class */
+        break;
+    default:
+        /* VC1, WMV, RV and friends set their buffers up for the size given at init */
+        if (e->width != width || e->height != height)
+            return 0;
+        break;
+    }
+
+    if (ctx_pool_same_extra(e, extradata, extraSize))
+        return 1;
+
+    switch (coding) {
+    case OMX_ON2_VIDEO_CodingAVC:
+        return e->nalLengthSize == ctx_pool_nal_length(coding, extradata, extraSize);
+    case OMX_ON2_VIDEO_CodingMPEG2:
+    case OMX_ON2_VIDEO_CodingMPEG4:
+    case OMX_ON2_VIDEO_CodingH263:
+    case OMX_ON2_VIDEO_CodingVP8:
+    case OMX_ON2_VIDEO_CodingMJPEG:
+        return 1;
+    default:
+        /* VC1, WMV, RV and friends only take their headers at init */
+        return 0;
+    }
+}
+
+/*
+ * avcC SPS/PPS rewritten as NAL units prefixed with the context's length
+ * size. Annex B and MPEG headers are sent as they are.
+ */
+static RK_U8 *ctx_pool_inband_headers(const CtxEntry_t *e, const RK_U8 *extradata,
+                                      RK_U32 extraSize, RK_U32 *size)
+{
+    RK_U32 i, n, k, pass, len, out = 0;
+    RK_U8 *buf = NULL;
+
+    if (!e->nalLengthSize) {
+        buf = (RK_U8 *)malloc(extraSize);
+        if (buf != NULL)
+            memcpy(buf, extradata, extraSize);
+        *size = extraSize;
+        return buf;
+    }
+
+    /* first pass sizes the buffer, second fills it */
+    for (pass = 0; pass < 2; pass++) {
+        i = 5;
+        out = 0;
+        for (k = 0; k < 2; k++) {
+            if (i >= extraSize)
+                goto bad;
+            n = k ? extradata[i] : (extradata[i] & 0x1f);
+            i++;
+            while (n--) {
+                if (i + 2 > extraSize)
+                    goto bad;
+                len = (extradata[i] << 8) | extradata[i + 1];
+                i += 2;
+                if (len > extraSize - i)
+                    goto bad;
+                if (buf != NULL) {
+                    RK_U32 b;
+                    for (b = 0; b < e->nalLengthSize; b++)
+                        buf[out + b] = (RK_U8)(len >> (8 * (e->nalLengthSize - 1 - b)));
+                    memcpy(buf + out + e->nalLengthSize, extradata + i, len);
+                }
+                out += e->nalLengthSize + len;
+                i += len;
+            }
+        }
+        if (!pass) {
+            buf = (RK_U8 *)malloc(out ? out : 1);
+            if (buf == NULL)
+                return NULL;
+        }
+    }
+
+    *size = out;
+    return buf;
+
+bad:
+    ALOGE("malformed avcC extradata, %d bytes", extraSize);
+    free(buf);
+    return NULL;
+}
+
+/* hand new stream headers to a warm decoder through decode() */
+static RK_S32 ctx_pool_reconfigure(CtxEntry_t *e, RK_U8 *extradata, RK_U32 extraSize)
+{
+    VpuCodecContext_t *ctx = e->ctx;
+    VideoPacket_t pkt;
+    DecoderOut_t out;
+    VPU_FRAME frame;
+    RK_U8 *copy;
+    RK_U32 size = 0;
+
+    copy = (RK_U8 *)malloc(extraSize ? extraSize : 1);
+    if (copy == NULL)
+        return VPU_ERR;
+    memcpy(copy, extradata, extraSize);
+
+    if (extraSize) {
+        memset(&pkt, 0, sizeof(pkt));
+        memset(&out, 0, sizeof(out));
+        pkt.pts = pkt.dts = (RK_S64)VPU_API_NOPTS_VALUE;
+        pkt.data = ctx_pool_inband_headers(e, extradata, extraSize, &size);
+        pkt.size = size;
+        out.data = (RK_U8 *)&frame;
+
+        if (pkt.data == NULL || ctx->decode == NULL || ctx->decode(ctx, &pkt, &out)) {
+            ALOGW("in band headers refused, coding 0x%x", e->coding);
+            free(pkt.data);
+            free(copy);
+            return VPU_ERR;
+        }
+        free(pkt.data);
+    }
+
+    free(e->extradata);
+    e->extradata = copy;
+    e->extraSize = extraSize;
+    ctx->extradata = e->extradata;
+    ctx->extradata_size = extraSize;
+
+    return VPU_OK;
+}
+
+static VpuCodecContext_t *ctx_pool_open(VpuCtxPool_t *pool, OMX_ON2_VIDEO_CODINGTYPE coding,
+                                        RK_U32 width, RK_U32 height, RK_U8 *extradata,
+                                        RK_U32 extraSize)
+{
+    VpuCodecContext_t *ctx = NULL;
+
+    /* answered from the capability cache instead of a failing init() */
+    if (pool->backend.open == vpu_open_context &&
+        !VPUHwCapsCanDecode(coding, width, height, VPU_HW_PP_NONE)) {
+        ALOGW("coding 0x%x %dx%d is not supported by the hardware", coding, width, height);
+        pthread_mutex_lock(&pool->lock);
+        pool->stats.unsupported++;
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+
+    if (pool->backend.open(&ctx) || ctx == NULL) {
+        ALOGE("open context failed");
+        return NULL;
+    }
+
+    ctx->codecType = CODEC_DECODER;
+    ctx->videoCoding = coding;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->extradata = extradata;
+    ctx->extradata_size = extraSize;
+
+    if (ctx->init == NULL || ctx->init(ctx, extradata, extraSize)) {
+        ALOGE("init failed, coding 0x%x %dx%d", coding, width, height);
+        pool->backend.close(&ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/* a free slot, evicting the least recently used idle context if needed; lock held */
+static CtxEntry_t *ctx_pool_slot_locked(VpuCtxPool_t *pool, VpuCodecContext_t **evict)
+{
+    CtxEntry_t *lru = NULL;
+    RK_U32 i;
+
+    *evict = NULL;
+    for (i = 0; i < VPU_CTX_POOL_MAX; i++) {
+        CtxEntry_t *e = &pool->entry[i];
+
+        if (!e->used)
+            return e;
+        if (!e->busy && (lru == NULL || e->lru < lru->lru))
+            lru = e;
+    }
+
+    if (lru == NULL)
+        return NULL;
+
+    *evict = lru->ctx;
+    free(lru->extradata);
+    memset(lru, 0, sizeof(*lru));
+    pool->stats.evictions++;
+    pool->stats.idle--;
+    return lru;
+}
+
+/* fill a reserved slot with a context; lock held */
+static RK_S32 ctx_pool_fill_locked(CtxEntry_t *e, VpuCodecContext_t *ctx,
+                                   OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                                   RK_U8 *extradata, RK_U32 extraSize)
+{
+    e->extradata = (RK_U8 *)malloc(extraSize ? extraSize : 1);
+    if (e->extradata == NULL)
+        return VPU_ERR;
+    memcpy(e->extradata, extradata, extraSize);
+
+    e->ctx = ctx;
+    e->coding = coding;
+    e->cls = VpuCtxPoolClass(width, height);
+    e->width = width;
+    e->height = height;
+    e->extraSize = extraSize;
+    e->nalLengthSize = ctx_pool_nal_length(coding, extradata, extraSize);
+    /* the context must not keep pointing at the caller's copy */
+    ctx->extradata = e->extradata;
+    return VPU_OK;
+}
+
+static CtxEntry_t *ctx_pool_find_locked(VpuCtxPool_t *pool, VpuCodecContext_t *ctx)
+{
+    RK_U32 i;
+
+    for (i = 0; i < VPU_CTX_POOL_MAX; i++) {
+        if (pool->entry[i].used && pool->entry[i].ctx == ctx)
+            return &pool->entry[i];
+    }
+    return NULL;
+}
+
+VpuCtxPool_t *VpuCtxPoolCreate(const VpuCtxPoolCfg_t *cfg)
+{
+    VpuCtxPool_t *pool;
+
+    pool = (VpuCtxPool_t *)calloc(1, sizeof(VpuCtxPool_t));
+    if (pool == NULL)
+        return NULL;
+
+    pool->maxIdle = (cfg && cfg->maxIdle) ? cfg->maxIdle : CTX_POOL_IDLE_DEF;
+    pool->maxIdle = MIN(pool->maxIdle, VPU_CTX_POOL_MAX);
+    if (cfg && cfg->backend) {
+        pool->backend = *cfg->backend;
+    } else {
+        pool->backend.open = vpu_open_context;
+        pool->backend.close = vpu_close_context;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+
+    return pool;
+}
+
+void VpuCtxPoolTrim(VpuCtxPool_t *pool)
+{
+    VpuCodecContext_t *victims[VPU_CTX_POOL_MAX];
+    RK_U32 i, n = 0;
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < VPU_CTX_POOL_MAX; i++) {
+        CtxEntry_t *e = &pool->entry[i];
+
+        if (!e->used || e->busy)
+            continue;
+        victims[n++] = e->ctx;
+        free(e->extradata);
+        memset(e, 0, sizeof(*e));
+        pool->stats.idle--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < n; i++)
+        pool->backend.close(&victims[i]);
+}
+
+RK_S32 VpuCtxPoolDestroy(VpuCtxPool_t *pool)
+{
+    if (pool == NULL)
+        return VPU_ERR;
+
+    VpuCtxPoolTrim(pool);
+
+    if (pool->stats.busy) {
+        ALOGE("destroy with %d contexts still acquired", pool->stats.busy);
+        return VPU_ERR;
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+
+    return VPU_OK;
+}
+
+RK_S32 VpuCtxPoolAcquire(VpuCtxPool_t *pool, OMX_ON2_VIDEO_CODINGTYPE coding,
+                         RK_U32 width, RK_U32 height, RK_U8 *extradata, RK_U32 extraSize,
+                         VpuCodecContext_t **ctx)
+{
+    VpuCodecContext_t *evict = NULL, *fresh;
+    CtxEntry_t *e = NULL;
+    VPU_CTX_CLASS cls;
+    RK_S64 t0, dt;
+    RK_U32 i;
+
+    if (pool == NULL || ctx == NULL || (extraSize && extradata == NULL))
+        return VPU_ERR;
+
+    t0 = ctx_pool_now_us();
+    cls = VpuCtxPoolClass(width, height);
+    *ctx = NULL;
+
+    /* warm context of the same kind, one already on these headers first */
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < VPU_CTX_POOL_MAX; i++) {
+        CtxEntry_t *c = &pool->entry[i];
+
+        if (!c->used || c->busy || c->coding != coding || c->cls != cls ||
+            !ctx_pool_compatible(c, coding, width, height, extradata, extraSize))
+            continue;
+        if (e == NULL || (ctx_pool_same_extra(c, extradata, extraSize) &&
+                          !ctx_pool_same_extra(e, extradata, extraSize)))
+            e = c;
+    }
+    if (e != NULL) {
+        e->busy = 1;
+        pool->stats.idle--;
+        pool->stats.busy++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (e != NULL) {
+        RK_S32 reconfig = !ctx_pool_same_extra(e, extradata, extraSize);
+
+        if (!reconfig || !ctx_pool_reconfigure(e, extradata, extraSize)) {
+            e->ctx->width = width;
+            e->ctx->height = height;
+
+            pthread_mutex_lock(&pool->lock);
+            dt = ctx_pool_now_us() - t0;
+            e->warm = 1;
+            e->zapPending = 1;
+            e->acquireUs = t0;
+            pool->stats.hits++;
+            if (reconfig)
+                pool->stats.reconfigs++;
+            pool->stats.warmAcquireUsSum += dt;
+            pool->stats.warmAcquireUsMax = MAX(pool->stats.warmAcquireUsMax, dt);
+            pthread_mutex_unlock(&pool->lock);
+
+            *ctx = e->ctx;
+            return VPU_OK;
+        }
+
+        /* the warm context did not take the headers, rebuild it */
+        pthread_mutex_lock(&pool->lock);
+        evict = e->ctx;
+        free(e->extradata);
+        memset(e, 0, sizeof(*e));
+        pool->stats.busy--;
+        pthread_mutex_unlock(&pool->lock);
+        pool->backend.close(&evict);
+    }
+
+    /* cold: reserve a slot first so a full pool fails before the expensive part */
+    pthread_mutex_lock(&pool->lock);
+    e = ctx_pool_slot_locked(pool, &evict);
+    if (e != NULL) {
+        e->used = 1;
+        e->busy = 1;
+        pool->stats.busy++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (evict != NULL)
+        pool->backend.close(&evict);
+
+    if (e == NULL) {
+        ALOGE("all %d contexts are in use", VPU_CTX_POOL_MAX);
+        return VPU_ERR;
+    }
+
+    fresh = ctx_pool_open(pool, coding, width, height, extradata, extraSize);
+
+    pthread_mutex_lock(&pool->lock);
+    if (fresh == NULL || ctx_pool_fill_locked(e, fresh, coding, width, height, extradata, extraSize)) {
+        free(e->extradata);
+        memset(e, 0, sizeof(*e));
+        pool->stats.busy--;
+        pthread_mutex_unlock(&pool->lock);
+        if (fresh != NULL)
+            pool->backend.close(&fresh);
+        return VPU_ERR;
+    }
+    dt = ctx_pool_now_us() - t0;
+    e->warm = 0;
+    e->zapPending = 1;
+    e->acquireUs = t0;
+    pool->stats.misses++;
+    pool->stats.coldAcquireUsSum += dt;
+    pool->stats.coldAcquireUsMax = MAX(pool->stats.coldAcquireUsMax, dt);
+    pthread_mutex_unlock(&pool->lock);
+
+    *ctx = fresh;
+    return VPU_OK;
+}
+
+RK_S32 VpuCtxPoolRelease(VpuCtxPool_t *pool, VpuCodecContext_t *ctx)
+{
+    VpuCodecContext_t *victims[2] = { NULL, NULL };
+    CtxEntry_t *e;
+    RK_S32 broken;
+    RK_U32 i;
+
+    if (pool == NULL || ctx == NULL)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&pool->lock);
+    e = ctx_pool_find_locked(pool, ctx);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (e == NULL || !e->busy) {
+        ALOGE("context %p was not acquired from this pool", ctx);
+        return VPU_ERR;
+    }
+
+    /* the flush is the only work a zap away from this stream costs */
+    broken = ctx->decoder_err || (ctx->flush != NULL && ctx->flush(ctx));
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.busy--;
+    if (broken || !pool->maxIdle) {
+        victims[0] = e->ctx;
+        free(e->extradata);
+        memset(e, 0, sizeof(*e));
+    } else {
+        e->busy = 0;
+        e->zapPending = 0;
+        e->lru = ++pool->tick;
+        pool->stats.idle++;
+
+        if (pool->stats.idle > pool->maxIdle) {
+            CtxEntry_t *lru = NULL;
+
+            for (i = 0; i < VPU_CTX_POOL_MAX; i++) {
+                CtxEntry_t *c = &pool->entry[i];
+                if (c->used && !c->busy && (lru == NULL || c->lru < lru->lru))
+                    lru = c;
+            }
+            victims[1] = lru->ctx;
+            free(lru->extradata);
+            memset(lru, 0, sizeof(*lru));
+            pool->stats.idle--;
+            pool->stats.evictions++;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < 2; i++) {
+        if (victims[i] != NULL)
+            pool->backend.close(&victims[i]);
+    }
+
+    return VPU_OK;
+}
+
+void VpuCtxPoolFirstFrame(VpuCtxPool_t *pool, VpuCodecContext_t *ctx)
+{
+    CtxEntry_t *e;
+    RK_S64 zap;
+
+    if (pool == NULL || ctx == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    e = ctx_pool_find_locked(pool, ctx);
+    if (e != NULL && e->zapPending) {
+        zap = ctx_pool_now_us() - e->acquireUs;
+        e->zapPending = 0;
+        if (e->warm) {
+            pool->stats.warmZaps++;
+            pool->stats.warmZapUsSum += zap;
+        } else {
+            pool->stats.coldZaps++;
+            pool->stats.coldZapUsSum += zap;
+        }
+        pool->stats.zapUsMax = MAX(pool->stats.zapUsMax, zap);
+        pool->stats.zapLastUs = zap;
+        ALOGV("zap %lld us, %s context", zap, e->warm ? "warm" : "cold");
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+RK_S32 VpuCtxPoolPrewarm(VpuCtxPool_t *pool, OMX_ON2_VIDEO_CODINGTYPE coding,
+                         RK_U32 width, RK_U32 height, RK_U8 *extradata, RK_U32 extraSize,
+                         RK_U32 count)
+{
+    VpuCodecContext_t *ctx;
+    CtxEntry_t *e = NULL;
+    RK_U32 i, k;
+
+    if (pool == NULL || (extraSize && extradata == NULL))
+        return VPU_ERR;
+
+    for (i = 0; i < count; i++) {
+        /* prewarming never evicts, it stops at maxIdle or a full pool */
+        pthread_mutex_lock(&pool->lock);
+        e = NULL;
+        if (pool->stats.idle < pool->maxIdle) {
+            for (k = 0; k < VPU_CTX_POOL_MAX; k++) {
+                if (!pool->entry[k].used) {
+                    e = &pool->entry[k];
+                    e->used = 1;
+                    e->busy = 1;
+                    break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (e == NULL)
+            break;
+
+        ctx = ctx_pool_open(pool, coding, width, height, extradata, extraSize);
+
+        pthread_mutex_lock(&pool->lock);
+        if (ctx == NULL || ctx_pool_fill_locked(e, ctx, coding, width, height, extradata, extraSize)) {
+            free(e->extradata);
+            memset(e, 0, sizeof(*e));
+            pthread_mutex_unlock(&pool->lock);
+            if (ctx != NULL)
+                pool->backend.close(&ctx);
+            return VPU_ERR;
+        }
+        e->busy = 0;
+        e->lru = ++pool->tick;
+        pool->stats.idle++;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return VPU_OK;
+}
+
+void VpuCtxPoolGetStats(VpuCtxPool_t *pool, VpuCtxPoolStats_t *stats)
+{
+    if (pool == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,102 @@
+/***************************************************************************************************
+    File:
+        vpu_ctx_pool.h
+    Description:
+        Pool of warm decoder contexts for channel change and multi view.
+        Instead of vpu_close_context on every zap and vpu_open_context +
+        init(extradata) for the next channel, released contexts are flushed
+        and parked per coding type and resolution class. A stream of the
+        same kind picks one up again; new codec headers are fed in band when
+        the coding allows it, so the context and its buffers are not rebuilt.
+        Codings that only take headers at init (VC1, WMV, RV) are reused for
+        the exact size they were opened with.
+        Acquire time and zap time (acquire to first frame) are measured
+        separately for warm and cold contexts.
+ **************************************************************************************************/
+#ifndef _VPU_CTX_POOL_H_
+#define _VPU_CTX_POOL_H_
+
+#include "vpu_api.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VPU_CTX_POOL_MAX                (16)
+
+typedef enum
+{
+    VPU_CTX_CLASS_SD            = 0x0,  /* up to 720x576 */
+    VPU_CTX_CLASS_HD            = 0x1,  /* up to 1280x720 */
+    VPU_CTX_CLASS_FHD           = 0x2,  /* up to 1920x1088 */
+    VPU_CTX_CLASS_UHD           = 0x3,
+    VPU_CTX_CLASS_BUTT          ,
+} VPU_CTX_CLASS;
+
+/* context entry points, replaceable by a stand-in */
+typedef struct VpuCtxPoolBackend {
+    RK_S32 (*open)(VpuCodecContext_t **ctx);
+    RK_S32 (*close)(VpuCodecContext_t **ctx);
+} VpuCtxPoolBackend_t;
+
+typedef struct VpuCtxPoolCfg {
+    RK_U32 maxIdle;                     /* warm contexts kept, least recently used go first */
+    const VpuCtxPoolBackend_t *backend; /* NULL: vpu_open_context / vpu_close_context */
+} VpuCtxPoolCfg_t;
+
+typedef struct VpuCtxPoolStats {
+    RK_U32 hits;                /* served by a warm context */
+    RK_U32 misses;              /* opened and initialised */
+    RK_U32 reconfigs;           /* warm hits that got new headers in band */
+    RK_U32 evictions;
+    RK_U32 unsupported;         /* refused from the capability cache */
+    RK_U32 idle;
+    RK_U32 busy;
+    RK_S64 warmAcquireUsSum;
+    RK_S64 warmAcquireUsMax;
+    RK_S64 coldAcquireUsSum;
+    RK_S64 coldAcquireUsMax;
+    RK_U32 warmZaps;            /* acquire to VpuCtxPoolFirstFrame */
+    RK_U32 coldZaps;
+    RK_S64 warmZapUsSum;
+    RK_S64 coldZapUsSum;
+    RK_S64 zapUsMax;
+    RK_S64 zapLastUs;
+} VpuCtxPoolStats_t;
+
+typedef struct VpuCtxPool VpuCtxPool_t;
+
+VPU_CTX_CLASS VpuCtxPoolClass(RK_U32 width, RK_U32 height);
+
+VpuCtxPool_t *VpuCtxPoolCreate(const VpuCtxPoolCfg_t *cfg);
+/* closes the idle contexts, fails while some are still acquired */
+RK_S32 VpuCtxPoolDestroy(VpuCtxPool_t *pool);
+
+/*
+ * An initialised decoder for the stream, warm when possible. The
+ * extradata is copied. The context goes back with VpuCtxPoolRelease,
+ * never vpu_close_context.
+ */
+RK_S32 VpuCtxPoolAcquire(VpuCtxPool_t *pool, OMX_ON2_VIDEO_CODINGTYPE coding,
+                         RK_U32 width, RK_U32 height, RK_U8 *extradata, RK_U32 extraSize,
+                         VpuCodecContext_t **ctx);
+/* flush and park; a context in error state is closed instead */
+RK_S32 VpuCtxPoolRelease(VpuCtxPool_t *pool, VpuCodecContext_t *ctx);
+/* first frame of the stream is out, ends the zap time measurement */
+void VpuCtxPoolFirstFrame(VpuCtxPool_t *pool, VpuCodecContext_t *ctx);
+
+/* open and park count contexts ahead of a likely zap */
+RK_S32 VpuCtxPoolPrewarm(VpuCtxPool_t *pool, OMX_ON2_VIDEO_CODINGTYPE coding,
+                         RK_U32 width, RK_U32 height, RK_U8 *extradata, RK_U32 extraSize,
+                         RK_U32 count);
+/* close every idle context, e.g. on memory pressure */
+void VpuCtxPoolTrim(VpuCtxPool_t *pool);
+
+void VpuCtxPoolGetStats(VpuCtxPool_t *pool, VpuCtxPoolStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VPU_CTX_POOL_H_ */
@@ -0,0 +1,308 @@
+/***************************************************************************************************
+    File:
+        vpu_ctx_pool_test.c
+    Description:
+        Test of the warm decoder context pool on a fake context backend.
+        Builds for the host:
+
+            vpu_ctx_pool_test
+
+        The fake contexts count init, in band header packets, flushes and
+        closes. The test covers a warm hit on the same headers, new avcC
+        headers rewritten and fed in band, a change of NAL length size
+        forcing a cold open, VC1/WMV/RV contexts only reused at their exact
+        size, the idle limit evicting the least recently used context, a
+        broken context closed on release, prewarming and destroy.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vpu_macro.h"
+#include "vpu_ctx_pool.h"
+#include "vpu_hw_caps.h"
+
+typedef struct
+{
+    RK_U32      inits;
+    RK_U32      inband;
+    RK_U32      flushes;
+    RK_U8       lastPkt[64];
+    RK_U32      lastPktSize;
+} FakeCtx_t;
+
+static int failures;
+static RK_U32 fakeOpens;
+static RK_U32 fakeCloses;
+
+#ifdef VPU_CTX_POOL_TEST_HOST
+/* the test runs on the fake backend, these only satisfy the default one */
+RK_S32 vpu_open_context(VpuCodecContext_t **ctx)
+{
+    (void)ctx;
+    return VPU_ERR;
+}
+
+RK_S32 vpu_close_context(VpuCodecContext_t **ctx)
+{
+    (void)ctx;
+    return VPU_ERR;
+}
+
+RK_S32 VPUHwCapsCanDecode(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                          RK_U32 ppFlags)
+{
+    (void)coding;
+    (void)width;
+    (void)height;
+    (void)ppFlags;
+    return 1;
+}
+#endif
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+static RK_S32 fake_init(VpuCodecContext_t *ctx, RK_U8 *extradata, RK_U32 extraSize)
+{
+    (void)extradata;
+    (void)extraSize;
+    ((FakeCtx_t *)ctx->private_data)->inits++;
+    return 0;
+}
+
+static RK_S32 fake_decode(VpuCodecContext_t *ctx, VideoPacket_t *pkt, DecoderOut_t *out)
+{
+    FakeCtx_t *f = (FakeCtx_t *)ctx->private_data;
+
+    f->inband++;
+    f->lastPktSize = MIN((RK_U32)pkt->size, sizeof(f->lastPkt));
+    memcpy(f->lastPkt, pkt->data, f->lastPktSize);
+    out->size = 0;
+    return 0;
+}
+
+static RK_S32 fake_flush(VpuCodecContext_t *ctx)
+{
+    ((FakeCtx_t *)ctx->private_data)->flushes++;
+    return 0;
+}
+
+static RK_S32 fake_open(VpuCodecContext_t **ctx)
+{
+    VpuCodecContext_t *c = (VpuCodecContext_t *)calloc(1, sizeof(VpuCodecContext_t));
+
+    if (c == NULL)
+        return VPU_ERR;
+    c->private_data = calloc(1, sizeof(FakeCtx_t));
+    c->init = fake_init;
+    c->decode = fake_decode;
+    c->flush = fake_flush;
+    fakeOpens++;
+    *ctx = c;
+    return VPU_OK;
+}
+
+static RK_S32 fake_close(VpuCodecContext_t **ctx)
+{
+    free((*ctx)->private_data);
+    free(*ctx);
+    *ctx = NULL;
+    fakeCloses++;
+    return VPU_OK;
+}
+
+static const VpuCtxPoolBackend_t fakeBackend = { fake_open, fake_close };
+
+/* avcC with one SPS and one PPS, 4 byte NAL lengths */
+static RK_U8 avcc1[] = { 1, 0x64, 0, 0x28, 0xff, 0xe1, 0, 3, 0x67, 0x64, 0x28, 1, 0, 2, 0x68, 0xee };
+static RK_U8 avcc2[] = { 1, 0x64, 0, 0x28, 0xff, 0xe1, 0, 3, 0x67, 0x64, 0x29, 1, 0, 2, 0x68, 0xef };
+/* the same with 2 byte NAL lengths */
+static RK_U8 avcc3[] = { 1, 0x64, 0, 0x28, 0xfd, 0xe1, 0, 3, 0x67, 0x64, 0x28, 1, 0, 2, 0x68, 0xee };
+
+static VpuCtxPool_t *test_pool(RK_U32 maxIdle)
+{
+    VpuCtxPoolCfg_t cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.maxIdle = maxIdle;
+    cfg.backend = &fakeBackend;
+    return VpuCtxPoolCreate(&cfg);
+}
+
+static FakeCtx_t *fake_of(VpuCodecContext_t *ctx)
+{
+    return (FakeCtx_t *)ctx->private_data;
+}
+
+/* same headers come back warm, new avcC headers go in band as length prefixed NALs */
+static void test_warm(void)
+{
+    static const RK_U8 inband[] = { 0, 0, 0, 3, 0x67, 0x64, 0x29, 0, 0, 0, 2, 0x68, 0xef };
+    VpuCtxPool_t *pool = test_pool(2);
+    VpuCodecContext_t *a, *b;
+    VpuCtxPoolStats_t stats;
+
+    check_eq("warm: cold acquire", VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingAVC, 1920, 1080,
+             avcc1, sizeof(avcc1), &a), VPU_OK);
+    check_eq("warm: init once", fake_of(a)->inits, 1);
+    VpuCtxPoolFirstFrame(pool, a);
+    check_eq("warm: release", VpuCtxPoolRelease(pool, a), VPU_OK);
+    check_eq("warm: flushed on release", fake_of(a)->flushes, 1);
+
+    VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingAVC, 1920, 1080, avcc1, sizeof(avcc1), &b);
+    check(b == a, "warm: same headers hit");
+    check_eq("warm: no headers sent", fake_of(b)->inband, 0);
+    VpuCtxPoolRelease(pool, b);
+
+    /* a 1280x720 stream is another class */
+    VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingAVC, 1280, 720, avcc1, sizeof(avcc1), &b);
+    check(b != a, "warm: other class misses");
+    VpuCtxPoolRelease(pool, b);
+
+    VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingAVC, 1920, 1080, avcc2, sizeof(avcc2), &b);
+    check(b == a, "warm: new headers reconfigure");
+    check_eq("warm: headers sent once", fake_of(b)->inband, 1);
+    check_eq("warm: in band size", fake_of(b)->lastPktSize, sizeof(inband));
+    check(!memcmp(fake_of(b)->lastPkt, inband, sizeof(inband)), "warm: in band NAL units");
+    check_eq("warm: still one init", fake_of(b)->inits, 1);
+    check(b->extradata != avcc2 && b->extradata_size == sizeof(avcc2), "warm: extradata copied");
+    VpuCtxPoolFirstFrame(pool, b);
+    VpuCtxPoolRelease(pool, b);
+
+    /* the packet format is fixed at init, another NAL length size needs a new context */
+    VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingAVC, 1920, 1080, avcc3, sizeof(avcc3), &b);
+    check_eq("warm: nal length change is cold", fake_of(b)->inits, 1);
+    check_eq("warm: nal length change sends nothing", fake_of(b)->inband, 0);
+    VpuCtxPoolRelease(pool, b);
+
+    VpuCtxPoolGetStats(pool, &stats);
+    check_eq("warm: hits", stats.hits, 2);
+    check_eq("warm: misses", stats.misses, 3);
+    check_eq("warm: reconfigs", stats.reconfigs, 1);
+    check_eq("warm: zaps", stats.warmZaps + stats.coldZaps, 2);
+    check_eq("warm: destroy", VpuCtxPoolDestroy(pool), VPU_OK);
+}
+
+/* codings that only take headers at init are reused for their exact size only */
+static void test_init_only(void)
+{
+    static const OMX_ON2_VIDEO_CODINGTYPE codings[] = {
+        OMX_ON2_VIDEO_CodingVC1, OMX_ON2_VIDEO_CodingWMV, OMX_ON2_VIDEO_CodingRV,
+    };
+    RK_U8 seq[] = { 0x0f, 0xcb, 0x80, 0x01 };
+    VpuCtxPool_t *pool;
+    VpuCodecContext_t *a, *b;
+    RK_U32 i, opens;
+
+    for (i = 0; i < sizeof(codings) / sizeof(codings[0]); i++) {
+        pool = test_pool(2);
+        VpuCtxPoolAcquire(pool, codings[i], 1920, 1080, seq, sizeof(seq), &a);
+        VpuCtxPoolRelease(pool, a);
+
+        /* same class, other size: the buffers were set up for 1920x1080 */
+        opens = fakeOpens;
+        VpuCtxPoolAcquire(pool, codings[i], 1440, 1080, seq, sizeof(seq), &b);
+        check(b != a, "init only: other size misses");
+        check_eq("init only: other size opens", fakeOpens - opens, 1);
+        VpuCtxPoolRelease(pool, b);
+
+        VpuCtxPoolAcquire(pool, codings[i], 1920, 1080, seq, sizeof(seq), &b);
+        check(b == a, "init only: exact size hits");
+        check_eq("init only: nothing in band", fake_of(b)->inband, 0);
+        VpuCtxPoolRelease(pool, b);
+
+        /* other headers at the same size cannot be fed in band either */
+        seq[3]++;
+        VpuCtxPoolAcquire(pool, codings[i], 1920, 1080, seq, sizeof(seq), &b);
+        check(fake_of(b)->inband == 0 && fake_of(b)->inits == 1, "init only: new headers cold");
+        VpuCtxPoolRelease(pool, b);
+
+        check_eq("init only: destroy", VpuCtxPoolDestroy(pool), VPU_OK);
+    }
+}
+
+/* the idle limit closes the least recently used, a broken context is not parked */
+static void test_eviction(void)
+{
+    VpuCtxPool_t *pool = test_pool(2);
+    VpuCodecContext_t *c[3], *b;
+    VpuCtxPoolStats_t stats;
+    RK_U32 i, closes;
+
+    for (i = 0; i < 3; i++)
+        VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingMPEG2, 720, 576, NULL, 0, &c[i]);
+    VpuCtxPoolGetStats(pool, &stats);
+    check_eq("evict: busy", stats.busy, 3);
+
+    closes = fakeCloses;
+    for (i = 0; i < 3; i++)
+        VpuCtxPoolRelease(pool, c[i]);
+    check_eq("evict: one closed", fakeCloses - closes, 1);
+    VpuCtxPoolGetStats(pool, &stats);
+    check_eq("evict: idle", stats.idle, 2);
+    check_eq("evict: evictions", stats.evictions, 1);
+
+    /* c[0] went first, c[1] is now the oldest idle one */
+    VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingMPEG2, 720, 576, NULL, 0, &b);
+    check(b == c[1] || b == c[2], "evict: warm hit on a parked context");
+    b->decoder_err = 1;
+    closes = fakeCloses;
+    VpuCtxPoolRelease(pool, b);
+    check_eq("evict: broken context closed", fakeCloses - closes, 1);
+    check_eq("evict: foreign release", VpuCtxPoolRelease(pool, b), VPU_ERR);
+
+    VpuCtxPoolGetStats(pool, &stats);
+    check_eq("evict: idle after the broken one", stats.idle, 1);
+    check_eq("evict: destroy", VpuCtxPoolDestroy(pool), VPU_OK);
+}
+
+/* prewarm stops at the idle limit, destroy refuses while a context is out */
+static void test_prewarm(void)
+{
+    VpuCtxPool_t *pool = test_pool(3);
+    VpuCodecContext_t *a;
+    VpuCtxPoolStats_t stats;
+    RK_U32 opens = fakeOpens;
+
+    check_eq("prewarm", VpuCtxPoolPrewarm(pool, OMX_ON2_VIDEO_CodingVP8, 1280, 720, NULL, 0, 5),
+             VPU_OK);
+    check_eq("prewarm: stops at the idle limit", fakeOpens - opens, 3);
+
+    VpuCtxPoolAcquire(pool, OMX_ON2_VIDEO_CodingVP8, 1280, 720, NULL, 0, &a);
+    VpuCtxPoolGetStats(pool, &stats);
+    check_eq("prewarm: hit", stats.hits, 1);
+    check_eq("prewarm: no miss", stats.misses, 0);
+
+    check_eq("prewarm: destroy while acquired", VpuCtxPoolDestroy(pool), VPU_ERR);
+    VpuCtxPoolGetStats(pool, &stats);
+    check_eq("prewarm: idle trimmed", stats.idle, 0);
+    VpuCtxPoolRelease(pool, a);
+    check_eq("prewarm: destroy", VpuCtxPoolDestroy(pool), VPU_OK);
+}
+
+int main(void)
+{
+    test_warm();
+    test_init_only();
+    test_eviction();
+    test_prewarm();
+
+    check_eq("every context closed", fakeCloses, fakeOpens);
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
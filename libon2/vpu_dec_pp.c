@@ -0,0 +1,388 @@
+/***************************************************************************************************
+    File:
+        vpu_dec_pp.c
+    Description:
+        Post-processor register setup for fused decode + post-process jobs
+ **************************************************************************************************/
+#define LOG_TAG "vpu_dec_pp"
+
+#include <string.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_dec_pp.h"
+#include "vpu_reg_batch.h"
+#include "regdrv.h"
+
+/* post-processor format codes, same values as hw_jpegdecapi.h */
+#define PP_IN_YUV420_SEMI           (1)
+#define PP_IN_YUV400                (3)
+#define PP_IN_YUV422_SEMI           (4)
+#define PP_IN_YUV420_TILED          (5)
+#define PP_IN_YUV440_SEMI           (6)
+#define PP_IN_YUV444_SEMI           (7)
+#define PP_IN_YUV411_SEMI           (8)
+#define PP_IN_EXTENDED              (7)     /* codes from here on go to PP_IN_FORMAT_ES */
+#define PP_OUT_RGB                  (0)
+#define PP_OUT_YUV422_INTERLEAVE    (3)
+#define PP_OUT_YUV420_SEMI          (5)
+
+#define PP_SCALE_NONE               (0)
+#define PP_SCALE_UP                 (1)
+#define PP_SCALE_DOWN               (2)
+
+/* BT.601 YCbCr to RGB, 8 bit fixed point */
+#define PP_COEFF_A                  (298)
+#define PP_COEFF_B                  (409)
+#define PP_COEFF_C                  (208)
+#define PP_COEFF_D                  (100)
+#define PP_COEFF_E                  (516)
+
+#define PP_DEINT_THRESHOLD          (25)
+#define PP_DEINT_EDGE_DET           (16)
+
+#define PP_DITHER_4BIT              (1)
+#define PP_DITHER_5BIT              (2)
+#define PP_DITHER_6BIT              (3)
+
+typedef struct PPRgbFormat
+{
+    RK_U32  colorType;
+    RK_U32  pixIn32;
+    RK_U32  rMask;
+    RK_U32  gMask;
+    RK_U32  bMask;
+} PPRgbFormat_t;
+
+static const PPRgbFormat_t ppRgbFormats[] = {
+    { VPU_PP_OUTPUT_FORMAT_ARGB8888, 1, 0x00ff0000, 0x0000ff00, 0x000000ff },
+    { VPU_PP_OUTPUT_FORMAT_ABGR8888, 1, 0x000000ff, 0x0000ff00, 0x00ff0000 },
+    { VPU_PP_OUTPUT_FORMAT_RGB565,   0, 0x0000f800, 0x000007e0, 0x0000001f },
+    { VPU_PP_OUTPUT_FORMAT_RGB555,   0, 0x00007c00, 0x000003e0, 0x0000001f },
+};
+
+static const PPRgbFormat_t *pp_rgb_format(RK_U32 colorType)
+{
+    RK_U32 i;
+
+    for (i = 0; i < sizeof(ppRgbFormats) / sizeof(ppRgbFormats[0]); i++) {
+        if (ppRgbFormats[i].colorType == colorType)
+            return &ppRgbFormats[i];
+    }
+
+    return NULL;
+}
+
+static RK_S32 pp_out_format(RK_U32 colorType)
+{
+    if (pp_rgb_format(colorType) != NULL)
+        return PP_OUT_RGB;
+
+    switch (colorType) {
+    case VPU_PP_OUTPUT_FORMAT_YUV420_SEMIPLANAR:
+        return PP_OUT_YUV420_SEMI;
+    case VPU_PP_OUTPUT_FORMAT_YUV422:
+        return PP_OUT_YUV422_INTERLEAVE;
+    default:
+        return -1;
+    }
+}
+
+/* zero bits above the mask inside the 16 or 32 bit pixel */
+static RK_U32 pp_mask_padding(RK_U32 mask, RK_U32 pixIn32)
+{
+    return __builtin_clz(mask) - (pixIn32 ? 0 : 16);
+}
+
+static RK_U32 pp_rotated(RK_U32 rotate)
+{
+    return rotate == VPU_DEC_PP_ROTATE_RIGHT_90 || rotate == VPU_DEC_PP_ROTATE_LEFT_90;
+}
+
+/* output size before rotation, which is what the scaler produces */
+static void pp_scaled_size(const VPU_POSTPROCESSING *pp, RK_U32 *w, RK_U32 *h)
+{
+    if (pp_rotated(pp->RotateEn)) {
+        *w = pp->OutputHeight;
+        *h = pp->OutputWidth;
+    } else {
+        *w = pp->OutputWidth;
+        *h = pp->OutputHeight;
+    }
+}
+
+static RK_S32 pp_scale_dir(RK_U32 in, RK_U32 out)
+{
+    if (out > in)
+        return PP_SCALE_UP;
+    if (out < in)
+        return PP_SCALE_DOWN;
+    return PP_SCALE_NONE;
+}
+
+RK_S32 VPUDecPPCheck(const VPU_POSTPROCESSING *pp, VPU_DEC_PP_MODE mode)
+{
+    RK_U32 outW, outH;
+    RK_S32 hDir, vDir;
+
+    if (pp == NULL || mode >= VPU_DEC_PP_MODE_BUTT)
+        return VPU_ERR;
+
+    if (pp_out_format(pp->ColorType) < 0) {
+        ALOGE("output format %d not supported", pp->ColorType);
+        return VPU_ERR;
+    }
+
+    if (!pp->InputWidth || !pp->InputHeight || !pp->OutputWidth || !pp->OutputHeight ||
+        (pp->OutputWidth & 7) || (pp->OutputHeight & 1) ||
+        pp->OutputWidth > VPU_DEC_PP_MAX_OUT_WIDTH || pp->OutputHeight > VPU_DEC_PP_MAX_OUT_HEIGHT) {
+        ALOGE("bad picture size %dx%d -> %dx%d", pp->InputWidth, pp->InputHeight,
+              pp->OutputWidth, pp->OutputHeight);
+        return VPU_ERR;
+    }
+
+    if (pp->RotateEn > VPU_DEC_PP_ROTATE_180)
+        return VPU_ERR;
+
+    if (pp->DeinterlaceEn) {
+        if (mode == VPU_DEC_PP_PIPELINE)
+            return VPU_ERR;
+        if (pp->RotateEn != VPU_DEC_PP_ROTATE_NONE) {
+            ALOGE("deinterlacing can not be combined with rotation");
+            return VPU_ERR;
+        }
+    }
+
+    pp_scaled_size(pp, &outW, &outH);
+    if (!pp->ScaleEn) {
+        if (outW != pp->InputWidth || outH != pp->InputHeight) {
+            ALOGE("size change requested with scaling disabled");
+            return VPU_ERR;
+        }
+        return VPU_OK;
+    }
+
+    hDir = pp_scale_dir(pp->InputWidth, outW);
+    vDir = pp_scale_dir(pp->InputHeight, outH);
+
+    /* the scaler cannot enlarge one direction while shrinking the other */
+    if ((hDir == PP_SCALE_UP && vDir == PP_SCALE_DOWN) ||
+        (hDir == PP_SCALE_DOWN && vDir == PP_SCALE_UP)) {
+        ALOGE("mixed up/down scaling %dx%d -> %dx%d", pp->InputWidth, pp->InputHeight, outW, outH);
+        return VPU_ERR;
+    }
+
+    if (outW > VPU_DEC_PP_MAX_UPSCALE * pp->InputWidth - 2 ||
+        outH > VPU_DEC_PP_MAX_UPSCALE * pp->InputHeight - 2 ||
+        outW * VPU_DEC_PP_MAX_DOWNSCALE < pp->InputWidth ||
+        outH * VPU_DEC_PP_MAX_DOWNSCALE < pp->InputHeight) {
+        ALOGE("scaling %dx%d -> %dx%d out of range", pp->InputWidth, pp->InputHeight, outW, outH);
+        return VPU_ERR;
+    }
+
+    return VPU_OK;
+}
+
+static void pp_setup_scaling(VPURegBatch_t *b, RK_U32 inW, RK_U32 inH, RK_U32 outW, RK_U32 outH)
+{
+    RK_S32 hDir = pp_scale_dir(inW, outW);
+    RK_S32 vDir = pp_scale_dir(inH, outH);
+
+    VPU_REG_BATCH_ADD(b, HWIF_HOR_SCALE_MODE, hDir);
+    VPU_REG_BATCH_ADD(b, HWIF_VER_SCALE_MODE, vDir);
+
+    if (hDir == PP_SCALE_UP) {
+        VPU_REG_BATCH_ADD(b, HWIF_SCALE_WRATIO, ((inW - 1) << 16) / (outW - 1));
+        VPU_REG_BATCH_ADD(b, HWIF_WSCALE_INVRA, ((outW - 1) << 16) / (inW - 1));
+    } else if (hDir == PP_SCALE_DOWN) {
+        VPU_REG_BATCH_ADD(b, HWIF_WSCALE_INVRA, (outW << 16) / inW + 1);
+    }
+
+    if (vDir == PP_SCALE_UP) {
+        VPU_REG_BATCH_ADD(b, HWIF_SCALE_HRATIO, ((inH - 1) << 16) / (outH - 1));
+        VPU_REG_BATCH_ADD(b, HWIF_HSCALE_INVRA, ((outH - 1) << 16) / (inH - 1));
+    } else if (vDir == PP_SCALE_DOWN) {
+        VPU_REG_BATCH_ADD(b, HWIF_HSCALE_INVRA, (outH << 16) / inH + 1);
+    }
+}
+
+static void pp_setup_rgb(VPURegBatch_t *b, const PPRgbFormat_t *fmt, RK_U32 dither)
+{
+    VPU_REG_BATCH_ADD(b, HWIF_RGB_PIX_IN32, fmt->pixIn32);
+    VPU_REG_BATCH_ADD(b, HWIF_R_MASK, fmt->rMask);
+    VPU_REG_BATCH_ADD(b, HWIF_G_MASK, fmt->gMask);
+    VPU_REG_BATCH_ADD(b, HWIF_B_MASK, fmt->bMask);
+    VPU_REG_BATCH_ADD(b, HWIF_RGB_R_PADD, pp_mask_padding(fmt->rMask, fmt->pixIn32));
+    VPU_REG_BATCH_ADD(b, HWIF_RGB_G_PADD, pp_mask_padding(fmt->gMask, fmt->pixIn32));
+    VPU_REG_BATCH_ADD(b, HWIF_RGB_B_PADD, pp_mask_padding(fmt->bMask, fmt->pixIn32));
+
+    VPU_REG_BATCH_ADD(b, HWIF_YCBCR_RANGE, 0);
+    VPU_REG_BATCH_ADD(b, HWIF_COLOR_COEFFA1, PP_COEFF_A);
+    VPU_REG_BATCH_ADD(b, HWIF_COLOR_COEFFA2, PP_COEFF_A);
+    VPU_REG_BATCH_ADD(b, HWIF_COLOR_COEFFB, PP_COEFF_B);
+    VPU_REG_BATCH_ADD(b, HWIF_COLOR_COEFFC, PP_COEFF_C);
+    VPU_REG_BATCH_ADD(b, HWIF_COLOR_COEFFD, PP_COEFF_D);
+    VPU_REG_BATCH_ADD(b, HWIF_COLOR_COEFFE, PP_COEFF_E);
+    VPU_REG_BATCH_ADD(b, HWIF_COLOR_COEFFF, 0);
+
+    /* dithering only pays off when channels are cut below 8 bits */
+    if (dither && !fmt->pixIn32) {
+        RK_U32 gBits = __builtin_popcount(fmt->gMask);
+
+        VPU_REG_BATCH_ADD(b, HWIF_DITHER_SELECT_R, PP_DITHER_5BIT);
+        VPU_REG_BATCH_ADD(b, HWIF_DITHER_SELECT_G, gBits == 6 ? PP_DITHER_6BIT : PP_DITHER_5BIT);
+        VPU_REG_BATCH_ADD(b, HWIF_DITHER_SELECT_B, PP_DITHER_5BIT);
+    }
+}
+
+RK_S32 VPUDecPPSetup(RK_U32 *regs, const VPU_POSTPROCESSING *pp, VPU_DEC_PP_MODE mode,
+                     RK_U32 discardDecOut)
+{
+    const PPRgbFormat_t *rgb;
+    VPURegBatch_t batch, *b = &batch;
+    RK_U32 mbW, mbH, outW, outH;
+
+    if (regs == NULL || VPUDecPPCheck(pp, mode) != VPU_OK)
+        return VPU_ERR;
+
+    mbW = (pp->InputWidth + 15) >> 4;
+    mbH = (pp->InputHeight + 15) >> 4;
+
+    if (mode == VPU_DEC_PP_PIPELINE) {
+        RK_U32 decMbW = VPURegGet(regs, HWIF_PIC_MB_WIDTH);
+        RK_U32 decMbH = VPURegGet(regs, HWIF_PIC_MB_HEIGHT_P);
+
+        if (decMbW != mbW || decMbH != mbH) {
+            ALOGE("input %dx%d does not match the decoder picture %dx%d MBs",
+                  pp->InputWidth, pp->InputHeight, decMbW, decMbH);
+            return VPU_ERR;
+        }
+    }
+
+    memset(VPU_DEC_PP_REGS(regs), 0, VPU_REG_NUM_PP * sizeof(RK_U32));
+    VPU_REG_BATCH_INIT(b);
+
+    VPU_REG_BATCH_ADD(b, HWIF_PP_E, 1);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_CLK_GATE_E, 1);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_MAX_BURST, 16);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_IN_ENDIAN, 1);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_IN_SWAP32_E, 1);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_OUT_ENDIAN, 1);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_OUT_SWAP32_E, 1);
+
+    if (mode == VPU_DEC_PP_PIPELINE) {
+        VPU_REG_BATCH_ADD(b, HWIF_PP_PIPELINE_E, 1);
+        VPU_REG_BATCH_ADD(b, HWIF_PP_IN_FORMAT, VPURegGet(regs, HWIF_DEC_OUT_TILED_E) ?
+                       PP_IN_YUV420_TILED : PP_IN_YUV420_SEMI);
+        VPU_REG_BATCH_ADD(b, HWIF_DEC_OUT_DIS, discardDecOut ? 1 : 0);
+    } else {
+        VPU_REG_BATCH_ADD(b, HWIF_PP_PIPELINE_E, 0);
+        VPU_REG_BATCH_ADD(b, HWIF_PP_IN_FORMAT, PP_IN_YUV420_SEMI);
+        VPU_REG_BATCH_ADD(b, HWIF_PP_IN_LU_BASE, pp->InputAddr[0]);
+        VPU_REG_BATCH_ADD(b, HWIF_PP_IN_CB_BASE, pp->InputAddr[1]);
+    }
+
+    VPU_REG_BATCH_ADD(b, HWIF_PP_IN_WIDTH, mbW & 0x1ff);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_IN_W_EXT, mbW >> 9);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_IN_HEIGHT, mbH & 0xff);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_IN_H_EXT, mbH >> 8);
+    /* decoded pictures are padded to whole macroblocks, crop back to the real size */
+    VPU_REG_BATCH_ADD(b, HWIF_PP_CROP8_R_E, (pp->InputWidth & 15) ? 1 : 0);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_CROP8_D_E, (pp->InputHeight & 15) ? 1 : 0);
+
+    VPU_REG_BATCH_ADD(b, HWIF_PP_OUT_FORMAT, pp_out_format(pp->ColorType));
+    VPU_REG_BATCH_ADD(b, HWIF_PP_OUT_WIDTH, pp->OutputWidth);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_OUT_HEIGHT, pp->OutputHeight);
+    VPU_REG_BATCH_ADD(b, HWIF_DISPLAY_WIDTH, pp->OutputWidth);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_OUT_LU_BASE, pp->OutputAddr[0]);
+    VPU_REG_BATCH_ADD(b, HWIF_PP_OUT_CH_BASE, pp->OutputAddr[1]);
+
+    /* DeblkEn is the decoder's own loop filter and is left to the decoder part */
+    VPU_REG_BATCH_ADD(b, HWIF_ROTATION_MODE, pp->RotateEn);
+
+    if (pp->ScaleEn) {
+        pp_scaled_size(pp, &outW, &outH);
+        pp_setup_scaling(b, pp->InputWidth, pp->InputHeight, outW, outH);
+    }
+
+    rgb = pp_rgb_format(pp->ColorType);
+    if (rgb != NULL)
+        pp_setup_rgb(b, rgb, pp->DitherEn);
+
+    if (pp->DeinterlaceEn) {
+        VPU_REG_BATCH_ADD(b, HWIF_DEINT_E, 1);
+        VPU_REG_BATCH_ADD(b, HWIF_DEINT_THRESHOLD, PP_DEINT_THRESHOLD);
+        VPU_REG_BATCH_ADD(b, HWIF_DEINT_EDGE_DET, PP_DEINT_EDGE_DET);
+    }
+
+    /* one write per register instead of one lookup and write per field */
+    return VPURegBatchApply(regs, b);
+}
+
+RK_S32 VPUDecPPSetInputFormat(RK_U32 *regs, VPU_DEC_PP_IN_FORMAT format)
+{
+    static const RK_U32 ppInFormats[VPU_DEC_PP_IN_BUTT] = {
+        PP_IN_YUV420_SEMI, PP_IN_YUV400, PP_IN_YUV422_SEMI,
+        PP_IN_YUV440_SEMI, PP_IN_YUV444_SEMI, PP_IN_YUV411_SEMI,
+    };
+    RK_U32 code;
+
+    if (regs == NULL || format >= VPU_DEC_PP_IN_BUTT)
+        return VPU_ERR;
+
+    if (VPURegGet(regs, HWIF_PP_PIPELINE_E)) {
+        ALOGE("input format is fixed by the decoder in pipeline mode");
+        return VPU_ERR;
+    }
+
+    code = ppInFormats[format];
+    if (code >= PP_IN_EXTENDED) {
+        VPURegSet(regs, HWIF_PP_IN_FORMAT, PP_IN_EXTENDED);
+        VPURegSet(regs, HWIF_PP_IN_FORMAT_ES, code - PP_IN_EXTENDED);
+    } else {
+        VPURegSet(regs, HWIF_PP_IN_FORMAT, code);
+        VPURegSet(regs, HWIF_PP_IN_FORMAT_ES, 0);
+    }
+
+    return VPU_OK;
+}
+
+RK_S32 VPUDecPPSetCrop(RK_U32 *regs, RK_U32 origWidth, RK_U32 x, RK_U32 y)
+{
+    RK_U32 origMbW = (origWidth + 15) >> 4;
+    RK_U32 mbX = x >> 4;
+    RK_U32 mbY = y >> 4;
+    VPURegBatch_t batch, *b = &batch;
+
+    if (regs == NULL || (x & 15) || (y & 15))
+        return VPU_ERR;
+
+    if (VPURegGet(regs, HWIF_PP_PIPELINE_E)) {
+        ALOGE("cropping is a standalone job");
+        return VPU_ERR;
+    }
+
+    VPU_REG_BATCH_INIT(b);
+    VPU_REG_BATCH_ADD(b, HWIF_EXT_ORIG_WIDTH, origMbW);
+    VPU_REG_BATCH_ADD(b, HWIF_CROP_STARTX, mbX & 0x1ff);
+    VPU_REG_BATCH_ADD(b, HWIF_CROP_STARTX_EXT, mbX >> 9);
+    VPU_REG_BATCH_ADD(b, HWIF_CROP_STARTY, mbY & 0xff);
+    VPU_REG_BATCH_ADD(b, HWIF_CROP_STARTY_EXT, mbY >> 8);
+
+    return VPURegBatchApply(regs, b);
+}
+
+RK_S32 VPUDecPPSetOutputStride(RK_U32 *regs, RK_U32 displayWidth)
+{
+    if (regs == NULL || displayWidth > VPU_DEC_PP_MAX_DISPLAY_WIDTH ||
+        displayWidth < VPURegGet(regs, HWIF_PP_OUT_WIDTH))
+        return VPU_ERR;
+
+    if (VPURegGet(regs, HWIF_PP_OUT_LU_BASE) & 7) {
+        ALOGE("output at 0x%x is not 8 byte aligned", VPURegGet(regs, HWIF_PP_OUT_LU_BASE));
+        return VPU_ERR;
+    }
+
+    VPURegSet(regs, HWIF_DISPLAY_WIDTH, displayWidth);
+    return VPU_OK;
+}
@@ -0,0 +1,104 @@
+/***************************************************************************************************
+    File:
+        vpu_dec_pp.h
+    Description:
+        Post-processor register setup for VPU_DEC_PP submissions. In pipeline
+        mode the post-processor takes macroblocks straight from the decoder
+        and writes the scaled, rotated, colour converted picture, so video
+        reaches the display format without a decoded frame round trip through
+        memory and a separate RGA pass. Jobs the pipeline cannot take
+        (deinterlacing) use the same setup in standalone mode on a decoded
+        frame.
+ **************************************************************************************************/
+#ifndef __VPU_DEC_PP_H__
+#define __VPU_DEC_PP_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "vpu.h"
+#include "vpu_global.h"
+
+/* post-processor scaling limits */
+#define VPU_DEC_PP_MAX_UPSCALE          (3)
+#define VPU_DEC_PP_MAX_DOWNSCALE        (70)
+#define VPU_DEC_PP_MAX_OUT_WIDTH        (1920)
+#define VPU_DEC_PP_MAX_OUT_HEIGHT       (1920)
+/* widest row, in pixels, the output can be laid out in */
+#define VPU_DEC_PP_MAX_DISPLAY_WIDTH    (4095)
+
+/* VPU_POSTPROCESSING::RotateEn values */
+#define VPU_DEC_PP_ROTATE_NONE          (0)
+#define VPU_DEC_PP_ROTATE_RIGHT_90      (1)
+#define VPU_DEC_PP_ROTATE_LEFT_90       (2)
+#define VPU_DEC_PP_FLIP_HOR             (3)
+#define VPU_DEC_PP_FLIP_VER             (4)
+#define VPU_DEC_PP_ROTATE_180           (5)
+
+typedef enum
+{
+    VPU_DEC_PP_PIPELINE     = 0x0,  /* VPU_DEC_PP, input comes from the decoder */
+    VPU_DEC_PP_STANDALONE   = 0x1,  /* VPU_PP, input is InputAddr */
+    VPU_DEC_PP_MODE_BUTT    ,
+} VPU_DEC_PP_MODE;
+
+/* standalone input layouts, the decoders other than JPEG only produce 4:2:0 */
+typedef enum
+{
+    VPU_DEC_PP_IN_YUV420_SEMI   = 0x0,
+    VPU_DEC_PP_IN_YUV400        = 0x1,
+    VPU_DEC_PP_IN_YUV422_SEMI   = 0x2,
+    VPU_DEC_PP_IN_YUV440_SEMI   = 0x3,
+    VPU_DEC_PP_IN_YUV444_SEMI   = 0x4,
+    VPU_DEC_PP_IN_YUV411_SEMI   = 0x5,
+    VPU_DEC_PP_IN_BUTT          ,
+} VPU_DEC_PP_IN_FORMAT;
+
+/*
+ * Check pp against the post-processor limits. Returns VPU_OK when it can
+ * run in the given mode; deinterlacing needs both fields and is standalone
+ * only.
+ */
+RK_S32 VPUDecPPCheck(const VPU_POSTPROCESSING *pp, VPU_DEC_PP_MODE mode);
+
+/*
+ * Program the post-processor part of a VPU_REG_NUM_DEC_PP register array.
+ * In pipeline mode the decoder part must already be set up, the input size
+ * is checked against it, and discardDecOut stops the decoder writing its own
+ * output (only for pictures that are not used as reference).
+ */
+RK_S32 VPUDecPPSetup(RK_U32 *regs, const VPU_POSTPROCESSING *pp, VPU_DEC_PP_MODE mode,
+                     RK_U32 discardDecOut);
+
+/*
+ * Change the input layout of a standalone job after VPUDecPPSetup, which
+ * programs 4:2:0 semi-planar. InputAddr[1] is the interleaved chroma.
+ */
+RK_S32 VPUDecPPSetInputFormat(RK_U32 *regs, VPU_DEC_PP_IN_FORMAT format);
+
+/*
+ * Post-process a window of a standalone input picture. Call after
+ * VPUDecPPSetup with InputWidth / InputHeight set to the window size;
+ * origWidth is the width of the whole picture in memory, x and y are on
+ * the macroblock grid.
+ */
+RK_S32 VPUDecPPSetCrop(RK_U32 *regs, RK_U32 origWidth, RK_U32 x, RK_U32 y);
+
+/*
+ * Write the output into a picture displayWidth pixels per row instead of
+ * OutputWidth, e.g. a bitmap with padded rows. Call after VPUDecPPSetup;
+ * OutputAddr[0] must be 8 byte aligned.
+ */
+RK_S32 VPUDecPPSetOutputStride(RK_U32 *regs, RK_U32 displayWidth);
+
+/* the VPU_REG_NUM_PP registers to send on a VPU_PP client in standalone mode */
+#define VPU_DEC_PP_REGS(regs)           ((regs) + VPU_REG_NUM_DEC)
+
+#ifdef __cplusplus
+}
+
+#endif
+
+#endif /* __VPU_DEC_PP_H__ */
@@ -0,0 +1,405 @@
+/***************************************************************************************************
+    File:
+        vpu_dec_seek.c
+    Description:
+        Seek and trick play packet filtering in front of VpuCodecContext::decode
+ **************************************************************************************************/
+#define LOG_TAG "vpu_dec_seek"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_dec_seek.h"
+
+#define SEEK_NOPTS              ((RK_S64)VPU_API_NOPTS_VALUE)
+/* enough payload for first_mb_in_slice and slice_type of any 1080p slice */
+#define SEEK_SLICE_HDR_BYTES    (16)
+
+#define H264_NAL_SLICE          (1)
+#define H264_NAL_IDR            (5)
+
+struct VpuDecSeek {
+    VpuCodecContext_t   *ctx;
+    pthread_mutex_t     lock;
+    RK_U32              nalLengthSize;
+
+    VPU_DEC_SEEK_MODE   mode;
+    RK_S32              idrOnly;
+    RK_S32              waitKey;        /* drop until a restart point */
+    RK_S64              targetUs;
+    RK_S32              seeking;        /* no displayable frame since the seek */
+    RK_S64              seekStartUs;
+
+    VpuDecSeekStats_t   stats;
+};
+
+static RK_S64 seek_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct SeekBits {
+    RK_U8   buf[SEEK_SLICE_HDR_BYTES];
+    RK_U32  size;
+    RK_U32  pos;                /* in bits */
+} SeekBits_t;
+
+/* copy the start of a NAL payload without emulation prevention bytes */
+static void seek_bits_init(SeekBits_t *bits, const RK_U8 *data, RK_U32 size)
+{
+    RK_U32 i, zeros = 0;
+
+    bits->size = 0;
+    bits->pos = 0;
+    for (i = 0; i < size && bits->size < SEEK_SLICE_HDR_BYTES; i++) {
+        if (zeros >= 2 && data[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = data[i] ? 0 : zeros + 1;
+        bits->buf[bits->size++] = data[i];
+    }
+}
+
+static RK_S32 seek_bits_ue(SeekBits_t *bits, RK_U32 *val)
+{
+    RK_U32 lead = 0, v = 0, i;
+
+    for (;;) {
+        if (bits->pos >= bits->size * 8 || lead > 31)
+            return VPU_ERR;
+        if ((bits->buf[bits->pos >> 3] >> (7 - (bits->pos & 7))) & 1)
+            break;
+        lead++;
+        bits->pos++;
+    }
+    bits->pos++;
+
+    for (i = 0; i < lead; i++, bits->pos++) {
+        if (bits->pos >= bits->size * 8)
+            return VPU_ERR;
+        v = (v << 1) | ((bits->buf[bits->pos >> 3] >> (7 - (bits->pos & 7))) & 1);
+    }
+    *val = (1u << lead) - 1 + v;
+    return VPU_OK;
+}
+
+/* the first VCL NAL decides for the whole packet, one picture per packet */
+static RK_S32 seek_classify_nal(const RK_U8 *nal, RK_U32 size, VpuDecSeekPic_t *pic)
+{
+    RK_U32 type, firstMb, sliceType;
+    SeekBits_t bits;
+
+    if (!size)
+        return VPU_ERR;
+
+    type = nal[0] & 0x1f;
+    if (type != H264_NAL_SLICE && type != H264_NAL_IDR)
+        return VPU_ERR;
+
+    pic->reference = (nal[0] >> 5) & 3 ? 1 : 0;
+    pic->idr = type == H264_NAL_IDR;
+    pic->key = pic->idr;
+    if (!pic->idr) {
+        seek_bits_init(&bits, nal + 1, size - 1);
+        if (!seek_bits_ue(&bits, &firstMb) && !seek_bits_ue(&bits, &sliceType))
+            pic->key = (sliceType % 5) == 2 || (sliceType % 5) == 4;    /* I or SI */
+    }
+    return VPU_OK;
+}
+
+static RK_S32 seek_classify_avc(RK_U32 nalLengthSize, const RK_U8 *data, RK_U32 size,
+                                VpuDecSeekPic_t *pic)
+{
+    RK_U32 i, len, start;
+
+    if (nalLengthSize) {
+        for (i = 0; i + nalLengthSize <= size; i += len) {
+            RK_U32 k;
+
+            for (k = 0, len = 0; k < nalLengthSize; k++)
+                len = (len << 8) | data[i + k];
+            i += nalLengthSize;
+            if (len > size - i)
+                return VPU_ERR;
+            if (!seek_classify_nal(data + i, len, pic))
+                return VPU_OK;
+        }
+        return VPU_ERR;
+    }
+
+    /* Annex B, a NAL runs to the next start code */
+    for (i = 0; i + 3 <= size; i++) {
+        if (data[i] || data[i + 1] || data[i + 2] != 1)
+            continue;
+        start = i + 3;
+        for (i = start; i + 3 <= size; i++) {
+            if (!data[i] && !data[i + 1] && data[i + 2] <= 1)
+                break;
+        }
+        len = (i + 3 <= size) ? i - start : size - start;
+        if (!seek_classify_nal(data + start, len, pic))
+            return VPU_OK;
+        i--;
+    }
+    return VPU_ERR;
+}
+
+/* first picture header after a 00 00 01 <code> start code */
+static const RK_U8 *seek_find_start(const RK_U8 *data, RK_U32 size, RK_U8 code, RK_U32 need)
+{
+    RK_U32 i;
+
+    for (i = 0; i + 4 + need <= size; i++) {
+        if (!data[i] && !data[i + 1] && data[i + 2] == 1 && data[i + 3] == code)
+            return data + i + 4;
+    }
+    return NULL;
+}
+
+RK_S32 VpuDecSeekClassify(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 nalLengthSize,
+                          const RK_U8 *data, RK_U32 size, VpuDecSeekPic_t *pic)
+{
+    const RK_U8 *hdr;
+    RK_U32 type;
+
+    if (data == NULL || !size || pic == NULL || nalLengthSize > 4)
+        return VPU_ERR;
+
+    memset(pic, 0, sizeof(*pic));
+
+    switch (coding) {
+    case OMX_ON2_VIDEO_CodingAVC:
+        return seek_classify_avc(nalLengthSize, data, size, pic);
+    case OMX_ON2_VIDEO_CodingMPEG2:
+        /* picture_coding_type after the 10 bit temporal_reference */
+        hdr = seek_find_start(data, size, 0x00, 2);
+        if (hdr == NULL)
+            return VPU_ERR;
+        type = (hdr[1] >> 3) & 7;
+        if (type < 1 || type > 3)
+            return VPU_ERR;
+        pic->key = type == 1;
+        pic->reference = type != 3;
+        break;
+    case OMX_ON2_VIDEO_CodingMPEG4:
+        /* vop_coding_type: I, P, B, S(GMC) */
+        hdr = seek_find_start(data, size, 0xb6, 1);
+        if (hdr == NULL)
+            return VPU_ERR;
+        type = hdr[0] >> 6;
+        pic->key = type == 0;
+        pic->reference = type != 2;
+        break;
+    case OMX_ON2_VIDEO_CodingVP8:
+        /* frame tag; golden / altref refresh flags sit in the compressed header */
+        pic->key = !(data[0] & 1);
+        pic->reference = 1;
+        break;
+    case OMX_ON2_VIDEO_CodingMJPEG:
+        pic->key = 1;
+        pic->reference = 0;
+        break;
+    default:
+        return VPU_ERR;
+    }
+
+    pic->idr = pic->key;
+    return VPU_OK;
+}
+
+VpuDecSeek_t *VpuDecSeekCreate(VpuCodecContext_t *ctx)
+{
+    VpuDecSeek_t *ds;
+
+    if (ctx == NULL || ctx->codecType != CODEC_DECODER)
+        return NULL;
+
+    ds = (VpuDecSeek_t *)calloc(1, sizeof(VpuDecSeek_t));
+    if (ds == NULL)
+        return NULL;
+
+    ds->ctx = ctx;
+    ds->mode = VPU_DEC_SEEK_MODE_NORMAL;
+    ds->targetUs = SEEK_NOPTS;
+    /* avcC extradata, the packets carry length prefixed NAL units */
+    if (ctx->videoCoding == OMX_ON2_VIDEO_CodingAVC && ctx->extradata != NULL &&
+        ctx->extradata_size >= 7 && ctx->extradata[0] == 1)
+        ds->nalLengthSize = (ctx->extradata[4] & 3) + 1;
+    pthread_mutex_init(&ds->lock, NULL);
+
+    return ds;
+}
+
+void VpuDecSeekDestroy(VpuDecSeek_t *ds)
+{
+    if (ds == NULL)
+        return;
+
+    pthread_mutex_destroy(&ds->lock);
+    free(ds);
+}
+
+RK_S32 VpuDecSeekSetMode(VpuDecSeek_t *ds, VPU_DEC_SEEK_MODE mode)
+{
+    if (ds == NULL || mode >= VPU_DEC_SEEK_MODE_BUTT)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&ds->lock);
+    /* pictures the dropped ones referred to are missing, start over on a key */
+    if (mode < ds->mode)
+        ds->waitKey = 1;
+    ds->mode = mode;
+    pthread_mutex_unlock(&ds->lock);
+
+    return VPU_OK;
+}
+
+RK_S32 VpuDecSeekSetIdrOnly(VpuDecSeek_t *ds, RK_S32 idrOnly)
+{
+    if (ds == NULL)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&ds->lock);
+    ds->idrOnly = idrOnly ? 1 : 0;
+    pthread_mutex_unlock(&ds->lock);
+
+    return VPU_OK;
+}
+
+RK_S32 VpuDecSeekSeek(VpuDecSeek_t *ds, RK_S64 targetUs)
+{
+    RK_S32 ret = 0;
+
+    if (ds == NULL)
+        return VPU_ERR;
+
+    /*
+     * Held across the flush: a key picture filtered while the codec flushes
+     * would clear waitKey and then be thrown away with the old GOP, letting
+     * the pictures after it reach an empty decoder.
+     */
+    pthread_mutex_lock(&ds->lock);
+    ds->seekStartUs = seek_now_us();
+    if (ds->ctx->flush)
+        ret = ds->ctx->flush(ds->ctx);
+    ds->targetUs = targetUs;
+    ds->waitKey = 1;
+    ds->seeking = 1;
+    ds->stats.seeks++;
+    pthread_mutex_unlock(&ds->lock);
+
+    if (ret)
+        ALOGE("flush failed %d", ret);
+
+    return ret ? VPU_ERR : VPU_OK;
+}
+
+RK_S32 VpuDecSeekFilter(VpuDecSeek_t *ds, VideoPacket_t *pkt)
+{
+    VpuDecSeekPic_t pic;
+    RK_S32 ret = VPU_DEC_SEEK_OK;
+
+    if (ds == NULL || pkt == NULL)
+        return VPU_DEC_SEEK_ERROR;
+
+    /* end of stream and drain packets always go through */
+    if (pkt->data == NULL || pkt->size <= 0)
+        return VPU_DEC_SEEK_OK;
+
+    pthread_mutex_lock(&ds->lock);
+    ds->stats.packets++;
+
+    if (VpuDecSeekClassify(ds->ctx->videoCoding, ds->nalLengthSize, pkt->data, pkt->size, &pic)) {
+        /* parameter sets and the like, or a coding we cannot parse */
+        ds->stats.unknownPackets++;
+    } else if (ds->waitKey) {
+        if (!pic.key || (ds->idrOnly && !pic.idr)) {
+            ds->stats.skippedWaitKey++;
+            ret = VPU_DEC_SEEK_SKIPPED;
+        } else {
+            ds->waitKey = 0;
+        }
+    } else if ((ds->mode == VPU_DEC_SEEK_MODE_KEY_ONLY && !pic.key) ||
+               (ds->mode == VPU_DEC_SEEK_MODE_REF_ONLY && !pic.key && !pic.reference)) {
+        ds->stats.skippedNonRef++;
+        ret = VPU_DEC_SEEK_SKIPPED;
+    } else if (ds->seeking && ds->targetUs != SEEK_NOPTS && !pic.reference &&
+               pkt->pts != SEEK_NOPTS && pkt->pts < ds->targetUs) {
+        /* never shown and never referenced */
+        ds->stats.skippedPreroll++;
+        ret = VPU_DEC_SEEK_SKIPPED;
+    }
+    pthread_mutex_unlock(&ds->lock);
+
+    return ret;
+}
+
+RK_S32 VpuDecSeekFrameOut(VpuDecSeek_t *ds, DecoderOut_t *out)
+{
+    RK_S64 ttff;
+    RK_S32 ret = VPU_DEC_SEEK_OK;
+
+    if (ds == NULL || out == NULL)
+        return VPU_DEC_SEEK_ERROR;
+
+    if (!out->size)
+        return VPU_DEC_SEEK_OK;
+
+    pthread_mutex_lock(&ds->lock);
+    if (ds->seeking) {
+        if (ds->targetUs != SEEK_NOPTS && out->timeUs != SEEK_NOPTS &&
+            out->timeUs < ds->targetUs) {
+            ds->stats.prerollFrames++;
+            ret = VPU_DEC_SEEK_PREROLL;
+        } else {
+            ttff = seek_now_us() - ds->seekStartUs;
+            ds->stats.ttffCount++;
+            ds->stats.ttffLastUs = ttff;
+            ds->stats.ttffSumUs += ttff;
+            if (ttff > ds->stats.ttffMaxUs)
+                ds->stats.ttffMaxUs = ttff;
+            ds->seeking = 0;
+            ds->targetUs = SEEK_NOPTS;
+            ALOGV("first frame %lld us after seek", ttff);
+        }
+    }
+    pthread_mutex_unlock(&ds->lock);
+
+    return ret;
+}
+
+RK_S32 VpuDecSeekDecode(VpuDecSeek_t *ds, VideoPacket_t *pkt, DecoderOut_t *out)
+{
+    RK_S32 ret;
+
+    if (ds == NULL || pkt == NULL || out == NULL || ds->ctx->decode == NULL)
+        return VPU_DEC_SEEK_ERROR;
+
+    ret = VpuDecSeekFilter(ds, pkt);
+    if (ret != VPU_DEC_SEEK_OK) {
+        out->size = 0;
+        return ret;
+    }
+
+    if (ds->ctx->decode(ds->ctx, pkt, out))
+        return VPU_DEC_SEEK_ERROR;
+
+    return VpuDecSeekFrameOut(ds, out);
+}
+
+void VpuDecSeekGetStats(VpuDecSeek_t *ds, VpuDecSeekStats_t *stats)
+{
+    if (ds == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&ds->lock);
+    *stats = ds->stats;
+    pthread_mutex_unlock(&ds->lock);
+}
@@ -0,0 +1,98 @@
+/***************************************************************************************************
+    File:
+        vpu_dec_seek.h
+    Description:
+        Seek and trick play front end for a decoding VpuCodecContext. Each
+        packet is classified from its bitstream headers (key picture,
+        reference or not) before it reaches decode(), so that fast forward
+        can feed only reference or only key pictures, pictures nobody
+        references are dropped on the way to a seek target, and after a
+        flush the decoder restarts on the first IDR / I picture instead of
+        decoding a broken GOP. Time to first frame after each seek is
+        measured.
+ **************************************************************************************************/
+#ifndef _VPU_DEC_SEEK_H_
+#define _VPU_DEC_SEEK_H_
+
+#include "vpu_api.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VPU_DEC_SEEK_OK                 (0)
+#define VPU_DEC_SEEK_SKIPPED            (1)     /* packet not given to the decoder */
+#define VPU_DEC_SEEK_PREROLL            (2)     /* frame decoded before the seek target, not for display */
+#define VPU_DEC_SEEK_ERROR              (-1)
+
+typedef enum
+{
+    VPU_DEC_SEEK_MODE_NORMAL    = 0x0,  /* every picture */
+    VPU_DEC_SEEK_MODE_REF_ONLY  = 0x1,  /* drop non-reference pictures (B frames) */
+    VPU_DEC_SEEK_MODE_KEY_ONLY  = 0x2,  /* only IDR / I pictures */
+    VPU_DEC_SEEK_MODE_BUTT      ,
+} VPU_DEC_SEEK_MODE;
+
+typedef struct VpuDecSeekPic {
+    RK_S32 key;                 /* decodable without earlier pictures */
+    RK_S32 idr;                 /* H.264 IDR, key otherwise */
+    RK_S32 reference;           /* later pictures may refer to it */
+} VpuDecSeekPic_t;
+
+typedef struct VpuDecSeekStats {
+    RK_U32 seeks;
+    RK_U32 packets;
+    RK_U32 skippedNonRef;       /* dropped by REF_ONLY / KEY_ONLY */
+    RK_U32 skippedWaitKey;      /* dropped while waiting for a restart point */
+    RK_U32 skippedPreroll;      /* non-reference pictures before the seek target */
+    RK_U32 prerollFrames;       /* decoded before the target as references */
+    RK_U32 unknownPackets;      /* headers not recognised, passed through */
+    RK_U32 ttffCount;
+    RK_S64 ttffLastUs;          /* seek to first displayable frame */
+    RK_S64 ttffMaxUs;
+    RK_S64 ttffSumUs;
+} VpuDecSeekStats_t;
+
+typedef struct VpuDecSeek VpuDecSeek_t;
+
+/*
+ * Classify one packet of the given coding. nalLengthSize is 0 for Annex B
+ * H.264 and 1..4 for avcC length prefixed NAL units. Returns VPU_ERR when
+ * the headers are not understood.
+ */
+RK_S32 VpuDecSeekClassify(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 nalLengthSize,
+                          const RK_U8 *data, RK_U32 size, VpuDecSeekPic_t *pic);
+
+/* ctx is an initialised decoder and stays owned by the caller */
+VpuDecSeek_t *VpuDecSeekCreate(VpuCodecContext_t *ctx);
+void VpuDecSeekDestroy(VpuDecSeek_t *ds);
+
+RK_S32 VpuDecSeekSetMode(VpuDecSeek_t *ds, VPU_DEC_SEEK_MODE mode);
+/* accept only IDR as restart point for H.264, I slices otherwise count too */
+RK_S32 VpuDecSeekSetIdrOnly(VpuDecSeek_t *ds, RK_S32 idrOnly);
+
+/*
+ * Flush the codec and restart on the next key picture. Frames before
+ * targetUs are decoded only as needed for reference; VPU_API_NOPTS_VALUE
+ * shows the first frame decoded. Filter and FrameOut calls from other
+ * threads wait until the flush is done.
+ */
+RK_S32 VpuDecSeekSeek(VpuDecSeek_t *ds, RK_S64 targetUs);
+
+/*
+ * Filter + decode() + FrameOut. Callers with their own decode loop (e.g.
+ * VpuDecPipeline) use Filter before sending a packet and FrameOut on each
+ * frame that comes back.
+ */
+RK_S32 VpuDecSeekDecode(VpuDecSeek_t *ds, VideoPacket_t *pkt, DecoderOut_t *out);
+RK_S32 VpuDecSeekFilter(VpuDecSeek_t *ds, VideoPacket_t *pkt);
+RK_S32 VpuDecSeekFrameOut(VpuDecSeek_t *ds, DecoderOut_t *out);
+
+void VpuDecSeekGetStats(VpuDecSeek_t *ds, VpuDecSeekStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VPU_DEC_SEEK_H_ */
@@ -0,0 +1,266 @@
+/***************************************************************************************************
+    File:
+        vpu_dec_seek_test.c
+    Description:
+        Test of the seek and trick play filter on a fake decoder. Builds for
+        the host:
+
+            vpu_dec_seek_test
+
+        Covers packet classification for Annex B and length prefixed H.264,
+        MPEG-2, MPEG-4 part 2 and VP8, the reference only and key only trick
+        modes, restarting on a key picture after a seek, pre-roll before the
+        seek target, and a key picture filtered while the seek flushes the
+        codec.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "vpu_macro.h"
+#include "vpu_dec_seek.h"
+
+#define TEST_FLUSH_MS               (20)
+
+/* one picture per packet, decoded straight out with the packet's pts */
+typedef struct
+{
+    RK_U32              decoded;
+    RK_U32              flushes;
+    volatile RK_U32     flushDone;
+    VpuDecSeek_t        *ds;
+    pthread_t           racer;
+    RK_S32              racerRet;
+    RK_U32              racerSawFlush;
+} FakeDecoder_t;
+
+/* Annex B IDR, P and B slices and an SPS, first_mb_in_slice 0 */
+static const RK_U8 avcIdr[] = { 0, 0, 0, 1, 0x65, 0x88, 0x84, 0x00 };
+static const RK_U8 avcI[]   = { 0, 0, 0, 1, 0x41, 0xb8, 0x00, 0x00 };     /* ue 0, ue 2: I */
+static const RK_U8 avcP[]   = { 0, 0, 0, 1, 0x41, 0x9a, 0x00, 0x00 };     /* ue 0, ue 5: P */
+static const RK_U8 avcB[]   = { 0, 0, 0, 1, 0x01, 0x9e, 0x00, 0x00 };     /* ue 0, ue 6: B */
+static const RK_U8 avcSps[] = { 0, 0, 0, 1, 0x67, 0x42, 0x00, 0x1e };
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+static RK_S32 fake_decode(VpuCodecContext_t *ctx, VideoPacket_t *pkt, DecoderOut_t *out)
+{
+    FakeDecoder_t *d = (FakeDecoder_t *)ctx->private_data;
+
+    d->decoded++;
+    out->size = 1;
+    out->timeUs = pkt->pts;
+    return 0;
+}
+
+static void *fake_racer(void *arg)
+{
+    FakeDecoder_t *d = (FakeDecoder_t *)arg;
+    VideoPacket_t pkt;
+
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.data = (RK_U8 *)avcIdr;
+    pkt.size = sizeof(avcIdr);
+    pkt.pts = 0;
+    d->racerRet = VpuDecSeekFilter(d->ds, &pkt);
+    d->racerSawFlush = d->flushDone;
+    return NULL;
+}
+
+/* a key picture arrives from the feeder while the codec is flushing */
+static RK_S32 fake_flush(VpuCodecContext_t *ctx)
+{
+    FakeDecoder_t *d = (FakeDecoder_t *)ctx->private_data;
+
+    d->flushes++;
+    d->flushDone = 0;
+    if (d->ds != NULL)
+        pthread_create(&d->racer, NULL, fake_racer, d);
+    usleep(TEST_FLUSH_MS * 1000);
+    d->flushDone = 1;
+    return 0;
+}
+
+static void fake_init(VpuCodecContext_t *ctx, FakeDecoder_t *d)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    memset(d, 0, sizeof(*d));
+    ctx->codecType = CODEC_DECODER;
+    ctx->videoCoding = OMX_ON2_VIDEO_CodingAVC;
+    ctx->private_data = d;
+    ctx->decode = fake_decode;
+    ctx->flush = fake_flush;
+}
+
+static RK_S32 test_classify(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 nalLengthSize,
+                            const RK_U8 *data, RK_U32 size)
+{
+    VpuDecSeekPic_t pic;
+
+    if (VpuDecSeekClassify(coding, nalLengthSize, data, size, &pic))
+        return -1;
+    return pic.key << 2 | pic.idr << 1 | pic.reference;
+}
+
+static void test_classification(void)
+{
+    /* length prefixed: 2 byte SPS, then the P slice */
+    static const RK_U8 avccP[] = { 0, 2, 0x67, 0x42, 0, 4, 0x41, 0x9a, 0x00, 0x00 };
+    /* picture start code, temporal_reference then picture_coding_type */
+    static const RK_U8 m2vI[] = { 0, 0, 1, 0x00, 0x00, 0x0f, 0xff, 0xf8 };
+    static const RK_U8 m2vB[] = { 0, 0, 1, 0x00, 0x00, 0x1f, 0xff, 0xf8 };
+    /* VOP start code, vop_coding_type in the top two bits */
+    static const RK_U8 m4vP[] = { 0, 0, 1, 0xb6, 0x40, 0x00 };
+    static const RK_U8 m4vB[] = { 0, 0, 1, 0xb6, 0x80, 0x00 };
+    static const RK_U8 vp8Key[] = { 0x10, 0x02, 0x00, 0x9d, 0x01, 0x2a };
+    static const RK_U8 vp8Inter[] = { 0x31, 0x02, 0x00 };
+
+    check_eq("classify: avc idr", test_classify(OMX_ON2_VIDEO_CodingAVC, 0, avcIdr,
+             sizeof(avcIdr)), 7);
+    check_eq("classify: avc I", test_classify(OMX_ON2_VIDEO_CodingAVC, 0, avcI, sizeof(avcI)), 5);
+    check_eq("classify: avc P", test_classify(OMX_ON2_VIDEO_CodingAVC, 0, avcP, sizeof(avcP)), 1);
+    check_eq("classify: avc B", test_classify(OMX_ON2_VIDEO_CodingAVC, 0, avcB, sizeof(avcB)), 0);
+    check_eq("classify: avc sps", test_classify(OMX_ON2_VIDEO_CodingAVC, 0, avcSps,
+             sizeof(avcSps)), -1);
+    check_eq("classify: avcC P", test_classify(OMX_ON2_VIDEO_CodingAVC, 2, avccP,
+             sizeof(avccP)), 1);
+    check_eq("classify: avcC truncated", test_classify(OMX_ON2_VIDEO_CodingAVC, 2, avccP, 7), -1);
+    check_eq("classify: mpeg2 I", test_classify(OMX_ON2_VIDEO_CodingMPEG2, 0, m2vI,
+             sizeof(m2vI)), 7);
+    check_eq("classify: mpeg2 B", test_classify(OMX_ON2_VIDEO_CodingMPEG2, 0, m2vB,
+             sizeof(m2vB)), 0);
+    check_eq("classify: mpeg4 P", test_classify(OMX_ON2_VIDEO_CodingMPEG4, 0, m4vP,
+             sizeof(m4vP)), 1);
+    check_eq("classify: mpeg4 B", test_classify(OMX_ON2_VIDEO_CodingMPEG4, 0, m4vB,
+             sizeof(m4vB)), 0);
+    check_eq("classify: vp8 key", test_classify(OMX_ON2_VIDEO_CodingVP8, 0, vp8Key,
+             sizeof(vp8Key)), 7);
+    check_eq("classify: vp8 inter", test_classify(OMX_ON2_VIDEO_CodingVP8, 0, vp8Inter,
+             sizeof(vp8Inter)), 1);
+}
+
+static RK_S32 test_decode(VpuDecSeek_t *ds, const RK_U8 *data, RK_U32 size, RK_S64 pts)
+{
+    VideoPacket_t pkt;
+    DecoderOut_t out;
+
+    memset(&pkt, 0, sizeof(pkt));
+    memset(&out, 0, sizeof(out));
+    pkt.data = (RK_U8 *)data;
+    pkt.size = size;
+    pkt.pts = pts;
+    return VpuDecSeekDecode(ds, &pkt, &out);
+}
+
+#define TEST_DECODE(ds, pic, pts)   test_decode(ds, pic, sizeof(pic), pts)
+
+static void test_trick_modes(void)
+{
+    VpuCodecContext_t ctx;
+    FakeDecoder_t dec;
+    VpuDecSeekStats_t stats;
+    VpuDecSeek_t *ds;
+
+    fake_init(&ctx, &dec);
+    ds = VpuDecSeekCreate(&ctx);
+    if (ds == NULL) {
+        check(0, "mode: create");
+        return;
+    }
+
+    VpuDecSeekSetMode(ds, VPU_DEC_SEEK_MODE_REF_ONLY);
+    check_eq("mode: ref only keeps P", TEST_DECODE(ds, avcP, 0), VPU_DEC_SEEK_OK);
+    check_eq("mode: ref only drops B", TEST_DECODE(ds, avcB, 0), VPU_DEC_SEEK_SKIPPED);
+
+    VpuDecSeekSetMode(ds, VPU_DEC_SEEK_MODE_KEY_ONLY);
+    check_eq("mode: key only drops P", TEST_DECODE(ds, avcP, 0), VPU_DEC_SEEK_SKIPPED);
+    check_eq("mode: key only keeps I", TEST_DECODE(ds, avcI, 0), VPU_DEC_SEEK_OK);
+
+    /* back to normal speed the dropped pictures are missing, wait for a key */
+    VpuDecSeekSetMode(ds, VPU_DEC_SEEK_MODE_NORMAL);
+    check_eq("mode: normal waits for a key", TEST_DECODE(ds, avcB, 0), VPU_DEC_SEEK_SKIPPED);
+    VpuDecSeekSetIdrOnly(ds, 1);
+    check_eq("mode: idr only skips I", TEST_DECODE(ds, avcI, 0), VPU_DEC_SEEK_SKIPPED);
+    check_eq("mode: idr restarts", TEST_DECODE(ds, avcIdr, 0), VPU_DEC_SEEK_OK);
+    check_eq("mode: then everything", TEST_DECODE(ds, avcB, 0), VPU_DEC_SEEK_OK);
+    check_eq("mode: parameter sets pass", TEST_DECODE(ds, avcSps, 0), VPU_DEC_SEEK_OK);
+
+    VpuDecSeekGetStats(ds, &stats);
+    check_eq("mode: skipped non-ref", stats.skippedNonRef, 2);
+    check_eq("mode: skipped waiting", stats.skippedWaitKey, 2);
+    check_eq("mode: unknown", stats.unknownPackets, 1);
+    check_eq("mode: decoded", dec.decoded, 5);
+
+    VpuDecSeekDestroy(ds);
+}
+
+static void test_seek(void)
+{
+    VpuCodecContext_t ctx;
+    FakeDecoder_t dec;
+    VpuDecSeekStats_t stats;
+    VpuDecSeek_t *ds;
+
+    fake_init(&ctx, &dec);
+    ds = VpuDecSeekCreate(&ctx);
+    if (ds == NULL) {
+        check(0, "seek: create");
+        return;
+    }
+
+    /* the racer's key picture only gets through once the flush is done */
+    dec.ds = ds;
+    check_eq("seek", VpuDecSeekSeek(ds, 100000), VPU_OK);
+    pthread_join(dec.racer, NULL);
+    dec.ds = NULL;
+    check_eq("seek: flushed", dec.flushes, 1);
+    check_eq("seek: racer key passed", dec.racerRet, VPU_DEC_SEEK_OK);
+    check(dec.racerSawFlush, "seek: racer waited for the flush");
+
+    /* a second seek, the key picture comes after it */
+    check_eq("seek: again", VpuDecSeekSeek(ds, 100000), VPU_OK);
+    check_eq("seek: P before the key", TEST_DECODE(ds, avcP, 0), VPU_DEC_SEEK_SKIPPED);
+    check_eq("seek: key before the target", TEST_DECODE(ds, avcIdr, 33333),
+             VPU_DEC_SEEK_PREROLL);
+    check_eq("seek: B before the target", TEST_DECODE(ds, avcB, 66666), VPU_DEC_SEEK_SKIPPED);
+    check_eq("seek: P before the target", TEST_DECODE(ds, avcP, 66666), VPU_DEC_SEEK_PREROLL);
+    check_eq("seek: target shown", TEST_DECODE(ds, avcB, 100000), VPU_DEC_SEEK_OK);
+    check_eq("seek: after the target", TEST_DECODE(ds, avcB, 133333), VPU_DEC_SEEK_OK);
+
+    VpuDecSeekGetStats(ds, &stats);
+    check_eq("seek: seeks", stats.seeks, 2);
+    check_eq("seek: preroll frames", stats.prerollFrames, 2);
+    check_eq("seek: preroll skipped", stats.skippedPreroll, 1);
+    check_eq("seek: ttff count", stats.ttffCount, 1);
+    check(stats.ttffLastUs >= 0 && stats.ttffMaxUs >= stats.ttffLastUs, "seek: ttff");
+
+    VpuDecSeekDestroy(ds);
+}
+
+int main(void)
+{
+    test_classification();
+    test_trick_modes();
+    test_seek();
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
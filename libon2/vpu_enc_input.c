@@ -0,0 +1,368 @@
+/***************************************************************************************************
+    File:
+        vpu_enc_input.c
+    Description:
+        Encoder input by physical address from gralloc / UMP buffers
+ **************************************************************************************************/
+#define LOG_TAG "vpu_enc_input"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cutils/log.h>
+#include <system/graphics.h>
+
+#include "vpu_macro.h"
+#include "vpu_enc_input.h"
+#include "gralloc_buffer_phys.h"
+#include "gralloc_ump_cache.h"
+#include "ump/include/ump/ump_ref_drv.h"
+
+/* framebuffer handles have no secure id, they are keyed by offset */
+#define ENC_KEY_FB_FLAG         (0x80000000)
+
+typedef struct EncInputEntry
+{
+    RK_U32  valid;
+    RK_U32  key;
+    RK_U32  phys;               /* 0 when the buffer has no usable address */
+    RK_U32  lastUse;
+} EncInputEntry_t;
+
+typedef struct EncInputSrc
+{
+    RK_U32          key;
+    RK_S32          halFormat;
+    RK_U32          stride;     /* pixels */
+    RK_U32          size;
+    void            *base;
+    buffer_handle_t handle;     /* NULL for UMP ids */
+    RK_U32          secureId;
+    RK_U32          framebuffer;
+} EncInputSrc_t;
+
+struct VPUEncInput
+{
+    VpuCodecContext_t   *ctx;
+    RK_S32              curFormat;
+    RK_U32              useCount;
+    EncInputEntry_t     cache[VPU_ENC_INPUT_CACHE_SIZE];
+    RK_U8               *stage;         /* packed copy for strided buffers */
+    RK_U32              stageSize;
+    pthread_mutex_t     lock;
+    VPUEncInputStats_t  stats;
+};
+
+RK_S32 VPUEncInputPictureType(RK_S32 halFormat)
+{
+    switch (halFormat) {
+    case HAL_PIXEL_FORMAT_YCrCb_NV12:
+        return VPU_H264ENC_YUV420_SEMIPLANAR;
+    case HAL_PIXEL_FORMAT_RGB_565:
+        return VPU_H264ENC_RGB565;
+    /* 32 bit words read little endian: BGRA in memory is 0xAARRGGBB */
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        return VPU_H264ENC_RGB888;
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+        return VPU_H264ENC_BGR888;
+    default:
+        return -1;
+    }
+}
+
+/* bits per pixel of the picture types VPUEncInputPictureType returns */
+static RK_U32 enc_input_bpp(RK_S32 picType)
+{
+    switch (picType) {
+    case VPU_H264ENC_YUV420_SEMIPLANAR:
+        return 12;
+    case VPU_H264ENC_RGB565:
+        return 16;
+    default:
+        return 32;
+    }
+}
+
+VPUEncInput_t *VPUEncInputCreate(VpuCodecContext_t *ctx)
+{
+    VPUEncInput_t *in;
+
+    if (ctx == NULL || ctx->codecType != CODEC_ENCODER || ctx->encode == NULL ||
+        !ctx->width || !ctx->height)
+        return NULL;
+
+    in = (VPUEncInput_t *)calloc(1, sizeof(VPUEncInput_t));
+    if (in == NULL)
+        return NULL;
+
+    in->ctx = ctx;
+    in->curFormat = -1;
+    pthread_mutex_init(&in->lock, NULL);
+
+    return in;
+}
+
+void VPUEncInputDestroy(VPUEncInput_t *in)
+{
+    if (in == NULL)
+        return;
+
+    pthread_mutex_destroy(&in->lock);
+    free(in->stage);
+    free(in);
+}
+
+static RK_U32 enc_input_resolve(const EncInputSrc_t *src)
+{
+    unsigned int phys = 0;
+    int ret;
+
+    if (src->handle != NULL)
+        ret = gralloc_buffer_phys_get(src->handle, &phys);
+    else
+        ret = gralloc_ump_phys_get((ump_secure_id)src->secureId, &phys);
+
+    if (ret < 0) {
+        ALOGD("buffer 0x%x has no physical address (%d), encoding from a copy", src->key, ret);
+        return 0;
+    }
+
+    return phys;
+}
+
+/* cached physical address of src, call with in->lock held */
+static RK_U32 enc_input_lookup(VPUEncInput_t *in, const EncInputSrc_t *src)
+{
+    EncInputEntry_t *e, *victim = NULL;
+    RK_U32 i;
+
+    in->useCount++;
+    for (i = 0; i < VPU_ENC_INPUT_CACHE_SIZE; i++) {
+        e = &in->cache[i];
+        if (e->valid && e->key == src->key) {
+            e->lastUse = in->useCount;
+            in->stats.cacheHits++;
+            return e->phys;
+        }
+        if (victim == NULL || !e->valid || (victim->valid && e->lastUse < victim->lastUse))
+            victim = e;
+    }
+
+    /* negative results are kept as well so a copy-only buffer is not probed every frame */
+    in->stats.resolves++;
+    victim->valid = 1;
+    victim->key = src->key;
+    victim->phys = enc_input_resolve(src);
+    victim->lastUse = in->useCount;
+
+    return victim->phys;
+}
+
+/*
+ * Write back what the CPU drew before the encoder reads the buffer by
+ * physical address. The framebuffer is mapped uncached; UMP buffers are
+ * cleaned through libUMP, which is a no-op for uncached ones. Anything else
+ * cannot be cleaned from here and goes through the copy.
+ *
+ * The clean goes through the cached mapping of the id: EncodeUmp callers
+ * pass no address, and libUMP wants one mapped through the handle it is
+ * given.
+ */
+static RK_S32 enc_input_clean(const EncInputSrc_t *src)
+{
+    ump_handle h;
+    void *addr;
+
+    if (src->framebuffer)
+        return 0;
+    if (src->secureId == (RK_U32)UMP_INVALID_SECURE_ID)
+        return -1;
+
+    addr = gralloc_ump_cache_map((ump_secure_id)src->secureId, &h);
+    if (addr == NULL)
+        return -1;
+
+    ump_cpu_msync_now(h, UMP_MSYNC_CLEAN, addr, src->size);
+    gralloc_ump_cache_unmap((ump_secure_id)src->secureId, h);
+    return 0;
+}
+
+/* repack a strided picture to the width the encoder expects */
+static RK_U8 *enc_input_pack(VPUEncInput_t *in, const RK_U8 *base, RK_U32 stride, RK_S32 picType,
+                             RK_U32 frameBytes)
+{
+    RK_U32 w = in->ctx->width;
+    RK_U32 h = in->ctx->height;
+    RK_U32 rowBytes, srcRowBytes, rows, y;
+    RK_U8 *dst;
+
+    if (in->stageSize < frameBytes) {
+        free(in->stage);
+        in->stage = (RK_U8 *)malloc(frameBytes);
+        in->stageSize = in->stage ? frameBytes : 0;
+        if (in->stage == NULL)
+            return NULL;
+    }
+
+    if (picType == VPU_H264ENC_YUV420_SEMIPLANAR) {
+        rowBytes = w;
+        srcRowBytes = stride;
+        /* the CbCr plane follows stride x height luma bytes at the same pitch */
+        rows = h + h / 2;
+    } else {
+        RK_U32 bytes = enc_input_bpp(picType) / 8;
+        rowBytes = w * bytes;
+        srcRowBytes = stride * bytes;
+        rows = h;
+    }
+
+    dst = in->stage;
+    for (y = 0; y < rows; y++)
+        memcpy(dst + y * rowBytes, base + y * srcRowBytes, rowBytes);
+
+    return in->stage;
+}
+
+static RK_S32 enc_input_encode(VPUEncInput_t *in, const EncInputSrc_t *src, RK_S64 timeUs,
+                               EncoderOut_t *out)
+{
+    VpuCodecContext_t *ctx = in->ctx;
+    EncInputStream_t strm;
+    ump_handle umpHandle = UMP_INVALID_MEMORY_HANDLE;
+    const RK_U8 *base = (const RK_U8 *)src->base;
+    RK_S32 picType = VPUEncInputPictureType(src->halFormat);
+    RK_U32 frameBytes, srcBytes, phys;
+    RK_S32 ret;
+
+    if (picType < 0) {
+        ALOGE("format 0x%x can not be encoded directly", src->halFormat);
+        return VPU_ERR;
+    }
+
+    frameBytes = ctx->width * ctx->height * enc_input_bpp(picType) / 8;
+    /* the pack reads whole source rows, stride pixels apart */
+    srcBytes = src->stride * ctx->height * enc_input_bpp(picType) / 8;
+    if (src->stride < ctx->width || src->size < srcBytes) {
+        ALOGE("buffer 0x%x too small: stride %d size %d for %dx%d", src->key, src->stride,
+              src->size, ctx->width, ctx->height);
+        return VPU_ERR;
+    }
+
+    pthread_mutex_lock(&in->lock);
+
+    if (picType != in->curFormat) {
+        if (ctx->control == NULL || ctx->control(ctx, VPU_API_ENC_SETFORMAT, &picType)) {
+            pthread_mutex_unlock(&in->lock);
+            ALOGE("encoder refused input format %d", picType);
+            return VPU_ERR;
+        }
+        in->curFormat = picType;
+        in->stats.formatChanges++;
+    }
+
+    phys = enc_input_lookup(in, src);
+
+    memset(&strm, 0, sizeof(strm));
+    strm.size = frameBytes;
+    strm.timeUs = timeUs;
+
+    /* the encoder has no pitch setting, so only unpadded buffers go in directly */
+    if (phys && src->stride == ctx->width && !enc_input_clean(src)) {
+        strm.bufPhyAddr = phys;
+        in->stats.zeroCopy++;
+    } else {
+        if (base == NULL && src->handle == NULL)
+            base = (const RK_U8 *)gralloc_ump_cache_map((ump_secure_id)src->secureId, &umpHandle);
+        if (base == NULL) {
+            pthread_mutex_unlock(&in->lock);
+            ALOGE("buffer 0x%x is not mapped", src->key);
+            return VPU_ERR;
+        }
+
+        if (src->stride != ctx->width)
+            strm.buf = enc_input_pack(in, base, src->stride, picType, frameBytes);
+        else
+            strm.buf = (RK_U8 *)base;
+        in->stats.copied++;
+    }
+    in->stats.frames++;
+
+    if (strm.buf == NULL && !strm.bufPhyAddr)
+        ret = VPU_ERR;
+    else
+        ret = ctx->encode(ctx, &strm, out);
+
+    if (umpHandle != UMP_INVALID_MEMORY_HANDLE)
+        gralloc_ump_cache_unmap((ump_secure_id)src->secureId, umpHandle);
+
+    pthread_mutex_unlock(&in->lock);
+
+    return ret;
+}
+
+RK_S32 VPUEncInputEncodeHandle(VPUEncInput_t *in, buffer_handle_t handle, RK_S64 timeUs,
+                               EncoderOut_t *out)
+{
+    struct gralloc_buffer_desc desc;
+    EncInputSrc_t src;
+
+    if (in == NULL || out == NULL || gralloc_buffer_describe(handle, &desc) < 0)
+        return VPU_ERR;
+
+    memset(&src, 0, sizeof(src));
+    src.key = desc.framebuffer ? (ENC_KEY_FB_FLAG | (RK_U32)desc.offset) : (RK_U32)desc.secure_id;
+    src.halFormat = desc.format;
+    src.stride = desc.stride;
+    src.size = desc.size;
+    src.base = desc.base;
+    src.handle = handle;
+    src.secureId = desc.secure_id;
+    src.framebuffer = desc.framebuffer;
+
+    return enc_input_encode(in, &src, timeUs, out);
+}
+
+RK_S32 VPUEncInputEncodeUmp(VPUEncInput_t *in, RK_U32 secureId, RK_S32 halFormat, RK_S64 timeUs,
+                            EncoderOut_t *out)
+{
+    EncInputSrc_t src;
+    RK_S32 picType = VPUEncInputPictureType(halFormat);
+
+    if (in == NULL || out == NULL || picType < 0)
+        return VPU_ERR;
+
+    memset(&src, 0, sizeof(src));
+    src.key = secureId;
+    src.halFormat = halFormat;
+    src.stride = in->ctx->width;
+    src.size = in->ctx->width * in->ctx->height * enc_input_bpp(picType) / 8;
+    src.secureId = secureId;
+
+    return enc_input_encode(in, &src, timeUs, out);
+}
+
+void VPUEncInputForget(VPUEncInput_t *in, RK_U32 secureId)
+{
+    RK_U32 i;
+
+    if (in == NULL)
+        return;
+
+    pthread_mutex_lock(&in->lock);
+    for (i = 0; i < VPU_ENC_INPUT_CACHE_SIZE; i++) {
+        if (in->cache[i].valid && in->cache[i].key == secureId)
+            in->cache[i].valid = 0;
+    }
+    pthread_mutex_unlock(&in->lock);
+}
+
+void VPUEncInputGetStats(VPUEncInput_t *in, VPUEncInputStats_t *stats)
+{
+    if (in == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&in->lock);
+    *stats = in->stats;
+    pthread_mutex_unlock(&in->lock);
+}
@@ -0,0 +1,64 @@
+/***************************************************************************************************
+    File:
+        vpu_enc_input.h
+    Description:
+        Zero-copy encoder input from gralloc buffers and UMP secure ids.
+        Screen and camera recording used to memcpy every frame into
+        EncInputStream_t::buf; here the physical address of the buffer is
+        resolved once, cached per buffer and passed as bufPhyAddr, with RGB
+        buffers fed as the matching H264EncPictureType instead of converted.
+        UMP buffers are cache cleaned before the encoder reads them.
+        Buffers without a usable physical address, or that cannot be
+        cleaned from here, fall back to the copy.
+ **************************************************************************************************/
+#ifndef __VPU_ENC_INPUT_H__
+#define __VPU_ENC_INPUT_H__
+
+#include <cutils/native_handle.h>
+
+#include "vpu_api.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* buffers remembered per encoder, a BufferQueue cycles through a handful */
+#define VPU_ENC_INPUT_CACHE_SIZE        (16)
+
+typedef struct VPUEncInputStats
+{
+    RK_U32  frames;
+    RK_U32  zeroCopy;           /* fed by physical address */
+    RK_U32  copied;             /* fell back to buf */
+    RK_U32  resolves;           /* physical address lookups */
+    RK_U32  cacheHits;
+    RK_U32  formatChanges;      /* VPU_API_ENC_SETFORMAT calls */
+} VPUEncInputStats_t;
+
+typedef struct VPUEncInput VPUEncInput_t;
+
+/* H264EncPictureType for a HAL_PIXEL_FORMAT_*, -1 if the encoder cannot read it */
+RK_S32 VPUEncInputPictureType(RK_S32 halFormat);
+
+/* ctx is an initialised encoder of ctx->width x ctx->height, owned by the caller */
+VPUEncInput_t *VPUEncInputCreate(VpuCodecContext_t *ctx);
+void VPUEncInputDestroy(VPUEncInput_t *in);
+
+/* encode one frame from a gralloc buffer, same return value as encode() */
+RK_S32 VPUEncInputEncodeHandle(VPUEncInput_t *in, buffer_handle_t handle, RK_S64 timeUs,
+                               EncoderOut_t *out);
+/* encode one frame from a UMP buffer of ctx->width x ctx->height in halFormat */
+RK_S32 VPUEncInputEncodeUmp(VPUEncInput_t *in, RK_U32 secureId, RK_S32 halFormat, RK_S64 timeUs,
+                            EncoderOut_t *out);
+
+/* drop the cached address of a buffer that is being freed */
+void VPUEncInputForget(VPUEncInput_t *in, RK_U32 secureId);
+
+void VPUEncInputGetStats(VPUEncInput_t *in, VPUEncInputStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VPU_ENC_INPUT_H__ */
@@ -0,0 +1,264 @@
+/***************************************************************************************************
+    File:
+        vpu_enc_rc.c
+    Description:
+        Frame boundary rate control updates over VPU_API_ENC_SETCFG / SETIDRFRAME
+ **************************************************************************************************/
+#define LOG_TAG "vpu_enc_rc"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_enc_rc.h"
+
+#define RC_QP_MIN           (0)
+#define RC_QP_MAX           (51)
+#define RC_FPS_MAX          (120)
+
+struct VpuEncRc {
+    VpuCodecContext_t   *ctx;
+    pthread_mutex_t     lock;
+
+    EncParameter_t      cur;            /* what the encoder runs with */
+    EncParameter_t      want;           /* cur plus pending requests */
+    RK_U32              cfgDirty;
+    RK_U32              cfgReqFrame;    /* frame of the oldest pending request */
+    RK_S32              qpMin;
+    RK_S32              qpMax;
+
+    RK_U32              idrPending;     /* requested, not sent yet */
+    RK_U32              idrSent;        /* sent, key frame not seen yet */
+    RK_U32              idrReqFrame;
+
+    RK_U32              frame;
+    VpuEncRcStats_t     stats;
+};
+
+VpuEncRc_t *VpuEncRcCreate(VpuCodecContext_t *ctx)
+{
+    VpuEncRc_t *rc;
+
+    if (ctx == NULL || ctx->control == NULL || ctx->codecType != CODEC_ENCODER)
+        return NULL;
+
+    rc = (VpuEncRc_t *)calloc(1, sizeof(VpuEncRc_t));
+    if (rc == NULL)
+        return NULL;
+
+    if (ctx->control(ctx, VPU_API_ENC_GETCFG, &rc->cur)) {
+        ALOGE("VPU_API_ENC_GETCFG failed");
+        free(rc);
+        return NULL;
+    }
+
+    rc->ctx = ctx;
+    rc->want = rc->cur;
+    rc->qpMin = RC_QP_MIN;
+    rc->qpMax = RC_QP_MAX;
+    pthread_mutex_init(&rc->lock, NULL);
+
+    return rc;
+}
+
+void VpuEncRcDestroy(VpuEncRc_t *rc)
+{
+    if (rc == NULL)
+        return;
+
+    pthread_mutex_destroy(&rc->lock);
+    free(rc);
+}
+
+/* note a config request, lock held */
+static void rc_mark_dirty(VpuEncRc_t *rc)
+{
+    if (!rc->cfgDirty)
+        rc->cfgReqFrame = rc->frame;
+    rc->cfgDirty = 1;
+    rc->stats.requests++;
+}
+
+RK_S32 VpuEncRcSetBitrate(VpuEncRc_t *rc, RK_S32 bitRate)
+{
+    if (rc == NULL || bitRate <= 0)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&rc->lock);
+    rc->want.bitRate = bitRate;
+    rc_mark_dirty(rc);
+    pthread_mutex_unlock(&rc->lock);
+
+    return VPU_OK;
+}
+
+RK_S32 VpuEncRcSetFramerate(VpuEncRc_t *rc, RK_S32 fps)
+{
+    if (rc == NULL || fps <= 0 || fps > RC_FPS_MAX)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&rc->lock);
+    rc->want.framerate = fps;
+    rc->want.framerateout = fps;
+    rc_mark_dirty(rc);
+    pthread_mutex_unlock(&rc->lock);
+
+    return VPU_OK;
+}
+
+/*
+ * EncParameter_t carries a single qp, the starting point of rate control,
+ * so the range is enforced by moving that qp inside it.
+ */
+RK_S32 VpuEncRcSetQpRange(VpuEncRc_t *rc, RK_S32 qpMin, RK_S32 qpMax)
+{
+    if (rc == NULL || qpMin < RC_QP_MIN || qpMax > RC_QP_MAX || qpMin > qpMax)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&rc->lock);
+    rc->qpMin = qpMin;
+    rc->qpMax = qpMax;
+    if (rc->want.qp < qpMin || rc->want.qp > qpMax) {
+        rc->want.qp = CLIP(rc->want.qp, qpMin, qpMax);
+        rc_mark_dirty(rc);
+    }
+    pthread_mutex_unlock(&rc->lock);
+
+    return VPU_OK;
+}
+
+RK_S32 VpuEncRcRequestIdr(VpuEncRc_t *rc)
+{
+    if (rc == NULL)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&rc->lock);
+    rc->stats.idrRequests++;
+    /* a request already in flight covers this one */
+    if (!rc->idrPending && !rc->idrSent) {
+        rc->idrPending = 1;
+        rc->idrReqFrame = rc->frame;
+    }
+    pthread_mutex_unlock(&rc->lock);
+
+    return VPU_OK;
+}
+
+RK_S32 VpuEncRcApply(VpuEncRc_t *rc)
+{
+    VpuCodecContext_t *ctx;
+    EncParameter_t cfg;
+    RK_U32 sendCfg, sendIdr, latency;
+    RK_S32 ret = VPU_OK;
+
+    if (rc == NULL)
+        return VPU_ERR;
+
+    ctx = rc->ctx;
+
+    pthread_mutex_lock(&rc->lock);
+    sendCfg = rc->cfgDirty;
+    sendIdr = rc->idrPending;
+    cfg = rc->want;
+    latency = rc->frame - rc->cfgReqFrame;
+    rc->cfgDirty = 0;
+    pthread_mutex_unlock(&rc->lock);
+
+    /* the control calls run on the encoding thread, between two frames */
+    if (sendCfg) {
+        if (ctx->control(ctx, VPU_API_ENC_SETCFG, &cfg)) {
+            ALOGE("VPU_API_ENC_SETCFG failed, bitRate %d fps %d qp %d",
+                  cfg.bitRate, cfg.framerate, cfg.qp);
+            ret = VPU_ERR;
+        }
+    }
+
+    if (sendIdr && ctx->control(ctx, VPU_API_ENC_SETIDRFRAME, NULL)) {
+        ALOGE("VPU_API_ENC_SETIDRFRAME failed");
+        ret = VPU_ERR;
+        sendIdr = 0;
+    }
+
+    pthread_mutex_lock(&rc->lock);
+    if (sendCfg) {
+        if (ret == VPU_OK) {
+            rc->cur = cfg;
+            rc->stats.setCfgCalls++;
+            rc->stats.cfgLatencySum += latency;
+            if (latency > rc->stats.cfgLatencyMax)
+                rc->stats.cfgLatencyMax = latency;
+        } else if (!rc->cfgDirty) {
+            /* nothing newer arrived, go back to what the encoder really has */
+            rc->want = rc->cur;
+        }
+    }
+    if (ret != VPU_OK)
+        rc->stats.failures++;
+    if (sendIdr && rc->idrPending) {
+        rc->idrPending = 0;
+        rc->idrSent = 1;
+    }
+    pthread_mutex_unlock(&rc->lock);
+
+    return ret;
+}
+
+void VpuEncRcFrameDone(VpuEncRc_t *rc, RK_S32 keyFrame)
+{
+    if (rc == NULL)
+        return;
+
+    pthread_mutex_lock(&rc->lock);
+    /* any key frame satisfies a request, including a regular GOP one */
+    if (keyFrame && (rc->idrSent || rc->idrPending)) {
+        RK_U32 latency = rc->frame - rc->idrReqFrame;
+
+        rc->stats.idrDelivered++;
+        rc->stats.idrLatencySum += latency;
+        if (latency > rc->stats.idrLatencyMax)
+            rc->stats.idrLatencyMax = latency;
+        rc->idrSent = 0;
+        rc->idrPending = 0;
+    }
+    rc->frame++;
+    rc->stats.frames++;
+    pthread_mutex_unlock(&rc->lock);
+}
+
+RK_S32 VpuEncRcEncode(VpuEncRc_t *rc, EncInputStream_t *in, EncoderOut_t *out)
+{
+    RK_S32 ret;
+
+    if (rc == NULL || in == NULL || out == NULL || rc->ctx->encode == NULL)
+        return VPU_ERR;
+
+    /* a failed update leaves the previous settings, the frame is still encoded */
+    VpuEncRcApply(rc);
+
+    ret = rc->ctx->encode(rc->ctx, in, out);
+    VpuEncRcFrameDone(rc, (ret == 0 && out->size > 0) ? out->keyFrame : 0);
+
+    return ret;
+}
+
+void VpuEncRcGetConfig(VpuEncRc_t *rc, EncParameter_t *cfg)
+{
+    if (rc == NULL || cfg == NULL)
+        return;
+
+    pthread_mutex_lock(&rc->lock);
+    *cfg = rc->want;
+    pthread_mutex_unlock(&rc->lock);
+}
+
+void VpuEncRcGetStats(VpuEncRc_t *rc, VpuEncRcStats_t *stats)
+{
+    if (rc == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&rc->lock);
+    *stats = rc->stats;
+    pthread_mutex_unlock(&rc->lock);
+}
@@ -0,0 +1,65 @@
+/***************************************************************************************************
+    File:
+        vpu_enc_rc.h
+    Description:
+        Fine grained encoder rate control changes for adaptive streaming.
+        control(VPU_API_ENC_SETCFG) only takes a whole EncParameter_t; here
+        bitrate, frame rate, QP range and IDR requests can be posted from any
+        thread, are merged, and take effect at the next frame boundary with
+        one SETCFG, without reinitialising or flushing the encoder. Latency
+        from request to effect is counted in frames.
+ **************************************************************************************************/
+#ifndef _VPU_ENC_RC_H_
+#define _VPU_ENC_RC_H_
+
+#include "vpu_api.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct VpuEncRcStats {
+    RK_U32 frames;
+    RK_U32 requests;
+    RK_U32 setCfgCalls;         /* requests merged into fewer SETCFG calls */
+    RK_U32 idrRequests;
+    RK_U32 idrDelivered;        /* key frames that satisfied a request */
+    RK_U32 cfgLatencySum;       /* frames from request to the frame it applied to */
+    RK_U32 cfgLatencyMax;
+    RK_U32 idrLatencySum;       /* frames from request to the key frame out */
+    RK_U32 idrLatencyMax;
+    RK_U32 failures;
+} VpuEncRcStats_t;
+
+typedef struct VpuEncRc VpuEncRc_t;
+
+/* ctx is an initialised encoder; its current config is read with VPU_API_ENC_GETCFG */
+VpuEncRc_t *VpuEncRcCreate(VpuCodecContext_t *ctx);
+void VpuEncRcDestroy(VpuEncRc_t *rc);
+
+/* thread safe, applied at the next frame boundary */
+RK_S32 VpuEncRcSetBitrate(VpuEncRc_t *rc, RK_S32 bitRate);
+RK_S32 VpuEncRcSetFramerate(VpuEncRc_t *rc, RK_S32 fps);
+RK_S32 VpuEncRcSetQpRange(VpuEncRc_t *rc, RK_S32 qpMin, RK_S32 qpMax);
+RK_S32 VpuEncRcRequestIdr(VpuEncRc_t *rc);
+
+/*
+ * Frame boundary hooks for callers that run encode() themselves (e.g.
+ * through VpuEncRingEncode): Apply before the frame, FrameDone after it.
+ */
+RK_S32 VpuEncRcApply(VpuEncRc_t *rc);
+void VpuEncRcFrameDone(VpuEncRc_t *rc, RK_S32 keyFrame);
+
+/* Apply + encode() + FrameDone */
+RK_S32 VpuEncRcEncode(VpuEncRc_t *rc, EncInputStream_t *in, EncoderOut_t *out);
+
+/* config as it will be after pending requests are applied */
+void VpuEncRcGetConfig(VpuEncRc_t *rc, EncParameter_t *cfg);
+void VpuEncRcGetStats(VpuEncRc_t *rc, VpuEncRcStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VPU_ENC_RC_H_ */
@@ -0,0 +1,331 @@
+/***************************************************************************************************
+    File:
+        vpu_enc_ring.c
+    Description:
+        Ring buffer for encoder stream output with per packet descriptors
+ **************************************************************************************************/
+#define LOG_TAG "vpu_enc_ring"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_enc_ring.h"
+
+typedef struct RingDesc {
+    RK_U32  offset;
+    RK_U32  size;
+    RK_S64  timeUs;
+    RK_S32  keyFrame;
+    RK_U32  seq;
+} RingDesc_t;
+
+struct VpuEncRing {
+    VpuEncRingCfg_t     cfg;
+    pthread_mutex_t     lock;
+    pthread_cond_t      notFull;
+    pthread_cond_t      notEmpty;
+
+    /* byte counters, the ring offset is the value modulo cfg.size */
+    RK_U32              head;
+    RK_U32              tail;
+
+    RingDesc_t          *desc;
+    RK_U32              descHead;
+    RK_U32              descCount;
+    RK_U32              seq;
+
+    RK_U8               *scratch;       /* staging for packets that wrap */
+    VpuEncRingStats_t   stats;
+};
+
+static RK_S64 ring_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct timespec *ring_deadline(struct timespec *ts, RK_S32 timeoutMs)
+{
+    if (timeoutMs < 0)
+        return NULL;
+
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += timeoutMs / 1000;
+    ts->tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static int ring_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline)
+{
+    if (deadline == NULL)
+        return pthread_cond_wait(cond, lock);
+    return pthread_cond_timedwait(cond, lock, deadline);
+}
+
+VpuEncRing_t *VpuEncRingCreate(const VpuEncRingCfg_t *cfg)
+{
+    VpuEncRing_t *ring;
+
+    if (cfg == NULL || cfg->mem == NULL || !cfg->maxPacketSize || !cfg->maxPackets ||
+        cfg->size < cfg->maxPacketSize * 2 || cfg->size > 0x7fffffff) {
+        ALOGE("bad ring config");
+        return NULL;
+    }
+
+    ring = (VpuEncRing_t *)calloc(1, sizeof(VpuEncRing_t));
+    if (ring == NULL)
+        return NULL;
+
+    ring->cfg = *cfg;
+    ring->desc = (RingDesc_t *)calloc(cfg->maxPackets, sizeof(RingDesc_t));
+    ring->scratch = (RK_U8 *)malloc(cfg->maxPacketSize);
+    if (ring->desc == NULL || ring->scratch == NULL) {
+        free(ring->desc);
+        free(ring->scratch);
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->notFull, NULL);
+    pthread_cond_init(&ring->notEmpty, NULL);
+
+    return ring;
+}
+
+void VpuEncRingDestroy(VpuEncRing_t *ring)
+{
+    if (ring == NULL)
+        return;
+
+    pthread_cond_destroy(&ring->notEmpty);
+    pthread_cond_destroy(&ring->notFull);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring->scratch);
+    free(ring->desc);
+    free(ring);
+}
+
+static RK_U32 ring_free_bytes(const VpuEncRing_t *ring)
+{
+    return ring->cfg.size - (ring->head - ring->tail);
+}
+
+RK_S32 VpuEncRingEncode(VpuEncRing_t *ring, VpuCodecContext_t *ctx, EncInputStream_t *in,
+                        RK_S32 timeoutMs)
+{
+    struct timespec ts, *deadline;
+    EncoderOut_t out;
+    RingDesc_t *d;
+    RK_U32 off, room;
+    RK_S32 direct, ret;
+    RK_S64 t0;
+
+    if (ring == NULL || ctx == NULL || ctx->encode == NULL || in == NULL)
+        return VPU_ENC_RING_ERROR;
+
+    deadline = ring_deadline(&ts, timeoutMs);
+
+    pthread_mutex_lock(&ring->lock);
+    if (ring_free_bytes(ring) < ring->cfg.maxPacketSize || ring->descCount == ring->cfg.maxPackets)
+        ring->stats.producerBlocked++;
+    while (ring_free_bytes(ring) < ring->cfg.maxPacketSize ||
+           ring->descCount == ring->cfg.maxPackets) {
+        if (ring_wait(&ring->notFull, &ring->lock, deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&ring->lock);
+            return VPU_ENC_RING_TIMEOUT;
+        }
+    }
+    off = ring->head % ring->cfg.size;
+    pthread_mutex_unlock(&ring->lock);
+
+    /*
+     * The consumer only ever frees space, so the maxPacketSize bytes after
+     * head stay ours while encoding without the lock. When they are not
+     * contiguous the encoder writes to scratch and the packet is split.
+     */
+    room = ring->cfg.size - off;
+    direct = room >= ring->cfg.maxPacketSize;
+
+    memset(&out, 0, sizeof(out));
+    out.data = direct ? ring->cfg.mem + off : ring->scratch;
+
+    t0 = ring_now_us();
+    ret = ctx->encode(ctx, in, &out);
+    t0 = ring_now_us() - t0;
+
+    if (ret == 0 && out.size > 0 && (RK_U32)out.size > ring->cfg.maxPacketSize) {
+        ALOGE("encoder wrote %d bytes, more than maxPacketSize %d", out.size, ring->cfg.maxPacketSize);
+        ret = -1;
+    }
+
+    if (ret == 0 && out.size > 0 && !direct) {
+        RK_U32 first = MIN((RK_U32)out.size, room);
+        memcpy(ring->cfg.mem + off, ring->scratch, first);
+        memcpy(ring->cfg.mem, ring->scratch + first, out.size - first);
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    ring->stats.encodeUs += t0;
+    if (ret != 0 || out.size <= 0) {
+        ring->stats.skipped++;
+        pthread_mutex_unlock(&ring->lock);
+        return ret ? VPU_ENC_RING_ERROR : VPU_ENC_RING_NO_OUTPUT;
+    }
+
+    d = &ring->desc[(ring->descHead + ring->descCount) % ring->cfg.maxPackets];
+    d->offset = off;
+    d->size = out.size;
+    d->timeUs = out.timeUs;
+    d->keyFrame = out.keyFrame;
+    d->seq = ring->seq++;
+    ring->descCount++;
+    ring->head += out.size;
+
+    ring->stats.packets++;
+    ring->stats.bytes += out.size;
+    if (!direct && (RK_U32)out.size > room)
+        ring->stats.wrapped++;
+    if (ring->head - ring->tail > ring->stats.peakBytes)
+        ring->stats.peakBytes = ring->head - ring->tail;
+
+    pthread_cond_signal(&ring->notEmpty);
+    pthread_mutex_unlock(&ring->lock);
+
+    return VPU_ENC_RING_OK;
+}
+
+RK_S32 VpuEncRingGetPacket(VpuEncRing_t *ring, VpuEncPacket_t *pkt, RK_S32 timeoutMs)
+{
+    struct timespec ts, *deadline;
+    RingDesc_t *d;
+    RK_U32 room;
+
+    if (ring == NULL || pkt == NULL)
+        return VPU_ENC_RING_ERROR;
+
+    deadline = ring_deadline(&ts, timeoutMs);
+
+    pthread_mutex_lock(&ring->lock);
+    while (!ring->descCount) {
+        if (ring_wait(&ring->notEmpty, &ring->lock, deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&ring->lock);
+            return VPU_ENC_RING_TIMEOUT;
+        }
+    }
+
+    d = &ring->desc[ring->descHead];
+    room = ring->cfg.size - d->offset;
+
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->data[0] = ring->cfg.mem + d->offset;
+    pkt->len[0] = MIN(d->size, room);
+    if (d->size > room) {
+        pkt->data[1] = ring->cfg.mem;
+        pkt->len[1] = d->size - room;
+    }
+    pkt->size = d->size;
+    pkt->timeUs = d->timeUs;
+    pkt->keyFrame = d->keyFrame;
+    pkt->seq = d->seq;
+    pthread_mutex_unlock(&ring->lock);
+
+    return VPU_ENC_RING_OK;
+}
+
+RK_S32 VpuEncRingRelease(VpuEncRing_t *ring)
+{
+    if (ring == NULL)
+        return VPU_ENC_RING_ERROR;
+
+    pthread_mutex_lock(&ring->lock);
+    if (!ring->descCount) {
+        pthread_mutex_unlock(&ring->lock);
+        return VPU_ENC_RING_ERROR;
+    }
+
+    ring->tail += ring->desc[ring->descHead].size;
+    ring->descHead = (ring->descHead + 1) % ring->cfg.maxPackets;
+    ring->descCount--;
+
+    pthread_cond_signal(&ring->notFull);
+    pthread_mutex_unlock(&ring->lock);
+
+    return VPU_ENC_RING_OK;
+}
+
+void VpuEncRingFlush(VpuEncRing_t *ring)
+{
+    if (ring == NULL)
+        return;
+
+    pthread_mutex_lock(&ring->lock);
+    ring->tail = ring->head;
+    ring->descHead = (ring->descHead + ring->descCount) % ring->cfg.maxPackets;
+    ring->descCount = 0;
+    pthread_cond_broadcast(&ring->notFull);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+void VpuEncRingGetStats(VpuEncRing_t *ring, VpuEncRingStats_t *stats)
+{
+    if (ring == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&ring->lock);
+    *stats = ring->stats;
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/* stand-in encoder state lives in extra_cfg.reserved */
+#define STANDIN_BYTES       (0)
+#define STANDIN_GOP         (1)
+#define STANDIN_FRAME       (2)
+
+static RK_S32 standin_encode(VpuCodecContext_t *ctx, EncInputStream_t *in, EncoderOut_t *out)
+{
+    RK_U32 *state = ctx->extra_cfg.reserved;
+    RK_U32 size = state[STANDIN_BYTES];
+    RK_S32 key = (state[STANDIN_FRAME] % state[STANDIN_GOP]) == 0;
+
+    if (out == NULL || out->data == NULL || size < 5)
+        return -1;
+
+    /* Annex B start code and an IDR / non-IDR slice NAL header */
+    out->data[0] = 0;
+    out->data[1] = 0;
+    out->data[2] = 0;
+    out->data[3] = 1;
+    out->data[4] = key ? 0x65 : 0x41;
+    memset(out->data + 5, (RK_U8)state[STANDIN_FRAME], size - 5);
+
+    out->size = size;
+    out->timeUs = in->timeUs;
+    out->keyFrame = key;
+    state[STANDIN_FRAME]++;
+
+    return 0;
+}
+
+void VpuEncRingStandInInit(VpuCodecContext_t *ctx, RK_U32 bytesPerFrame, RK_U32 gop)
+{
+    if (ctx == NULL)
+        return;
+
+    ctx->codecType = CODEC_ENCODER;
+    ctx->videoCoding = OMX_ON2_VIDEO_CodingAVC;
+    ctx->encode = standin_encode;
+    ctx->extra_cfg.reserved[STANDIN_BYTES] = bytesPerFrame;
+    ctx->extra_cfg.reserved[STANDIN_GOP] = gop ? gop : 1;
+    ctx->extra_cfg.reserved[STANDIN_FRAME] = 0;
+}
@@ -0,0 +1,87 @@
+/***************************************************************************************************
+    File:
+        vpu_enc_ring.h
+    Description:
+        Encoder stream output into a caller provided ring buffer. encode()
+        writes straight into the free space of the ring instead of a payload
+        the caller allocates per frame, and every packet gets a descriptor
+        with its timeUs and keyFrame. A packet that does not fit before the
+        end of the ring wraps and is returned as two slices. The data region
+        holds nothing but stream bytes, so it can be an mmap'd or shared
+        region read by a muxer or socket writer.
+ **************************************************************************************************/
+#ifndef _VPU_ENC_RING_H_
+#define _VPU_ENC_RING_H_
+
+#include "vpu_api.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VPU_ENC_RING_OK                 (0)
+#define VPU_ENC_RING_TIMEOUT            (1)     /* no room / no packet within the timeout */
+#define VPU_ENC_RING_NO_OUTPUT          (2)     /* the encoder produced nothing for this frame */
+#define VPU_ENC_RING_ERROR              (-1)
+
+#define VPU_ENC_RING_WAIT_FOREVER       (-1)
+
+typedef struct VpuEncRingCfg {
+    RK_U8  *mem;                /* ring storage, owned by the caller */
+    RK_U32 size;
+    RK_U32 maxPacketSize;       /* upper bound of one encoded frame */
+    RK_U32 maxPackets;          /* descriptors, i.e. packets in flight */
+} VpuEncRingCfg_t;
+
+typedef struct VpuEncPacket {
+    RK_U8  *data[2];            /* second slice is set when the packet wrapped */
+    RK_U32 len[2];
+    RK_U32 size;
+    RK_S64 timeUs;
+    RK_S32 keyFrame;
+    RK_U32 seq;
+} VpuEncPacket_t;
+
+typedef struct VpuEncRingStats {
+    RK_U32 packets;
+    RK_U64 bytes;
+    RK_U32 wrapped;             /* packets staged and split at the end of the ring */
+    RK_U32 skipped;             /* frames with no output */
+    RK_U32 producerBlocked;     /* encode waited for the consumer */
+    RK_U32 peakBytes;
+    RK_S64 encodeUs;
+} VpuEncRingStats_t;
+
+typedef struct VpuEncRing VpuEncRing_t;
+
+VpuEncRing_t *VpuEncRingCreate(const VpuEncRingCfg_t *cfg);
+void VpuEncRingDestroy(VpuEncRing_t *ring);
+
+/*
+ * Encode one frame into the ring. Waits up to timeoutMs for maxPacketSize
+ * bytes and a descriptor to be free. One producer thread at a time.
+ */
+RK_S32 VpuEncRingEncode(VpuEncRing_t *ring, VpuCodecContext_t *ctx, EncInputStream_t *in,
+                        RK_S32 timeoutMs);
+
+/* oldest packet, left in the ring until VpuEncRingRelease */
+RK_S32 VpuEncRingGetPacket(VpuEncRing_t *ring, VpuEncPacket_t *pkt, RK_S32 timeoutMs);
+RK_S32 VpuEncRingRelease(VpuEncRing_t *ring);
+/* drop every packet not read yet */
+void VpuEncRingFlush(VpuEncRing_t *ring);
+
+void VpuEncRingGetStats(VpuEncRing_t *ring, VpuEncRingStats_t *stats);
+
+/*
+ * Software stand-in for an encoder context: encode() emits bytesPerFrame
+ * bytes of NAL shaped data, an IDR every gop frames. Lets the ring be
+ * benchmarked without the VPU.
+ */
+void VpuEncRingStandInInit(VpuCodecContext_t *ctx, RK_U32 bytesPerFrame, RK_U32 gop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VPU_ENC_RING_H_ */
@@ -0,0 +1,252 @@
+/***************************************************************************************************
+    File:
+        vpu_enc_ring_bench.c
+    Description:
+        Throughput of the encoder output ring with the software stand-in
+        encoder. Builds for the host:
+
+            vpu_enc_ring_bench [frames [ring KB]]
+
+        A producer thread encodes into the ring and a consumer thread copies
+        every packet out, slice by slice, the way a muxer or socket writer
+        would. The same frames are also run the old way, an EncoderOut_t
+        payload malloc'd per frame and handed over through a locked queue,
+        and the consumer frees it. Frame sizes go from a 4 Mbps stream to a
+        near intra-only one. The ring is walked end to end while a freed
+        malloc block comes back still in the cache, so a smaller ring reads
+        faster.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "vpu_macro.h"
+#include "vpu_enc_ring.h"
+
+#define BENCH_FRAMES_DEF            (20000)
+#define BENCH_RING_KB_DEF           (4 * 1024)
+#define BENCH_PACKETS               (64)
+#define BENCH_GOP                   (30)
+
+typedef struct
+{
+    RK_U32              frameBytes;
+    RK_U32              frames;
+    RK_U32              ringSize;
+    VpuEncRing_t        *ring;
+
+    /* per frame allocation path */
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    EncoderOut_t        queue[BENCH_PACKETS];
+    RK_U32              head;
+    RK_U32              count;
+
+    RK_U8               *sink;      /* where the consumer copies packets */
+    RK_U64              bytes;
+    RK_U32              errors;
+} BenchCtx_t;
+
+static double bench_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *ring_consumer(void *arg)
+{
+    BenchCtx_t *b = (BenchCtx_t *)arg;
+    VpuEncPacket_t pkt;
+    RK_U32 n;
+
+    for (n = 0; n < b->frames; n++) {
+        if (VpuEncRingGetPacket(b->ring, &pkt, 1000) != VPU_ENC_RING_OK) {
+            b->errors++;
+            break;
+        }
+        memcpy(b->sink, pkt.data[0], pkt.len[0]);
+        if (pkt.len[1])
+            memcpy(b->sink + pkt.len[0], pkt.data[1], pkt.len[1]);
+        if (pkt.seq != n || pkt.keyFrame != ((n % BENCH_GOP) == 0))
+            b->errors++;
+        b->bytes += pkt.size;
+        VpuEncRingRelease(b->ring);
+    }
+
+    return NULL;
+}
+
+static double bench_ring(BenchCtx_t *b, VpuEncRingStats_t *stats)
+{
+    VpuCodecContext_t ctx;
+    VpuEncRingCfg_t cfg;
+    EncInputStream_t in;
+    pthread_t thread;
+    RK_U8 *mem = (RK_U8 *)malloc(b->ringSize);
+    double t0, t1;
+    RK_U32 n;
+
+    memset(&ctx, 0, sizeof(ctx));
+    VpuEncRingStandInInit(&ctx, b->frameBytes, BENCH_GOP);
+
+    cfg.mem = mem;
+    cfg.size = b->ringSize;
+    cfg.maxPacketSize = b->frameBytes;
+    cfg.maxPackets = BENCH_PACKETS;
+    b->ring = VpuEncRingCreate(&cfg);
+    if (mem == NULL || b->ring == NULL) {
+        free(mem);
+        b->errors++;
+        return 0;
+    }
+
+    memset(&in, 0, sizeof(in));
+    b->bytes = 0;
+    t0 = bench_now_s();
+    pthread_create(&thread, NULL, ring_consumer, b);
+    for (n = 0; n < b->frames; n++) {
+        in.timeUs = n * 33333LL;
+        if (VpuEncRingEncode(b->ring, &ctx, &in, 1000) != VPU_ENC_RING_OK) {
+            b->errors++;
+            break;
+        }
+    }
+    pthread_join(thread, NULL);
+    t1 = bench_now_s();
+
+    VpuEncRingGetStats(b->ring, stats);
+    VpuEncRingDestroy(b->ring);
+    free(mem);
+
+    return t1 - t0;
+}
+
+static void *alloc_consumer(void *arg)
+{
+    BenchCtx_t *b = (BenchCtx_t *)arg;
+    EncoderOut_t out;
+    RK_U32 n;
+
+    for (n = 0; n < b->frames; n++) {
+        pthread_mutex_lock(&b->lock);
+        while (!b->count)
+            pthread_cond_wait(&b->cond, &b->lock);
+        out = b->queue[b->head];
+        b->head = (b->head + 1) % BENCH_PACKETS;
+        b->count--;
+        pthread_cond_signal(&b->cond);
+        pthread_mutex_unlock(&b->lock);
+
+        if (out.size)
+            memcpy(b->sink, out.data, out.size);
+        b->bytes += out.size;
+        free(out.data);
+    }
+
+    return NULL;
+}
+
+static double bench_alloc(BenchCtx_t *b)
+{
+    VpuCodecContext_t ctx;
+    EncInputStream_t in;
+    EncoderOut_t out;
+    pthread_t thread;
+    double t0, t1;
+    RK_U32 n;
+
+    memset(&ctx, 0, sizeof(ctx));
+    VpuEncRingStandInInit(&ctx, b->frameBytes, BENCH_GOP);
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond, NULL);
+    b->head = 0;
+    b->count = 0;
+
+    memset(&in, 0, sizeof(in));
+    b->bytes = 0;
+    t0 = bench_now_s();
+    pthread_create(&thread, NULL, alloc_consumer, b);
+    for (n = 0; n < b->frames; n++) {
+        memset(&out, 0, sizeof(out));
+        out.data = (RK_U8 *)malloc(b->frameBytes);
+        in.timeUs = n * 33333LL;
+        if (out.data == NULL || ctx.encode(&ctx, &in, &out)) {
+            /* still handed over, the consumer counts frames */
+            b->errors++;
+            out.size = 0;
+        }
+
+        pthread_mutex_lock(&b->lock);
+        while (b->count == BENCH_PACKETS)
+            pthread_cond_wait(&b->cond, &b->lock);
+        b->queue[(b->head + b->count) % BENCH_PACKETS] = out;
+        b->count++;
+        pthread_cond_signal(&b->cond);
+        pthread_mutex_unlock(&b->lock);
+    }
+    pthread_join(thread, NULL);
+    t1 = bench_now_s();
+
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->lock);
+    return t1 - t0;
+}
+
+int main(int argc, char **argv)
+{
+    /* not dividing the ring, so packets wrap at its end */
+    static const RK_U32 sizes[] = { 15000, 60000, 250000, 1000000 };
+    RK_U32 frames = argc > 1 ? (RK_U32)atoi(argv[1]) : BENCH_FRAMES_DEF;
+    RK_U32 ringKb = argc > 2 ? (RK_U32)atoi(argv[2]) : BENCH_RING_KB_DEF;
+    RK_U32 i;
+    int failed = 0;
+
+    if (!frames)
+        frames = BENCH_FRAMES_DEF;
+    if (!ringKb)
+        ringKb = BENCH_RING_KB_DEF;
+
+    printf("%u frames per run, %d KB ring, %d descriptors, IDR every %d\n",
+           frames, ringKb, BENCH_PACKETS, BENCH_GOP);
+    printf("  frame B    ring MB/s  ring fps  wrapped  blocked   alloc MB/s  alloc fps   speedup\n");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        BenchCtx_t b;
+        VpuEncRingStats_t stats;
+        double tRing, tAlloc, mb;
+
+        /* the ring takes two of the largest packets at least */
+        if (sizes[i] * 2 > ringKb * 1024)
+            break;
+
+        memset(&b, 0, sizeof(b));
+        b.frameBytes = sizes[i];
+        b.ringSize = ringKb * 1024;
+        /* the same number of bytes for the larger frames */
+        b.frames = MAX((RK_U32)((RK_U64)frames * sizes[0] / sizes[i]), 200);
+        if (b.frames > frames)
+            b.frames = frames;
+        b.sink = (RK_U8 *)malloc(b.frameBytes);
+        if (b.sink == NULL)
+            return 1;
+
+        tRing = bench_ring(&b, &stats);
+        tAlloc = bench_alloc(&b);
+        mb = (double)b.frameBytes * b.frames / (1024 * 1024);
+
+        printf("  %8u %11.0f %9.0f %8u %8u %12.0f %10.0f %8.2fx\n", sizes[i],
+               mb / tRing, b.frames / tRing, stats.wrapped, stats.producerBlocked,
+               mb / tAlloc, b.frames / tAlloc, tAlloc / tRing);
+
+        if (b.errors || stats.packets != b.frames) {
+            printf("  FAILED: %u errors, %u of %u packets\n", b.errors, stats.packets, b.frames);
+            failed = 1;
+        }
+        free(b.sink);
+    }
+
+    return failed;
+}
@@ -0,0 +1,421 @@
+/***************************************************************************************************
+    File:
+        vpu_frame_pool.c
+    Description:
+        Reference counted pool of decoded VPU_FRAMEs with lock-free free lists
+ **************************************************************************************************/
+#define LOG_TAG "vpu_frame_pool"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/log.h>
+#include <cutils/atomic.h>
+
+#include "vpu_macro.h"
+#include "vpu_frame_pool.h"
+
+#define FRAME_POOL_MAGIC        (0x46504c31)    /* "FPL1" */
+#define FRAME_POOL_DISPLAY_DEF  (2)
+#define FRAME_POOL_ALIGN16(x)   (((x) + 15) & ~15)
+
+/*
+ * The free list head packs a 16 bit ABA tag with index + 1 of the top slot,
+ * 0 being the empty list, so push and pop are a single 32 bit CAS.
+ */
+#define HEAD_INDEX(h)           ((RK_U32)(h) & 0xffff)
+#define HEAD_TAG(h)             (((RK_U32)(h) >> 16) & 0xffff)
+#define HEAD_MAKE(tag, index)   ((int32_t)((((tag) & 0xffff) << 16) | ((index) & 0xffff)))
+
+typedef struct FrameSlot
+{
+    VPU_FRAME           frame;          /* first, a VPU_FRAME * is a FrameSlot_t * */
+    RK_U32              magic;
+    VPUFramePool_t      *pool;
+    RK_U32              index;
+    volatile int32_t    refs;           /* 0 while on the free list */
+    volatile int32_t    next;           /* index + 1 of the next free slot */
+} FrameSlot_t;
+
+struct VPUFramePool
+{
+    FrameSlot_t             *slots;
+    RK_U32                  frameNum;
+    RK_U32                  frameSize;
+    VPUMemPoolBackend_t     backend;
+
+    volatile int32_t        freeHead;
+    volatile int32_t        inUse;
+    volatile int32_t        peakInUse;
+    volatile int32_t        acquires;
+    volatile int32_t        starved;
+    volatile int32_t        timeouts;
+    volatile int32_t        badRelease;
+
+    /* only taken when the pool runs dry */
+    pthread_mutex_t         lock;
+    pthread_cond_t          freed;
+    volatile int32_t        waiters;
+    RK_U64                  starvedUs;
+};
+
+static const VPUMemPoolBackend_t defaultBackend =
+{
+    VPUMallocLinear,
+    VPUFreeLinear,
+    VPUMemDuplicate,
+    VPUMemLink,
+};
+
+static RK_S64 pool_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct timespec *pool_deadline(struct timespec *ts, RK_S32 timeoutMs)
+{
+    if (timeoutMs < 0)
+        return NULL;
+
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += timeoutMs / 1000;
+    ts->tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static int pool_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline)
+{
+    if (deadline == NULL)
+        return pthread_cond_wait(cond, lock);
+    return pthread_cond_timedwait(cond, lock, deadline);
+}
+
+RK_U32 VPUFramePoolDpbSize(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height)
+{
+    RK_U32 mbs = (FRAME_POOL_ALIGN16(width) >> 4) * (FRAME_POOL_ALIGN16(height) >> 4);
+
+    switch (coding) {
+    case OMX_ON2_VIDEO_CodingAVC:
+        /* MaxDpbMbs of level 4.1, the highest level the decoder runs at 1080p */
+        if (!mbs)
+            return 16;
+        return CLIP(32768 / mbs, 1, 16);
+    case OMX_ON2_VIDEO_CodingVP8:
+        /* last, golden and altref */
+        return 3;
+    case OMX_ON2_VIDEO_CodingVP9:
+        return 8;
+    case OMX_ON2_VIDEO_CodingMJPEG:
+        return 0;
+    default:
+        /* forward and backward reference of the B frame codecs */
+        return 2;
+    }
+}
+
+RK_U32 VPUFramePoolSize(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                        RK_U32 displayDepth)
+{
+    RK_U32 num = VPUFramePoolDpbSize(coding, width, height) + 1 + displayDepth + 1;
+
+    return MIN(num, VPU_FRAME_POOL_MAX);
+}
+
+static RK_S32 pool_pop(VPUFramePool_t *pool, FrameSlot_t **slot)
+{
+    int32_t head, next;
+    RK_U32 index;
+
+    do {
+        head = pool->freeHead;
+        index = HEAD_INDEX(head);
+        if (!index)
+            return VPU_ERR;
+        /* slots are never freed under the pool, a stale next only fails the CAS */
+        next = pool->slots[index - 1].next;
+    } while (android_atomic_acquire_cas(head, HEAD_MAKE(HEAD_TAG(head) + 1, next),
+                                        &pool->freeHead));
+
+    *slot = &pool->slots[index - 1];
+    return VPU_OK;
+}
+
+static void pool_push(VPUFramePool_t *pool, FrameSlot_t *slot)
+{
+    int32_t head;
+
+    do {
+        head = pool->freeHead;
+        slot->next = HEAD_INDEX(head);
+    } while (android_atomic_release_cas(head, HEAD_MAKE(HEAD_TAG(head) + 1, slot->index + 1),
+                                        &pool->freeHead));
+}
+
+static void pool_free_frames(VPUFramePool_t *pool)
+{
+    RK_U32 i;
+
+    for (i = 0; i < pool->frameNum; i++) {
+        if (pool->slots[i].frame.vpumem.phy_addr)
+            pool->backend.free(&pool->slots[i].frame.vpumem);
+    }
+}
+
+VPUFramePool_t *VPUFramePoolCreate(const VPUFramePoolCfg_t *cfg)
+{
+    VPUFramePool_t *pool;
+    RK_U32 i, num, alignW, alignH, lumaSize;
+
+    if (cfg == NULL || !cfg->width || !cfg->height)
+        return NULL;
+
+    num = cfg->frameNum;
+    if (!num) {
+        num = VPUFramePoolSize(cfg->coding, cfg->width, cfg->height,
+                               cfg->displayDepth ? cfg->displayDepth : FRAME_POOL_DISPLAY_DEF);
+    }
+    if (num > VPU_FRAME_POOL_MAX) {
+        ALOGE("%d frames requested, at most %d", num, VPU_FRAME_POOL_MAX);
+        return NULL;
+    }
+
+    pool = (VPUFramePool_t *)calloc(1, sizeof(VPUFramePool_t));
+    if (pool == NULL)
+        return NULL;
+
+    pool->slots = (FrameSlot_t *)calloc(num, sizeof(FrameSlot_t));
+    if (pool->slots == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    alignW = FRAME_POOL_ALIGN16(cfg->width);
+    alignH = FRAME_POOL_ALIGN16(cfg->height);
+    lumaSize = alignW * alignH;
+
+    pool->frameNum = num;
+    pool->frameSize = lumaSize * 3 / 2;
+    pool->backend = cfg->backend ? *cfg->backend : defaultBackend;
+
+    for (i = 0; i < num; i++) {
+        FrameSlot_t *slot = &pool->slots[i];
+        VPU_FRAME *frame = &slot->frame;
+
+        if (pool->backend.alloc(&frame->vpumem, pool->frameSize)) {
+            ALOGE("frame %d of %d, %d bytes, allocation failed", i, num, pool->frameSize);
+            memset(&frame->vpumem, 0, sizeof(frame->vpumem));
+            pool_free_frames(pool);
+            free(pool->slots);
+            free(pool);
+            return NULL;
+        }
+
+        frame->FrameBusAddr[0] = frame->vpumem.phy_addr;
+        frame->FrameBusAddr[1] = frame->vpumem.phy_addr + lumaSize;
+        frame->FrameWidth = alignW;
+        frame->FrameHeight = alignH;
+        frame->DisplayWidth = cfg->width;
+        frame->DisplayHeight = cfg->height;
+        frame->CodingType = cfg->coding;
+        frame->ColorType = VPU_OUTPUT_FORMAT_YUV420_SEMIPLANAR;
+
+        slot->magic = FRAME_POOL_MAGIC;
+        slot->pool = pool;
+        slot->index = i;
+        slot->refs = 0;
+        pool_push(pool, slot);
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->freed, NULL);
+
+    ALOGD("%d frames of %dx%d, %d bytes each", num, cfg->width, cfg->height, pool->frameSize);
+
+    return pool;
+}
+
+RK_S32 VPUFramePoolDestroy(VPUFramePool_t *pool)
+{
+    if (pool == NULL)
+        return VPU_ERR;
+
+    if (android_atomic_acquire_load(&pool->inUse)) {
+        ALOGE("destroy with %d frames still held", pool->inUse);
+        return VPU_ERR;
+    }
+
+    pool_free_frames(pool);
+    pthread_cond_destroy(&pool->freed);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->slots);
+    free(pool);
+
+    return VPU_OK;
+}
+
+static FrameSlot_t *pool_slot(VPU_FRAME *frame)
+{
+    FrameSlot_t *slot = (FrameSlot_t *)frame;
+
+    if (slot == NULL || slot->magic != FRAME_POOL_MAGIC) {
+        ALOGE("frame %p does not come from a frame pool", frame);
+        return NULL;
+    }
+    return slot;
+}
+
+static void pool_note_in_use(VPUFramePool_t *pool)
+{
+    int32_t used = android_atomic_inc(&pool->inUse) + 1;
+    int32_t peak;
+
+    do {
+        peak = pool->peakInUse;
+        if (used <= peak)
+            break;
+    } while (android_atomic_release_cas(peak, used, &pool->peakInUse));
+}
+
+VPU_FRAME *VPUFramePoolAcquire(VPUFramePool_t *pool, RK_S32 timeoutMs)
+{
+    struct timespec ts, *deadline;
+    FrameSlot_t *slot = NULL;
+    RK_S64 t0;
+
+    if (pool == NULL)
+        return NULL;
+
+    android_atomic_inc(&pool->acquires);
+
+    if (pool_pop(pool, &slot)) {
+        android_atomic_inc(&pool->starved);
+        if (!timeoutMs) {
+            android_atomic_inc(&pool->timeouts);
+            return NULL;
+        }
+
+        deadline = pool_deadline(&ts, timeoutMs);
+        t0 = pool_now_us();
+
+        pthread_mutex_lock(&pool->lock);
+        /* announced before the retry, a release after it sees us and signals */
+        android_atomic_inc(&pool->waiters);
+        while (pool_pop(pool, &slot)) {
+            if (pool_wait(&pool->freed, &pool->lock, deadline) == ETIMEDOUT) {
+                pool_pop(pool, &slot);
+                break;
+            }
+        }
+        android_atomic_dec(&pool->waiters);
+        pool->starvedUs += pool_now_us() - t0;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (slot == NULL) {
+            android_atomic_inc(&pool->timeouts);
+            ALOGW("no free frame within %d ms, %d of %d in use", timeoutMs,
+                  pool->inUse, pool->frameNum);
+            return NULL;
+        }
+    }
+
+    android_atomic_release_store(1, &slot->refs);
+    slot->frame.employ_cnt = 1;
+    slot->frame.next_frame = NULL;
+    pool_note_in_use(pool);
+
+    return &slot->frame;
+}
+
+RK_S32 VPUFramePoolAddRef(VPU_FRAME *frame)
+{
+    FrameSlot_t *slot = pool_slot(frame);
+    int32_t old;
+
+    if (slot == NULL)
+        return VPU_ERR;
+
+    do {
+        old = slot->refs;
+        if (old <= 0) {
+            /* a free frame cannot be revived, the holder already lost it */
+            android_atomic_inc(&slot->pool->badRelease);
+            ALOGE("addref of free frame %d", slot->index);
+            return VPU_ERR;
+        }
+    } while (android_atomic_release_cas(old, old + 1, &slot->refs));
+    frame->employ_cnt = old + 1;
+
+    return VPU_OK;
+}
+
+RK_S32 VPUFramePoolRelease(VPU_FRAME *frame)
+{
+    FrameSlot_t *slot = pool_slot(frame);
+    VPUFramePool_t *pool;
+    int32_t old;
+
+    if (slot == NULL)
+        return VPU_ERR;
+
+    pool = slot->pool;
+    do {
+        old = slot->refs;
+        if (old <= 0) {
+            android_atomic_inc(&pool->badRelease);
+            ALOGE("release of free frame %d", slot->index);
+            return VPU_ERR;
+        }
+    } while (android_atomic_release_cas(old, old - 1, &slot->refs));
+    frame->employ_cnt = old - 1;
+
+    if (old == 1) {
+        android_atomic_dec(&pool->inUse);
+        pool_push(pool, slot);
+        /* full barrier: the push is visible before waiters is read */
+        if (android_atomic_or(0, &pool->waiters)) {
+            pthread_mutex_lock(&pool->lock);
+            pthread_cond_broadcast(&pool->freed);
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+
+    return VPU_OK;
+}
+
+RK_S32 VPUFramePoolRefCount(VPU_FRAME *frame)
+{
+    FrameSlot_t *slot = pool_slot(frame);
+
+    if (slot == NULL)
+        return VPU_ERR;
+
+    return android_atomic_acquire_load(&slot->refs);
+}
+
+void VPUFramePoolGetStats(VPUFramePool_t *pool, VPUFramePoolStats_t *stats)
+{
+    if (pool == NULL || stats == NULL)
+        return;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->frameNum = pool->frameNum;
+    stats->frameSize = pool->frameSize;
+    stats->inUse = android_atomic_acquire_load(&pool->inUse);
+    stats->peakInUse = android_atomic_acquire_load(&pool->peakInUse);
+    stats->acquires = android_atomic_acquire_load(&pool->acquires);
+    stats->starved = android_atomic_acquire_load(&pool->starved);
+    stats->timeouts = android_atomic_acquire_load(&pool->timeouts);
+    stats->badRelease = android_atomic_acquire_load(&pool->badRelease);
+
+    pthread_mutex_lock(&pool->lock);
+    stats->starvedUs = pool->starvedUs;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,80 @@
+/***************************************************************************************************
+    File:
+        vpu_frame_pool.h
+    Description:
+        Shared pool of decoded VPU_FRAMEs with explicit reference counting.
+        The decoder acquires a frame, whoever hands it to the display or to
+        an RGA conversion takes a reference, and the frame goes back to the
+        free list only when the last holder releases it, so frames are
+        neither over allocated nor recycled while still on screen. Free
+        lists are lock-free; the pool is sized from the codec's DPB needs.
+
+        References are counted per process: holders in another process
+        (hwcomposer reading the frame from a gralloc buffer) need the owning
+        process to hold a reference for them.
+ **************************************************************************************************/
+#ifndef __VPU_FRAME_POOL_H__
+#define __VPU_FRAME_POOL_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "vpu_api.h"
+#include "vpu_mem_pool.h"
+
+#define VPU_FRAME_POOL_MAX              (64)
+#define VPU_FRAME_POOL_WAIT_FOREVER     (-1)
+
+typedef struct VPUFramePoolCfg
+{
+    RK_U32                      width;          /* display size */
+    RK_U32                      height;
+    RK_U32                      frameNum;       /* 0: VPUFramePoolSize() of the fields below */
+    OMX_ON2_VIDEO_CODINGTYPE    coding;
+    RK_U32                      displayDepth;   /* frames the display side may hold */
+    const VPUMemPoolBackend_t   *backend;       /* NULL: VPUMallocLinear */
+} VPUFramePoolCfg_t;
+
+typedef struct VPUFramePoolStats
+{
+    RK_U32  frameNum;
+    RK_U32  frameSize;
+    RK_U32  inUse;
+    RK_U32  peakInUse;
+    RK_U32  acquires;
+    RK_U32  starved;            /* acquires that found the pool empty */
+    RK_U32  timeouts;
+    RK_U64  starvedUs;          /* time spent waiting for a frame */
+    RK_U32  badRelease;         /* release of a frame that was already free */
+} VPUFramePoolStats_t;
+
+typedef struct VPUFramePool VPUFramePool_t;
+
+/* reference frames the codec keeps for a picture of width x height */
+RK_U32 VPUFramePoolDpbSize(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height);
+/* DPB + the frame being decoded + displayDepth + one in conversion */
+RK_U32 VPUFramePoolSize(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                        RK_U32 displayDepth);
+
+VPUFramePool_t *VPUFramePoolCreate(const VPUFramePoolCfg_t *cfg);
+/* fails while frames are still held */
+RK_S32 VPUFramePoolDestroy(VPUFramePool_t *pool);
+
+/* a free frame with one reference, or NULL after timeoutMs */
+VPU_FRAME *VPUFramePoolAcquire(VPUFramePool_t *pool, RK_S32 timeoutMs);
+/* extra reference, e.g. when the frame is queued to the overlay */
+RK_S32 VPUFramePoolAddRef(VPU_FRAME *frame);
+/* drop a reference, the frame is free again after the last one */
+RK_S32 VPUFramePoolRelease(VPU_FRAME *frame);
+RK_S32 VPUFramePoolRefCount(VPU_FRAME *frame);
+
+void VPUFramePoolGetStats(VPUFramePool_t *pool, VPUFramePoolStats_t *stats);
+
+#ifdef __cplusplus
+}
+
+#endif
+
+#endif /* __VPU_FRAME_POOL_H__ */
@@ -0,0 +1,263 @@
+/***************************************************************************************************
+    File:
+        vpu_frame_pool_test.c
+    Description:
+        Test of the reference counted frame pool on the malloc stand-in
+        backend. Builds for the host:
+
+            vpu_frame_pool_test [threads]
+
+        Covers the DPB based sizing, the reference count of a frame through
+        acquire, addref and release, misuse of free frames, an exhausted
+        pool timing out and waking a blocked acquire on release, destroy
+        with frames still held, and threads sharing one pool.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "vpu_macro.h"
+#include "vpu_frame_pool.h"
+
+#define TEST_THREADS_DEF            (4)
+#define TEST_LOOPS                  (100000)
+
+#ifdef VPU_FRAME_POOL_TEST_HOST
+/* the test runs on the malloc stand-in, these only satisfy the default backends */
+RK_S32 VPUMallocLinear(VPUMemLinear_t *p, RK_U32 size)
+{
+    (void)size;
+    p->offset = -1;
+    return VPU_ERR;
+}
+
+RK_S32 VPUFreeLinear(VPUMemLinear_t *p)
+{
+    (void)p;
+    return VPU_ERR;
+}
+
+RK_S32 VPUMemDuplicate(VPUMemLinear_t *dst, VPUMemLinear_t *src)
+{
+    (void)dst;
+    (void)src;
+    return VPU_ERR;
+}
+
+RK_S32 VPUMemLink(VPUMemLinear_t *p)
+{
+    (void)p;
+    return VPU_ERR;
+}
+#endif
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+static VPUFramePool_t *test_pool(RK_U32 frameNum)
+{
+    VPUFramePoolCfg_t cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.width = 1920;
+    cfg.height = 1080;
+    cfg.frameNum = frameNum;
+    cfg.coding = OMX_ON2_VIDEO_CodingAVC;
+    cfg.backend = VPUMemPoolMallocBackend();
+    return VPUFramePoolCreate(&cfg);
+}
+
+static void test_sizing(void)
+{
+    VPUFramePoolStats_t stats;
+    VPUFramePool_t *pool;
+
+    /* level 4.1: 32768 MBs over the 8160 of 1080p */
+    check_eq("size: avc 1080p dpb", VPUFramePoolDpbSize(OMX_ON2_VIDEO_CodingAVC, 1920, 1080), 4);
+    check_eq("size: avc vga dpb", VPUFramePoolDpbSize(OMX_ON2_VIDEO_CodingAVC, 640, 480), 16);
+    check_eq("size: vp8 dpb", VPUFramePoolDpbSize(OMX_ON2_VIDEO_CodingVP8, 1920, 1080), 3);
+    check_eq("size: mjpeg dpb", VPUFramePoolDpbSize(OMX_ON2_VIDEO_CodingMJPEG, 1920, 1080), 0);
+    check_eq("size: mpeg4 dpb", VPUFramePoolDpbSize(OMX_ON2_VIDEO_CodingMPEG4, 1920, 1080), 2);
+    /* DPB, the frame being decoded, the display and one in conversion */
+    check_eq("size: avc 1080p pool", VPUFramePoolSize(OMX_ON2_VIDEO_CodingAVC, 1920, 1080, 2), 8);
+
+    pool = test_pool(0);
+    if (pool == NULL) {
+        check(0, "size: create");
+        return;
+    }
+    VPUFramePoolGetStats(pool, &stats);
+    check_eq("size: default frames", stats.frameNum, 8);
+    check_eq("size: frame bytes", stats.frameSize, 1920 * 1088 * 3 / 2);
+    check_eq("size: destroy", VPUFramePoolDestroy(pool), VPU_OK);
+}
+
+static void test_refs(void)
+{
+    VPUFramePoolStats_t stats;
+    VPUFramePool_t *pool = test_pool(2);
+    VPU_FRAME *f;
+
+    if (pool == NULL) {
+        check(0, "refs: create");
+        return;
+    }
+
+    f = VPUFramePoolAcquire(pool, 0);
+    check(f != NULL, "refs: acquire");
+    if (f == NULL)
+        return;
+    check_eq("refs: one after acquire", VPUFramePoolRefCount(f), 1);
+    check(f->FrameBusAddr[1] == f->FrameBusAddr[0] + 1920 * 1088, "refs: chroma after luma");
+
+    VPUFramePoolAddRef(f);
+    check_eq("refs: two after addref", VPUFramePoolRefCount(f), 2);
+    check_eq("refs: employ_cnt follows", f->employ_cnt, 2);
+    check_eq("refs: destroy while held", VPUFramePoolDestroy(pool), VPU_ERR);
+
+    VPUFramePoolRelease(f);
+    VPUFramePoolGetStats(pool, &stats);
+    check_eq("refs: still in use", stats.inUse, 1);
+    VPUFramePoolRelease(f);
+    VPUFramePoolGetStats(pool, &stats);
+    check_eq("refs: free after the last release", stats.inUse, 0);
+
+    /* a free frame can be neither released nor revived */
+    check_eq("refs: release of a free frame", VPUFramePoolRelease(f), VPU_ERR);
+    check_eq("refs: addref of a free frame", VPUFramePoolAddRef(f), VPU_ERR);
+    VPUFramePoolGetStats(pool, &stats);
+    check_eq("refs: misuse counted", stats.badRelease, 2);
+
+    check_eq("refs: destroy", VPUFramePoolDestroy(pool), VPU_OK);
+}
+
+typedef struct
+{
+    VPU_FRAME   *frame;
+    RK_U32      delayMs;
+} TestRelease_t;
+
+static void *test_late_release(void *arg)
+{
+    TestRelease_t *r = (TestRelease_t *)arg;
+
+    usleep(r->delayMs * 1000);
+    VPUFramePoolRelease(r->frame);
+    return NULL;
+}
+
+static void test_exhaustion(void)
+{
+    VPUFramePoolStats_t stats;
+    VPUFramePool_t *pool = test_pool(2);
+    VPU_FRAME *a, *b, *c;
+    TestRelease_t r;
+    pthread_t thread;
+
+    if (pool == NULL) {
+        check(0, "dry: create");
+        return;
+    }
+
+    a = VPUFramePoolAcquire(pool, 0);
+    b = VPUFramePoolAcquire(pool, 0);
+    check(a != NULL && b != NULL && a != b, "dry: two frames");
+    check(VPUFramePoolAcquire(pool, 0) == NULL, "dry: no wait on an empty pool");
+    check(VPUFramePoolAcquire(pool, 20) == NULL, "dry: timeout on an empty pool");
+
+    /* a blocked acquire gets the frame released by another thread */
+    r.frame = b;
+    r.delayMs = 20;
+    pthread_create(&thread, NULL, test_late_release, &r);
+    c = VPUFramePoolAcquire(pool, VPU_FRAME_POOL_WAIT_FOREVER);
+    pthread_join(thread, NULL);
+    check(c == b, "dry: woken by the release");
+
+    VPUFramePoolGetStats(pool, &stats);
+    check_eq("dry: starved", stats.starved, 3);
+    check_eq("dry: timeouts", stats.timeouts, 2);
+    check_eq("dry: peak", stats.peakInUse, 2);
+    check(stats.starvedUs >= 20000, "dry: wait time");
+
+    VPUFramePoolRelease(a);
+    VPUFramePoolRelease(c);
+    check_eq("dry: destroy", VPUFramePoolDestroy(pool), VPU_OK);
+}
+
+static void *test_worker(void *arg)
+{
+    VPUFramePool_t *pool = (VPUFramePool_t *)arg;
+    RK_U32 i;
+
+    for (i = 0; i < TEST_LOOPS; i++) {
+        VPU_FRAME *f = VPUFramePoolAcquire(pool, VPU_FRAME_POOL_WAIT_FOREVER);
+
+        if (f == NULL) {
+            check(0, "threads: acquire");
+            break;
+        }
+        /* display and conversion holders */
+        VPUFramePoolAddRef(f);
+        VPUFramePoolRelease(f);
+        VPUFramePoolRelease(f);
+    }
+    return NULL;
+}
+
+static void test_threads(int threads)
+{
+    VPUFramePoolStats_t stats;
+    VPUFramePool_t *pool = test_pool(3);
+    pthread_t t[16];
+    int i;
+
+    if (pool == NULL) {
+        check(0, "threads: create");
+        return;
+    }
+
+    for (i = 0; i < threads; i++)
+        pthread_create(&t[i], NULL, test_worker, pool);
+    for (i = 0; i < threads; i++)
+        pthread_join(t[i], NULL);
+
+    VPUFramePoolGetStats(pool, &stats);
+    check_eq("threads: acquires", stats.acquires, threads * TEST_LOOPS);
+    check_eq("threads: all back", stats.inUse, 0);
+    check(stats.peakInUse <= 3, "threads: peak within the pool");
+    check_eq("threads: no misuse", stats.badRelease, 0);
+    check_eq("threads: destroy", VPUFramePoolDestroy(pool), VPU_OK);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : TEST_THREADS_DEF;
+
+    if (threads <= 0 || threads > 16)
+        threads = TEST_THREADS_DEF;
+
+    test_sizing();
+    test_refs();
+    test_exhaustion();
+    test_threads(threads);
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
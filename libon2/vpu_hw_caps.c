@@ -0,0 +1,299 @@
+/***************************************************************************************************
+    File:
+        vpu_hw_caps.c
+    Description:
+        Process wide VPU hardware capability cache
+ **************************************************************************************************/
+#define LOG_TAG "vpu_hw_caps"
+
+#include <string.h>
+#include <pthread.h>
+#include <cutils/log.h>
+#include <cutils/atomic.h>
+
+#include "vpu_macro.h"
+#include "vpu_hw_caps.h"
+#include "dwl.h"
+
+/* the JPEG decoder and encoder work on any size up to this, in both directions */
+#define CAPS_JPEG_MAX_DIM       (8176)
+
+#define CAPS_ALIGN16(x)         (((x) + 15) & ~15)
+
+/* video codings the decoder knows, the index of the lookup tables */
+typedef enum
+{
+    CAPS_DEC_H264           = 0,
+    CAPS_DEC_MPEG4,
+    CAPS_DEC_H263,
+    CAPS_DEC_MPEG2,
+    CAPS_DEC_VC1,
+    CAPS_DEC_SORENSON,
+    CAPS_DEC_DIVX3,
+    CAPS_DEC_VP6,
+    CAPS_DEC_VP8,
+    CAPS_DEC_RV,
+    CAPS_DEC_MJPEG,
+    CAPS_DEC_BUTT,
+} CAPS_DEC_CODING;
+
+static pthread_mutex_t capsLock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int32_t capsReady = 0;
+static VPUHwCaps_t caps;
+static DWLHwConfig_t capsDwl;
+
+/* filled at probe time, 0 means not in hardware */
+static RK_U32 capsDecMaxWidth[CAPS_DEC_BUTT];
+static RK_U32 capsDecMaxMbs;
+static RK_U32 capsEncMaxMbs;
+static RK_U32 capsPpMask;
+
+static RK_S32 caps_dec_index(OMX_ON2_VIDEO_CODINGTYPE coding)
+{
+    switch (coding) {
+    case OMX_ON2_VIDEO_CodingAVC:       return CAPS_DEC_H264;
+    case OMX_ON2_VIDEO_CodingMPEG4:     return CAPS_DEC_MPEG4;
+    case OMX_ON2_VIDEO_CodingH263:      return CAPS_DEC_H263;
+    case OMX_ON2_VIDEO_CodingMPEG2:     return CAPS_DEC_MPEG2;
+    case OMX_ON2_VIDEO_CodingWMV:
+    case OMX_ON2_VIDEO_CodingVC1:       return CAPS_DEC_VC1;
+    case OMX_ON2_VIDEO_CodingFLV1:      return CAPS_DEC_SORENSON;
+    case OMX_ON2_VIDEO_CodingDIVX3:     return CAPS_DEC_DIVX3;
+    case OMX_ON2_VIDEO_CodingVP6:       return CAPS_DEC_VP6;
+    case OMX_ON2_VIDEO_CodingVP8:       return CAPS_DEC_VP8;
+    case OMX_ON2_VIDEO_CodingRV:        return CAPS_DEC_RV;
+    case OMX_ON2_VIDEO_CodingMJPEG:     return CAPS_DEC_MJPEG;
+    default:                            return -1;
+    }
+}
+
+/*
+ * Macroblock budget of a width limited engine: a 16:9 picture at the
+ * maximum width (1920 -> 1920x1088), so that portrait pictures of the
+ * same area pass too.
+ */
+static RK_U32 caps_max_mbs(RK_U32 maxWidth)
+{
+    return (CAPS_ALIGN16(maxWidth) >> 4) * (CAPS_ALIGN16(maxWidth * 9 / 16) >> 4);
+}
+
+static void caps_build_tables(void)
+{
+    const VPUHwDecConfig_t *dec = &caps.dec;
+    RK_U32 w = dec->maxDecPicWidth;
+
+    memset(capsDecMaxWidth, 0, sizeof(capsDecMaxWidth));
+    capsPpMask = VPU_HW_PP_NONE;
+    capsDecMaxMbs = 0;
+    capsEncMaxMbs = 0;
+
+    if (caps.decValid) {
+        capsDecMaxWidth[CAPS_DEC_H264] = dec->h264Support ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_MPEG4] = dec->mpeg4Support ? w : 0;
+        /* H.263 baseline is decoded by the MPEG-4 core */
+        capsDecMaxWidth[CAPS_DEC_H263] = dec->mpeg4Support ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_MPEG2] = dec->mpeg2Support ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_VC1] = dec->vc1Support ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_SORENSON] = dec->sorensonSparkSupport ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_DIVX3] = dec->customMpeg4Support ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_VP6] = dec->vp6Support ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_VP8] = dec->vp8Support ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_RV] = dec->rvSupport ? w : 0;
+        capsDecMaxWidth[CAPS_DEC_MJPEG] = dec->jpegSupport ? w : 0;
+        capsDecMaxMbs = caps_max_mbs(w);
+
+        if (dec->ppSupport) {
+            if (dec->ppConfig & PP_SCALING)
+                capsPpMask |= VPU_HW_PP_SCALE;
+            if (dec->ppConfig & PP_DEINTERLACING)
+                capsPpMask |= VPU_HW_PP_DEINTERLACE;
+            if (dec->ppConfig & PP_DITHERING)
+                capsPpMask |= VPU_HW_PP_DITHER;
+            if (dec->ppConfig & PP_ALPHA_BLENDING)
+                capsPpMask |= VPU_HW_PP_ALPHA;
+        }
+    }
+
+    if (caps.encValid)
+        capsEncMaxMbs = caps_max_mbs(caps.enc.maxEncodedWidth);
+}
+
+static RK_S32 caps_read(VPU_CLIENT_TYPE type, RK_U32 *cfg, RK_U32 size)
+{
+    RK_S32 ret;
+    int socket;
+
+    socket = VPUClientInit(type);
+    if (socket < 0) {
+        ALOGE("VPUClientInit(%d) failed", type);
+        return VPU_ERR;
+    }
+
+    ret = VPUClientGetHwCfg(socket, cfg, size);
+    VPUClientRelease(socket);
+    if (ret) {
+        ALOGE("VPUClientGetHwCfg(%d) failed %d", type, ret);
+        return VPU_ERR;
+    }
+
+    return VPU_OK;
+}
+
+/* the JPEG decoder's view for an override, taken from the decoder configuration */
+static void caps_dwl_from_dec(const VPUHwDecConfig_t *dec)
+{
+    memset(&capsDwl, 0, sizeof(capsDwl));
+    capsDwl.maxDecPicWidth = dec->maxDecPicWidth;
+    capsDwl.maxPpOutPicWidth = dec->maxPpOutPicWidth;
+    capsDwl.jpegSupport = dec->jpegSupport;
+    capsDwl.jpegESupport = dec->jpegESupport;
+    capsDwl.ppSupport = dec->ppSupport;
+    capsDwl.ppConfig = dec->ppConfig;
+}
+
+/*
+ * There are no fuses to apply: DWLReadAsicFuseStatus in libjpeghwdec.so
+ * returns without writing anything. DWLReadAsicConfig only sets
+ * jpegSupport and jpegESupport, and that is what the JPEG decoder checks
+ * a stream against, so it is kept next to the service configuration.
+ */
+static void caps_probe(void)
+{
+    memset(&caps, 0, sizeof(caps));
+
+    if (!caps_read(VPU_DEC, (RK_U32 *)&caps.dec, sizeof(caps.dec)))
+        caps.decValid = 1;
+
+    if (!caps_read(VPU_ENC, (RK_U32 *)&caps.enc, sizeof(caps.enc)))
+        caps.encValid = 1;
+
+    memset(&capsDwl, 0, sizeof(capsDwl));
+    DWLReadAsicConfig(&capsDwl);
+
+    ALOGD("decoder %s max width %d pp 0x%x, encoder %s max width %d, jpeg decoder %d ext %d",
+          caps.decValid ? "ok" : "absent", caps.dec.maxDecPicWidth, caps.dec.ppConfig,
+          caps.encValid ? "ok" : "absent", caps.enc.maxEncodedWidth,
+          capsDwl.jpegSupport, capsDwl.jpegESupport);
+}
+
+const VPUHwCaps_t *VPUHwCapsGet(void)
+{
+    if (android_atomic_acquire_load(&capsReady))
+        return &caps;
+
+    pthread_mutex_lock(&capsLock);
+    if (!capsReady) {
+        caps_probe();
+        caps_build_tables();
+        android_atomic_release_store(1, &capsReady);
+    }
+    pthread_mutex_unlock(&capsLock);
+
+    return &caps;
+}
+
+RK_S32 VPUHwCapsOverride(const VPUHwDecConfig_t *dec, const VPUHwEncConfig_t *enc)
+{
+    pthread_mutex_lock(&capsLock);
+    if (capsReady) {
+        pthread_mutex_unlock(&capsLock);
+        return VPU_ERR;
+    }
+
+    memset(&caps, 0, sizeof(caps));
+    memset(&capsDwl, 0, sizeof(capsDwl));
+    if (dec != NULL) {
+        caps.dec = *dec;
+        caps.decValid = 1;
+        caps_dwl_from_dec(dec);
+    }
+    if (enc != NULL) {
+        caps.enc = *enc;
+        caps.encValid = 1;
+    }
+    caps_build_tables();
+    android_atomic_release_store(1, &capsReady);
+    pthread_mutex_unlock(&capsLock);
+
+    return VPU_OK;
+}
+
+const DWLHwConfig_t *VPUHwCapsDwlConfig(void)
+{
+    VPUHwCapsGet();
+    return &capsDwl;
+}
+
+RK_S32 VPUHwCapsCanPostProcess(RK_U32 outWidth, RK_U32 ppFlags)
+{
+    const VPUHwCaps_t *c = VPUHwCapsGet();
+
+    if (!c->dec.ppSupport || (ppFlags & ~capsPpMask))
+        return 0;
+    return !outWidth || outWidth <= c->dec.maxPpOutPicWidth;
+}
+
+RK_S32 VPUHwCapsCanDecode(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                          RK_U32 ppFlags)
+{
+    RK_S32 idx = caps_dec_index(coding);
+    RK_U32 maxWidth, mbs;
+
+    VPUHwCapsGet();
+
+    if (idx < 0)
+        return 0;
+
+    maxWidth = capsDecMaxWidth[idx];
+    mbs = (CAPS_ALIGN16(width) >> 4) * (CAPS_ALIGN16(height) >> 4);
+    if (!maxWidth || width > maxWidth || height > maxWidth || mbs > capsDecMaxMbs)
+        return 0;
+
+    return ppFlags == VPU_HW_PP_NONE || VPUHwCapsCanPostProcess(0, ppFlags);
+}
+
+RK_S32 VPUHwCapsCanDecodeJpeg(RK_U32 width, RK_U32 height, RK_S32 progressive, RK_U32 ppFlags)
+{
+    const VPUHwCaps_t *c = VPUHwCapsGet();
+
+    /* the service says what the silicon does, the DWL what the JPEG decoder accepts */
+    if (!c->dec.jpegSupport || !capsDwl.jpegSupport)
+        return 0;
+    if (progressive && (c->dec.jpegSupport != JPEG_PROGRESSIVE ||
+                        capsDwl.jpegSupport != JPEG_PROGRESSIVE))
+        return 0;
+    if (width > CAPS_JPEG_MAX_DIM || height > CAPS_JPEG_MAX_DIM)
+        return 0;
+
+    return ppFlags == VPU_HW_PP_NONE || VPUHwCapsCanPostProcess(0, ppFlags);
+}
+
+RK_S32 VPUHwCapsCanEncode(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                          RK_S32 rgbInput)
+{
+    const VPUHwCaps_t *c = VPUHwCapsGet();
+    RK_U32 mbs;
+
+    if (!c->encValid || (rgbInput && !c->enc.rgbEnabled))
+        return 0;
+
+    switch (coding) {
+    case OMX_ON2_VIDEO_CodingAVC:
+        if (!c->enc.h264Enabled)
+            return 0;
+        break;
+    case OMX_ON2_VIDEO_CodingMPEG4:
+    case OMX_ON2_VIDEO_CodingH263:
+        if (!c->enc.mpeg4Enabled)
+            return 0;
+        break;
+    case OMX_ON2_VIDEO_CodingMJPEG:
+        return c->enc.jpegEnabled && width <= CAPS_JPEG_MAX_DIM && height <= CAPS_JPEG_MAX_DIM;
+    default:
+        return 0;
+    }
+
+    mbs = (CAPS_ALIGN16(width) >> 4) * (CAPS_ALIGN16(height) >> 4);
+    return width <= c->enc.maxEncodedWidth && height <= c->enc.maxEncodedWidth &&
+           mbs <= capsEncMaxMbs;
+}
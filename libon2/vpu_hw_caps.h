@@ -0,0 +1,63 @@
+/***************************************************************************************************
+    File:
+        vpu_hw_caps.h
+    Description:
+        Process wide cache of the VPU hardware configuration. The decoder
+        and encoder configuration are read from the VPU service once, the
+        JPEG decoder's DWL configuration next to them, and kept read-only
+        for the life of the process, so clients stop doing a socket round
+        trip at every init. The helpers answer whether a coding /
+        resolution / post processing combination runs in hardware from a
+        table built at probe time, before a context is opened and fails.
+ **************************************************************************************************/
+#ifndef __VPU_HW_CAPS_H__
+#define __VPU_HW_CAPS_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "vpu.h"
+#include "vpu_api.h"
+
+/* post-processor functions a job needs, checked against ppConfig */
+#define VPU_HW_PP_NONE                  (0x0)
+#define VPU_HW_PP_SCALE                 (0x1)
+#define VPU_HW_PP_DEINTERLACE           (0x2)
+#define VPU_HW_PP_DITHER                (0x4)
+#define VPU_HW_PP_ALPHA                 (0x8)
+
+typedef struct VPUHwCaps
+{
+    VPUHwDecConfig_t    dec;        /* after the fuses */
+    VPUHwEncConfig_t    enc;
+    RK_U32              decValid;   /* the service answered, otherwise nothing is supported */
+    RK_U32              encValid;
+} VPUHwCaps_t;
+
+/* probed on first use, never NULL */
+const VPUHwCaps_t *VPUHwCapsGet(void);
+/* DWLReadAsicConfig of the JPEG decoder, read once with the rest */
+const struct DWLHwConfig *VPUHwCapsDwlConfig(void);
+
+/*
+ * Use this configuration instead of probing, e.g. to run on a PC. Only
+ * before the first VPUHwCapsGet; returns VPU_ERR afterwards.
+ */
+RK_S32 VPUHwCapsOverride(const VPUHwDecConfig_t *dec, const VPUHwEncConfig_t *enc);
+
+/* 1 when the combination runs in hardware, 0 otherwise */
+RK_S32 VPUHwCapsCanDecode(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                          RK_U32 ppFlags);
+RK_S32 VPUHwCapsCanDecodeJpeg(RK_U32 width, RK_U32 height, RK_S32 progressive, RK_U32 ppFlags);
+RK_S32 VPUHwCapsCanPostProcess(RK_U32 outWidth, RK_U32 ppFlags);
+RK_S32 VPUHwCapsCanEncode(OMX_ON2_VIDEO_CODINGTYPE coding, RK_U32 width, RK_U32 height,
+                          RK_S32 rgbInput);
+
+#ifdef __cplusplus
+}
+
+#endif
+
+#endif /* __VPU_HW_CAPS_H__ */
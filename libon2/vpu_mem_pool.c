@@ -0,0 +1,598 @@
+/***************************************************************************************************
+    File:
+        vpu_mem_pool.c
+    Description:
+        Pooled slab allocator over VPUMemLinear_t
+ **************************************************************************************************/
+#define LOG_TAG "vpu_mem_pool"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_mem_pool.h"
+
+#define POOL_ALIGN(x)       (((x) + VPU_MEM_POOL_ALIGN - 1) & ~(VPU_MEM_POOL_ALIGN - 1))
+
+typedef struct
+{
+    VPUMemLinear_t  region;
+    RK_U32          blockSize;
+    RK_U32          blockNum;
+    RK_U32          blockUsed;
+    RK_U32          blockPeak;
+    RK_U32          bytesRequested;
+    RK_U32          allocFailed;
+    RK_U32          *refs;          /* per block reference count, 0 means free */
+    RK_U32          *reqSize;       /* per block requested size */
+    RK_U32          *freeList;      /* stack of free block indexes */
+    RK_U32          freeTop;
+    RK_U32          carved;         /* region is allocated, 0 after a trim */
+} VPUMemPoolClass_t;
+
+struct VPUMemPool
+{
+    pthread_mutex_t         lock;
+    VPUMemPoolBackend_t     backend;
+    VPUMemPoolClass_t       cls[VPU_MEM_CLASS_BUTT];
+    RK_U32                  fallbackAllocs;
+    RK_U32                  fallbackBytes;
+};
+
+static const VPUMemPoolBackend_t defaultBackend =
+{
+    VPUMallocLinear,
+    VPUFreeLinear,
+    VPUMemDuplicate,
+    VPUMemLink,
+};
+
+/* find the class and block index owning a descriptor, -1 if not pooled, -2 if bogus */
+static RK_S32 pool_lookup(VPUMemPool_t *pool, const VPUMemLinear_t *p, RK_U32 *index)
+{
+    RK_S32 i;
+
+    for (i = 0; i < VPU_MEM_CLASS_BUTT; i++) {
+        VPUMemPoolClass_t *c = &pool->cls[i];
+        RK_U32 off;
+
+        if (!c->carved)
+            continue;
+
+        if (p->phy_addr < c->region.phy_addr)
+            continue;
+
+        off = p->phy_addr - c->region.phy_addr;
+        if (off >= c->blockNum * c->blockSize)
+            continue;
+
+        if (off % c->blockSize) {
+            ALOGE("address 0x%x is inside class %d but not on a block start", p->phy_addr, i);
+            return -2;
+        }
+
+        *index = off / c->blockSize;
+        return i;
+    }
+
+    return -1;
+}
+
+/* (re)carve the region of a class and put every block on the free list */
+static RK_S32 pool_class_carve(VPUMemPool_t *pool, VPUMemPoolClass_t *c)
+{
+    RK_U32 n;
+
+    if (pool->backend.alloc(&c->region, c->blockSize * c->blockNum) != VPU_OK ||
+        VPU_MEM_IS_NULL(&c->region)) {
+        c->region.offset = -1;
+        return VPU_ERR;
+    }
+
+    /* hand out low addresses first */
+    for (n = 0; n < c->blockNum; n++)
+        c->freeList[n] = c->blockNum - 1 - n;
+    c->freeTop = c->blockNum;
+    c->carved = 1;
+    return VPU_OK;
+}
+
+static void pool_class_release(VPUMemPool_t *pool, VPUMemPoolClass_t *c)
+{
+    if (c->carved)
+        pool->backend.free(&c->region);
+
+    free(c->refs);
+    free(c->reqSize);
+    free(c->freeList);
+    memset(c, 0, sizeof(*c));
+}
+
+VPUMemPool_t *VPUMemPoolCreate(const VPUMemPoolClassCfg_t cfg[VPU_MEM_CLASS_BUTT],
+                               const VPUMemPoolBackend_t *backend)
+{
+    VPUMemPool_t *pool;
+    RK_S32 i;
+
+    pool = (VPUMemPool_t *)calloc(1, sizeof(VPUMemPool_t));
+    if (pool == NULL)
+        return NULL;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->backend = backend ? *backend : defaultBackend;
+
+    for (i = 0; i < VPU_MEM_CLASS_BUTT; i++) {
+        VPUMemPoolClass_t *c = &pool->cls[i];
+
+        c->region.offset = -1;
+        if (!cfg[i].blockNum || !cfg[i].blockSize)
+            continue;
+
+        c->blockSize = POOL_ALIGN(cfg[i].blockSize);
+        c->blockNum = cfg[i].blockNum;
+
+        c->refs     = (RK_U32 *)calloc(c->blockNum, sizeof(RK_U32));
+        c->reqSize  = (RK_U32 *)calloc(c->blockNum, sizeof(RK_U32));
+        c->freeList = (RK_U32 *)calloc(c->blockNum, sizeof(RK_U32));
+        if (!c->refs || !c->reqSize || !c->freeList)
+            goto fail;
+
+        if (pool_class_carve(pool, c) != VPU_OK) {
+            ALOGE("class %d: failed to carve %d x %d bytes", i, c->blockNum, c->blockSize);
+            goto fail;
+        }
+    }
+
+    return pool;
+
+fail:
+    VPUMemPoolDestroy(pool);
+    return NULL;
+}
+
+void VPUMemPoolDestroy(VPUMemPool_t *pool)
+{
+    RK_S32 i;
+
+    if (pool == NULL)
+        return;
+
+    for (i = 0; i < VPU_MEM_CLASS_BUTT; i++) {
+        if (pool->cls[i].blockUsed)
+            ALOGW("class %d destroyed with %d blocks in use", i, pool->cls[i].blockUsed);
+        pool_class_release(pool, &pool->cls[i]);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static RK_S32 pool_class_alloc(VPUMemPool_t *pool, VPUMemPoolClass_t *c, VPUMemLinear_t *p,
+                               RK_U32 size)
+{
+    RK_U32 idx, off;
+
+    /* a trimmed class is carved again on its first use */
+    if (!c->carved && pool_class_carve(pool, c) != VPU_OK) {
+        c->allocFailed++;
+        return VPU_ERR;
+    }
+
+    if (!c->freeTop) {
+        c->allocFailed++;
+        return VPU_ERR;
+    }
+
+    idx = c->freeList[--c->freeTop];
+    off = idx * c->blockSize;
+
+    c->refs[idx] = 1;
+    c->reqSize[idx] = size;
+    c->blockUsed++;
+    c->bytesRequested += size;
+    if (c->blockUsed > c->blockPeak)
+        c->blockPeak = c->blockUsed;
+
+    p->phy_addr = c->region.phy_addr + off;
+    p->vir_addr = c->region.vir_addr + off / sizeof(RK_U32);
+    p->size     = c->blockSize;
+    p->offset   = c->region.offset + off;
+#ifdef RVDS_PROGRAME
+    p->pbase    = c->region.pbase;
+#endif
+    return VPU_OK;
+}
+
+RK_S32 VPUMemPoolMallocClass(VPUMemPool_t *pool, VPUMemLinear_t *p, RK_U32 size, VPU_MEM_CLASS cls)
+{
+    RK_S32 ret = VPU_ERR;
+    RK_S32 i;
+
+    if (pool == NULL || p == NULL || cls >= VPU_MEM_CLASS_BUTT)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&pool->lock);
+
+    /* the requested class first, then any larger one */
+    for (i = cls; i < VPU_MEM_CLASS_BUTT && ret != VPU_OK; i++) {
+        VPUMemPoolClass_t *c = &pool->cls[i];
+        if (c->blockNum && c->blockSize >= size)
+            ret = pool_class_alloc(pool, c, p, size);
+    }
+
+    if (ret != VPU_OK) {
+        ret = pool->backend.alloc(p, size);
+        if (ret == VPU_OK) {
+            pool->fallbackAllocs++;
+            pool->fallbackBytes += size;
+        }
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+RK_S32 VPUMemPoolMalloc(VPUMemPool_t *pool, VPUMemLinear_t *p, RK_U32 size)
+{
+    RK_S32 i;
+
+    if (pool == NULL)
+        return VPU_ERR;
+
+    for (i = 0; i < VPU_MEM_CLASS_BUTT; i++) {
+        if (pool->cls[i].blockNum && pool->cls[i].blockSize >= size)
+            break;
+    }
+
+    if (i == VPU_MEM_CLASS_BUTT) {
+        RK_S32 ret;
+
+        pthread_mutex_lock(&pool->lock);
+        ret = pool->backend.alloc(p, size);
+        if (ret == VPU_OK) {
+            pool->fallbackAllocs++;
+            pool->fallbackBytes += size;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return ret;
+    }
+
+    return VPUMemPoolMallocClass(pool, p, size, (VPU_MEM_CLASS)i);
+}
+
+RK_S32 VPUMemPoolFree(VPUMemPool_t *pool, VPUMemLinear_t *p)
+{
+    RK_U32 idx;
+    RK_S32 cls;
+
+    if (pool == NULL || p == NULL || VPU_MEM_IS_NULL(p))
+        return VPU_ERR;
+
+    pthread_mutex_lock(&pool->lock);
+
+    cls = pool_lookup(pool, p, &idx);
+    if (cls < 0) {
+        RK_S32 ret = (cls == -1) ? pool->backend.free(p) : VPU_ERR;
+        pthread_mutex_unlock(&pool->lock);
+        return ret;
+    }
+
+    VPUMemPoolClass_t *c = &pool->cls[cls];
+    if (!c->refs[idx]) {
+        ALOGE("double free of 0x%x in class %d", p->phy_addr, cls);
+        pthread_mutex_unlock(&pool->lock);
+        return VPU_ERR;
+    }
+
+    if (--c->refs[idx] == 0) {
+        c->blockUsed--;
+        c->bytesRequested -= c->reqSize[idx];
+        c->reqSize[idx] = 0;
+        c->freeList[c->freeTop++] = idx;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    p->phy_addr = 0;
+    p->vir_addr = NULL;
+    p->size = 0;
+    p->offset = -1;
+    return VPU_OK;
+}
+
+RK_S32 VPUMemPoolDuplicate(VPUMemPool_t *pool, VPUMemLinear_t *dst, VPUMemLinear_t *src)
+{
+    RK_U32 idx;
+    RK_S32 cls;
+    RK_S32 ret = VPU_OK;
+
+    if (pool == NULL || dst == NULL || src == NULL || VPU_MEM_IS_NULL(src))
+        return VPU_ERR;
+
+    pthread_mutex_lock(&pool->lock);
+
+    cls = pool_lookup(pool, src, &idx);
+    if (cls >= 0 && pool->cls[cls].refs[idx]) {
+        pool->cls[cls].refs[idx]++;
+        *dst = *src;
+    } else if (cls == -1 && pool->backend.duplicate) {
+        ret = pool->backend.duplicate(dst, src);
+    } else {
+        ret = VPU_ERR;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+RK_S32 VPUMemPoolLink(VPUMemPool_t *pool, VPUMemLinear_t *p)
+{
+    RK_U32 idx;
+    RK_S32 cls;
+    RK_S32 ret = VPU_OK;
+
+    if (pool == NULL || p == NULL || VPU_MEM_IS_NULL(p))
+        return VPU_ERR;
+
+    pthread_mutex_lock(&pool->lock);
+
+    cls = pool_lookup(pool, p, &idx);
+    if (cls >= 0 && pool->cls[cls].refs[idx]) {
+        VPUMemPoolClass_t *c = &pool->cls[cls];
+
+        /* the block is already mapped through the region, just take a reference */
+        c->refs[idx]++;
+        p->vir_addr = c->region.vir_addr + idx * c->blockSize / sizeof(RK_U32);
+    } else if (cls == -1 && pool->backend.link) {
+        ret = pool->backend.link(p);
+    } else {
+        ret = VPU_ERR;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+RK_S32 VPUMemPoolRefCount(VPUMemPool_t *pool, VPUMemLinear_t *p)
+{
+    RK_U32 idx;
+    RK_S32 cls;
+    RK_S32 refs = -1;
+
+    if (pool == NULL || p == NULL)
+        return -1;
+
+    pthread_mutex_lock(&pool->lock);
+    cls = pool_lookup(pool, p, &idx);
+    if (cls >= 0)
+        refs = pool->cls[cls].refs[idx];
+    pthread_mutex_unlock(&pool->lock);
+
+    return refs;
+}
+
+RK_S32 VPUMemPoolTrim(VPUMemPool_t *pool)
+{
+    RK_S32 i, trimmed = 0;
+
+    if (pool == NULL)
+        return 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (i = 0; i < VPU_MEM_CLASS_BUTT; i++) {
+        VPUMemPoolClass_t *c = &pool->cls[i];
+
+        if (!c->carved || c->blockUsed)
+            continue;
+
+        pool->backend.free(&c->region);
+        c->region.offset = -1;
+        c->freeTop = 0;
+        c->carved = 0;
+        trimmed++;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return trimmed;
+}
+
+RK_S32 VPUMemPoolGetStats(VPUMemPool_t *pool, VPUMemPoolStats_t *stats)
+{
+    RK_S32 i;
+
+    if (pool == NULL || stats == NULL)
+        return VPU_ERR;
+
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (i = 0; i < VPU_MEM_CLASS_BUTT; i++) {
+        VPUMemPoolClass_t *c = &pool->cls[i];
+        VPUMemPoolClassStats_t *s = &stats->cls[i];
+
+        s->blockSize      = c->blockSize;
+        s->blockNum       = c->blockNum;
+        s->blockUsed      = c->blockUsed;
+        s->blockPeak      = c->blockPeak;
+        s->bytesRequested = c->bytesRequested;
+        s->allocFailed    = c->allocFailed;
+
+        if (c->carved)
+            stats->regionBytes += c->blockSize * c->blockNum;
+        stats->usedBytes   += c->blockSize * c->blockUsed;
+        stats->wastedBytes += c->blockSize * c->blockUsed - c->bytesRequested;
+    }
+
+    stats->fallbackAllocs = pool->fallbackAllocs;
+    stats->fallbackBytes  = pool->fallbackBytes;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    if (stats->usedBytes)
+        stats->fragmentation = (RK_U32)((RK_U64)stats->wastedBytes * 100 / stats->usedBytes);
+
+    return VPU_OK;
+}
+
+void VPUMemPoolDump(VPUMemPool_t *pool)
+{
+    VPUMemPoolStats_t stats;
+    RK_S32 i;
+
+    if (VPUMemPoolGetStats(pool, &stats) != VPU_OK)
+        return;
+
+    for (i = 0; i < VPU_MEM_CLASS_BUTT; i++) {
+        VPUMemPoolClassStats_t *s = &stats.cls[i];
+        if (!s->blockNum)
+            continue;
+        ALOGD("class %d: block %d used %d/%d peak %d exhausted %d",
+              i, s->blockSize, s->blockUsed, s->blockNum, s->blockPeak, s->allocFailed);
+    }
+
+    ALOGD("region %d used %d wasted %d (%d%%) fallback %d allocs %d bytes",
+          stats.regionBytes, stats.usedBytes, stats.wastedBytes, stats.fragmentation,
+          stats.fallbackAllocs, stats.fallbackBytes);
+}
+
+/*
+ * malloc based stand-in: buffers are page aligned heap memory and bus
+ * addresses are handed out from a fake linear range. Buffers are kept on a
+ * list with a reference count so duplicate and link behave like vpu_mem:
+ * the memory goes when the last reference is freed.
+ */
+#define MALLOC_BACKEND_PHY_BASE     0x40000000
+
+typedef struct MallocBackendBuf
+{
+    struct MallocBackendBuf *next;
+    RK_U32                  phy_addr;
+    RK_U32                  *vir_addr;
+    RK_U32                  size;
+    RK_U32                  refs;
+} MallocBackendBuf;
+
+static pthread_mutex_t mallocBackendLock = PTHREAD_MUTEX_INITIALIZER;
+static RK_U32 mallocBackendPhy = MALLOC_BACKEND_PHY_BASE;
+static MallocBackendBuf *mallocBackendBufs;
+
+/* called with mallocBackendLock held */
+static MallocBackendBuf **malloc_backend_find(RK_U32 phy_addr)
+{
+    MallocBackendBuf **b;
+
+    for (b = &mallocBackendBufs; *b != NULL; b = &(*b)->next) {
+        if ((*b)->phy_addr == phy_addr)
+            return b;
+    }
+    return NULL;
+}
+
+static void malloc_backend_fill(VPUMemLinear_t *p, const MallocBackendBuf *b)
+{
+    p->phy_addr = b->phy_addr;
+    p->vir_addr = b->vir_addr;
+    p->size = b->size;
+    p->offset = b->phy_addr - MALLOC_BACKEND_PHY_BASE;
+}
+
+static RK_S32 malloc_backend_alloc(VPUMemLinear_t *p, RK_U32 size)
+{
+    MallocBackendBuf *b;
+    void *buf = NULL;
+
+    b = (MallocBackendBuf *)calloc(1, sizeof(MallocBackendBuf));
+    if (b == NULL || posix_memalign(&buf, VPU_MEM_POOL_ALIGN, size)) {
+        free(b);
+        p->offset = -1;
+        return VPU_ERR;
+    }
+
+    b->vir_addr = (RK_U32 *)buf;
+    b->size = size;
+    b->refs = 1;
+
+    pthread_mutex_lock(&mallocBackendLock);
+    b->phy_addr = mallocBackendPhy;
+    mallocBackendPhy += POOL_ALIGN(size);
+    b->next = mallocBackendBufs;
+    mallocBackendBufs = b;
+    pthread_mutex_unlock(&mallocBackendLock);
+
+    malloc_backend_fill(p, b);
+    return VPU_OK;
+}
+
+static RK_S32 malloc_backend_free(VPUMemLinear_t *p)
+{
+    MallocBackendBuf **link, *b = NULL;
+
+    pthread_mutex_lock(&mallocBackendLock);
+    link = malloc_backend_find(p->phy_addr);
+    if (link != NULL && --(*link)->refs == 0) {
+        b = *link;
+        *link = b->next;
+    }
+    pthread_mutex_unlock(&mallocBackendLock);
+
+    if (link == NULL) {
+        ALOGE("free of unknown buffer 0x%x", p->phy_addr);
+        return VPU_ERR;
+    }
+
+    if (b != NULL) {
+        free(b->vir_addr);
+        free(b);
+    }
+    p->vir_addr = NULL;
+    p->offset = -1;
+    return VPU_OK;
+}
+
+static RK_S32 malloc_backend_duplicate(VPUMemLinear_t *dst, VPUMemLinear_t *src)
+{
+    MallocBackendBuf **link;
+
+    pthread_mutex_lock(&mallocBackendLock);
+    link = malloc_backend_find(src->phy_addr);
+    if (link != NULL) {
+        (*link)->refs++;
+        malloc_backend_fill(dst, *link);
+    }
+    pthread_mutex_unlock(&mallocBackendLock);
+
+    return link != NULL ? VPU_OK : VPU_ERR;
+}
+
+/* the bus address is all a linked descriptor brings, the mapping is shared */
+static RK_S32 malloc_backend_link(VPUMemLinear_t *p)
+{
+    MallocBackendBuf **link;
+
+    pthread_mutex_lock(&mallocBackendLock);
+    link = malloc_backend_find(p->phy_addr);
+    if (link != NULL) {
+        (*link)->refs++;
+        malloc_backend_fill(p, *link);
+    }
+    pthread_mutex_unlock(&mallocBackendLock);
+
+    return link != NULL ? VPU_OK : VPU_ERR;
+}
+
+static const VPUMemPoolBackend_t mallocBackend =
+{
+    malloc_backend_alloc,
+    malloc_backend_free,
+    malloc_backend_duplicate,
+    malloc_backend_link,
+};
+
+const VPUMemPoolBackend_t *VPUMemPoolMallocBackend(void)
+{
+    return &mallocBackend;
+}
@@ -0,0 +1,106 @@
+/***************************************************************************************************
+    File:
+        vpu_mem_pool.h
+    Description:
+        Pooled slab allocator over VPUMemLinear_t. A few large linear regions
+        are carved at init into fixed size classes (stream buffers, reference
+        frames, thumbnails) so that per frame allocations, duplicates and
+        links never go down to the kernel.
+ **************************************************************************************************/
+#ifndef __VPU_MEM_POOL_H__
+#define __VPU_MEM_POOL_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "vpu_mem.h"
+
+/* every block starts on a page so cache maintenance never straddles two blocks */
+#define VPU_MEM_POOL_ALIGN              (4096)
+
+typedef enum
+{
+    VPU_MEM_CLASS_THUMB         = 0x0,
+    VPU_MEM_CLASS_STREAM        = 0x1,
+    VPU_MEM_CLASS_FRAME         = 0x2,
+    VPU_MEM_CLASS_BUTT          ,
+} VPU_MEM_CLASS;
+
+/* size class layout, a class with blockNum == 0 is not carved */
+typedef struct VPUMemPoolClassCfg
+{
+    RK_U32  blockSize;
+    RK_U32  blockNum;
+} VPUMemPoolClassCfg_t;
+
+/*
+ * Where the pool gets its linear regions from. The default backend is
+ * VPUMallocLinear/VPUFreeLinear; VPUMemPoolMallocBackend() returns a
+ * malloc based stand-in with fake bus addresses for running on a PC,
+ * reference counted so duplicate and link work on it too.
+ */
+typedef struct VPUMemPoolBackend
+{
+    RK_S32  (*alloc)(VPUMemLinear_t *p, RK_U32 size);
+    RK_S32  (*free)(VPUMemLinear_t *p);
+    RK_S32  (*duplicate)(VPUMemLinear_t *dst, VPUMemLinear_t *src);
+    RK_S32  (*link)(VPUMemLinear_t *p);
+} VPUMemPoolBackend_t;
+
+typedef struct VPUMemPoolClassStats
+{
+    RK_U32  blockSize;
+    RK_U32  blockNum;
+    RK_U32  blockUsed;
+    RK_U32  blockPeak;
+    RK_U32  bytesRequested;     /* sum of requested sizes of blocks in use */
+    RK_U32  allocFailed;        /* class was exhausted */
+} VPUMemPoolClassStats_t;
+
+typedef struct VPUMemPoolStats
+{
+    VPUMemPoolClassStats_t  cls[VPU_MEM_CLASS_BUTT];
+    RK_U32  regionBytes;        /* linear memory carved, trimmed classes excluded */
+    RK_U32  usedBytes;          /* block bytes handed out */
+    RK_U32  wastedBytes;        /* usedBytes not covered by requests */
+    RK_U32  fallbackAllocs;     /* requests served by the backend directly */
+    RK_U32  fallbackBytes;
+    RK_U32  fragmentation;      /* wastedBytes * 100 / usedBytes */
+} VPUMemPoolStats_t;
+
+typedef struct VPUMemPool VPUMemPool_t;
+
+VPUMemPool_t *VPUMemPoolCreate(const VPUMemPoolClassCfg_t cfg[VPU_MEM_CLASS_BUTT],
+                               const VPUMemPoolBackend_t *backend);
+void VPUMemPoolDestroy(VPUMemPool_t *pool);
+
+/* same contract as VPUMallocLinear/VPUFreeLinear, smallest fitting class first */
+RK_S32 VPUMemPoolMalloc(VPUMemPool_t *pool, VPUMemLinear_t *p, RK_U32 size);
+RK_S32 VPUMemPoolMallocClass(VPUMemPool_t *pool, VPUMemLinear_t *p, RK_U32 size, VPU_MEM_CLASS cls);
+RK_S32 VPUMemPoolFree(VPUMemPool_t *pool, VPUMemLinear_t *p);
+
+/* reference counted in the pool, no kernel call for pooled blocks */
+RK_S32 VPUMemPoolDuplicate(VPUMemPool_t *pool, VPUMemLinear_t *dst, VPUMemLinear_t *src);
+RK_S32 VPUMemPoolLink(VPUMemPool_t *pool, VPUMemLinear_t *p);
+RK_S32 VPUMemPoolRefCount(VPUMemPool_t *pool, VPUMemLinear_t *p);
+
+/*
+ * Give the regions of classes with no block in use back to the backend,
+ * e.g. on memory pressure. A trimmed class is carved again by its next
+ * allocation. Returns the number of classes trimmed.
+ */
+RK_S32 VPUMemPoolTrim(VPUMemPool_t *pool);
+
+RK_S32 VPUMemPoolGetStats(VPUMemPool_t *pool, VPUMemPoolStats_t *stats);
+void VPUMemPoolDump(VPUMemPool_t *pool);
+
+const VPUMemPoolBackend_t *VPUMemPoolMallocBackend(void);
+
+#ifdef __cplusplus
+}
+
+#endif
+
+#endif /* __VPU_MEM_POOL_H__ */
@@ -0,0 +1,233 @@
+/***************************************************************************************************
+    File:
+        vpu_mem_pool_test.c
+    Description:
+        Test of the slab pool on the malloc stand-in backend. Builds for the
+        host:
+
+            vpu_mem_pool_test
+
+        Covers picking the smallest fitting size class and spilling into a
+        larger one, block reuse after free, duplicate and link reference
+        counts inside and outside the pool, the fallback to the backend, and
+        trimming idle classes and carving them again.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vpu_macro.h"
+#include "vpu_mem_pool.h"
+
+#define TEST_THUMB_SIZE             (64 * 1024)
+#define TEST_STREAM_SIZE            (512 * 1024)
+#define TEST_FRAME_SIZE             (1920 * 1088 * 3 / 2)
+
+#ifdef VPU_MEM_POOL_TEST_HOST
+/* the test runs on the malloc stand-in, these only satisfy the default backend */
+RK_S32 VPUMallocLinear(VPUMemLinear_t *p, RK_U32 size)
+{
+    (void)size;
+    p->offset = -1;
+    return VPU_ERR;
+}
+
+RK_S32 VPUFreeLinear(VPUMemLinear_t *p)
+{
+    (void)p;
+    return VPU_ERR;
+}
+
+RK_S32 VPUMemDuplicate(VPUMemLinear_t *dst, VPUMemLinear_t *src)
+{
+    (void)dst;
+    (void)src;
+    return VPU_ERR;
+}
+
+RK_S32 VPUMemLink(VPUMemLinear_t *p)
+{
+    (void)p;
+    return VPU_ERR;
+}
+#endif
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void check_eq(const char *what, long got, long want)
+{
+    if (got != want) {
+        failures++;
+        printf("FAIL: %s: %ld, expected %ld\n", what, got, want);
+    }
+}
+
+static VPUMemPool_t *test_pool(void)
+{
+    static const VPUMemPoolClassCfg_t cfg[VPU_MEM_CLASS_BUTT] = {
+        { TEST_THUMB_SIZE,  2 },
+        { TEST_STREAM_SIZE, 2 },
+        { TEST_FRAME_SIZE,  2 },
+    };
+
+    return VPUMemPoolCreate(cfg, VPUMemPoolMallocBackend());
+}
+
+/* smallest fitting class first, a full class spills into the next one */
+static void test_size_classes(VPUMemPool_t *pool)
+{
+    VPUMemPoolStats_t stats;
+    VPUMemLinear_t m[5];
+
+    check_eq("class: thumb alloc", VPUMemPoolMalloc(pool, &m[0], 1000), VPU_OK);
+    check_eq("class: thumb block size", m[0].size, TEST_THUMB_SIZE);
+    check_eq("class: stream alloc", VPUMemPoolMalloc(pool, &m[1], TEST_THUMB_SIZE + 1), VPU_OK);
+    check_eq("class: stream block size", m[1].size, TEST_STREAM_SIZE);
+    check_eq("class: frame alloc", VPUMemPoolMalloc(pool, &m[2], TEST_FRAME_SIZE), VPU_OK);
+    check_eq("class: frame block size", m[2].size, (TEST_FRAME_SIZE + VPU_MEM_POOL_ALIGN - 1) &
+             ~(VPU_MEM_POOL_ALIGN - 1));
+    check(!(m[2].phy_addr % VPU_MEM_POOL_ALIGN), "class: block page aligned");
+
+    /* with both stream blocks in use the next stream request takes a frame block */
+    check_eq("class: second stream", VPUMemPoolMallocClass(pool, &m[3], 1000,
+             VPU_MEM_CLASS_STREAM), VPU_OK);
+    check_eq("class: stream spill", VPUMemPoolMallocClass(pool, &m[4], 1000,
+             VPU_MEM_CLASS_STREAM), VPU_OK);
+    check_eq("class: stream spill size", m[4].size, m[2].size);
+
+    VPUMemPoolGetStats(pool, &stats);
+    check_eq("class: stream used", stats.cls[VPU_MEM_CLASS_STREAM].blockUsed, 2);
+    check_eq("class: requested bytes", stats.cls[VPU_MEM_CLASS_THUMB].bytesRequested, 1000);
+    check_eq("class: frame used", stats.cls[VPU_MEM_CLASS_FRAME].blockUsed, 2);
+    check_eq("class: no fallback", stats.fallbackAllocs, 0);
+    check(stats.fragmentation > 0 && stats.fragmentation < 100, "class: fragmentation");
+
+    for (int i = 0; i < 5; i++)
+        check_eq("class: free", VPUMemPoolFree(pool, &m[i]), VPU_OK);
+
+    VPUMemPoolGetStats(pool, &stats);
+    check_eq("class: nothing used", stats.usedBytes, 0);
+}
+
+/* a freed block is the next one handed out, without asking the backend */
+static void test_reuse(VPUMemPool_t *pool)
+{
+    VPUMemPoolStats_t stats;
+    VPUMemLinear_t a, b;
+    RK_U32 phy;
+
+    VPUMemPoolMalloc(pool, &a, 4096);
+    phy = a.phy_addr;
+    a.vir_addr[0] = 0x12345678;
+    check_eq("reuse: free", VPUMemPoolFree(pool, &a), VPU_OK);
+    check(VPU_MEM_IS_NULL(&a), "reuse: descriptor cleared");
+    check_eq("reuse: double free", VPUMemPoolFree(pool, &(VPUMemLinear_t){ phy, NULL, 0, 0 }),
+             VPU_ERR);
+
+    VPUMemPoolMalloc(pool, &b, 100);
+    check_eq("reuse: same block", b.phy_addr, phy);
+    VPUMemPoolFree(pool, &b);
+
+    /* more than the largest class goes to the backend and back */
+    check_eq("reuse: fallback alloc", VPUMemPoolMalloc(pool, &a, 8 * 1024 * 1024), VPU_OK);
+    check_eq("reuse: fallback not pooled", VPUMemPoolRefCount(pool, &a), -1);
+    VPUMemPoolGetStats(pool, &stats);
+    check_eq("reuse: fallback counted", stats.fallbackAllocs, 1);
+    check_eq("reuse: fallback free", VPUMemPoolFree(pool, &a), VPU_OK);
+}
+
+/* duplicate and link take references, the block goes back on the last free */
+static void test_refs(VPUMemPool_t *pool)
+{
+    VPUMemLinear_t a, dup, linked, big, bigDup, bigLinked;
+    RK_U32 phy;
+
+    VPUMemPoolMalloc(pool, &a, 4096);
+    phy = a.phy_addr;
+    check_eq("refs: duplicate", VPUMemPoolDuplicate(pool, &dup, &a), VPU_OK);
+    check_eq("refs: duplicate same block", dup.phy_addr, a.phy_addr);
+
+    memset(&linked, 0, sizeof(linked));
+    linked.phy_addr = a.phy_addr;
+    check_eq("refs: link", VPUMemPoolLink(pool, &linked), VPU_OK);
+    check(linked.vir_addr == a.vir_addr, "refs: link maps the block");
+    check_eq("refs: count", VPUMemPoolRefCount(pool, &a), 3);
+
+    VPUMemPoolFree(pool, &a);
+    VPUMemPoolFree(pool, &dup);
+    check_eq("refs: still held", VPUMemPoolRefCount(pool, &linked), 1);
+    VPUMemPoolFree(pool, &linked);
+    check_eq("refs: back in the pool", VPUMemPoolRefCount(pool, &(VPUMemLinear_t){ phy, NULL, 0,
+             0 }), 0);
+
+    /* the stand-in counts references on fallback buffers too */
+    VPUMemPoolMalloc(pool, &big, 8 * 1024 * 1024);
+    check_eq("refs: backend duplicate", VPUMemPoolDuplicate(pool, &bigDup, &big), VPU_OK);
+    bigLinked = big;
+    bigLinked.vir_addr = NULL;
+    check_eq("refs: backend link", VPUMemPoolLink(pool, &bigLinked), VPU_OK);
+    check(bigLinked.vir_addr == big.vir_addr, "refs: backend link maps the buffer");
+
+    VPUMemPoolFree(pool, &big);
+    VPUMemPoolFree(pool, &bigDup);
+    bigLinked.vir_addr[0] = 1;      /* still alive, ASan would catch a use after free */
+    check_eq("refs: backend last free", VPUMemPoolFree(pool, &bigLinked), VPU_OK);
+    big.offset = 0;
+    check_eq("refs: backend gone", VPUMemPoolFree(pool, &big), VPU_ERR);
+}
+
+/* idle classes give their region back and are carved again on demand */
+static void test_trim(VPUMemPool_t *pool)
+{
+    VPUMemPoolStats_t stats;
+    VPUMemLinear_t busy, m;
+    RK_U32 fallbacks;
+
+    VPUMemPoolGetStats(pool, &stats);
+    fallbacks = stats.fallbackAllocs;
+    VPUMemPoolMallocClass(pool, &busy, 1000, VPU_MEM_CLASS_STREAM);
+    check_eq("trim: idle classes", VPUMemPoolTrim(pool), 2);
+    check_eq("trim: nothing left to trim", VPUMemPoolTrim(pool), 0);
+
+    VPUMemPoolGetStats(pool, &stats);
+    check_eq("trim: only the busy class carved", stats.regionBytes, 2 * TEST_STREAM_SIZE);
+    check_eq("trim: busy block kept", VPUMemPoolRefCount(pool, &busy), 1);
+
+    check_eq("trim: recarve", VPUMemPoolMalloc(pool, &m, 1000), VPU_OK);
+    check_eq("trim: recarved class", m.size, TEST_THUMB_SIZE);
+    check_eq("trim: pooled again", VPUMemPoolRefCount(pool, &m), 1);
+    VPUMemPoolGetStats(pool, &stats);
+    check_eq("trim: no fallback", stats.fallbackAllocs, fallbacks);
+
+    VPUMemPoolFree(pool, &m);
+    VPUMemPoolFree(pool, &busy);
+    check_eq("trim: all idle", VPUMemPoolTrim(pool), 2);
+}
+
+int main(void)
+{
+    VPUMemPool_t *pool = test_pool();
+
+    if (pool == NULL) {
+        printf("FAILED: pool create\n");
+        return 1;
+    }
+
+    test_size_classes(pool);
+    test_reuse(pool);
+    test_refs(pool);
+    test_trim(pool);
+
+    VPUMemPoolDestroy(pool);
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,460 @@
+/***************************************************************************************************
+    File:
+        vpu_mem_range.c
+    Description:
+        Range based cache maintenance and CPU dirty tracking for VPUMemLinear_t
+ **************************************************************************************************/
+#define LOG_TAG "vpu_mem_range"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <cutils/log.h>
+#include <cutils/atomic.h>
+
+#include "vpu_macro.h"
+#include "vpu_mem_range.h"
+
+#define LINE_FLOOR(x)       ((x) & ~(VPU_MEM_CACHE_LINE - 1))
+#define LINE_CEIL(x)        (((x) + VPU_MEM_CACHE_LINE - 1) & ~(VPU_MEM_CACHE_LINE - 1))
+
+/*
+ * vpu_mem comes from the pmem driver and keeps its ranged flush: the
+ * region is a byte offset into the device and a length, as for
+ * PMEM_CACHE_FLUSH. There is no ranged clean or invalidate, so the hook
+ * flushes for all three ops.
+ */
+#define VPU_MEM_DEV                 "/dev/vpu_mem"
+#define VPU_MEM_IOCTL_MAGIC         'p'
+#define VPU_MEM_CACHE_FLUSH_RANGE   _IOW(VPU_MEM_IOCTL_MAGIC, 8, unsigned int)
+
+typedef struct
+{
+    unsigned long   offset;
+    unsigned long   len;
+} VPUMemRegion_t;
+
+struct VPUMemDirty
+{
+    VPUMemLinear_t      *mem;
+    RK_U32              granules;
+    RK_U32              words;
+    volatile int32_t    *map;
+};
+
+static RK_S32 whole_buffer_op(VPUMemLinear_t *p, VPU_MEM_CACHE_OP op)
+{
+    switch (op) {
+    case VPU_MEM_CACHE_CLEAN:
+        return VPUMemClean(p);
+    case VPU_MEM_CACHE_INVALIDATE:
+        return VPUMemInvalidate(p);
+    case VPU_MEM_CACHE_FLUSH:
+        return VPUMemFlush(p);
+    default:
+        return VPU_ERR;
+    }
+}
+
+static VPUMemRangeSyncFun rangeSyncHook = NULL;
+static int rangeSyncHookSet = 0;
+static pthread_once_t rangeSyncOnce = PTHREAD_ONCE_INIT;
+static int vpuMemFd = -1;
+static pthread_mutex_t rangeStatsLock = PTHREAD_MUTEX_INITIALIZER;
+static VPUMemRangeStats_t rangeStats;
+
+static RK_S32 vpu_mem_range_sync(VPUMemLinear_t *p, VPU_MEM_CACHE_OP op,
+                                 const VPUMemRange_t *ranges, RK_U32 num)
+{
+    RK_U32 i;
+
+    (void)op;
+
+    for (i = 0; i < num; i++) {
+        VPUMemRegion_t region;
+
+        region.offset = (RK_U32)p->offset + ranges[i].offset;
+        region.len = ranges[i].len;
+        if (ioctl(vpuMemFd, VPU_MEM_CACHE_FLUSH_RANGE, &region)) {
+            if (errno != ENOTTY && errno != EINVAL)
+                return VPU_ERR;
+
+            /* the driver has no ranged flush, stop trying */
+            ALOGW("%s has no ranged cache flush, using whole buffer ops", VPU_MEM_DEV);
+            rangeSyncHook = NULL;
+            return whole_buffer_op(p, VPU_MEM_CACHE_FLUSH);
+        }
+    }
+
+    return VPU_OK;
+}
+
+/* install the vpu_mem hook unless a platform hook was set first */
+static void range_sync_init(void)
+{
+    if (rangeSyncHookSet)
+        return;
+
+    vpuMemFd = open(VPU_MEM_DEV, O_RDWR);
+    if (vpuMemFd < 0) {
+        ALOGW("open %s failed, range ops use whole buffer ops", VPU_MEM_DEV);
+        return;
+    }
+
+    rangeSyncHook = vpu_mem_range_sync;
+}
+
+void VPUMemSetRangeSyncHook(VPUMemRangeSyncFun hook)
+{
+    rangeSyncHookSet = 1;
+    rangeSyncHook = hook;
+}
+
+static int range_cmp(const void *a, const void *b)
+{
+    const VPUMemRange_t *ra = (const VPUMemRange_t *)a;
+    const VPUMemRange_t *rb = (const VPUMemRange_t *)b;
+
+    if (ra->offset < rb->offset)
+        return -1;
+    return ra->offset > rb->offset;
+}
+
+/* merge sorted ranges that overlap or touch, returns the number left */
+static RK_U32 range_merge(VPUMemRange_t *r, RK_U32 n)
+{
+    RK_U32 i, m = 0;
+
+    if (n < 2)
+        return n;
+
+    for (i = 1; i < n; i++) {
+        RK_U32 curEnd = r[m].offset + r[m].len;
+
+        if (r[i].offset <= curEnd) {
+            RK_U32 end = r[i].offset + r[i].len;
+            if (end > curEnd)
+                r[m].len = end - r[m].offset;
+        } else {
+            r[++m] = r[i];
+        }
+    }
+
+    return m + 1;
+}
+
+/*
+ * Clip to the buffer, sort and merge the byte ranges the caller asked for.
+ * Returns the number of ranges left in out.
+ */
+static RK_U32 range_normalize(const VPUMemLinear_t *p, const VPUMemRange_t *in, RK_U32 num,
+                              VPUMemRange_t *out)
+{
+    RK_U32 i, n = 0;
+
+    for (i = 0; i < num && n < VPU_MEM_RANGE_MAX; i++) {
+        RK_U32 start = in[i].offset;
+
+        if (!in[i].len || start >= p->size)
+            continue;
+
+        out[n].offset = start;
+        out[n].len = MIN(in[i].len, p->size - start);
+        n++;
+    }
+
+    if (n > 1)
+        qsort(out, n, sizeof(VPUMemRange_t), range_cmp);
+
+    return range_merge(out, n);
+}
+
+/* widen to whole cache lines, which is what clean and flush work on anyway */
+static RK_U32 range_widen(const VPUMemLinear_t *p, VPUMemRange_t *r, RK_U32 n)
+{
+    RK_U32 i;
+
+    for (i = 0; i < n; i++) {
+        RK_U32 start = LINE_FLOOR(r[i].offset);
+        RK_U32 end = MIN(LINE_CEIL(r[i].offset + r[i].len), p->size);
+
+        r[i].offset = start;
+        r[i].len = end - start;
+    }
+
+    return range_merge(r, n);
+}
+
+/*
+ * Invalidating a line discards all of it, so a line the range only partly
+ * covers may also hold data the CPU has written and not cleaned yet. Those
+ * edge lines are flushed (cleaned, then invalidated) instead, and only the
+ * lines wholly inside a range are invalidated. inner and edges take up to
+ * n and 2 * n ranges.
+ */
+static void range_split(const VPUMemLinear_t *p, const VPUMemRange_t *r, RK_U32 n,
+                        VPUMemRange_t *inner, RK_U32 *numInner,
+                        VPUMemRange_t *edges, RK_U32 *numEdges)
+{
+    RK_U32 i, ni = 0, ne = 0;
+
+    for (i = 0; i < n; i++) {
+        RK_U32 start = r[i].offset;
+        RK_U32 end = r[i].offset + r[i].len;
+        RK_U32 lo = LINE_CEIL(start);
+        /* the tail of the buffer has nothing after it to lose */
+        RK_U32 hi = (end == p->size) ? end : LINE_FLOOR(end);
+
+        if (lo >= hi) {
+            /* within one or two lines, no whole line inside */
+            edges[ne].offset = LINE_FLOOR(start);
+            edges[ne].len = MIN(LINE_CEIL(end), p->size) - edges[ne].offset;
+            ne++;
+            continue;
+        }
+
+        if (start != lo) {
+            edges[ne].offset = LINE_FLOOR(start);
+            edges[ne].len = VPU_MEM_CACHE_LINE;
+            ne++;
+        }
+        inner[ni].offset = lo;
+        inner[ni].len = hi - lo;
+        ni++;
+        if (end != hi) {
+            edges[ne].offset = hi;
+            edges[ne].len = MIN(hi + VPU_MEM_CACHE_LINE, p->size) - hi;
+            ne++;
+        }
+    }
+
+    /* two ranges may end and start in the same line */
+    *numInner = ni;
+    *numEdges = range_merge(edges, ne);
+}
+
+RK_S32 VPUMemSyncRanges(VPUMemLinear_t *p, VPU_MEM_CACHE_OP op,
+                        const VPUMemRange_t *ranges, RK_U32 num)
+{
+    VPUMemRange_t merged[VPU_MEM_RANGE_MAX];
+    VPUMemRange_t inner[VPU_MEM_RANGE_MAX];
+    VPUMemRange_t edges[2 * VPU_MEM_RANGE_MAX];
+    RK_U32 n, i;
+    RK_U32 numInner = 0, numEdges = 0;
+    RK_U32 bytes = 0;
+    RK_S32 whole;
+    RK_S32 ret = VPU_OK;
+
+    if (p == NULL || VPU_MEM_IS_NULL(p) || op >= VPU_MEM_CACHE_BUTT)
+        return VPU_ERR;
+
+    pthread_once(&rangeSyncOnce, range_sync_init);
+
+    if (num > VPU_MEM_RANGE_MAX) {
+        ALOGW("%d ranges submitted, only the first %d are merged", num, VPU_MEM_RANGE_MAX);
+        num = VPU_MEM_RANGE_MAX;
+    }
+
+    n = range_normalize(p, ranges, num, merged);
+    if (!n)
+        return VPU_OK;
+
+    if (op == VPU_MEM_CACHE_INVALIDATE) {
+        range_split(p, merged, n, inner, &numInner, edges, &numEdges);
+        for (i = 0; i < numInner; i++)
+            bytes += inner[i].len;
+        for (i = 0; i < numEdges; i++)
+            bytes += edges[i].len;
+        n = numInner + numEdges;
+    } else {
+        n = range_widen(p, merged, n);
+        for (i = 0; i < n; i++)
+            bytes += merged[i].len;
+    }
+
+    whole = (rangeSyncHook == NULL) ||
+            ((RK_U64)bytes * 100 > (RK_U64)p->size * VPU_MEM_RANGE_WHOLE_PERCENT);
+
+    if (whole) {
+        /* a whole buffer invalidate would drop what the CPU wrote outside the ranges */
+        if (op == VPU_MEM_CACHE_INVALIDATE && bytes < p->size)
+            op = VPU_MEM_CACHE_FLUSH;
+        ret = whole_buffer_op(p, op);
+    } else if (op == VPU_MEM_CACHE_INVALIDATE) {
+        if (numEdges)
+            ret = rangeSyncHook(p, VPU_MEM_CACHE_FLUSH, edges, numEdges);
+        if (numInner && ret == VPU_OK)
+            ret = rangeSyncHook(p, VPU_MEM_CACHE_INVALIDATE, inner, numInner);
+    } else {
+        ret = rangeSyncHook(p, op, merged, n);
+    }
+
+    pthread_mutex_lock(&rangeStatsLock);
+    rangeStats.calls++;
+    rangeStats.rangesIn += num;
+    rangeStats.rangesOut += n;
+    if (whole) {
+        rangeStats.wholeOps++;
+        rangeStats.bytesSynced += p->size;
+    } else {
+        rangeStats.bytesSynced += bytes;
+        rangeStats.bytesSaved += p->size - bytes;
+    }
+    pthread_mutex_unlock(&rangeStatsLock);
+
+    return ret;
+}
+
+RK_S32 VPUMemCleanRange(VPUMemLinear_t *p, RK_U32 offset, RK_U32 len)
+{
+    VPUMemRange_t r = { offset, len };
+    return VPUMemSyncRanges(p, VPU_MEM_CACHE_CLEAN, &r, 1);
+}
+
+RK_S32 VPUMemInvalidateRange(VPUMemLinear_t *p, RK_U32 offset, RK_U32 len)
+{
+    VPUMemRange_t r = { offset, len };
+    return VPUMemSyncRanges(p, VPU_MEM_CACHE_INVALIDATE, &r, 1);
+}
+
+RK_S32 VPUMemFlushRange(VPUMemLinear_t *p, RK_U32 offset, RK_U32 len)
+{
+    VPUMemRange_t r = { offset, len };
+    return VPUMemSyncRanges(p, VPU_MEM_CACHE_FLUSH, &r, 1);
+}
+
+void VPUMemRangeGetStats(VPUMemRangeStats_t *stats)
+{
+    pthread_mutex_lock(&rangeStatsLock);
+    *stats = rangeStats;
+    pthread_mutex_unlock(&rangeStatsLock);
+}
+
+VPUMemDirty_t *VPUMemDirtyCreate(VPUMemLinear_t *p)
+{
+    VPUMemDirty_t *d;
+
+    if (p == NULL || VPU_MEM_IS_NULL(p) || !p->size)
+        return NULL;
+
+    d = (VPUMemDirty_t *)calloc(1, sizeof(VPUMemDirty_t));
+    if (d == NULL)
+        return NULL;
+
+    d->mem = p;
+    d->granules = (p->size + VPU_MEM_DIRTY_GRANULE - 1) / VPU_MEM_DIRTY_GRANULE;
+    d->words = (d->granules + 31) / 32;
+    d->map = (volatile int32_t *)calloc(d->words, sizeof(int32_t));
+    if (d->map == NULL) {
+        free(d);
+        return NULL;
+    }
+
+    return d;
+}
+
+void VPUMemDirtyDestroy(VPUMemDirty_t *d)
+{
+    if (d == NULL)
+        return;
+
+    free((void *)d->map);
+    free(d);
+}
+
+void VPUMemDirtyMark(VPUMemDirty_t *d, RK_U32 offset, RK_U32 len)
+{
+    RK_U32 first, last, g;
+
+    if (d == NULL || !len || offset >= d->mem->size)
+        return;
+
+    if (len > d->mem->size - offset)
+        len = d->mem->size - offset;
+
+    first = offset / VPU_MEM_DIRTY_GRANULE;
+    last = (offset + len - 1) / VPU_MEM_DIRTY_GRANULE;
+
+    /* may be called from several writer threads at once */
+    for (g = first; g <= last; ) {
+        RK_U32 word = g / 32;
+        RK_U32 bit = g % 32;
+        RK_U32 cnt = MIN(32 - bit, last - g + 1);
+        RK_U32 mask = (cnt == 32) ? 0xffffffff : (((1u << cnt) - 1) << bit);
+
+        android_atomic_or((int32_t)mask, &d->map[word]);
+        g += cnt;
+    }
+}
+
+RK_U32 VPUMemDirtyBytes(VPUMemDirty_t *d)
+{
+    RK_U32 i, bits = 0;
+
+    if (d == NULL)
+        return 0;
+
+    for (i = 0; i < d->words; i++)
+        bits += __builtin_popcount((RK_U32)d->map[i]);
+
+    return MIN(bits * VPU_MEM_DIRTY_GRANULE, d->mem->size);
+}
+
+RK_S32 VPUMemDirtyClean(VPUMemDirty_t *d)
+{
+    VPUMemRange_t ranges[VPU_MEM_RANGE_MAX];
+    RK_U32 n = 0;
+    RK_U32 i, g;
+    RK_S32 runStart = -1;
+
+    if (d == NULL)
+        return VPU_ERR;
+
+    for (i = 0; i < d->words; i++) {
+        /* take the word and clear it, marks racing with us land in the next clean */
+        RK_U32 bits = (RK_U32)android_atomic_and(0, &d->map[i]);
+
+        for (g = i * 32; g < MIN((i + 1) * 32, d->granules); g++) {
+            RK_U32 dirty = (bits >> (g % 32)) & 1;
+
+            if (dirty && runStart < 0) {
+                runStart = g;
+            } else if (!dirty && runStart >= 0) {
+                RK_U32 off = runStart * VPU_MEM_DIRTY_GRANULE;
+                RK_U32 len = (g - runStart) * VPU_MEM_DIRTY_GRANULE;
+
+                if (n < VPU_MEM_RANGE_MAX) {
+                    ranges[n].offset = off;
+                    ranges[n].len = len;
+                    n++;
+                } else {
+                    /* out of slots, grow the last range over the gap */
+                    ranges[n - 1].len = off + len - ranges[n - 1].offset;
+                }
+                runStart = -1;
+            }
+        }
+    }
+
+    if (runStart >= 0) {
+        RK_U32 off = runStart * VPU_MEM_DIRTY_GRANULE;
+        RK_U32 len = d->mem->size - off;
+
+        if (n < VPU_MEM_RANGE_MAX) {
+            ranges[n].offset = off;
+            ranges[n].len = len;
+            n++;
+        } else {
+            ranges[n - 1].len = off + len - ranges[n - 1].offset;
+        }
+    }
+
+    if (!n)
+        return VPU_OK;
+
+    return VPUMemSyncRanges(d->mem, VPU_MEM_CACHE_CLEAN, ranges, n);
+}
@@ -0,0 +1,95 @@
+/***************************************************************************************************
+    File:
+        vpu_mem_range.h
+    Description:
+        Range based cache maintenance for VPUMemLinear_t. VPUMemFlush/Clean/
+        Invalidate always work on the whole buffer; these variants take byte
+        ranges, merge batches of them into one submission and can track which
+        parts of a buffer the CPU has dirtied since the last clean.
+ **************************************************************************************************/
+#ifndef __VPU_MEM_RANGE_H__
+#define __VPU_MEM_RANGE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "vpu_mem.h"
+
+/* cache line size ranges are widened to */
+#define VPU_MEM_CACHE_LINE              (32)
+/* merged ranges covering more than this share of the buffer use the whole buffer op */
+#define VPU_MEM_RANGE_WHOLE_PERCENT     (50)
+/* dirty tracking granule */
+#define VPU_MEM_DIRTY_GRANULE           (4096)
+#define VPU_MEM_RANGE_MAX               (32)
+
+typedef enum
+{
+    VPU_MEM_CACHE_CLEAN         = 0x0,  /* write back, CPU wrote the data */
+    VPU_MEM_CACHE_INVALIDATE    = 0x1,  /* discard, hardware wrote the data */
+    VPU_MEM_CACHE_FLUSH         = 0x2,  /* write back and discard */
+    VPU_MEM_CACHE_BUTT          ,
+} VPU_MEM_CACHE_OP;
+
+typedef struct VPUMemRange
+{
+    RK_U32  offset;
+    RK_U32  len;
+} VPUMemRange_t;
+
+/*
+ * Platform hook doing maintenance on a set of sorted, non overlapping,
+ * cache line aligned ranges of one buffer in a single call, in the same
+ * spirit as JpegEncOutInfo::cacheflush. The first range op installs a hook
+ * doing the ranged flush of /dev/vpu_mem unless one was set before; without
+ * a hook a batch costs one whole buffer VPUMemClean/VPUMemInvalidate/
+ * VPUMemFlush. The partial lines at the edges of an invalidate are passed
+ * to the hook as a separate flush.
+ */
+typedef RK_S32 (*VPUMemRangeSyncFun)(VPUMemLinear_t *p, VPU_MEM_CACHE_OP op,
+                                     const VPUMemRange_t *ranges, RK_U32 num);
+
+void VPUMemSetRangeSyncHook(VPUMemRangeSyncFun hook);
+
+typedef struct VPUMemRangeStats
+{
+    RK_U32  calls;              /* range submissions */
+    RK_U32  rangesIn;           /* ranges passed by callers */
+    RK_U32  rangesOut;          /* ranges left after merging */
+    RK_U32  wholeOps;           /* submissions done as whole buffer ops */
+    RK_U64  bytesSynced;
+    RK_U64  bytesSaved;         /* buffer bytes not touched versus whole buffer ops */
+} VPUMemRangeStats_t;
+
+RK_S32 VPUMemCleanRange(VPUMemLinear_t *p, RK_U32 offset, RK_U32 len);
+RK_S32 VPUMemInvalidateRange(VPUMemLinear_t *p, RK_U32 offset, RK_U32 len);
+RK_S32 VPUMemFlushRange(VPUMemLinear_t *p, RK_U32 offset, RK_U32 len);
+
+/* sort, clip and merge up to VPU_MEM_RANGE_MAX ranges and submit them at once */
+RK_S32 VPUMemSyncRanges(VPUMemLinear_t *p, VPU_MEM_CACHE_OP op,
+                        const VPUMemRange_t *ranges, RK_U32 num);
+
+void VPUMemRangeGetStats(VPUMemRangeStats_t *stats);
+
+/*
+ * CPU dirty tracking. Writers mark what they touched (a subtitle stripe, a
+ * thumbnail area) and the owner cleans only those granules before handing
+ * the buffer to hardware.
+ */
+typedef struct VPUMemDirty VPUMemDirty_t;
+
+VPUMemDirty_t *VPUMemDirtyCreate(VPUMemLinear_t *p);
+void VPUMemDirtyDestroy(VPUMemDirty_t *d);
+void VPUMemDirtyMark(VPUMemDirty_t *d, RK_U32 offset, RK_U32 len);
+RK_U32 VPUMemDirtyBytes(VPUMemDirty_t *d);
+/* clean everything marked so far as one batch and reset the map */
+RK_S32 VPUMemDirtyClean(VPUMemDirty_t *d);
+
+#ifdef __cplusplus
+}
+
+#endif
+
+#endif /* __VPU_MEM_RANGE_H__ */
@@ -0,0 +1,191 @@
+/***************************************************************************************************
+    File:
+        vpu_reg_batch.c
+    Description:
+        Field table driven, batched decoder register programming
+ **************************************************************************************************/
+#define LOG_TAG "vpu_reg_batch"
+
+#include <string.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_reg_batch.h"
+#include "regdrv.h"
+
+/* words past the register file, a spec pointing just beyond it lands here */
+#define REG_PROBE_GUARD         (32)
+#define REG_PROBE_WORDS         (VPU_REG_BATCH_REGS + REG_PROBE_GUARD)
+#define REG_FIELD_NONE          (0xffff)    /* left to SetDecRegister */
+#define REG_FIELD_BAD           (0xfffe)    /* outside the register file, never written */
+
+typedef struct VPURegField
+{
+    RK_U16  reg;
+    RK_U8   shift;
+    RK_U8   bits;
+    RK_U32  mask;               /* in place, already shifted */
+} VPURegField_t;
+
+static pthread_once_t regTableOnce = PTHREAD_ONCE_INIT;
+static VPURegField_t regTable[HWIF_LAST_REG];
+
+/*
+ * The field specs are compiled into the decoder library, so the layout is
+ * read back through SetDecRegister: writing all ones to one field of a
+ * zeroed register file sets exactly the bits that field owns. The probe is
+ * the decoder + PP register file the specs index plus guard words, and a
+ * field found outside the file is refused rather than written later into
+ * a caller's array of VPU_REG_NUM_DEC_PP words.
+ */
+static void reg_table_probe(void)
+{
+    RK_U32 probe[REG_PROBE_WORDS];
+    RK_U32 id, r, hits, outside, bad = 0;
+
+    for (id = 0; id < HWIF_LAST_REG; id++) {
+        VPURegField_t *f = &regTable[id];
+        RK_U32 m, field;
+
+        memset(probe, 0, sizeof(probe));
+        SetDecRegister(probe, id, 0xffffffff);
+
+        f->reg = REG_FIELD_NONE;
+        for (r = 0, hits = 0, outside = 0; r < REG_PROBE_WORDS; r++) {
+            if (!probe[r])
+                continue;
+            hits++;
+            if (r >= VPU_REG_BATCH_REGS)
+                outside = 1;
+            f->reg = r;
+        }
+
+        if (outside) {
+            ALOGE("field %d lands in register %d, past the %d word register file", id, f->reg,
+                  VPU_REG_BATCH_REGS);
+            f->reg = REG_FIELD_BAD;
+            continue;
+        }
+
+        m = (hits == 1) ? probe[f->reg] : 0;
+        field = m ? m >> __builtin_ctz(m) : 0;
+        if (!m || (field & (field + 1))) {
+            /* not a single contiguous field, leave it to SetDecRegister */
+            if (hits)
+                bad++;
+            f->reg = REG_FIELD_NONE;
+            continue;
+        }
+
+        f->mask = m;
+        f->shift = __builtin_ctz(m);
+        f->bits = __builtin_popcount(m);
+    }
+
+    if (bad)
+        ALOGW("%d fields do not map to one register, they go through SetDecRegister", bad);
+}
+
+static const VPURegField_t *reg_table(void)
+{
+    pthread_once(&regTableOnce, reg_table_probe);
+    return regTable;
+}
+
+void VPURegSet(RK_U32 *regs, RK_U32 id, RK_U32 value)
+{
+    const VPURegField_t *f;
+
+    if (id >= HWIF_LAST_REG)
+        return;
+
+    f = &reg_table()[id];
+    if (f->reg == REG_FIELD_BAD)
+        return;
+    if (f->reg == REG_FIELD_NONE) {
+        SetDecRegister(regs, id, value);
+        return;
+    }
+
+    regs[f->reg] = (regs[f->reg] & ~f->mask) | ((value << f->shift) & f->mask);
+}
+
+RK_U32 VPURegGet(const RK_U32 *regs, RK_U32 id)
+{
+    const VPURegField_t *f;
+
+    if (id >= HWIF_LAST_REG)
+        return 0;
+
+    f = &reg_table()[id];
+    if (f->reg == REG_FIELD_BAD)
+        return 0;
+    if (f->reg == REG_FIELD_NONE)
+        return GetDecRegister(regs, id);
+
+    return (regs[f->reg] & f->mask) >> f->shift;
+}
+
+void VPURegSetBatch(RK_U32 *regs, const VPURegWrite_t *w, RK_U32 n)
+{
+    const VPURegField_t *table = reg_table();
+    RK_U32 clr[VPU_REG_BATCH_REGS];
+    RK_U32 set[VPU_REG_BATCH_REGS];
+    RK_U32 touched[(VPU_REG_BATCH_REGS + 31) / 32];
+    RK_U32 list[VPU_REG_BATCH_MAX];
+    RK_U32 i, count = 0;
+
+    memset(touched, 0, sizeof(touched));
+
+    for (i = 0; i < n; i++) {
+        const VPURegField_t *f;
+        RK_U32 r;
+
+        if (w[i].id >= HWIF_LAST_REG)
+            continue;
+
+        f = &table[w[i].id];
+        r = f->reg;
+        if (r == REG_FIELD_BAD)
+            continue;
+        if (r == REG_FIELD_NONE || count == VPU_REG_BATCH_MAX) {
+            /* keep the order: fold what is pending first */
+            RK_U32 k;
+            for (k = 0; k < count; k++)
+                regs[list[k]] = (regs[list[k]] & ~clr[list[k]]) | set[list[k]];
+            memset(touched, 0, sizeof(touched));
+            count = 0;
+            if (r == REG_FIELD_NONE) {
+                SetDecRegister(regs, w[i].id, w[i].value);
+                continue;
+            }
+        }
+
+        if (!(touched[r >> 5] & (1u << (r & 31)))) {
+            touched[r >> 5] |= 1u << (r & 31);
+            clr[r] = 0;
+            set[r] = 0;
+            list[count++] = r;
+        }
+        clr[r] |= f->mask;
+        set[r] = (set[r] & ~f->mask) | ((w[i].value << f->shift) & f->mask);
+    }
+
+    /* one read-modify-write per register */
+    for (i = 0; i < count; i++)
+        regs[list[i]] = (regs[list[i]] & ~clr[list[i]]) | set[list[i]];
+}
+
+RK_S32 VPURegBatchApply(RK_U32 *regs, const VPURegBatch_t *b)
+{
+    /* a partial job would run the hardware half configured */
+    if (b->overflow) {
+        ALOGE("register batch overflow, %d fields past the %d slots", b->overflow,
+              VPU_REG_BATCH_MAX);
+        return VPU_ERR;
+    }
+
+    VPURegSetBatch(regs, b->w, b->n);
+    return VPU_OK;
+}
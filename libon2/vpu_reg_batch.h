@@ -0,0 +1,65 @@
+/***************************************************************************************************
+    File:
+        vpu_reg_batch.h
+    Description:
+        Batched register field programming for the decoder and post-processor.
+        SetDecRegister looks up register, shift and mask of one hwIfName_e
+        field per call; here that layout is captured once in a process wide
+        table and a list of (field, value) pairs is merged into a single
+        read-modify-write per 32 bit register.
+ **************************************************************************************************/
+#ifndef __VPU_REG_BATCH_H__
+#define __VPU_REG_BATCH_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "vpu.h"
+
+/* registers a decoder + post-processor job can touch */
+#define VPU_REG_BATCH_REGS              (VPU_REG_NUM_DEC_PP)
+#define VPU_REG_BATCH_MAX               (64)
+
+typedef struct VPURegWrite
+{
+    RK_U32  id;                 /* hwIfName_e */
+    RK_U32  value;
+} VPURegWrite_t;
+
+/* fields collected for one VPURegBatchApply */
+typedef struct VPURegBatch
+{
+    RK_U32          n;
+    RK_U32          overflow;   /* pairs dropped past VPU_REG_BATCH_MAX */
+    VPURegWrite_t   w[VPU_REG_BATCH_MAX];
+} VPURegBatch_t;
+
+#define VPU_REG_BATCH_INIT(b)           ((b)->n = 0, (b)->overflow = 0)
+#define VPU_REG_BATCH_ADD(b, field, val) \
+    do { \
+        if ((b)->n < VPU_REG_BATCH_MAX) { \
+            (b)->w[(b)->n].id = (field); \
+            (b)->w[(b)->n].value = (val); \
+            (b)->n++; \
+        } else { \
+            (b)->overflow++; \
+        } \
+    } while (0)
+
+/* same contract as SetDecRegister / GetDecRegister, from the field table */
+void VPURegSet(RK_U32 *regs, RK_U32 id, RK_U32 value);
+RK_U32 VPURegGet(const RK_U32 *regs, RK_U32 id);
+
+/* a later pair for the same field wins, as with sequential SetDecRegister calls */
+void VPURegSetBatch(RK_U32 *regs, const VPURegWrite_t *w, RK_U32 n);
+/* VPU_ERR and nothing written when the batch overflowed */
+RK_S32 VPURegBatchApply(RK_U32 *regs, const VPURegBatch_t *b);
+
+#ifdef __cplusplus
+}
+
+#endif
+
+#endif /* __VPU_REG_BATCH_H__ */
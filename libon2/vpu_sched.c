@@ -0,0 +1,497 @@
+/***************************************************************************************************
+    File:
+        vpu_sched.c
+    Description:
+        Priority / weighted fair queueing scheduler for VPU client sessions
+ **************************************************************************************************/
+#define LOG_TAG "vpu_sched"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/log.h>
+
+#include "vpu_macro.h"
+#include "vpu_sched.h"
+
+/*
+ * The decoder (with its post-processor) and the encoder are separate blocks
+ * and run in parallel, so each gets its own queue. PP and DEC_PP jobs occupy
+ * the decoder block.
+ */
+#define SCHED_ENGINE_DEC        (0)
+#define SCHED_ENGINE_ENC        (1)
+#define SCHED_ENGINE_NUM        (2)
+
+#define SCHED_STATE_IDLE        (0)
+#define SCHED_STATE_QUEUED      (1)
+#define SCHED_STATE_RUNNING     (2)
+#define SCHED_STATE_FAILED      (3)     /* send refused by the service */
+
+/* first guess of one job's hardware time before anything was measured */
+#define SCHED_INITIAL_EST_US    (5000)
+
+#define SCHED_SIM_SOCKETS       (64)
+#define SCHED_SIM_SOCKET_BASE   (0x5000)
+
+struct VPUSchedSession
+{
+    VPUSchedSession_t   *next;
+    int                 socket;
+    VPU_CLIENT_TYPE     type;
+    RK_U32              engine;
+    VPU_SCHED_PRIO      prio;
+    RK_U32              weight;
+    RK_U32              state;
+    RK_U32              *regs;
+    RK_U32              nregs;
+    RK_S32              sendRet;
+    RK_S64              submitUs;
+    RK_S64              dispatchUs;
+    RK_U64              vtime;      /* hardware time scaled by weight, the WFQ tag */
+    RK_U32              charged;    /* estimate charged to vtime at dispatch */
+    RK_U32              estUs;      /* running estimate of one job's hardware time */
+    RK_U32              aged;       /* current job was promoted by aging */
+    pthread_cond_t      cond;
+    VPUSchedStats_t     stats;
+};
+
+typedef struct SchedEngine
+{
+    VPUSchedSession_t   *sessions;
+    VPUSchedSession_t   *running;
+    RK_U64              vmin;       /* tag of the last dispatched job */
+} SchedEngine_t;
+
+static pthread_mutex_t schedLock = PTHREAD_MUTEX_INITIALIZER;
+static SchedEngine_t schedEngine[SCHED_ENGINE_NUM];
+static RK_U32 schedOpen = 0;
+
+static const VPUSchedBackend_t schedClientBackend = {
+    VPUClientInit,
+    VPUClientRelease,
+    VPUClientSendReg,
+    VPUClientWaitResult,
+};
+static VPUSchedBackend_t schedBackend = {
+    VPUClientInit,
+    VPUClientRelease,
+    VPUClientSendReg,
+    VPUClientWaitResult,
+};
+
+static RK_S64 sched_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static RK_U64 sched_scale(RK_U32 us, RK_U32 weight)
+{
+    return (RK_U64)us * VPU_SCHED_DEFAULT_WEIGHT / weight;
+}
+
+static RK_U32 sched_lat_bucket(RK_U32 us)
+{
+    RK_U32 b = 0;
+
+    while ((us >>= 1) && b < VPU_SCHED_LAT_BUCKETS - 1)
+        b++;
+
+    return b;
+}
+
+void VPUSchedSetBackend(const VPUSchedBackend_t *backend)
+{
+    pthread_mutex_lock(&schedLock);
+    if (schedOpen) {
+        ALOGE("backend change refused, %d sessions open", schedOpen);
+    } else {
+        schedBackend = backend ? *backend : schedClientBackend;
+    }
+    pthread_mutex_unlock(&schedLock);
+}
+
+/*
+ * Lowest class first, where a job queued longer than VPU_SCHED_AGING_US
+ * counts as above every class so background work cannot starve behind a
+ * busy display session. Within a class the smallest virtual time wins, ties
+ * go to the oldest submission.
+ */
+static VPUSchedSession_t *sched_pick(SchedEngine_t *e, RK_S64 now)
+{
+    VPUSchedSession_t *s, *best = NULL;
+    RK_S32 bestClass = 0;
+
+    for (s = e->sessions; s != NULL; s = s->next) {
+        RK_S32 cls;
+
+        if (s->state != SCHED_STATE_QUEUED)
+            continue;
+
+        s->aged = (now - s->submitUs >= VPU_SCHED_AGING_US) && s->prio != VPU_SCHED_PRIO_DISPLAY;
+        cls = s->aged ? -1 : (RK_S32)s->prio;
+
+        if (best == NULL || cls < bestClass ||
+            (cls == bestClass && (s->vtime < best->vtime ||
+                                  (s->vtime == best->vtime && s->submitUs < best->submitUs)))) {
+            best = s;
+            bestClass = cls;
+        }
+    }
+
+    return best;
+}
+
+/* hand the next queued job to an idle engine, call with schedLock held */
+static void sched_dispatch(SchedEngine_t *e)
+{
+    while (e->running == NULL) {
+        RK_S64 now = sched_now_us();
+        VPUSchedSession_t *s = sched_pick(e, now);
+        RK_U32 waitUs;
+
+        if (s == NULL)
+            return;
+
+        waitUs = (RK_U32)(now - s->submitUs);
+        s->stats.queueTimeUs += waitUs;
+        if (waitUs > s->stats.queueMaxUs)
+            s->stats.queueMaxUs = waitUs;
+        s->stats.latHist[sched_lat_bucket(waitUs)]++;
+        if (s->aged)
+            s->stats.aged++;
+
+        e->vmin = s->vtime;
+        s->charged = s->estUs;
+        s->vtime += sched_scale(s->charged, s->weight);
+        s->dispatchUs = now;
+
+        s->sendRet = schedBackend.send(s->socket, s->regs, s->nregs);
+        if (s->sendRet < 0) {
+            ALOGE("socket %d send failed %d", s->socket, s->sendRet);
+            s->vtime -= sched_scale(s->charged, s->weight);
+            s->state = SCHED_STATE_FAILED;
+        } else {
+            s->state = SCHED_STATE_RUNNING;
+            e->running = s;
+        }
+        pthread_cond_signal(&s->cond);
+    }
+}
+
+VPUSchedSession_t *VPUSchedOpen(VPU_CLIENT_TYPE type, VPU_SCHED_PRIO prio, RK_U32 weight)
+{
+    VPUSchedSession_t *s;
+    SchedEngine_t *e;
+
+    if (type >= VPU_TYPE_BUTT || prio >= VPU_SCHED_PRIO_BUTT)
+        return NULL;
+
+    s = (VPUSchedSession_t *)calloc(1, sizeof(VPUSchedSession_t));
+    if (s == NULL)
+        return NULL;
+
+    s->type = type;
+    s->engine = (type == VPU_ENC) ? SCHED_ENGINE_ENC : SCHED_ENGINE_DEC;
+    s->prio = prio;
+    s->weight = weight ? weight : VPU_SCHED_DEFAULT_WEIGHT;
+    s->estUs = SCHED_INITIAL_EST_US;
+    pthread_cond_init(&s->cond, NULL);
+
+    pthread_mutex_lock(&schedLock);
+    s->socket = schedBackend.init(type);
+    if (s->socket < 0) {
+        pthread_mutex_unlock(&schedLock);
+        ALOGE("client init type %d failed", type);
+        pthread_cond_destroy(&s->cond);
+        free(s);
+        return NULL;
+    }
+
+    e = &schedEngine[s->engine];
+    /* a new session starts level with the others instead of owed their history */
+    s->vtime = e->vmin;
+    s->next = e->sessions;
+    e->sessions = s;
+    schedOpen++;
+    pthread_mutex_unlock(&schedLock);
+
+    return s;
+}
+
+RK_S32 VPUSchedClose(VPUSchedSession_t *s)
+{
+    SchedEngine_t *e;
+    VPUSchedSession_t **pp;
+
+    if (s == NULL)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&schedLock);
+    if (s->state == SCHED_STATE_QUEUED || s->state == SCHED_STATE_RUNNING) {
+        pthread_mutex_unlock(&schedLock);
+        ALOGE("close with a job in flight on socket %d", s->socket);
+        return VPU_ERR;
+    }
+
+    e = &schedEngine[s->engine];
+    for (pp = &e->sessions; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == s) {
+            *pp = s->next;
+            break;
+        }
+    }
+    schedBackend.release(s->socket);
+    schedOpen--;
+    pthread_mutex_unlock(&schedLock);
+
+    pthread_cond_destroy(&s->cond);
+    free(s);
+
+    return VPU_OK;
+}
+
+RK_S32 VPUSchedSetPriority(VPUSchedSession_t *s, VPU_SCHED_PRIO prio, RK_U32 weight)
+{
+    if (s == NULL || prio >= VPU_SCHED_PRIO_BUTT)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&schedLock);
+    s->prio = prio;
+    s->weight = weight ? weight : VPU_SCHED_DEFAULT_WEIGHT;
+    pthread_mutex_unlock(&schedLock);
+
+    return VPU_OK;
+}
+
+RK_S32 VPUSchedSendReg(VPUSchedSession_t *s, RK_U32 *regs, RK_U32 nregs)
+{
+    SchedEngine_t *e;
+
+    if (s == NULL || regs == NULL)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&schedLock);
+    if (s->state != SCHED_STATE_IDLE) {
+        pthread_mutex_unlock(&schedLock);
+        ALOGE("socket %d send while the previous job is pending", s->socket);
+        return VPU_ERR;
+    }
+
+    e = &schedEngine[s->engine];
+    s->regs = regs;
+    s->nregs = nregs;
+    s->submitUs = sched_now_us();
+    s->state = SCHED_STATE_QUEUED;
+    /* no credit is banked while a session sits idle */
+    if (s->vtime < e->vmin)
+        s->vtime = e->vmin;
+
+    sched_dispatch(e);
+    pthread_mutex_unlock(&schedLock);
+
+    return VPU_OK;
+}
+
+RK_S32 VPUSchedWaitResult(VPUSchedSession_t *s, RK_U32 *regs, RK_U32 nregs,
+                          VPU_CMD_TYPE *cmd, RK_S32 *len)
+{
+    SchedEngine_t *e;
+    RK_S32 ret;
+    RK_U32 hwUs;
+
+    if (s == NULL)
+        return VPU_ERR;
+
+    pthread_mutex_lock(&schedLock);
+    while (s->state == SCHED_STATE_QUEUED)
+        pthread_cond_wait(&s->cond, &schedLock);
+
+    if (s->state != SCHED_STATE_RUNNING) {
+        ret = (s->state == SCHED_STATE_FAILED) ? s->sendRet : VPU_ERR;
+        s->state = SCHED_STATE_IDLE;
+        pthread_mutex_unlock(&schedLock);
+        return ret;
+    }
+    pthread_mutex_unlock(&schedLock);
+
+    ret = schedBackend.wait(s->socket, regs, nregs, cmd, len);
+
+    pthread_mutex_lock(&schedLock);
+    e = &schedEngine[s->engine];
+    hwUs = (RK_U32)(sched_now_us() - s->dispatchUs);
+
+    s->stats.jobs++;
+    s->stats.hwTimeUs += hwUs;
+    /* replace the estimate charged at dispatch by what the job really took */
+    s->vtime -= sched_scale(s->charged, s->weight);
+    s->vtime += sched_scale(hwUs, s->weight);
+    s->estUs = (s->estUs * 3 + hwUs) / 4;
+    if (!s->estUs)
+        s->estUs = 1;
+
+    s->state = SCHED_STATE_IDLE;
+    e->running = NULL;
+    sched_dispatch(e);
+    pthread_mutex_unlock(&schedLock);
+
+    return ret;
+}
+
+void VPUSchedGetStats(VPUSchedSession_t *s, VPUSchedStats_t *stats)
+{
+    if (s == NULL || stats == NULL)
+        return;
+
+    pthread_mutex_lock(&schedLock);
+    *stats = s->stats;
+    pthread_mutex_unlock(&schedLock);
+}
+
+RK_U32 VPUSchedLatencyPercentile(const VPUSchedStats_t *stats, RK_U32 percent)
+{
+    RK_U64 target, sum = 0;
+    RK_U32 b;
+
+    if (stats == NULL || !stats->jobs)
+        return 0;
+
+    if (percent > 100)
+        percent = 100;
+    target = ((RK_U64)stats->jobs * percent + 99) / 100;
+
+    for (b = 0; b < VPU_SCHED_LAT_BUCKETS; b++) {
+        sum += stats->latHist[b];
+        if (sum >= target && sum)
+            break;
+    }
+    if (b == VPU_SCHED_LAT_BUCKETS)
+        b--;
+
+    /* upper bound of the bucket, capped by the real maximum */
+    return MIN((2u << b) - 1, stats->queueMaxUs);
+}
+
+/*
+ * Simulated VPU service. The scheduler already serialises jobs per engine,
+ * so a job simply finishes usPerJob[type] after it was sent. Useful to
+ * measure fairness and queueing latency without hardware.
+ */
+typedef struct SchedSimSlot
+{
+    RK_U32              used;
+    VPU_CLIENT_TYPE     type;
+    RK_S64              doneUs;
+} SchedSimSlot_t;
+
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+static SchedSimSlot_t simSlot[SCHED_SIM_SOCKETS];
+static RK_U32 simUsPerJob[VPU_TYPE_BUTT];
+
+static int sim_init(VPU_CLIENT_TYPE type)
+{
+    int i, socket = -1;
+
+    pthread_mutex_lock(&simLock);
+    for (i = 0; i < SCHED_SIM_SOCKETS; i++) {
+        if (!simSlot[i].used) {
+            simSlot[i].used = 1;
+            simSlot[i].type = type;
+            simSlot[i].doneUs = 0;
+            socket = SCHED_SIM_SOCKET_BASE + i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return socket;
+}
+
+static SchedSimSlot_t *sim_slot(int socket)
+{
+    int i = socket - SCHED_SIM_SOCKET_BASE;
+
+    if (i < 0 || i >= SCHED_SIM_SOCKETS || !simSlot[i].used)
+        return NULL;
+
+    return &simSlot[i];
+}
+
+static RK_S32 sim_release(int socket)
+{
+    SchedSimSlot_t *slot;
+
+    pthread_mutex_lock(&simLock);
+    slot = sim_slot(socket);
+    if (slot != NULL)
+        slot->used = 0;
+    pthread_mutex_unlock(&simLock);
+
+    return slot ? VPU_OK : VPU_ERR;
+}
+
+static RK_S32 sim_send(int socket, RK_U32 *regs, RK_U32 nregs)
+{
+    SchedSimSlot_t *slot;
+
+    (void)regs;
+    (void)nregs;
+
+    pthread_mutex_lock(&simLock);
+    slot = sim_slot(socket);
+    if (slot != NULL)
+        slot->doneUs = sched_now_us() + simUsPerJob[slot->type];
+    pthread_mutex_unlock(&simLock);
+
+    return slot ? VPU_OK : -1;
+}
+
+static RK_S32 sim_wait(int socket, RK_U32 *regs, RK_U32 nregs, VPU_CMD_TYPE *cmd, RK_S32 *len)
+{
+    SchedSimSlot_t *slot;
+    RK_S64 done = 0;
+    RK_S64 now;
+
+    (void)regs;
+
+    pthread_mutex_lock(&simLock);
+    slot = sim_slot(socket);
+    if (slot != NULL)
+        done = slot->doneUs;
+    pthread_mutex_unlock(&simLock);
+
+    if (slot == NULL)
+        return -1;
+
+    now = sched_now_us();
+    if (done > now)
+        usleep((useconds_t)(done - now));
+
+    if (cmd)
+        *cmd = VPU_SEND_CONFIG_ACK_OK;
+    if (len)
+        *len = nregs * sizeof(RK_U32);
+
+    return VPU_OK;
+}
+
+const VPUSchedBackend_t *VPUSchedSimBackend(const RK_U32 usPerJob[VPU_TYPE_BUTT])
+{
+    static const VPUSchedBackend_t simBackend = {
+        sim_init,
+        sim_release,
+        sim_send,
+        sim_wait,
+    };
+
+    pthread_mutex_lock(&simLock);
+    if (usPerJob != NULL)
+        memcpy(simUsPerJob, usPerJob, sizeof(simUsPerJob));
+    pthread_mutex_unlock(&simLock);
+
+    return &simBackend;
+}
@@ -0,0 +1,87 @@
+/***************************************************************************************************
+    File:
+        vpu_sched.h
+    Description:
+        Session scheduler in front of VPUClientSendReg/VPUClientWaitResult.
+        Without it concurrent decode, encode and post-process clients reach
+        the hardware in whatever order they happen to send. Sessions carry a
+        priority class (live display before background transcode) and a
+        weight; register submissions of the same class are ordered by
+        weighted fair queueing on measured hardware time, and every session
+        keeps its own hardware time and queueing latency accounting.
+
+        Arbitration covers the sessions opened in this process.
+ **************************************************************************************************/
+#ifndef __VPU_SCHED_H__
+#define __VPU_SCHED_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "vpu.h"
+
+/* a queued job waiting this long is served ahead of higher classes */
+#define VPU_SCHED_AGING_US              (100 * 1000)
+#define VPU_SCHED_DEFAULT_WEIGHT        (16)
+#define VPU_SCHED_LAT_BUCKETS           (20)        /* log2 microsecond buckets */
+
+typedef enum
+{
+    VPU_SCHED_PRIO_DISPLAY      = 0x0,  /* frames on screen right now */
+    VPU_SCHED_PRIO_NORMAL       = 0x1,
+    VPU_SCHED_PRIO_BACKGROUND   = 0x2,  /* transcode, thumbnails */
+    VPU_SCHED_PRIO_BUTT         ,
+} VPU_SCHED_PRIO;
+
+/* VPU service entry points, replaceable by a simulation */
+typedef struct VPUSchedBackend
+{
+    int     (*init)(VPU_CLIENT_TYPE type);
+    RK_S32  (*release)(int socket);
+    RK_S32  (*send)(int socket, RK_U32 *regs, RK_U32 nregs);
+    RK_S32  (*wait)(int socket, RK_U32 *regs, RK_U32 nregs, VPU_CMD_TYPE *cmd, RK_S32 *len);
+} VPUSchedBackend_t;
+
+typedef struct VPUSchedStats
+{
+    RK_U32  jobs;
+    RK_U64  hwTimeUs;           /* dispatch to result */
+    RK_U64  queueTimeUs;        /* submission to dispatch */
+    RK_U32  queueMaxUs;
+    RK_U32  aged;               /* jobs promoted by aging */
+    RK_U32  latHist[VPU_SCHED_LAT_BUCKETS];
+} VPUSchedStats_t;
+
+typedef struct VPUSchedSession VPUSchedSession_t;
+
+/* install the service entry points, NULL restores VPUClient*; only with no session open */
+void VPUSchedSetBackend(const VPUSchedBackend_t *backend);
+
+VPUSchedSession_t *VPUSchedOpen(VPU_CLIENT_TYPE type, VPU_SCHED_PRIO prio, RK_U32 weight);
+RK_S32 VPUSchedClose(VPUSchedSession_t *s);
+RK_S32 VPUSchedSetPriority(VPUSchedSession_t *s, VPU_SCHED_PRIO prio, RK_U32 weight);
+
+/*
+ * Same contract as VPUClientSendReg/VPUClientWaitResult: one job in flight
+ * per session, and regs must stay valid until WaitResult returns, since the
+ * job may be handed to the hardware later, from another thread.
+ */
+RK_S32 VPUSchedSendReg(VPUSchedSession_t *s, RK_U32 *regs, RK_U32 nregs);
+RK_S32 VPUSchedWaitResult(VPUSchedSession_t *s, RK_U32 *regs, RK_U32 nregs,
+                          VPU_CMD_TYPE *cmd, RK_S32 *len);
+
+void VPUSchedGetStats(VPUSchedSession_t *s, VPUSchedStats_t *stats);
+/* queueing latency percentile from the histogram, in microseconds */
+RK_U32 VPUSchedLatencyPercentile(const VPUSchedStats_t *stats, RK_U32 percent);
+
+/* simulated service: every job occupies its engine for usPerJob[type] */
+const VPUSchedBackend_t *VPUSchedSimBackend(const RK_U32 usPerJob[VPU_TYPE_BUTT]);
+
+#ifdef __cplusplus
+}
+
+#endif
+
+#endif /* __VPU_SCHED_H__ */
@@ -0,0 +1,228 @@
+/***************************************************************************************************
+    File:
+        vpu_sched_bench.c
+    Description:
+        Fairness and tail latency of the session scheduler on the simulated
+        VPU service. Builds for the host, the service is never opened:
+
+            vpu_sched_bench [seconds]
+
+        The fairness run puts decode sessions of one class and different
+        weights on a saturated decoder and compares each one's share of
+        hardware time to its share of the weights. The latency run paces a
+        60 fps display session against saturating background sessions, once
+        with the display class and once with the background class, and
+        prints the queueing percentiles of the paced session.
+ **************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "vpu_sched.h"
+
+#define BENCH_SESSIONS_MAX          (8)
+#define BENCH_DEC_US                (4000)
+#define BENCH_ENC_US                (8000)
+#define BENCH_PP_US                 (1500)
+#define BENCH_FRAME_US              (16667)
+
+#ifdef VPU_SCHED_BENCH_HOST
+/* the simulation replaces the service, these only satisfy the default backend */
+int VPUClientInit(VPU_CLIENT_TYPE type)
+{
+    (void)type;
+    return -1;
+}
+
+RK_S32 VPUClientRelease(int socket)
+{
+    (void)socket;
+    return -1;
+}
+
+RK_S32 VPUClientSendReg(int socket, RK_U32 *regs, RK_U32 nregs)
+{
+    (void)socket;
+    (void)regs;
+    (void)nregs;
+    return -1;
+}
+
+RK_S32 VPUClientWaitResult(int socket, RK_U32 *regs, RK_U32 nregs, VPU_CMD_TYPE *cmd, RK_S32 *len)
+{
+    (void)socket;
+    (void)regs;
+    (void)nregs;
+    (void)cmd;
+    (void)len;
+    return -1;
+}
+#endif
+
+typedef struct
+{
+    const char          *name;
+    VPU_CLIENT_TYPE     type;
+    VPU_SCHED_PRIO      prio;
+    RK_U32              weight;
+    RK_U32              periodUs;   /* 0: submit back to back */
+    VPUSchedSession_t   *session;
+    pthread_t           thread;
+    VPUSchedStats_t     stats;
+} BenchClient_t;
+
+static volatile int benchStop;
+
+static RK_S64 bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (RK_S64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *bench_client(void *arg)
+{
+    BenchClient_t *c = (BenchClient_t *)arg;
+    RK_U32 regs[VPU_REG_NUM_DEC_PP];
+    RK_S64 next = bench_now_us();
+    VPU_CMD_TYPE cmd;
+    RK_S32 len;
+
+    memset(regs, 0, sizeof(regs));
+    while (!benchStop) {
+        if (c->periodUs) {
+            RK_S64 now = bench_now_us();
+
+            if (next > now)
+                usleep((useconds_t)(next - now));
+            next += c->periodUs;
+        }
+        if (VPUSchedSendReg(c->session, regs, VPU_REG_NUM_DEC_PP) ||
+            VPUSchedWaitResult(c->session, regs, VPU_REG_NUM_DEC_PP, &cmd, &len)) {
+            fprintf(stderr, "%s: job failed\n", c->name);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* run the clients for seconds, their statistics are left in stats */
+static int bench_run(BenchClient_t *c, int n, double seconds)
+{
+    int i;
+
+    benchStop = 0;
+    for (i = 0; i < n; i++) {
+        c[i].session = VPUSchedOpen(c[i].type, c[i].prio, c[i].weight);
+        if (c[i].session == NULL) {
+            fprintf(stderr, "%s: open failed\n", c[i].name);
+            while (i--)
+                VPUSchedClose(c[i].session);
+            return -1;
+        }
+    }
+    for (i = 0; i < n; i++)
+        pthread_create(&c[i].thread, NULL, bench_client, &c[i]);
+
+    usleep((useconds_t)(seconds * 1e6));
+    benchStop = 1;
+
+    for (i = 0; i < n; i++) {
+        pthread_join(c[i].thread, NULL);
+        VPUSchedGetStats(c[i].session, &c[i].stats);
+        VPUSchedClose(c[i].session);
+    }
+    return 0;
+}
+
+static void bench_fairness(double seconds)
+{
+    BenchClient_t c[] = {
+        { "bg w8",  VPU_DEC, VPU_SCHED_PRIO_BACKGROUND,  8, 0, NULL, 0, { 0 } },
+        { "bg w8",  VPU_DEC, VPU_SCHED_PRIO_BACKGROUND,  8, 0, NULL, 0, { 0 } },
+        { "bg w16", VPU_DEC, VPU_SCHED_PRIO_BACKGROUND, 16, 0, NULL, 0, { 0 } },
+        { "bg w32", VPU_DEC, VPU_SCHED_PRIO_BACKGROUND, 32, 0, NULL, 0, { 0 } },
+        { "pp w16", VPU_PP,  VPU_SCHED_PRIO_BACKGROUND, 16, 0, NULL, 0, { 0 } },
+    };
+    int n = sizeof(c) / sizeof(c[0]), i;
+    double hw = 0, weights = 0, sum = 0, sumSq = 0;
+
+    if (bench_run(c, n, seconds))
+        return;
+
+    for (i = 0; i < n; i++) {
+        hw += c[i].stats.hwTimeUs;
+        weights += c[i].weight;
+    }
+
+    printf("fairness: %d sessions on a saturated decoder, %.1f s\n", n, seconds);
+    printf("  session      jobs   hw share  weight share   ratio\n");
+    for (i = 0; i < n; i++) {
+        double share = hw ? c[i].stats.hwTimeUs / hw : 0;
+        double want = c[i].weight / weights;
+        double ratio = share / want;
+
+        sum += ratio;
+        sumSq += ratio * ratio;
+        printf("  %-8s %8u %9.1f%% %12.1f%% %7.2f\n", c[i].name, c[i].stats.jobs,
+               share * 100, want * 100, ratio);
+    }
+    /* Jain's index over share / entitlement, 1.0 is exactly weighted fair */
+    printf("  Jain's fairness index %.3f\n", sumSq ? sum * sum / (n * sumSq) : 0);
+}
+
+static void bench_latency(double seconds, VPU_SCHED_PRIO prio, const char *label)
+{
+    BenchClient_t c[] = {
+        { "display", VPU_DEC_PP, prio,                      16, BENCH_FRAME_US, NULL, 0, { 0 } },
+        { "bg dec",  VPU_DEC,    VPU_SCHED_PRIO_BACKGROUND, 16, 0,              NULL, 0, { 0 } },
+        { "bg dec",  VPU_DEC,    VPU_SCHED_PRIO_BACKGROUND, 16, 0,              NULL, 0, { 0 } },
+        { "bg pp",   VPU_PP,     VPU_SCHED_PRIO_BACKGROUND, 16, 0,              NULL, 0, { 0 } },
+        { "bg enc",  VPU_ENC,    VPU_SCHED_PRIO_BACKGROUND, 16, 0,              NULL, 0, { 0 } },
+    };
+    int n = sizeof(c) / sizeof(c[0]), i;
+
+    if (bench_run(c, n, seconds))
+        return;
+
+    printf("latency: 60 fps display session %s, %.1f s\n", label, seconds);
+    printf("  session      jobs   avg us   p50 us   p99 us   max us\n");
+    for (i = 0; i < n; i++) {
+        VPUSchedStats_t *s = &c[i].stats;
+
+        printf("  %-8s %8u %8llu %8u %8u %8u\n", c[i].name, s->jobs,
+               s->jobs ? (unsigned long long)(s->queueTimeUs / s->jobs) : 0ULL,
+               VPUSchedLatencyPercentile(s, 50), VPUSchedLatencyPercentile(s, 99), s->queueMaxUs);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    RK_U32 usPerJob[VPU_TYPE_BUTT];
+    double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+
+    if (seconds <= 0)
+        seconds = 3.0;
+
+    usPerJob[VPU_ENC] = BENCH_ENC_US;
+    usPerJob[VPU_DEC] = BENCH_DEC_US;
+    usPerJob[VPU_PP] = BENCH_PP_US;
+    usPerJob[VPU_DEC_PP] = BENCH_DEC_US + BENCH_PP_US / 2;
+    VPUSchedSetBackend(VPUSchedSimBackend(usPerJob));
+
+    printf("simulated job times: dec %d us, enc %d us, pp %d us, dec+pp %u us\n\n",
+           BENCH_DEC_US, BENCH_ENC_US, BENCH_PP_US, usPerJob[VPU_DEC_PP]);
+
+    bench_fairness(seconds);
+    printf("\n");
+    bench_latency(seconds, VPU_SCHED_PRIO_DISPLAY, "in the display class");
+    printf("\n");
+    bench_latency(seconds, VPU_SCHED_PRIO_BACKGROUND, "in the background class");
+
+    VPUSchedSetBackend(NULL);
+    return 0;
+}